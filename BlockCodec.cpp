@@ -0,0 +1,259 @@
+#include "BlockCodec.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const uint8_t CODEC_MAGIC0 = 0xB1;
+const uint8_t CODEC_MAGIC1 = 0x0C;
+const uint8_t CODEC_VERSION = 1;
+
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+const int HASH_LOG = 12;
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t hash4(const uint8_t* p) {
+    return (read32(p) * 2654435761u) >> (32 - HASH_LOG);
+}
+
+// 写入扩展长度：每255记一个字节，最后写余数
+inline uint8_t* writeLength(uint8_t* op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = static_cast<uint8_t>(len);
+    return op;
+}
+
+// 读取扩展长度，越界时返回 false
+inline bool readLength(const uint8_t* src, size_t len, size_t& sp, size_t& value) {
+    uint8_t b;
+    do {
+        if (sp >= len) return false;
+        b = src[sp++];
+        value += b;
+    } while (b == 255);
+    return true;
+}
+
+// 输出一个序列：[token][扩展字面量长度][字面量][offset][扩展匹配长度]
+// match_len 为0表示最后一个只有字面量的序列
+uint8_t* writeSequence(uint8_t* op, const uint8_t* literals, size_t literal_len,
+                       size_t offset, size_t match_len) {
+    uint8_t* token = op++;
+    size_t lit_code = literal_len < 15 ? literal_len : 15;
+    size_t match_code = 0;
+
+    if (literal_len >= 15) {
+        op = writeLength(op, literal_len - 15);
+    }
+    if (literal_len > 0) {
+        memcpy(op, literals, literal_len);
+        op += literal_len;
+    }
+
+    if (match_len > 0) {
+        *op++ = static_cast<uint8_t>(offset & 0xFF);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+        size_t ml = match_len - MIN_MATCH;
+        match_code = ml < 15 ? ml : 15;
+        if (ml >= 15) {
+            op = writeLength(op, ml - 15);
+        }
+    }
+
+    *token = static_cast<uint8_t>((lit_code << 4) | match_code);
+    return op;
+}
+
+} // namespace
+
+// ================================
+// LZ 压缩原语
+// ================================
+
+size_t BlockCodec::compressBound(size_t len) {
+    return len + len / 255 + 16;
+}
+
+size_t BlockCodec::compress(const uint8_t* src, size_t len, uint8_t* dst) {
+    // 哈希表记录每个4字节前缀最近出现的位置
+    int32_t table[1 << HASH_LOG];
+    std::fill(table, table + (1 << HASH_LOG), -1);
+
+    uint8_t* op = dst;
+    size_t ip = 0;
+    size_t anchor = 0;
+
+    while (ip + MIN_MATCH <= len) {
+        uint32_t h = hash4(src + ip);
+        int32_t ref = table[h];
+        table[h] = static_cast<int32_t>(ip);
+
+        if (ref >= 0 && ip - ref <= MAX_OFFSET && read32(src + ref) == read32(src + ip)) {
+            // 向后扩展匹配
+            size_t match_len = MIN_MATCH;
+            while (ip + match_len < len && src[ref + match_len] == src[ip + match_len]) {
+                match_len++;
+            }
+
+            op = writeSequence(op, src + anchor, ip - anchor, ip - ref, match_len);
+            ip += match_len;
+            anchor = ip;
+        }
+        else {
+            ip++;
+        }
+    }
+
+    // 剩余字面量
+    op = writeSequence(op, src + anchor, len - anchor, 0, 0);
+    return static_cast<size_t>(op - dst);
+}
+
+bool BlockCodec::decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t raw_len) {
+    size_t sp = 0;
+    size_t op = 0;
+
+    while (true) {
+        if (sp >= len) return false;
+        uint8_t token = src[sp++];
+
+        // 字面量
+        size_t literal_len = token >> 4;
+        if (literal_len == 15 && !readLength(src, len, sp, literal_len)) return false;
+        if (literal_len > len - sp || literal_len > raw_len - op) return false;
+        memcpy(dst + op, src + sp, literal_len);
+        sp += literal_len;
+        op += literal_len;
+
+        // 最后一个序列只有字面量
+        if (sp == len) {
+            return op == raw_len;
+        }
+
+        // 匹配
+        if (len - sp < 2) return false;
+        size_t offset = src[sp] | (static_cast<size_t>(src[sp + 1]) << 8);
+        sp += 2;
+        if (offset == 0 || offset > op) return false;
+
+        size_t match_len = token & 0x0F;
+        if (match_len == 15 && !readLength(src, len, sp, match_len)) return false;
+        match_len += MIN_MATCH;
+        if (match_len > raw_len - op) return false;
+
+        // 允许重叠（offset < match_len 时为重复模式），逐字节复制
+        const uint8_t* ref = dst + op - offset;
+        for (size_t i = 0; i < match_len; i++) {
+            dst[op + i] = ref[i];
+        }
+        op += match_len;
+    }
+}
+
+// ================================
+// 编码 / 解码
+// ================================
+
+bool BlockCodec::isEncoded(const std::vector<uint8_t>& data) {
+    return data.size() >= HEADER_SIZE
+        && data[0] == CODEC_MAGIC0
+        && data[1] == CODEC_MAGIC1
+        && data[2] == CODEC_VERSION;
+}
+
+std::vector<uint8_t> BlockCodec::encode(const std::vector<uint8_t>& raw, size_t size_class) {
+    std::vector<uint8_t> out(HEADER_SIZE + compressBound(raw.size()));
+
+    uint8_t method = LZ;
+    size_t payload_len = compress(raw.data(), raw.size(), out.data() + HEADER_SIZE);
+    if (payload_len >= raw.size()) {
+        // 压缩无收益，原样存储
+        method = STORED;
+        payload_len = raw.size();
+        if (!raw.empty()) {
+            memcpy(out.data() + HEADER_SIZE, raw.data(), raw.size());
+        }
+    }
+
+    uint32_t raw_len32 = static_cast<uint32_t>(raw.size());
+    uint32_t payload_len32 = static_cast<uint32_t>(payload_len);
+    out[0] = CODEC_MAGIC0;
+    out[1] = CODEC_MAGIC1;
+    out[2] = CODEC_VERSION;
+    out[3] = method;
+    memcpy(out.data() + 4, &raw_len32, sizeof(raw_len32));
+    memcpy(out.data() + 8, &payload_len32, sizeof(payload_len32));
+
+    size_t total = HEADER_SIZE + payload_len;
+    if (size_class > 0) {
+        // 固定填充到档位减1：加密时 PKCS#7 补1字节，密文恰为一个档位。
+        // 放不下的块直接拒绝，不向上取整到更大的长度（否则密文长度会暴露块的大小）
+        if (total + 1 > size_class) {
+            std::cerr << "BlockCodec: encoded block of " << total << " bytes does not fit size class "
+                      << size_class << std::endl;
+            return {};
+        }
+        total = size_class - 1;
+    }
+    out.resize(total, 0);
+    return out;
+}
+
+std::vector<uint8_t> BlockCodec::decode(const std::vector<uint8_t>& stored) {
+    if (!isEncoded(stored)) {
+        return stored;
+    }
+
+    uint8_t method = stored[3];
+    uint32_t raw_len;
+    uint32_t payload_len;
+    memcpy(&raw_len, stored.data() + 4, sizeof(raw_len));
+    memcpy(&payload_len, stored.data() + 8, sizeof(payload_len));
+
+    if (payload_len > stored.size() - HEADER_SIZE) {
+        std::cerr << "BlockCodec: truncated payload (" << payload_len << " bytes declared, "
+                  << stored.size() - HEADER_SIZE << " available)" << std::endl;
+        return {};
+    }
+
+    // LZ 最大膨胀比约为255，超出说明头部损坏，避免按错误长度分配内存
+    if (raw_len > static_cast<uint64_t>(payload_len) * 255 + 16) {
+        std::cerr << "BlockCodec: implausible raw length " << raw_len << std::endl;
+        return {};
+    }
+
+    const uint8_t* payload = stored.data() + HEADER_SIZE;
+    std::vector<uint8_t> raw(raw_len);
+
+    if (method == STORED) {
+        if (payload_len != raw_len) {
+            std::cerr << "BlockCodec: stored length mismatch" << std::endl;
+            return {};
+        }
+        if (raw_len > 0) {
+            memcpy(raw.data(), payload, raw_len);
+        }
+        return raw;
+    }
+
+    if (method == LZ) {
+        if (!decompress(payload, payload_len, raw.data(), raw_len)) {
+            std::cerr << "BlockCodec: corrupted compressed block" << std::endl;
+            return {};
+        }
+        return raw;
+    }
+
+    std::cerr << "BlockCodec: unknown method " << static_cast<int>(method) << std::endl;
+    return {};
+}
@@ -0,0 +1,74 @@
+#ifndef BLOCK_CODEC_H
+#define BLOCK_CODEC_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * BlockCodec.h
+ * ----------------------------------------
+ * NodeSerializer 与 RingOramStorage::storeNode 之间可选的压缩层。
+ *
+ * 节点序列化结果中包含大量重复的词项字符串、定长整数和 double，
+ * 使用内置的 LZ 类字节压缩（格式与 LZ4 block 相近）即可明显缩小。
+ * 压缩后的数据被填充到一个固定的大小档位，所有编码块的密文等长，
+ * 同时每个 ORAM 块传输的字节数下降。压缩后仍超出档位的块被拒绝，
+ * 不会填充到更大的长度。
+ *
+ * 编码格式：
+ *   [magic 2B][version 1B][method 1B][raw_len 4B][payload_len 4B][payload][0 填充]
+ */
+
+class BlockCodec {
+public:
+    enum Method : uint8_t {
+        STORED = 0,   ///< 不压缩（压缩无收益时）
+        LZ = 1        ///< 内置 LZ 压缩
+    };
+
+    static const size_t HEADER_SIZE = 12;
+
+    /**
+     * @brief 压缩并填充到大小档位
+     * @param raw 原始数据（NodeSerializer 输出）
+     * @param size_class 大小档位（字节，16的倍数）；0 表示不填充。
+     *        编码长度固定为档位减1，经 PKCS#7 填充加密后密文恰为一个档位
+     * @return 编码后的数据；压缩后放不下档位时返回空向量
+     */
+    static std::vector<uint8_t> encode(const std::vector<uint8_t>& raw, size_t size_class);
+
+    /**
+     * @brief 解码；不带编码头的数据（未开启压缩时写入的块）原样返回
+     * @return 原始数据，数据损坏时返回空向量
+     */
+    static std::vector<uint8_t> decode(const std::vector<uint8_t>& stored);
+
+    /**
+     * @brief 判断数据是否带有编码头
+     */
+    static bool isEncoded(const std::vector<uint8_t>& data);
+
+    // ==============================
+    // LZ 压缩原语
+    // ==============================
+
+    /**
+     * @brief 压缩输出的最大长度
+     */
+    static size_t compressBound(size_t len);
+
+    /**
+     * @brief 压缩 src，dst 至少有 compressBound(len) 字节
+     * @return 压缩后的长度
+     */
+    static size_t compress(const uint8_t* src, size_t len, uint8_t* dst);
+
+    /**
+     * @brief 解压到恰好 raw_len 字节，所有读写都做边界检查
+     * @return 数据合法且长度一致时返回 true
+     */
+    static bool decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t raw_len);
+};
+
+#endif // BLOCK_CODEC_H
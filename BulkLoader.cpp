@@ -0,0 +1,282 @@
+#include "BulkLoader.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// Hilbert 网格的阶数：每个维度 2^16 个格子
+const int HILBERT_ORDER = 16;
+
+double centerOf(const MBR& box, size_t dim) {
+    return (box.getMin()[dim] + box.getMax()[dim]) / 2.0;
+}
+
+// 已排好序的下标按每组 per_node 个顺序切分
+void chunk(const std::vector<size_t>& order, size_t begin, size_t end, size_t per_node,
+    std::vector<std::vector<size_t>>& groups) {
+    for (size_t i = begin; i < end; i += per_node) {
+        size_t group_end = std::min(end, i + per_node);
+        groups.emplace_back(order.begin() + i, order.begin() + group_end);
+    }
+}
+
+// STR 切分：P 个组排成约 √P × √P 的网格，先按 x 切成竖条，竖条内按 y 排序后每 group_size 个一组
+void strGroups(const std::vector<MBR>& boxes, std::vector<size_t>& order, size_t group_size,
+    std::vector<std::vector<size_t>>& groups) {
+    auto by_dim = [&boxes](size_t dim) {
+        return [&boxes, dim](size_t a, size_t b) {
+            return centerOf(boxes[a], dim) < centerOf(boxes[b], dim);
+        };
+    };
+
+    if (order.empty()) {
+        return;
+    }
+    size_t group_count = (order.size() + group_size - 1) / group_size;
+    size_t slices = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(group_count))));
+    size_t slice_size = slices * group_size;
+
+    std::sort(order.begin(), order.end(), by_dim(0));
+    for (size_t begin = 0; begin < order.size(); begin += slice_size) {
+        size_t end = std::min(order.size(), begin + slice_size);
+        std::sort(order.begin() + begin, order.begin() + end, by_dim(1));
+        chunk(order, begin, end, group_size, groups);
+    }
+}
+
+// 按 STR 重新排列条目，之后每 per_node 个顺序切分即为 STR 打包
+void strOrder(const std::vector<MBR>& boxes, std::vector<size_t>& order, size_t per_node) {
+    std::vector<std::vector<size_t>> spatial;
+    strGroups(boxes, order, per_node, spatial);
+    order.clear();
+    for (const auto& group : spatial) {
+        order.insert(order.end(), group.begin(), group.end());
+    }
+}
+
+// 一组条目组成节点的代价：节点 MBR 向外扩展 query_extent 后的面积（与查询范围相交的概率）
+// × 节点含有的不同词项数（查询关键词落在该节点的概率）。
+// 分块内所有条目都含有的词项不计入：无论怎样打包，每个节点都含有它们
+double groupCost(const std::vector<MBR>& boxes, const std::vector<std::vector<int>>& terms,
+    const std::unordered_set<int>& shared_terms, const std::vector<size_t>& order,
+    size_t begin, size_t end, double query_extent) {
+    MBR mbr = boxes[order[begin]];
+    std::vector<int> distinct;
+    for (size_t i = begin; i < end; i++) {
+        mbr.expand(boxes[order[i]]);
+        for (int term : terms[order[i]]) {
+            if (!shared_terms.count(term)) {
+                distinct.push_back(term);
+            }
+        }
+    }
+    std::sort(distinct.begin(), distinct.end());
+    size_t term_count = std::unique(distinct.begin(), distinct.end()) - distinct.begin();
+
+    double cost = static_cast<double>(term_count);
+    for (size_t dim = 0; dim < mbr.getMin().size(); dim++) {
+        cost *= mbr.getMax()[dim] - mbr.getMin()[dim] + query_extent;
+    }
+    return cost;
+}
+
+double packingCost(const std::vector<MBR>& boxes, const std::vector<std::vector<int>>& terms,
+    const std::unordered_set<int>& shared_terms, const std::vector<size_t>& order,
+    size_t per_node, double query_extent) {
+    double cost = 0.0;
+    for (size_t i = 0; i < order.size(); i += per_node) {
+        cost += groupCost(boxes, terms, shared_terms, order, i,
+            std::min(order.size(), i + per_node), query_extent);
+    }
+    return cost;
+}
+
+// 一个空间分块内按词项划分。tile 已按 STR 顺序排列，直接切分即为纯空间打包。
+// 每轮尝试把含某个词项的条目（取整节点数）集中打包、其余条目重新按 STR 打包，
+// 选出总代价下降最多的词项；没有词项能降低代价时停止，剩余条目按空间顺序打包。
+// 与位置相关的词项按空间打包时已经集中，集中后收益很小，不会被选中
+void partitionByTerms(const std::vector<MBR>& boxes, const std::vector<size_t>& tile,
+    const std::vector<std::vector<int>>& terms, size_t per_node, double query_extent,
+    std::vector<std::vector<size_t>>& groups) {
+    std::vector<size_t> remaining = tile;
+
+    std::unordered_map<int, size_t> tile_counts;
+    for (size_t index : tile) {
+        for (int term : terms[index]) {
+            tile_counts[term]++;
+        }
+    }
+    std::unordered_set<int> shared_terms;
+    for (const auto& entry : tile_counts) {
+        if (entry.second == tile.size()) {
+            shared_terms.insert(entry.first);
+        }
+    }
+
+    while (remaining.size() > per_node) {
+        std::unordered_map<int, size_t> counts;
+        for (size_t index : remaining) {
+            for (int term : terms[index]) {
+                counts[term]++;
+            }
+        }
+
+        double base_cost = packingCost(boxes, terms, shared_terms, remaining, per_node, query_extent);
+        double best_cost = base_cost;
+        std::vector<size_t> best_selected, best_rest;
+        for (const auto& entry : counts) {
+            if (entry.second < per_node || entry.second >= remaining.size()) {
+                continue;
+            }
+            size_t take = entry.second / per_node * per_node;
+            std::vector<size_t> selected, rest;
+            for (size_t index : remaining) {
+                const auto& entry_terms = terms[index];
+                if (selected.size() < take &&
+                    std::find(entry_terms.begin(), entry_terms.end(), entry.first) != entry_terms.end()) {
+                    selected.push_back(index);
+                }
+                else {
+                    rest.push_back(index);
+                }
+            }
+            strOrder(boxes, selected, per_node);
+            strOrder(boxes, rest, per_node);
+            double cost = packingCost(boxes, terms, shared_terms, selected, per_node, query_extent) +
+                packingCost(boxes, terms, shared_terms, rest, per_node, query_extent);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_selected.swap(selected);
+                best_rest.swap(rest);
+            }
+        }
+        if (best_selected.empty()) {
+            break;
+        }
+
+        chunk(best_selected, 0, best_selected.size(), per_node, groups);
+        remaining.swap(best_rest);
+    }
+
+    chunk(remaining, 0, remaining.size(), per_node, groups);
+}
+
+} // namespace
+
+size_t BulkLoader::entriesPerNode(int max_entries, double fill_factor) {
+    fill_factor = std::min(std::max(fill_factor, 0.0), 1.0);
+    long entries = std::lround(max_entries * fill_factor);
+    return static_cast<size_t>(std::max(1L, entries));
+}
+
+BulkLoadStrategy BulkLoader::fromInt(int value) {
+    switch (value) {
+    case 1: return BulkLoadStrategy::STR;
+    case 2: return BulkLoadStrategy::HILBERT;
+    case 3: return BulkLoadStrategy::TEXT_AWARE;
+    default: return BulkLoadStrategy::X_SORT;
+    }
+}
+
+const char* BulkLoader::name(BulkLoadStrategy strategy) {
+    switch (strategy) {
+    case BulkLoadStrategy::STR: return "STR";
+    case BulkLoadStrategy::HILBERT: return "Hilbert";
+    case BulkLoadStrategy::TEXT_AWARE: return "text-aware STR";
+    default: return "x-sort";
+    }
+}
+
+uint64_t BulkLoader::hilbertIndex(uint32_t x, uint32_t y, int order) {
+    // 逐层确定所在象限并旋转坐标（Hilbert 曲线的标准迭代算法）
+    uint64_t index = 0;
+    for (uint32_t s = 1u << (order - 1); s > 0; s >>= 1) {
+        uint32_t rx = (x & s) ? 1 : 0;
+        uint32_t ry = (y & s) ? 1 : 0;
+        index += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - (x & (s - 1));
+                y = s - 1 - (y & (s - 1));
+            }
+            std::swap(x, y);
+        }
+        x &= s - 1;
+        y &= s - 1;
+    }
+    return index;
+}
+
+std::vector<std::vector<size_t>> BulkLoader::pack(const std::vector<MBR>& boxes,
+    int max_entries, double fill_factor, BulkLoadStrategy strategy,
+    const std::vector<std::vector<int>>* terms, int tile_nodes, double query_extent) {
+
+    std::vector<std::vector<size_t>> groups;
+    if (boxes.empty()) {
+        return groups;
+    }
+
+    size_t per_node = entriesPerNode(max_entries, fill_factor);
+    std::vector<size_t> order(boxes.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    // STR 和 Hilbert 只使用前两个维度，一维数据退化为按 x 排序
+    if (boxes[0].getMin().size() < 2) {
+        strategy = BulkLoadStrategy::X_SORT;
+    }
+    // 没有词项信息时文本感知打包退化为 STR
+    if (strategy == BulkLoadStrategy::TEXT_AWARE && (!terms || terms->size() != boxes.size())) {
+        strategy = BulkLoadStrategy::STR;
+    }
+
+    switch (strategy) {
+    case BulkLoadStrategy::STR:
+        strGroups(boxes, order, per_node, groups);
+        break;
+    case BulkLoadStrategy::TEXT_AWARE: {
+        // 先按 STR 切成每块 tile_nodes 个节点的空间分块，块内再按词项细分
+        std::vector<std::vector<size_t>> tiles;
+        strGroups(boxes, order, per_node * static_cast<size_t>(std::max(1, tile_nodes)), tiles);
+        for (auto& tile : tiles) {
+            // 块内先按 STR 排列，顺序切分即为纯空间打包
+            strOrder(boxes, tile, per_node);
+            partitionByTerms(boxes, tile, *terms, per_node, query_extent, groups);
+        }
+        break;
+    }
+    case BulkLoadStrategy::HILBERT: {
+        // 中心点归一化到所有条目的包围框，映射到 2^16 × 2^16 网格
+        MBR extent = boxes[0];
+        for (const auto& box : boxes) {
+            extent.expand(box);
+        }
+        double grid = static_cast<double>((1u << HILBERT_ORDER) - 1);
+        auto cell = [&](const MBR& box, size_t dim) {
+            double span = extent.getMax()[dim] - extent.getMin()[dim];
+            double t = span > 0 ? (centerOf(box, dim) - extent.getMin()[dim]) / span : 0.0;
+            return static_cast<uint32_t>(std::lround(t * grid));
+        };
+
+        std::vector<uint64_t> keys(boxes.size());
+        for (size_t i = 0; i < boxes.size(); i++) {
+            keys[i] = hilbertIndex(cell(boxes[i], 0), cell(boxes[i], 1), HILBERT_ORDER);
+        }
+        std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+            return keys[a] < keys[b];
+        });
+        chunk(order, 0, order.size(), per_node, groups);
+        break;
+    }
+    default:
+        std::sort(order.begin(), order.end(), [&boxes](size_t a, size_t b) {
+            return centerOf(boxes[a], 0) < centerOf(boxes[b], 0);
+        });
+        chunk(order, 0, order.size(), per_node, groups);
+        break;
+    }
+
+    return groups;
+}
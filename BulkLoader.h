@@ -0,0 +1,74 @@
+#ifndef BULK_LOADER_H
+#define BULK_LOADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MBR.h"
+
+/*
+ * BulkLoader.h
+ * ----------------------------------------
+ * IRTree::buildTreeBottomUp 使用的打包策略：把同一层的条目（文档或节点）
+ * 分成若干组，每组成为上一层的一个节点。
+ *
+ *   X_SORT  按 MBR 中心的 x 坐标排序后顺序切分（原有做法）。节点是细长的竖条，
+ *           y 方向重叠严重，小范围查询要进入很多子树。
+ *   STR     Sort-Tile-Recursive：先按 x 切成 ⌈√P⌉ 个竖条（P 为节点数），
+ *           每个竖条内再按 y 排序切分，节点接近正方形。
+ *   HILBERT 按 MBR 中心的 Hilbert 曲线序号排序后顺序切分，相邻节点在空间上连续。
+ *   TEXT_AWARE 先按 STR 切成每块 tile_nodes 个节点的空间分块，块内按词项细分：
+ *           每轮选出一个词项，把含它的条目集中成整节点、其余条目重新 STR 打包，
+ *           选择使代价下降最多的词项，没有词项能降低代价时停止。节点代价为
+ *           （MBR 各边加 query_extent 后的面积）×（节点含有的不同词项数），
+ *           近似于一次查询访问该节点的概率。同一节点的条目共享关键词，
+ *           tf_max 和子节点关键词过滤器更有选择性，关键词查询能剪掉更多子树。
+ *
+ * 填充因子决定每个节点装入的条目数（max_entries × fill_factor），
+ * 小于 1 时为之后的逐条插入预留空间，减少分裂。
+ */
+
+/// 批量建树的打包策略（取值与 param.h 中的 bulkLoadStrategy 对应）
+enum class BulkLoadStrategy {
+    X_SORT = 0,
+    STR = 1,
+    HILBERT = 2,
+    TEXT_AWARE = 3
+};
+
+class BulkLoader {
+public:
+    /**
+     * @brief 把一层条目分组
+     * @param boxes 条目的 MBR（文档位置或子节点 MBR）
+     * @param max_entries 节点容量
+     * @param fill_factor 填充因子，(0, 1]
+     * @param strategy 打包策略
+     * @param terms 每个条目的词项 ID（TEXT_AWARE 使用，为空时退化为 STR）
+     * @param tile_nodes TEXT_AWARE 每个空间分块包含的节点数
+     * @param query_extent TEXT_AWARE 估算代价时假设的查询范围边长
+     * @return 每组条目在 boxes 中的下标，组内按打包顺序排列
+     */
+    static std::vector<std::vector<size_t>> pack(const std::vector<MBR>& boxes,
+        int max_entries, double fill_factor, BulkLoadStrategy strategy,
+        const std::vector<std::vector<int>>* terms = nullptr, int tile_nodes = 1,
+        double query_extent = 0.0);
+
+    /// 填充因子对应的每个节点条目数（至少为 1）
+    static size_t entriesPerNode(int max_entries, double fill_factor);
+
+    /// 由参数值得到策略，未知取值返回 X_SORT
+    static BulkLoadStrategy fromInt(int value);
+
+    /// 策略名称（用于输出）
+    static const char* name(BulkLoadStrategy strategy);
+
+    /**
+     * @brief 二维点在 2^order × 2^order 网格上的 Hilbert 曲线序号
+     * @param x 网格横坐标 [0, 2^order)
+     * @param y 网格纵坐标 [0, 2^order)
+     */
+    static uint64_t hilbertIndex(uint32_t x, uint32_t y, int order);
+};
+
+#endif // BULK_LOADER_H
@@ -0,0 +1,208 @@
+#include "ConnectionPool.h"
+#include "NetProtocol.h"
+#include <iostream>
+#include <stdexcept>
+
+ConnectionPool::ConnectionPool(const std::string& endpoint, int port, int connections)
+    : next_index_(0) {
+    if (connections < 1) {
+        connections = 1;
+    }
+
+    for (int i = 0; i < connections; i++) {
+        std::unique_ptr<Connection> conn(new Connection());
+        conn->transport = connectTransport(endpoint, port);
+        connections_.push_back(std::move(conn));
+    }
+
+    // 第0条连接由调用线程驱动，其余连接各启动一个工作线程
+    for (size_t i = 1; i < connections_.size(); i++) {
+        workers_.emplace_back(&ConnectionPool::workerLoop, this, i);
+    }
+}
+
+ConnectionPool::~ConnectionPool() {
+    {
+        std::lock_guard<std::mutex> lock(batch_mutex_);
+        stopping_ = true;
+    }
+    batch_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::string ConnectionPool::describe() const {
+    std::string desc = connections_.empty() || !connections_[0]->transport
+        ? std::string("(none)") : connections_[0]->transport->describe();
+    if (connections_.size() > 1) {
+        desc += " x" + std::to_string(connections_.size());
+    }
+    return desc;
+}
+
+// ================================
+// 单条连接上的请求/响应
+// ================================
+
+// 请求负载由若干分段组成，与请求头一起通过一次聚合写直接从各自的
+// 缓冲区发出；响应写入调用方提供的可复用缓冲区。稳态下整个过程不分配堆内存。
+bool ConnectionPool::call(Connection& conn, uint32_t type, const boost::asio::const_buffer* segments,
+                          size_t num_segments, std::vector<uint8_t>& response_data, std::string& error_msg) {
+    std::lock_guard<std::mutex> lock(conn.mutex);
+
+    if (!conn.transport || !conn.transport->isOpen()) {
+        error_msg = "Network connection is not established or disconnected";
+        return false;
+    }
+
+    if (num_segments > 3) {
+        error_msg = "Too many request segments: " + std::to_string(num_segments);
+        return false;
+    }
+
+    try {
+        // 1. 准备请求头和分段列表（固定大小数组，空分段长度为0）
+        RequestHeader req_header;
+        FrameBuffers buffers;
+        buffers[0] = boost::asio::buffer(&req_header, sizeof(req_header));
+
+        size_t request_len = 0;
+        for (size_t i = 0; i < num_segments; i++) {
+            buffers[i + 1] = segments[i];
+            request_len += segments[i].size();
+        }
+
+        req_header.type = type;
+        req_header.request_id = conn.next_request_id++;
+        req_header.data_len = static_cast<uint32_t>(request_len);
+        req_header.reserved = 0;
+
+        // 2. 发送请求（头和所有分段一次性聚合发送）
+        conn.transport->send(buffers);
+
+        // 3. 接收响应头（TCP 在此设置一次QUICKACK）
+        conn.transport->prepareReceive();
+        ResponseHeader resp_header;
+        conn.transport->receive(&resp_header, sizeof(resp_header));
+
+        // 检查响应是否匹配请求。不匹配时无法确定负载长度是否可信，
+        // 流已失去同步，关闭这条连接，之后的请求直接失败而不是读到错位的数据
+        if (resp_header.request_id != req_header.request_id) {
+            error_msg = "Response ID mismatch: request=" + std::to_string(req_header.request_id)
+                      + ", response=" + std::to_string(resp_header.request_id);
+            conn.transport.reset();
+            return false;
+        }
+
+        if (resp_header.type != RESPONSE) {
+            error_msg = "Invalid response type: " + std::to_string(resp_header.type);
+            conn.transport.reset();
+            return false;
+        }
+
+        // 4. 接收响应数据（resize 在容量足够时不会重新分配）
+        response_data.resize(resp_header.data_len);
+        if (resp_header.data_len > 0) {
+            conn.transport->receive(response_data.data(), resp_header.data_len);
+        }
+
+        if (resp_header.result != 0) {
+            error_msg = "Server operation failed, error code: " + std::to_string(resp_header.result);
+            return false;
+        }
+
+        return true;
+    }
+    catch (const std::exception& e) {
+        // 帧可能只收发了一部分，同样关闭连接
+        error_msg = "Network communication error: " + std::string(e.what());
+        conn.transport.reset();
+        return false;
+    }
+}
+
+bool ConnectionPool::request(uint32_t type, std::initializer_list<boost::asio::const_buffer> segments,
+                             std::vector<uint8_t>& response, std::string& error_msg) {
+    return call(*connections_[0], type, segments.begin(), segments.size(), response, error_msg);
+}
+
+// ================================
+// 批量并行执行
+// ================================
+
+void ConnectionPool::drain(Connection& conn) {
+    while (true) {
+        size_t i = next_index_.fetch_add(1);
+        if (i >= batch_size_) {
+            break;
+        }
+        PoolRequest& req = batch_[i];
+        // 长度为0的分段不会产生任何字节，直接全部传入
+        req.ok = call(conn, req.type, req.segments.data(), req.segments.size(), *req.response, req.error);
+    }
+}
+
+bool ConnectionPool::requestBatch(PoolRequest* requests, size_t count) {
+    if (count == 0) {
+        return true;
+    }
+
+    // batch_ / batch_size_ / next_index_ 同一时刻只能描述一个批次
+    std::lock_guard<std::mutex> call_lock(batch_call_mutex_);
+
+    if (workers_.empty() || count == 1) {
+        // 单连接或单请求：直接在调用线程上顺序执行，免去线程切换
+        batch_ = requests;
+        batch_size_ = count;
+        next_index_.store(0);
+        drain(*connections_[0]);
+    }
+    else {
+        {
+            std::lock_guard<std::mutex> lock(batch_mutex_);
+            batch_ = requests;
+            batch_size_ = count;
+            next_index_.store(0);
+            pending_workers_ = workers_.size();
+            generation_++;
+        }
+        batch_cv_.notify_all();
+
+        drain(*connections_[0]);
+
+        std::unique_lock<std::mutex> lock(batch_mutex_);
+        done_cv_.wait(lock, [this]() { return pending_workers_ == 0; });
+    }
+
+    bool all_ok = true;
+    for (size_t i = 0; i < count; i++) {
+        all_ok = all_ok && requests[i].ok;
+    }
+    return all_ok;
+}
+
+void ConnectionPool::workerLoop(size_t index) {
+    Connection& conn = *connections_[index];
+    uint64_t seen_generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(batch_mutex_);
+            batch_cv_.wait(lock, [&]() { return stopping_ || generation_ != seen_generation; });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = generation_;
+        }
+
+        drain(conn);
+
+        {
+            std::lock_guard<std::mutex> lock(batch_mutex_);
+            if (--pending_workers_ == 0) {
+                done_cv_.notify_one();
+            }
+        }
+    }
+}
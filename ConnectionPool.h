@@ -0,0 +1,126 @@
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Transport.h"
+
+/*
+ * ConnectionPool.h
+ * ----------------------------------------
+ * 客户端到存储服务器的连接池。
+ *
+ * 单条连接上请求严格串行（一问一答），高延迟链路上吞吐受限于
+ * 单个 TCP 流的拥塞窗口和队头阻塞。连接池维护 N 条连接，
+ * 一批相互独立的 bucket 读/写（例如一次驱逐路径上的 L+1 个 bucket）
+ * 被分散到各条连接上并行执行。
+ */
+
+/**
+ * @struct PoolRequest
+ * @brief 批量执行中的一个请求
+ *
+ * 负载分段与响应缓冲区都由调用方持有，连接池只引用它们。
+ */
+struct PoolRequest {
+    uint32_t type = 0;
+    std::array<boost::asio::const_buffer, 3> segments;  ///< 负载分段，未使用的保持长度0
+    std::vector<uint8_t>* response = nullptr;           ///< 响应写入位置（可复用）
+    bool ok = false;                                    ///< 执行结果
+    std::string error;                                  ///< 失败原因
+};
+
+/**
+ * @class ConnectionPool
+ * @brief N 条 Transport 连接 + 每条连接一个常驻工作线程
+ *
+ * 调用线程自身使用第0条连接参与批量执行，其余连接各由一个工作线程驱动；
+ * 批内请求通过共享下标动态领取，先完成的连接继续领取下一个请求。
+ */
+class ConnectionPool {
+public:
+    /**
+     * @brief 建立 connections 条到同一端点的连接
+     * @throws std::exception 任意一条连接失败
+     */
+    ConnectionPool(const std::string& endpoint, int port, int connections);
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    /**
+     * @brief 连接数
+     */
+    int size() const { return static_cast<int>(connections_.size()); }
+
+    /**
+     * @brief 在第0条连接上同步执行单个请求
+     *
+     * 响应与请求不匹配或收发中途出错时，该连接被关闭（流已失去同步），之后的请求直接失败。
+     * @param type 请求类型（见 NetProtocol.h）
+     * @param segments 负载分段（最多3段）
+     * @param response 响应数据（复用调用方缓冲区）
+     * @param error_msg 失败原因
+     */
+    bool request(uint32_t type, std::initializer_list<boost::asio::const_buffer> segments,
+                 std::vector<uint8_t>& response, std::string& error_msg);
+
+    /**
+     * @brief 并行执行一批相互独立的请求，全部完成后返回
+     *
+     * 多个线程同时调用时按调用顺序逐批执行（batch_call_mutex_），批次之间不会交错。
+     * @param requests 请求数组
+     * @param count 请求个数
+     * @return 全部成功返回 true；各请求的结果见 PoolRequest::ok
+     */
+    bool requestBatch(PoolRequest* requests, size_t count);
+
+    /**
+     * @brief 连接描述（用于日志）
+     */
+    std::string describe() const;
+
+private:
+    struct Connection {
+        std::unique_ptr<Transport> transport;
+        std::mutex mutex;
+        uint32_t next_request_id = 1;
+    };
+
+    std::vector<std::unique_ptr<Connection>> connections_;
+    std::vector<std::thread> workers_;
+
+    // 同一时刻只执行一个批次
+    std::mutex batch_call_mutex_;
+
+    // 当前批次（受 batch_mutex_ 保护，next_index_ 除外）
+    std::mutex batch_mutex_;
+    std::condition_variable batch_cv_;
+    std::condition_variable done_cv_;
+    PoolRequest* batch_ = nullptr;
+    size_t batch_size_ = 0;
+    std::atomic<size_t> next_index_;
+    size_t pending_workers_ = 0;
+    uint64_t generation_ = 0;
+    bool stopping_ = false;
+
+    // 单条连接上的一问一答
+    bool call(Connection& conn, uint32_t type, const boost::asio::const_buffer* segments,
+              size_t num_segments, std::vector<uint8_t>& response, std::string& error_msg);
+
+    // 在指定连接上领取并执行当前批次中剩余的请求
+    void drain(Connection& conn);
+
+    void workerLoop(size_t index);
+};
+
+#endif // CONNECTION_POOL_H
@@ -16,6 +16,10 @@ public:
     std::vector<uint8_t> encrypt(const std::vector<uint8_t>& plaintext);
     std::vector<uint8_t> decrypt(const std::vector<uint8_t>& ciphertext);
 
+    // 密钥与 IV（快照保存后用双参数构造函数恢复）
+    const std::vector<uint8_t>& getKey() const { return key; }
+    const std::vector<uint8_t>& getIV() const { return iv; }
+
     static std::vector<uint8_t> generateRandomKey(size_t key_size = 16);
     static std::vector<uint8_t> generateRandomIV(size_t iv_size = 16);
     static std::vector<uint8_t> padData(const std::vector<uint8_t>& data, size_t block_size);
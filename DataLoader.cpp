@@ -0,0 +1,225 @@
+#include "DataLoader.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// 10 的 0~22 次幂都能用 double 精确表示
+const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const uint64_t MAX_EXACT_MANTISSA = 1ULL << 53;
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// 慢速路径：复制到以 0 结尾的缓冲区后交给 strtod（映射区不以 0 结尾）
+bool parseDoubleSlow(const char* begin, const char* end, double& value) {
+    char buffer[64];
+    size_t length = std::min(static_cast<size_t>(end - begin), sizeof(buffer) - 1);
+    std::memcpy(buffer, begin, length);
+    buffer[length] = '\0';
+
+    char* parsed_end = nullptr;
+    value = std::strtod(buffer, &parsed_end);
+    return parsed_end != buffer;
+}
+
+} // namespace
+
+// ==============================
+// MappedFile
+// ==============================
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (mapped_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
+
+bool MappedFile::open(const std::string& filename) {
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot open file " << filename << std::endl;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ == 0) {
+            ::close(fd);
+            return true;
+        }
+        void* address = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address != MAP_FAILED) {
+            madvise(address, size_, MADV_WILLNEED);
+            data_ = static_cast<const char*>(address);
+            mapped_ = true;
+            return true;
+        }
+    }
+    else {
+        ::close(fd);
+    }
+#endif
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot open file " << filename << std::endl;
+        return false;
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+}
+
+// ==============================
+// DataLoader
+// ==============================
+
+bool DataLoader::parseDouble(const char* begin, const char* end, double& value) {
+    const char* p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    // 尾数最多累积 19 位十进制数字（不会溢出 uint64）
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    for (; p < end && isDigit(*p); p++, digits++) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+        }
+    }
+    if (p < end && (*p == 'x' || *p == 'X')) {
+        // 十六进制浮点数
+        return parseDoubleSlow(begin, end, value);
+    }
+    int integer_digits = digits;
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++, digits++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if (digits == 0 || digits > 19 || integer_digits > 19) {
+        // 前导空白、inf/nan 或数字过长
+        return parseDoubleSlow(begin, end, value);
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool exponent_negative = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            exponent_negative = *q == '-';
+            q++;
+        }
+        if (q < end && isDigit(*q)) {
+            int explicit_exponent = 0;
+            for (; q < end && isDigit(*q); q++) {
+                if (explicit_exponent > 10000) {
+                    return parseDoubleSlow(begin, end, value);
+                }
+                explicit_exponent = explicit_exponent * 10 + (*q - '0');
+            }
+            exponent += exponent_negative ? -explicit_exponent : explicit_exponent;
+        }
+    }
+
+    if (mantissa > MAX_EXACT_MANTISSA || exponent < -22 || exponent > 22) {
+        return parseDoubleSlow(begin, end, value);
+    }
+
+    double result = static_cast<double>(mantissa);
+    result = exponent < 0 ? result / POW10[-exponent] : result * POW10[exponent];
+    value = negative ? -result : result;
+    return true;
+}
+
+bool DataLoader::parseLine(const char* begin, const char* end, TextRecord& record) {
+    const char* sep1 = static_cast<const char*>(std::memchr(begin, '|', end - begin));
+    if (!sep1) return false;
+
+    const char* sep2 = static_cast<const char*>(std::memchr(sep1 + 1, '|', end - sep1 - 1));
+    if (!sep2) return false;
+
+    // 与原来的 std::stod 相同：经度解析到第二个 '|' 为止，纬度之后的字段（如 ID）忽略
+    if (!parseDouble(sep1 + 1, sep2, record.lon) || !parseDouble(sep2 + 1, end, record.lat)) {
+        return false;
+    }
+    record.text = begin;
+    record.text_length = static_cast<size_t>(sep1 - begin);
+    return true;
+}
+
+std::vector<TextRecord> DataLoader::parseRecords(const char* data, size_t size, int threads) {
+    threads = resolveThreadCount(threads);
+
+    // 每段的起点移到所在行的下一行开头，每行只属于一段
+    std::vector<size_t> bounds(threads + 1, size);
+    bounds[0] = 0;
+    for (int t = 1; t < threads; t++) {
+        size_t pos = size * t / threads;
+        if (pos > 0) {
+            const char* newline = static_cast<const char*>(std::memchr(data + pos - 1, '\n', size - pos + 1));
+            pos = newline ? static_cast<size_t>(newline - data) + 1 : size;
+        }
+        bounds[t] = std::max(bounds[t - 1], pos);
+    }
+
+    std::vector<std::vector<TextRecord>> parts(threads);
+    parallelFor(parts.size(), threads, [&](size_t t) {
+        const char* p = data + bounds[t];
+        const char* part_end = data + bounds[t + 1];
+        // 按平均行长预估记录数，减少扩容
+        parts[t].reserve((part_end - p) / 48 + 1);
+        while (p < part_end) {
+            const char* line_end = static_cast<const char*>(std::memchr(p, '\n', part_end - p));
+            if (!line_end) line_end = part_end;
+
+            TextRecord record;
+            if (line_end > p && parseLine(p, line_end, record)) {
+                parts[t].push_back(record);
+            }
+            p = line_end + 1;
+        }
+    }, 1);
+
+    size_t total = 0;
+    for (const auto& part : parts) {
+        total += part.size();
+    }
+    std::vector<TextRecord> records;
+    records.reserve(total);
+    for (const auto& part : parts) {
+        records.insert(records.end(), part.begin(), part.end());
+    }
+    return records;
+}
@@ -0,0 +1,80 @@
+#ifndef DATA_LOADER_H
+#define DATA_LOADER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * DataLoader.h
+ * ----------------------------------------
+ * 批量建树读取数据文件（每行 "文本|经度|纬度[|...]"）使用的加载器。
+ *
+ * 文件整体映射到内存（mmap），按行边界切成每线程一段并行解析。
+ * 每条记录只保存文本在映射区中的位置，坐标由快速解析器直接从映射区转换，
+ * 文本直接交给 Document 构造（分词时只复制一次），不再为每行创建临时字符串。
+ * 加载时间主要取决于读盘，而不是内存分配。
+ */
+
+/// 只读映射的文件，析构时解除映射
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief 映射文件
+     * @return 是否成功，失败时输出错误信息
+     */
+    bool open(const std::string& filename);
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+
+    /// 无法映射时（非 POSIX 平台或特殊文件）退化为整体读入
+    std::vector<char> buffer_;
+};
+
+/// 一条记录：文本在映射区中的位置（不复制）与坐标
+struct TextRecord {
+    const char* text;
+    size_t text_length;
+    double lon;
+    double lat;
+};
+
+class DataLoader {
+public:
+    /**
+     * @brief 按行边界切成 threads 段并行解析
+     * @param threads 线程数（<= 0 为硬件线程数）
+     * @return 按文件顺序排列的记录，缺少字段或坐标无法解析的行被跳过
+     */
+    static std::vector<TextRecord> parseRecords(const char* data, size_t size, int threads);
+
+    /**
+     * @brief 解析一行（不含换行符）
+     * @return 是否为有效记录
+     */
+    static bool parseLine(const char* begin, const char* end, TextRecord& record);
+
+    /**
+     * @brief 解析 [begin, end) 开头的浮点数，忽略数字之后的内容（与 std::stod 结果相同）
+     *
+     * 尾数不超过 2^53 且 10 的指数在 ±22 以内时，尾数与 10 的幂都能精确表示，
+     * 一次乘除即得到正确舍入的结果（Clinger 快速路径），坐标数据几乎都走这条路径；
+     * 其他情况复制到临时缓冲区交给 strtod。
+     * @return 开头没有可解析的数字时返回 false
+     */
+    static bool parseDouble(const char* begin, const char* end, double& value);
+};
+
+#endif // DATA_LOADER_H
@@ -10,16 +10,38 @@ Document::Document(int id, const MBR& loc, const std::string& text)
     }
 }
 
+Document::Document(int id, const MBR& loc, std::string text, std::unordered_map<std::string, int>&& freqs)
+    : doc_id(id), location(loc), term_freq(std::move(freqs)), raw_text(std::move(text)) {
+}
+
+Document::Document(int id, const MBR& loc, const char* text, size_t length)
+    : doc_id(id), location(loc), raw_text(text, length) {
+    processText(raw_text.data(), raw_text.size());
+}
+
 void Document::processText(const std::string& text) {
+    processText(text.data(), text.size());
+}
+
+void Document::processText(const char* text, size_t length) {
     term_freq.clear();
 
-    std::stringstream ss(text);
+    // 按空白切分（与 stringstream >> 相同），直接在原文上逐字符处理
     std::string word;
+    size_t i = 0;
+    while (i < length) {
+        while (i < length && std::isspace(static_cast<unsigned char>(text[i]))) {
+            i++;
+        }
 
-    while (ss >> word) {
         // 文本清理：转换为小写，移除标点
-        std::transform(word.begin(), word.end(), word.begin(), ::tolower);
-        word.erase(std::remove_if(word.begin(), word.end(), ::ispunct), word.end());
+        word.clear();
+        for (; i < length && !std::isspace(static_cast<unsigned char>(text[i])); i++) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (!std::ispunct(c)) {
+                word.push_back(static_cast<char>(std::tolower(c)));
+            }
+        }
 
         if (!word.empty()) {
             addTerm(word);
@@ -28,12 +50,8 @@ void Document::processText(const std::string& text) {
 }
 
 void Document::addTerm(const std::string& term, int freq) {
-    if (term_freq.find(term) == term_freq.end()) {
-        term_freq[term] = freq;
-    }
-    else {
-        term_freq[term] += freq;
-    }
+    // 不存在时 operator[] 插入 0，只查找一次
+    term_freq[term] += freq;
 }
 
 int Document::getTermFrequency(const std::string& term) const {
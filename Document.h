@@ -14,9 +14,14 @@ private:
 
 public:
     Document(int id, const MBR& loc, const std::string& text = "");
+    // 已知词频时直接构造（反序列化），不再重新分词
+    Document(int id, const MBR& loc, std::string text, std::unordered_map<std::string, int>&& freqs);
+    // 直接由内存中的一段文本构造（批量加载时文本位于文件映射区，不再创建临时字符串）
+    Document(int id, const MBR& loc, const char* text, size_t length);
 
     // ÎÄ±¾´¦Àí
     void processText(const std::string& text);
+    void processText(const char* text, size_t length);
     void addTerm(const std::string& term, int freq = 1);
 
     // Getter
@@ -10,17 +10,77 @@
 #include <chrono>
 #include "ringoram.h"
 #include "RingoramStorage.h"
+#include "BulkLoader.h"
+#include "Parallel.h"
+#include "DataLoader.h"
+#include "Snapshot.h"
 #include <iomanip>
 #include <random>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <iterator>
+#include <unordered_set>
+
+namespace {
+
+// 固定访问次数模式的每层预算：一层的读取在 ringoram::batchAccess 中按 S（dummyBlockEachbkt）个一组
+// 依次执行，预算超过 S 时每层变成多次往返，延迟随预算增加。截断到 S，保证每层恰好一个并行批次
+int clampObliviousBudget(int budget) {
+    if (budget <= 0) {
+        return 1;
+    }
+    if (budget > dummyBlockEachbkt) {
+        std::cerr << "Warning: oblivious level budget " << budget << " exceeds S = " << dummyBlockEachbkt
+                  << " reads per round trip; using " << dummyBlockEachbkt << std::endl;
+        return dummyBlockEachbkt;
+    }
+    return budget;
+}
+
+// Top-k 分支限界使用的第k名得分：把新加入结果的文档得分放入小顶堆（保留k个），
+// 堆满后堆顶即第k名得分
+void updateKthScore(const std::vector<TreeHeapEntry>& results, size_t first, int k,
+    std::priority_queue<double, std::vector<double>, std::greater<double>>& top_scores,
+    double& kth_score) {
+    for (size_t j = first; j < results.size(); j++) {
+        top_scores.push(results[j].score);
+        if (static_cast<int>(top_scores.size()) > k) {
+            top_scores.pop();
+        }
+    }
+    if (static_cast<int>(top_scores.size()) >= k) {
+        kth_score = top_scores.top();
+    }
+}
+
+} // namespace
 
 
 // 修改构造函数
 IRTree::IRTree(std::shared_ptr<StorageInterface> storage_impl,
-    int dims, int min_cap, int max_cap)
+    int dims, int min_cap, int max_cap, bool init_root)
     : storage(storage_impl), dimensions(dims), min_capacity(min_cap),
-    max_capacity(max_cap), next_node_id(0), next_doc_id(0) {
+    max_capacity(max_cap), next_node_id(0), next_doc_id(0),
+    search_mode(obliviousLevelBudget > 0 ? OBLIVIOUS : (searchFrontierWidth > 0 ? BATCHED : BEST_FIRST)),
+    search_frontier_width(searchFrontierWidth > 0 ? searchFrontierWidth : 1),
+    oblivious_level_budget(clampObliviousBudget(obliviousLevelBudget)),
+    upper_cache(nodeCacheLevels, nodeCacheBytes) {
+
+    auto path_oram_storage = std::dynamic_pointer_cast<RingOramStorage>(storage);
+    if (path_oram_storage && path_oram_storage->isOdsMode()) {
+        ods_storage = path_oram_storage;
+        upper_cache.configure(0, nodeCacheBytes);
+    }
+
+    if (!init_root) {
+        // 之后从快照恢复，不写入存储
+        root_node_id = -1;
+        return;
+    }
 
     // 创建根节点 - 初始化为全零MBR的叶子节点
+    OdsSession session(*this);
     MBR root_mbr(std::vector<double>(dims, 0.0), std::vector<double>(dims, 0.0));
     root_node_id = createNewNode(Node::LEAF, 0, root_mbr);
 
@@ -32,8 +92,17 @@ IRTree::IRTree(std::shared_ptr<StorageInterface> storage_impl,
 
 // 节点管理方法
 std::shared_ptr<Node> IRTree::loadNode(int node_id) const {
-    // 从存储中读取节点数据
-    auto node_data = storage->readNode(node_id);
+    // 从存储中读取节点数据（ODS 模式下按块号读取，叶子取自父节点）
+    std::vector<uint8_t> node_data;
+    if (ods_storage) {
+        int block_id = ods_storage->getNodeBlock(node_id);
+        if (block_id != -1) {
+            node_data = ods_storage->readNodeBlock(block_id, odsLeafHint(block_id));
+        }
+    }
+    else {
+        node_data = storage->readNode(node_id);
+    }
     if (node_data.empty()) {
         std::cout << "No data found for node " << node_id << std::endl;
 
@@ -41,10 +110,13 @@ std::shared_ptr<Node> IRTree::loadNode(int node_id) const {
     }
 
     // 反序列化节点数据为节点对象
-    auto node = NodeSerializer::deserialize(node_data);
+    auto node = decodeNode(node_data);
     if (!node) {
         std::cerr << "Failed to deserialize node " << node_id << std::endl;
     }
+    else if (ods_storage) {
+        registerOdsNode(node);
+    }
 
     return node;
 }
@@ -55,8 +127,13 @@ void IRTree::saveNode(int node_id, std::shared_ptr<Node> node) {
         return;
     }
 
+    // ODS 模式：本次会话中已换到新叶子的子节点，叶子随本次写入一起更新
+    if (ods_storage) {
+        refreshChildLeaves(*node);
+    }
+
     // 序列化节点对象为字节数据
-    auto node_data = NodeSerializer::serialize(*node);
+    auto node_data = encodeNode(*node);
     if (node_data.empty()) {
         std::cerr << "Failed to serialize node " << node_id << std::endl;
         return;
@@ -64,8 +141,82 @@ void IRTree::saveNode(int node_id, std::shared_ptr<Node> node) {
 
     // 存储序列化后的节点数据
     storage->storeNode(node_id, node_data);
+    if (ods_storage) {
+        registerOdsNode(node);
+    }
+
+    // 写穿上层节点缓存：缓存独立的反序列化副本，调用方之后对 node 的修改不影响缓存
+    if (upper_cache.admits(node->getLevel())) {
+        upper_cache.update(decodeNode(node_data));
+    }
+}
+
+
+std::vector<uint8_t> IRTree::encodeNode(const Node& node) {
+    // 完整文档单独存放时叶子节点不写入文本
+    bool include_text = !separateDocuments;
+    if (compactNodeFormat) {
+        return NodeSerializer::serializeCompact(node, vocab, include_text);
+    }
+    return NodeSerializer::serialize(node, include_text);
+}
+
+std::shared_ptr<Node> IRTree::decodeNode(const std::vector<uint8_t>& data) const {
+    return NodeSerializer::deserialize(data, &vocab);
+}
+
+void IRTree::storeFullDocument(const Document& document) {
+    if (!separateDocuments) {
+        return;
+    }
+    if (!storage->storeDocument(document.getId(), NodeSerializer::serializeDocument(document))) {
+        std::cerr << "Failed to store document " << document.getId() << std::endl;
+    }
 }
 
+void IRTree::fetchResultDocuments(const std::vector<std::vector<TreeHeapEntry>*>& results, int pad_to, SearchStats& stats) {
+    if (!separateDocuments) {
+        return;
+    }
+
+    auto path_oram_storage = std::dynamic_pointer_cast<RingOramStorage>(storage);
+    if (!path_oram_storage) {
+        std::cerr << "Storage is not RingOramStorage, cannot fetch result documents" << std::endl;
+        return;
+    }
+
+    std::vector<int> doc_ids;
+    std::vector<TreeHeapEntry*> entries;
+    for (auto* query_results : results) {
+        for (auto& entry : *query_results) {
+            if (entry.isData()) {
+                doc_ids.push_back(entry.document->getId());
+                entries.push_back(&entry);
+            }
+        }
+    }
+
+    // 结果不足时同样读取 pad_to 块，服务器看到的读取次数与结果数无关
+    int fetch_count = std::max(pad_to, static_cast<int>(doc_ids.size()));
+    if (fetch_count == 0) {
+        return;
+    }
+    auto doc_data = path_oram_storage->batchReadDocuments(doc_ids, fetch_count);
+    stats.rounds++;
+    stats.blocks += fetch_count * (OramL - cacheLevel);
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (doc_data[i].empty()) {
+            std::cerr << "Failed to read document " << doc_ids[i] << std::endl;
+            continue;
+        }
+        auto document = NodeSerializer::deserializeDocument(doc_data[i]);
+        if (document) {
+            entries[i]->document = document;
+            stats.documents_fetched++;
+        }
+    }
+}
 
 int IRTree::createNewNode(Node::Type type, int level, const MBR& mbr) {
     // 分配新节点ID并创建节点对象
@@ -102,6 +253,17 @@ double IRTree::computeNodeRelevance(std::shared_ptr<Node> node, const std::vecto
     if (spatial_rel == 0.0) return 0.0;
 
     // 计算文本相关性
+    double text_upper_bound = computeNodeTextUpperBound(node, keywords);
+    if (text_upper_bound == 0.0) return 0.0;
+
+    //计算综合相关性
+    double joint_relevance = computeJointRelevance(text_upper_bound, spatial_rel, alpha);
+
+    return joint_relevance;
+}
+
+double IRTree::computeNodeTextUpperBound(std::shared_ptr<Node> node, const std::vector<std::string>& keywords) const
+{
     double text_upper_bound = 0.0;
     int total_docs = global_index.getTotalDocuments();
     int valid_keywords = 0;
@@ -128,13 +290,32 @@ double IRTree::computeNodeRelevance(std::shared_ptr<Node> node, const std::vecto
     if (valid_keywords == 0) return 0.0;
 
     // 归一化到[0,1]范围 - 除以查询词数量
-    text_upper_bound = std::min(1.0, text_upper_bound / keywords.size());
+    return std::min(1.0, text_upper_bound / keywords.size());
+}
 
-   
-    //计算综合相关性
-    double joint_relevance = computeJointRelevance(text_upper_bound, spatial_rel, alpha);
+double IRTree::computeMaxQueryIdf(const std::vector<std::string>& keywords) const {
+    int total_docs = global_index.getTotalDocuments();
+    double max_idf = 0.0;
+    for (const auto& keyword : keywords) {
+        int term_id = vocab.getTermId(keyword);
+        if (term_id == -1) continue;
 
-    return joint_relevance;
+        int global_df = global_index.getDocumentFrequency(term_id);
+        if (global_df == 0 || total_docs == 0) continue;
+
+        max_idf = std::max(max_idf, std::log(static_cast<double>(total_docs) / global_df));
+    }
+    return max_idf;
+}
+
+double IRTree::computeNodeUpperBound(std::shared_ptr<Node> node, const std::vector<std::string>& keywords, const MBR& spatial_scope, double alpha) const
+{
+    if (!node || !node->getMBR().overlaps(spatial_scope)) return 0.0;
+
+    double text_upper_bound = computeNodeTextUpperBound(node, keywords);
+    if (text_upper_bound == 0.0) return 0.0;
+
+    return computeJointRelevance(text_upper_bound, 1.0, alpha);
 }
 
 void IRTree::processLeafNode(std::shared_ptr<Node> leaf_node,
@@ -193,126 +374,158 @@ void IRTree::processLeafNode(std::shared_ptr<Node> leaf_node,
     }
 }
 
-void IRTree::processInternalNode(std::shared_ptr<Node> internal_node,
+// 使用路径处理内部节点：通过检查的子节点逐个访问
+void IRTree::processInternalNodeWithPath(std::shared_ptr<Node> internal_node,
+    int parent_path,
     const std::vector<std::string>& keywords,
     const MBR& spatial_scope,
     double alpha,
-    std::priority_queue<TreeHeapEntry, std::vector<TreeHeapEntry>, TreeHeapComparator>& queue) const {
+    double prune_bound,
+    std::priority_queue<TreeHeapEntry, std::vector<TreeHeapEntry>, TreeHeapComparator>& queue,
+    SearchStats& stats) {
+
+    std::vector<int> child_paths;
+    collectCandidateChildren(internal_node, keywords, spatial_scope, alpha, prune_bound, child_paths);
 
-    if (internal_node == nullptr || internal_node->getType() != Node::INTERNAL) {
+    for (int child_path : child_paths) {
+        auto child_node = findCachedNode(child_path, stats);
+        if (!child_node) {
+            child_node = accessNodeByPath(child_path);
+            stats.rounds++;
+            stats.blocks += OramL - cacheLevel;
+        }
+        if (!child_node) {
+            std::cerr << "Failed to load child node using path " << child_path << std::endl;
+            continue;
+        }
+        scoreLoadedChild(child_node, child_path, keywords, spatial_scope, alpha, queue);
+    }
+}
+
+void IRTree::collectCandidateChildren(std::shared_ptr<Node> internal_node,
+    const std::vector<std::string>& keywords,
+    const MBR& spatial_scope,
+    double alpha,
+    double prune_bound,
+    std::vector<int>& child_paths,
+    std::vector<double>* upper_bounds) const {
+
+    if (!internal_node || internal_node->getType() != Node::INTERNAL) {
         return;
     }
 
-    auto child_nodes = internal_node->getChildNodes();
+    // 从父节点中获取子节点的位置映射
+    const auto& child_position_map = internal_node->getChildPositionMap();
 
-    for (const auto& child_node_ptr : child_nodes) {
-        int child_id = child_node_ptr->getId();
+    // 查询关键词的哈希与最大 IDF 只计算一次，逐个子节点检查过滤器和上界
+    std::vector<uint64_t> keyword_hashes = KeywordFilter::hashTerms(keywords);
+    double max_idf = computeMaxQueryIdf(keywords);
 
-        // 1. 快速空间检查（使用缓存的MBR）
-        MBR child_mbr = internal_node->getChildMBR(child_id);
+    for (const auto& pos_pair : child_position_map) {
+        int child_id = pos_pair.first;
+        int child_path = pos_pair.second;
+
+        // 没有缓存MBR的子节点只能加载后再检查（见 scoreLoadedChild）
         if (!internal_node->hasChildMBR(child_id)) {
-            // 回退逻辑
-            auto child_node = loadNode(child_id);
-            if (child_node == nullptr) continue;
-            child_mbr = child_node->getMBR();
+            child_paths.push_back(child_path);
+            if (upper_bounds) upper_bounds->push_back(std::numeric_limits<double>::max());
+            continue;
         }
 
-        bool overlaps = child_mbr.overlaps(spatial_scope);
-        if (!overlaps) {
+        // 1. 快速空间检查（使用缓存的MBR）
+        MBR child_mbr = internal_node->getChildMBR(child_id);
+        if (!child_mbr.overlaps(spatial_scope)) {
             continue;
         }
 
         // 2. 快速关键词存在性检查
-        if (!internal_node->childHasAllKeywords(child_id, keywords)) {
-            continue;  // 子节点不包含所有查询关键词，跳过
+        if (!internal_node->childHasAllKeywords(child_id, keyword_hashes)) {
+            continue;  // 子节点不包含所有查询关键词（过滤器可能误报，但不会漏报），跳过
         }
 
-        // 3. 快速上界检查
-        double text_upper_bound = internal_node->getChildTextUpperBound(child_id);
-        double spatial_upper_bound = computeSpatialRelevance(child_mbr, spatial_scope);
-        double total_upper_bound = computeJointRelevance(text_upper_bound, spatial_upper_bound, alpha);
+        // 3. 快速上界检查：父节点中缓存的上界（单个词的最大 log(1+TF)）乘以查询词的最大 IDF
+        //    不小于子树中任一文档的文本相关性；子节点与查询范围相交，空间部分上界为1
+        double text_upper_bound = std::min(1.0, internal_node->getChildTextUpperBound(child_id) * max_idf);
+        double total_upper_bound = computeJointRelevance(text_upper_bound, 1.0, alpha);
 
-        // 如果上界太低，跳过加载子节点
-        if (total_upper_bound < 0.1) {  // 可调整的阈值
+        // 上界不超过当前第k名得分，子树中不可能有文档进入 Top-k
+        if (total_upper_bound <= prune_bound) {
             continue;
         }
 
-        // 4. 只有通过所有检查的子节点才实际加载
-        auto child_node = loadNode(child_id);
-        if (child_node == nullptr) {
-            continue;
-        }
-
-        // 计算精确的相关性
-        double relevance = computeNodeRelevance(child_node, keywords, spatial_scope, alpha);
-        if (relevance > 0) {
-            queue.push(TreeHeapEntry(child_node, relevance));
-        }
+        // 4. 只有通过所有检查的节点才实际加载
+        child_paths.push_back(child_path);
+        if (upper_bounds) upper_bounds->push_back(total_upper_bound);
     }
 }
 
-// 使用路径处理内部节点
-void IRTree::processInternalNodeWithPath(std::shared_ptr<Node> internal_node,
-    int parent_path,
+void IRTree::scoreLoadedChild(std::shared_ptr<Node> child_node,
+    int child_path,
     const std::vector<std::string>& keywords,
     const MBR& spatial_scope,
     double alpha,
-    std::priority_queue<TreeHeapEntry, std::vector<TreeHeapEntry>, TreeHeapComparator>& queue) {
+    std::priority_queue<TreeHeapEntry, std::vector<TreeHeapEntry>, TreeHeapComparator>& queue) const {
+
+    // 计算子树得分上界并加入优先队列（包含路径信息）
+    double upper_bound = computeNodeUpperBound(child_node, keywords, spatial_scope, alpha);
+    if (upper_bound > 0) {
+        queue.push(TreeHeapEntry(child_node, child_path, upper_bound));
+    }
+}
+
+void IRTree::collectNearestChildren(std::shared_ptr<Node> internal_node,
+    const std::vector<uint64_t>& keyword_hashes,
+    double max_idf,
+    const std::vector<double>& location,
+    double max_distance,
+    double alpha,
+    double prune_bound,
+    std::vector<int>& child_paths) const {
 
     if (!internal_node || internal_node->getType() != Node::INTERNAL) {
         return;
     }
 
-    // 从父节点中获取子节点的位置映射
-    const auto& child_position_map = internal_node->getChildPositionMap();
-
-    for (const auto& pos_pair : child_position_map) {
+    for (const auto& pos_pair : internal_node->getChildPositionMap()) {
         int child_id = pos_pair.first;
         int child_path = pos_pair.second;
 
-        // 1. 快速空间检查（使用缓存的MBR）
-        MBR child_mbr = internal_node->getChildMBR(child_id);
+        // 没有缓存MBR的子节点只能加载后再计算上界（见 computeNodeNearestBound）
         if (!internal_node->hasChildMBR(child_id)) {
-            // 如果没有缓存，使用路径访问节点获取MBR
-            auto child_node = accessNodeByPath(child_path);
-            if (!child_node) continue;
-            child_mbr = child_node->getMBR();
-        }
-
-        // 检查空间重叠
-        bool overlaps = child_mbr.overlaps(spatial_scope);
-        if (!overlaps) {
+            child_paths.push_back(child_path);
             continue;
         }
 
-        // 2. 快速关键词存在性检查
-        if (!internal_node->childHasAllKeywords(child_id, keywords)) {
-            continue;  // 子节点不包含所有查询关键词，跳过
+        if (!internal_node->childHasAllKeywords(child_id, keyword_hashes)) {
+            continue;
         }
 
-        // 3. 快速上界检查
-        double text_upper_bound = internal_node->getChildTextUpperBound(child_id);
-        double spatial_upper_bound = computeSpatialRelevance(child_mbr, spatial_scope);
-        double total_upper_bound = computeJointRelevance(text_upper_bound, spatial_upper_bound, alpha);
+        // 子树中任一文档到查询点的距离不小于子节点 MBR 的最小距离，
+        // 文本部分同样使用父节点中缓存的上界
+        double text_upper_bound = std::min(1.0, internal_node->getChildTextUpperBound(child_id) * max_idf);
+        double distance = internal_node->getChildMBR(child_id).minDistance(location);
+        double total_upper_bound = computeJointRelevance(text_upper_bound,
+            computeDistanceRelevance(distance, max_distance), alpha);
 
-        // 如果上界太低，跳过加载子节点
-        if (total_upper_bound < 0.1) {  // 可调整的阈值
+        if (total_upper_bound <= prune_bound) {
             continue;
         }
+        child_paths.push_back(child_path);
+    }
+}
 
-        // 4. 只有通过所有检查的节点才实际加载
-        auto child_node = accessNodeByPath(child_path);
-        if (!child_node) {
-            std::cerr << "Failed to load child node " << child_id << " using path " << child_path << std::endl;
-            continue;
-        }
+double IRTree::computeNodeNearestBound(std::shared_ptr<Node> node,
+    const std::vector<std::string>& keywords,
+    const std::vector<double>& location,
+    double max_distance,
+    double alpha) const {
 
-        // 计算精确的相关性并加入优先队列（包含路径信息）
-        double relevance = computeNodeRelevance(child_node, keywords, spatial_scope, alpha);
-        if (relevance > 0) {
-            queue.push(TreeHeapEntry(child_node, child_path, relevance));
-        }
+    double text_upper_bound = computeNodeTextUpperBound(node, keywords);
+    if (text_upper_bound == 0.0) {
+        return 0.0;  // 子树中没有文档包含查询关键词
     }
+    double distance = node->getMBR().minDistance(location);
+    return computeJointRelevance(text_upper_bound, computeDistanceRelevance(distance, max_distance), alpha);
 }
 
 double IRTree::computeTextRelevance(const Document& doc, const std::vector<std::string>& query_terms) const
@@ -370,274 +583,155 @@ double IRTree::computeSpatialRelevance(const MBR& doc_location, const MBR& query
     return overlap_area / doc_area;
 }
 
+double IRTree::computeDistanceRelevance(double distance, double max_distance) const {
+    if (max_distance <= 0) return 1.0;  // 所有文档都在查询点上
+
+    // 距离线性衰减，max_distance 之外的点（不应出现）得分为0
+    return std::max(0.0, 1.0 - distance / max_distance);
+}
+
 double IRTree::computeJointRelevance(double text_relevance, double spatial_relevance, double alpha) const
 {
     // 线性加权组合文本相关性和空间相关性
     return alpha * text_relevance + (1 - alpha) * spatial_relevance;
 }
 
-int IRTree::chooseLeaf(const MBR& mbr) {
-    int current_id = root_node_id;
-    auto current = loadNode(current_id);
+// ====================================================
+// 插入事务：节点缓冲区
+// ====================================================
 
-    if (!current) {
-        std::cerr << "Failed to load root node " << current_id << std::endl;
-        return -1;
+std::shared_ptr<Node> IRTree::bufferedLoadNode(NodeWriteBuffer& buffer, int node_id) const {
+    auto it = buffer.nodes.find(node_id);
+    if (it != buffer.nodes.end()) {
+        return it->second;
+    }
+    auto node = loadNode(node_id);
+    if (node) {
+        buffer.nodes[node_id] = node;
     }
+    return node;
+}
 
-    // 从根节点开始向下遍历，直到找到叶子节点
-    while (current->getType() != Node::LEAF) {
-        auto children = current->getChildNodes();
-        if (children.empty()) break;
+std::vector<std::shared_ptr<Node>> IRTree::choosePathToLevel(const MBR& mbr, int level, NodeWriteBuffer& buffer) {
+    std::vector<std::shared_ptr<Node>> path;
+    auto current = bufferedLoadNode(buffer, root_node_id);
 
-        // 选择需要最小扩展的子树（R树插入策略）
+    while (current) {
+        path.push_back(current);
+        if (current->getType() == Node::LEAF || current->getLevel() <= level) {
+            return current->getLevel() == level ? path : std::vector<std::shared_ptr<Node>>();
+        }
+
+        // R 树插入策略：扩展面积最小，相同时取面积较小的子节点
         int best_child_id = -1;
         double min_expansion = std::numeric_limits<double>::max();
-
-        for (const auto& child : children) {
-            MBR expanded = child->getMBR();
-            expanded.expand(mbr);  // 扩展MBR以包含新文档
-            double expansion = expanded.area() - child->getMBR().area();  // 计算扩展面积
-
-            // 选择扩展面积最小的子节点，面积相同时选择面积较小的子节点
+        double best_area = 0.0;
+        for (const auto& child : current->getChildNodes()) {
+            MBR child_mbr = current->getChildMBR(child->getId());
+            MBR expanded = child_mbr;
+            expanded.expand(mbr);
+            double area = child_mbr.area();
+            double expansion = expanded.area() - area;
             if (best_child_id == -1 || expansion < min_expansion ||
-                (expansion == min_expansion && child->getMBR().area() <
-                    loadNode(best_child_id)->getMBR().area())) {
+                (expansion == min_expansion && area < best_area)) {
                 min_expansion = expansion;
+                best_area = area;
                 best_child_id = child->getId();
             }
         }
-
-        if (best_child_id == -1) break;
-
-        // 移动到选择的子节点
-        current_id = best_child_id;
-        current = loadNode(current_id);
-        if (!current) break;
-    }
-
-    return current_id;  // 返回选择的叶子节点ID
-}
-
-void IRTree::adjustTree(int node_id)
-{
-    // 首先加载节点
-    auto node = loadNode(node_id);
-    if (!node) {
-        std::cerr << "Failed to load node " << node_id << " for adjustment" << std::endl;
-        return;
+        if (best_child_id == -1) {
+            break;
+        }
+        current = bufferedLoadNode(buffer, best_child_id);
     }
 
-    // 更新节点摘要信息（MBR和文本摘要）
-    node->updateSummary();
-
-    // 保存更新后的节点
-    saveNode(node_id, node);
-
-    // 如果节点溢出，需要分裂
-    if ((node->getType() == Node::LEAF && node->getDocuments().size() > max_capacity) ||
-        (node->getType() == Node::INTERNAL && node->getChildNodes().size() > max_capacity)) {
-        splitNode(node_id);
-    }
+    std::cerr << "Failed to find insertion path at level " << level << std::endl;
+    return {};
 }
 
-
-
-void IRTree::splitNode(int node_id) {
-
-    auto node = loadNode(node_id);
-    if (node == nullptr) {
-        std::cerr << "Failed to load node " << node_id << " for splitting" << std::endl;
-        return;
-    }
+std::shared_ptr<Node> IRTree::splitBufferedNode(std::shared_ptr<Node>& node, NodeWriteBuffer& buffer) {
+    std::shared_ptr<Node> first;
+    std::shared_ptr<Node> second;
 
     if (node->getType() == Node::LEAF) {
+        // 按X坐标排序后从中间分开
         auto documents = node->getDocuments();
-
-
-        if (documents.size() <= max_capacity) {
-            std::cout << "  No need to split - within capacity" << std::endl;
-            return;
-        }
-
-
-        // 按X坐标排序文档，然后分成两部分（线性分裂策略）
-
         std::sort(documents.begin(), documents.end(),
             [](const std::shared_ptr<Document>& a, const std::shared_ptr<Document>& b) {
-                double center_a = a->getLocation().getCenter()[0];
-                double center_b = b->getLocation().getCenter()[0];
-
-                return center_a < center_b;
+                return a->getLocation().getCenter()[0] < b->getLocation().getCenter()[0];
             });
+        size_t split_index = documents.size() / 2;
 
-
-
-        int split_index = documents.size() / 2;  // 中间位置分裂
-
-
-        // 创建两个新节点 - 修复1：计算正确的MBR
-        MBR new_mbr1 = documents[0]->getLocation();
-        MBR new_mbr2 = documents[split_index]->getLocation();
-
-        // 扩展MBR以包含所有分配的文档
-        for (int i = 1; i < split_index; i++) {
-            new_mbr1.expand(documents[i]->getLocation());
-        }
-        for (int i = split_index + 1; i < documents.size(); i++) {
-            new_mbr2.expand(documents[i]->getLocation());
-        }
-
-        int new_node_id1 = createNewNode(Node::LEAF, node->getLevel(), new_mbr1);
-        int new_node_id2 = createNewNode(Node::LEAF, node->getLevel(), new_mbr2);
-
-        auto new_node1 = loadNode(new_node_id1);
-        auto new_node2 = loadNode(new_node_id2);
-
-        if (new_node1 == nullptr || new_node2 == nullptr) {
-            std::cerr << "? Failed to create new nodes for splitting" << std::endl;
-            return;
-        }
-
-
-        // 分配文档到两个新节点
-        for (int i = 0; i < split_index; i++) {
-            new_node1->addDocument(documents[i]);
-
-        }
-        for (int i = split_index; i < documents.size(); i++) {
-            new_node2->addDocument(documents[i]);
-
+        first = std::make_shared<Node>(node->getId(), Node::LEAF, 0, documents[0]->getLocation());
+        second = std::make_shared<Node>(next_node_id++, Node::LEAF, 0, documents[split_index]->getLocation());
+        for (size_t i = 0; i < documents.size(); i++) {
+            (i < split_index ? first : second)->addDocument(documents[i]);
         }
-
-
-        new_node1->updateSummary();
-        new_node2->updateSummary();
-
-
-
-        // 保存新节点
-        saveNode(new_node_id1, new_node1);
-        saveNode(new_node_id2, new_node2);
-
-        // 如果是根节点，创建新的根节点
-        if (node_id == root_node_id) {
-
-            MBR root_mbr = new_mbr1;
-            root_mbr.expand(new_mbr2);
-
-            int new_root_id = createNewNode(Node::INTERNAL, node->getLevel() + 1, root_mbr);
-            auto new_root = loadNode(new_root_id);
-
-            if (new_root != nullptr) {
-                // 重新加载实际的子节点对象
-                auto child1 = loadNode(new_node_id1);
-                auto child2 = loadNode(new_node_id2);
-
-                if (child1 != nullptr && child2 != nullptr) {
-                    new_root->addChild(child1);
-                    new_root->addChild(child2);
-                    saveNode(new_root_id, new_root);
-                    root_node_id = new_root_id;  // 更新根节点ID
-
-
-                    // 删除旧的根节点
-                    storage->deleteNode(node_id);
-
-                }
-                else {
-                    std::cerr << "Failed to load child nodes for new root" << std::endl;
-                }
-            }
-        }
-
     }
     else {
-        // 内部节点的分裂 - 类似修复
+        // 子节点多为占位对象，按父节点中存储的子节点MBR排序
+        const Node& source = *node;
         auto children = node->getChildNodes();
-
-
-        if (children.size() <= max_capacity) {
-
-            return;
-        }
-
-
-
-        // 按X坐标排序子节点
         std::sort(children.begin(), children.end(),
-            [](const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b) {
-                return a->getMBR().getCenter()[0] < b->getMBR().getCenter()[0];
+            [&source](const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b) {
+                return source.getChildMBR(a->getId()).getCenter()[0] < source.getChildMBR(b->getId()).getCenter()[0];
             });
-
-        int split_index = children.size() / 2;
-
-        // 创建新节点 - 修复MBR计算
-        MBR new_mbr1 = children[0]->getMBR();
-        MBR new_mbr2 = children[split_index]->getMBR();
-
-        for (int i = 1; i < split_index; i++) {
-            new_mbr1.expand(children[i]->getMBR());
-        }
-        for (int i = split_index + 1; i < children.size(); i++) {
-            new_mbr2.expand(children[i]->getMBR());
-        }
-
-        int new_node_id1 = createNewNode(Node::INTERNAL, node->getLevel(), new_mbr1);
-        int new_node_id2 = createNewNode(Node::INTERNAL, node->getLevel(), new_mbr2);
-
-        auto new_node1 = loadNode(new_node_id1);
-        auto new_node2 = loadNode(new_node_id2);
-
-        if (new_node1 == nullptr || new_node2 == nullptr) {
-            std::cerr << " Failed to create new internal nodes for splitting" << std::endl;
-            return;
+        size_t split_index = children.size() / 2;
+
+        first = std::make_shared<Node>(node->getId(), Node::INTERNAL, node->getLevel(),
+            source.getChildMBR(children[0]->getId()));
+        second = std::make_shared<Node>(next_node_id++, Node::INTERNAL, node->getLevel(),
+            source.getChildMBR(children[split_index]->getId()));
+        for (size_t i = 0; i < children.size(); i++) {
+            auto& half = i < split_index ? first : second;
+            half->copyChildEntry(*node, children[i]);
         }
 
-        // 分配子节点
-        for (int i = 0; i < split_index; i++) {
-            new_node1->addChild(children[i]);
+        // 占位子节点没有摘要，无法按半重新聚合；沿用分裂前的摘要，作为两半的上界
+        for (auto* half : { &first, &second }) {
+            (*half)->setDocumentSummary(node->getDF(), node->getTFMax());
+            (*half)->setDocumentCount(node->getDocumentCount());
         }
-        for (int i = split_index; i < children.size(); i++) {
-            new_node2->addChild(children[i]);
-        }
-
-        // 保存新节点
-        saveNode(new_node_id1, new_node1);
-        saveNode(new_node_id2, new_node2);
-
-        // 如果是根节点，创建新的根节点
-        if (node_id == root_node_id) {
-            MBR root_mbr = new_mbr1;
-            root_mbr.expand(new_mbr2);
+    }
 
-            int new_root_id = createNewNode(Node::INTERNAL, node->getLevel() + 1, root_mbr);
-            auto new_root = loadNode(new_root_id);
+    node = first;
+    buffer.put(first);
+    buffer.put(second);
+    return second;
+}
 
-            if (new_root != nullptr) {
-                auto child1 = loadNode(new_node_id1);
-                auto child2 = loadNode(new_node_id2);
+int IRTree::assignNodePath(int node_id) {
+    auto path_oram_storage = std::dynamic_pointer_cast<RingOramStorage>(storage);
+    if (!path_oram_storage) {
+        return -1;
+    }
 
-                if (child1 != nullptr && child2 != nullptr) {
-                    new_root->addChild(child1);
-                    new_root->addChild(child2);
-                    saveNode(new_root_id, new_root);
-                    root_node_id = new_root_id;
+    // 节点的位置就是它的块号，父节点据此直接读取，不再经过路径与节点ID的映射
+    return path_oram_storage->allocateNodeBlock(node_id);
+}
 
-                    // 删除旧的根节点
-                    storage->deleteNode(node_id);
-                }
-                else {
-                    std::cerr << "Failed to load child nodes for new root" << std::endl;
-                }
-            }
-        }
+void IRTree::commitNodeBuffer(NodeWriteBuffer& buffer) {
+    if (ods_storage) {
+        // 子节点先写入（新节点在写入时得到叶子），父节点写入时即可带上子节点的新叶子
+        std::stable_sort(buffer.dirty.begin(), buffer.dirty.end(), [&buffer](int a, int b) {
+            return buffer.nodes[a]->getLevel() < buffer.nodes[b]->getLevel();
+        });
     }
-
+    for (int node_id : buffer.dirty) {
+        saveNode(node_id, buffer.nodes[node_id]);
+    }
+    buffer.dirty.clear();
+    buffer.dirty_set.clear();
 }
+
 // 初始化递归位置映射
 void IRTree::initializeRecursivePositionMap() {
-    // 从根节点开始递归分配路径
+    OdsSession session(*this);
+
+    // 节点重新写入后缓存的节点（含子节点位置）全部失效，下次查询时重新预热
+    upper_cache.clear();
+
+    // 从根节点开始递归登记位置
     int root_path = assignPathRecursively(root_node_id);
 
     if (root_path != -1) {
@@ -658,18 +752,11 @@ int IRTree::assignPathRecursively(int node_id) {
         return -1;
     }
 
-    // 为当前节点分配随机路径
-    int current_path = getRandomLeafPath();
-
-    // 为路径分配块索引
-    auto path_oram_storage = std::dynamic_pointer_cast<RingOramStorage>(storage);
-    if (path_oram_storage) {
-        int block_index = path_oram_storage->allocateBlockForPath(current_path);
-        path_oram_storage->mapPathToNode(current_path, node_id);
-    }
+    // 当前节点的位置即其块号（节点已写入时沿用原来的块）
+    int current_path = assignNodePath(node_id);
 
     if (node->getType() == Node::INTERNAL) {
-        // 递归为子节点分配路径
+        // 递归登记子节点的位置
         auto child_nodes = node->getChildNodes();
         for (const auto& child : child_nodes) {
             int child_id = child->getId();
@@ -688,14 +775,6 @@ int IRTree::assignPathRecursively(int node_id) {
     return current_path;
 }
 
-// 获取随机叶子路径
-int IRTree::getRandomLeafPath() const {
-    static random_device rd;
-    static mt19937 gen(rd());
-    uniform_int_distribution<int> dist(0, numLeaves - 1);
-    return dist(gen);
-}
-
 // 根节点路径管理（简化实现，后面需要集成到RingOramStorage）
 int IRTree::getRootPath() const {
     if (!storage) {
@@ -731,7 +810,7 @@ void IRTree::setRootPath(int path) {
     }
 }
 
-// 递归访问节点（使用路径而不是节点ID）
+// 按位置（块号）访问节点，不经过节点ID映射
 std::shared_ptr<Node> IRTree::accessNodeByPath(int path) {
     if (!storage) {
         std::cerr << "Storage not available for path access" << std::endl;
@@ -741,18 +820,21 @@ std::shared_ptr<Node> IRTree::accessNodeByPath(int path) {
     // 动态转换到RingOramStorage来使用路径访问
     auto path_oram_storage = std::dynamic_pointer_cast<RingOramStorage>(storage);
     if (path_oram_storage) {
-        auto node_data = path_oram_storage->accessByPath(path);
+        auto node_data = path_oram_storage->readNodeBlock(path, ods_storage ? odsLeafHint(path) : -1);
         if (node_data.empty()) {
-            std::cerr << "Failed to access node data for path " << path << std::endl;
+            std::cerr << "Failed to access node data for block " << path << std::endl;
             return nullptr;
         }
 
         // 反序列化节点数据
-        auto node = NodeSerializer::deserialize(node_data);
+        auto node = decodeNode(node_data);
         if (!node) {
-            std::cerr << "Failed to deserialize node from path " << path << std::endl;
+            std::cerr << "Failed to deserialize node from block " << path << std::endl;
             return nullptr;
         }
+        if (ods_storage) {
+            registerOdsNode(node);
+        }
 
         return node;
     }
@@ -762,143 +844,1256 @@ std::shared_ptr<Node> IRTree::accessNodeByPath(int path) {
     }
 }
 
-void IRTree::insertDocument(const std::string& text, const MBR& location)
-{
-    // 创建文档对象并分配ID
+std::vector<std::shared_ptr<Node>> IRTree::batchAccessNodesByPath(const std::vector<int>& paths, int pad_to) {
+    std::vector<std::shared_ptr<Node>> nodes(paths.size());
+
+    auto path_oram_storage = std::dynamic_pointer_cast<RingOramStorage>(storage);
+    if (!path_oram_storage) {
+        std::cerr << "Storage is not RingOramStorage, cannot use path-based access" << std::endl;
+        return nodes;
+    }
+
+    std::vector<int> leaves;
+    if (ods_storage) {
+        leaves.reserve(paths.size());
+        for (int path : paths) {
+            leaves.push_back(odsLeafHint(path));
+        }
+    }
+
+    auto node_data = path_oram_storage->batchReadNodeBlocks(paths, pad_to, ods_storage ? &leaves : nullptr);
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (node_data[i].empty()) {
+            std::cerr << "Failed to access node data for block " << paths[i] << std::endl;
+            continue;
+        }
+        nodes[i] = decodeNode(node_data[i]);
+        if (!nodes[i]) {
+            std::cerr << "Failed to deserialize node from block " << paths[i] << std::endl;
+        }
+        else if (ods_storage) {
+            registerOdsNode(nodes[i]);
+        }
+    }
+    return nodes;
+}
+
+void IRTree::warmNodeCache(SearchStats& stats) {
+    upper_cache.clear();
+    if (!upper_cache.enabled()) {
+        return;
+    }
+
+    int root_path = getRootPath();
+    auto root_node = accessNodeByPath(root_path);
+    stats.rounds++;
+    stats.blocks += OramL - cacheLevel;
+    if (!root_node) {
+        return;
+    }
+
+    // 逐层向下：整层放入缓存后再批量读取下一层，放不下的层不缓存
+    std::vector<std::shared_ptr<Node>> level_nodes{ root_node };
+    std::vector<int> child_paths;
+    while (upper_cache.addLevel(level_nodes) && upper_cache.canAddLevel()
+        && level_nodes[0]->getType() == Node::INTERNAL) {
+        child_paths.clear();
+        for (const auto& node : level_nodes) {
+            for (const auto& child : node->getChildNodes()) {
+                int child_path = node->getChildPosition(child->getId());
+                if (child_path != -1) {
+                    child_paths.push_back(child_path);
+                }
+            }
+        }
+        if (child_paths.empty()) {
+            break;
+        }
+
+        auto children = batchAccessNodesByPath(child_paths, 0);
+        stats.rounds++;
+        stats.blocks += static_cast<int>(child_paths.size()) * (OramL - cacheLevel);
+
+        // 有节点读取失败时该层不完整，不缓存
+        if (std::find(children.begin(), children.end(), nullptr) != children.end()) {
+            break;
+        }
+        level_nodes.swap(children);
+    }
+
+    upper_cache.markWarm();
+    std::cout << "Node cache warmed: " << upper_cache.cachedLevels() << " levels, "
+        << upper_cache.size() << " nodes, " << upper_cache.memoryBytes() / 1024 << " KB" << std::endl;
+}
+
+void IRTree::ensureNodeCacheWarm(SearchStats& stats) {
+    if (!upper_cache.enabled() || upper_cache.isWarm()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(cache_warm_mutex);
+    if (!upper_cache.isWarm()) {
+        warmNodeCache(stats);
+    }
+}
+
+std::shared_ptr<Node> IRTree::findCachedNode(int path, SearchStats& stats) {
+    if (!upper_cache.isWarm() || upper_cache.size() == 0) {
+        return nullptr;
+    }
+
+    auto path_oram_storage = std::dynamic_pointer_cast<RingOramStorage>(storage);
+    if (!path_oram_storage) {
+        return nullptr;
+    }
+
+    int node_id = path_oram_storage->getNodeIdByBlock(path);
+    if (node_id == -1) {
+        return nullptr;
+    }
+
+    auto node = upper_cache.find(node_id);
+    if (node) {
+        stats.cache_hits++;
+    }
+    return node;
+}
+
+void IRTree::setNodeCacheLimits(int levels, size_t bytes) {
+    upper_cache.configure(ods_storage ? 0 : levels, bytes);
+}
+
+// ====================================================
+// 不可知数据结构（ODS）会话
+// ====================================================
+
+IRTree::OdsSession::OdsSession(IRTree& tree) : tree_(tree) {
+    if (tree_.ods_storage) {
+        lock_ = std::unique_lock<std::recursive_mutex>(tree_.ods_mutex);
+        tree_.ods_depth++;
+    }
+}
+
+IRTree::OdsSession::~OdsSession() {
+    if (lock_.owns_lock() && --tree_.ods_depth == 0) {
+        tree_.finishOdsSession();
+    }
+}
+
+int IRTree::odsLeafHint(int block_id) const {
+    auto it = ods_leaf_hints.find(block_id);
+    if (it != ods_leaf_hints.end()) {
+        return it->second;
+    }
+    if (block_id == ods_storage->getNodeBlock(root_node_id)) {
+        return ods_storage->getRootLeaf();
+    }
+    return -1;
+}
+
+void IRTree::registerOdsNode(const std::shared_ptr<Node>& node) const {
+    ods_nodes[node->getId()] = node;
+    for (const auto& entry : node->getChildLeafMap()) {
+        int child_path = node->getChildPosition(entry.first);
+        if (child_path != -1) {
+            ods_leaf_hints[child_path] = entry.second;
+        }
+    }
+}
+
+bool IRTree::refreshChildLeaves(Node& node) const {
+    if (node.getType() != Node::INTERNAL) {
+        return false;
+    }
+    bool changed = false;
+    for (const auto& child : node.getChildNodes()) {
+        int leaf = ods_storage->getSessionLeaf(node.getChildPosition(child->getId()));
+        if (leaf != -1 && leaf != node.getChildLeaf(child->getId())) {
+            node.setChildLeaf(child->getId(), leaf);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+void IRTree::finishOdsSession() {
+    // 自底向上写回：父节点写入时子节点的叶子已经确定。会话中的节点都在 stash 中，写入不访问服务器
+    std::vector<std::shared_ptr<Node>> nodes;
+    nodes.reserve(ods_nodes.size());
+    for (const auto& entry : ods_nodes) {
+        nodes.push_back(entry.second);
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b) {
+        return a->getLevel() < b->getLevel();
+    });
+    for (const auto& node : nodes) {
+        if (refreshChildLeaves(*node)) {
+            saveNode(node->getId(), node);
+        }
+    }
+
+    // 根节点块的叶子保存在客户端；根节点本次未读取（例如根节点收缩后的新根）时取原父节点中的叶子
+    int root_block = ods_storage->getNodeBlock(root_node_id);
+    int root_leaf = ods_storage->getSessionLeaf(root_block);
+    if (root_leaf == -1) {
+        auto it = ods_leaf_hints.find(root_block);
+        if (it != ods_leaf_hints.end()) {
+            root_leaf = it->second;
+        }
+    }
+    if (root_leaf != -1) {
+        ods_storage->setRootLeaf(root_leaf);
+    }
+
+    ods_storage->endNodeSession();
+    ods_nodes.clear();
+    ods_leaf_hints.clear();
+}
+
+void IRTree::setSearchMode(SearchMode mode, int frontier_width) {
+    search_mode = mode;
+    search_frontier_width = frontier_width > 0 ? frontier_width : 1;
+}
+
+void IRTree::setObliviousMode(int level_budget) {
+    search_mode = OBLIVIOUS;
+    oblivious_level_budget = clampObliviousBudget(level_budget);
+}
+
+// 固定访问形态的逐层搜索
+//
+// 根以下每层恰好读取 oblivious_level_budget 个节点：候选子节点按上界截断到预算，
+// 不足的用 dummy 读取补齐，并且一直走到叶子层（候选为空时整层都是 dummy）。
+// 服务器看到的访问次数只取决于树高和预算，与查询的选择性无关，也不会提前终止。
+int IRTree::searchLevelsOblivious(std::shared_ptr<Node> root_node,
+    int root_path,
+    const std::vector<std::string>& keywords,
+    const MBR& spatial_scope,
+    double alpha,
+    std::vector<TreeHeapEntry>& results,
+    SearchStats& stats) {
+
+    int budget = oblivious_level_budget;
+    int nodes_visited = 1;
+
+    std::vector<TreeHeapEntry> frontier;
+    if (computeNodeRelevance(root_node, keywords, spatial_scope, alpha) > 0) {
+        frontier.push_back(TreeHeapEntry(root_node, root_path));
+    }
+
+    std::vector<int> child_paths;
+    std::vector<double> upper_bounds;
+    std::vector<size_t> order;
+
+    for (int level = root_node->getLevel(); level >= 0; level--) {
+        // 1. 本层的叶节点直接处理（文档内联在叶节点中，不需要额外访问）
+        child_paths.clear();
+        upper_bounds.clear();
+        for (const auto& entry : frontier) {
+            if (entry.node->getType() == Node::LEAF) {
+                processLeafNode(entry.node, keywords, spatial_scope, alpha, results);
+            }
+            else {
+                collectCandidateChildren(entry.node, keywords, spatial_scope, alpha, 0.0, child_paths, &upper_bounds);
+            }
+        }
+        if (level == 0) {
+            break;
+        }
+
+        // 2. 候选超过预算时保留上界最高的 budget 个
+        std::vector<int> fetch_paths;
+        if (static_cast<int>(child_paths.size()) > budget) {
+            order.resize(child_paths.size());
+            for (size_t i = 0; i < order.size(); i++) order[i] = i;
+            std::partial_sort(order.begin(), order.begin() + budget, order.end(),
+                [&upper_bounds](size_t a, size_t b) { return upper_bounds[a] > upper_bounds[b]; });
+            for (int i = 0; i < budget; i++) {
+                fetch_paths.push_back(child_paths[order[i]]);
+            }
+        }
+        else {
+            fetch_paths = child_paths;
+        }
+
+        // 3. 补齐到 budget 的一次批量读取；整层都在客户端缓存中时不访问 ORAM
+        //    （缓存按整层保存，是否跳过只取决于树高，与查询无关）
+        std::vector<std::shared_ptr<Node>> children;
+        if (upper_cache.coversLevel(level - 1)) {
+            for (int path : fetch_paths) {
+                children.push_back(findCachedNode(path, stats));
+            }
+        }
+        else {
+            children = batchAccessNodesByPath(fetch_paths, budget);
+            stats.rounds++;
+            stats.blocks += budget * (OramL - cacheLevel);
+        }
+        nodes_visited += static_cast<int>(fetch_paths.size());
+
+        frontier.clear();
+        for (size_t i = 0; i < fetch_paths.size(); i++) {
+            auto& child = children[i];
+            if (!child || !child->getMBR().overlaps(spatial_scope)) {
+                continue;
+            }
+            double relevance = computeNodeRelevance(child, keywords, spatial_scope, alpha);
+            if (relevance > 0) {
+                frontier.push_back(TreeHeapEntry(child, fetch_paths[i], relevance));
+            }
+        }
+    }
+
+    return nodes_visited;
+}
+
+void IRTree::insertDocument(const std::string& text, const MBR& location)
+{
+    // 创建文档对象并分配ID
     auto document = std::make_shared<Document>(next_doc_id++, location, text);
     insertDocument(document);
 }
 
 //修改 insertDocument 方法
 void IRTree::insertDocument(std::shared_ptr<Document> document) {
+    OdsSession session(*this);
+
     // 添加到全局索引 - 构建文本索引
     Vector doc_vector(document->getId());
     Vector::vectorize(doc_vector, document->getText(), vocab);
     global_index.addDocument(document->getId(), doc_vector);
 
-    // 选择插入的叶子节点
-    int leaf_id = chooseLeaf(document->getLocation());
-    if (leaf_id == -1) {
-        std::cerr << "Failed to choose leaf for document insertion" << std::endl;
-        return;
-    }
+    storeFullDocument(*document);
+
+    recordDocumentLocation(*document);
+
+    // 根到叶子的路径只读取一次（每层一次 ORAM 访问），之后的修改都在缓冲区中进行
+    NodeWriteBuffer buffer;
+    insertIntoTree(document, buffer);
+
+    // 每个被修改的节点写回一次
+    commitNodeBuffer(buffer);
+}
+
+bool IRTree::insertIntoTree(std::shared_ptr<Document> document, NodeWriteBuffer& buffer) {
+    auto path = choosePathToLevel(document->getLocation(), 0, buffer);
+    if (path.empty()) {
+        std::cerr << "Failed to choose leaf for document insertion" << std::endl;
+        return false;
+    }
+
+    // 插入文档到叶子节点，祖先节点的摘要增量合并
+    path.back()->addDocument(document);
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+        path[i]->addDocumentToSummary(*document);
+    }
+    for (const auto& node : path) {
+        buffer.put(node);
+    }
+
+    adjustInsertPath(path, buffer);
+    return true;
+}
+
+void IRTree::adjustInsertPath(std::vector<std::shared_ptr<Node>>& path, NodeWriteBuffer& buffer) {
+    // 自底向上：溢出的节点分裂，父节点中刷新子节点条目（MBR、关键词过滤器、文本上界）
+    for (int i = static_cast<int>(path.size()) - 1; i >= 0; i--) {
+        auto node = path[i];
+        std::shared_ptr<Node> sibling;
+        if ((node->getType() == Node::LEAF && node->getDocuments().size() > static_cast<size_t>(max_capacity)) ||
+            (node->getType() == Node::INTERNAL && node->getChildNodes().size() > static_cast<size_t>(max_capacity))) {
+            sibling = splitBufferedNode(node, buffer);
+        }
+
+        std::shared_ptr<Node> parent;
+        if (i > 0) {
+            parent = path[i - 1];
+        }
+        else if (sibling) {
+            // 根节点分裂：新建根节点，原根节点保留ID和路径成为第一个子节点
+            int old_root_path = getRootPath();
+            MBR root_mbr = node->getMBR();
+            root_mbr.expand(sibling->getMBR());
+            parent = std::make_shared<Node>(next_node_id++, Node::INTERNAL, node->getLevel() + 1, root_mbr);
+            parent->setChildPosition(node->getId(), old_root_path);
+            // 新根节点的摘要由两半合并（computeNodeUpperBound 按根节点自身的摘要计算上界）
+            parent->addSubtreeToSummary(*node);
+            parent->addSubtreeToSummary(*sibling);
+            root_node_id = parent->getId();
+            buffer.put(parent);
+
+            // 树高改变，缓存的层次失效
+            upper_cache.clear();
+            int root_path = assignNodePath(parent->getId());
+            if (root_path != -1) {
+                setRootPath(root_path);
+            }
+        }
+        else {
+            break;
+        }
+
+        parent->refreshChild(node);
+        parent->setChildTextUpperBound(node->getId(), computeChildTextUpperBound(*node));
+        if (sibling) {
+            parent->refreshChild(sibling);
+            parent->setChildTextUpperBound(sibling->getId(), computeChildTextUpperBound(*sibling));
+            int sibling_path = assignNodePath(sibling->getId());
+            if (sibling_path != -1) {
+                parent->setChildPosition(sibling->getId(), sibling_path);
+            }
+        }
+    }
+}
+
+// ====================================================
+// 删除与更新
+// ====================================================
+
+void IRTree::recordDocumentLocation(const Document& document) {
+    int doc_id = document.getId();
+    if (doc_id < 0) {
+        return;
+    }
+    size_t stride = static_cast<size_t>(dimensions) * 2;
+    size_t offset = static_cast<size_t>(doc_id) * stride;
+    if (document_locations.size() < offset + stride) {
+        document_locations.resize(offset + stride, std::numeric_limits<double>::quiet_NaN());
+    }
+
+    const MBR& location = document.getLocation();
+    for (int d = 0; d < dimensions; d++) {
+        document_locations[offset + d] = location.getMin()[d];
+        document_locations[offset + dimensions + d] = location.getMax()[d];
+    }
+}
+
+bool IRTree::getDocumentLocation(int doc_id, MBR& location) const {
+    size_t stride = static_cast<size_t>(dimensions) * 2;
+    size_t offset = static_cast<size_t>(doc_id) * stride;
+    if (doc_id < 0 || document_locations.size() < offset + stride || std::isnan(document_locations[offset])) {
+        return false;
+    }
+
+    auto begin = document_locations.begin() + offset;
+    location = MBR(std::vector<double>(begin, begin + dimensions),
+        std::vector<double>(begin + dimensions, begin + stride));
+    return true;
+}
+
+bool IRTree::findDocumentPath(int node_id, int doc_id, const MBR& location,
+    NodeWriteBuffer& buffer, std::vector<std::shared_ptr<Node>>& path) {
+    auto node = bufferedLoadNode(buffer, node_id);
+    if (!node) {
+        return false;
+    }
+    path.push_back(node);
+
+    if (node->getType() == Node::LEAF) {
+        for (const auto& doc : node->getDocuments()) {
+            if (doc->getId() == doc_id) {
+                return true;
+            }
+        }
+    }
+    else {
+        // 子节点MBR可能重叠，包含文档位置的分支逐个尝试
+        for (const auto& child : node->getChildNodes()) {
+            if (node->getChildMBR(child->getId()).contains(location) &&
+                findDocumentPath(child->getId(), doc_id, location, buffer, path)) {
+                return true;
+            }
+        }
+    }
+
+    path.pop_back();
+    return false;
+}
+
+void IRTree::releaseNode(int node_id, NodeWriteBuffer& buffer) {
+    buffer.drop(node_id);
+    ods_nodes.erase(node_id);
+    storage->deleteNode(node_id);
+    upper_cache.erase(node_id);
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        node_cache.erase(node_id);
+    }
+}
+
+void IRTree::releaseSubtree(int node_id, NodeWriteBuffer& buffer) {
+    auto node = bufferedLoadNode(buffer, node_id);
+    if (node && node->getType() == Node::INTERNAL) {
+        for (const auto& child : node->getChildNodes()) {
+            releaseSubtree(child->getId(), buffer);
+        }
+    }
+    releaseNode(node_id, buffer);
+}
+
+bool IRTree::insertSubtree(std::shared_ptr<Node> child, int child_path, NodeWriteBuffer& buffer) {
+    auto path = choosePathToLevel(child->getMBR(), child->getLevel() + 1, buffer);
+    if (path.empty()) {
+        std::cerr << "Failed to reinsert subtree " << child->getId() << std::endl;
+        return false;
+    }
+
+    // 子树挂到目标节点下，路径上的节点合并子树摘要；子树内部不变，只需更新父节点中的条目
+    auto target = path.back();
+    target->refreshChild(child);
+    target->setChildTextUpperBound(child->getId(), computeChildTextUpperBound(*child));
+    if (child_path != -1) {
+        target->setChildPosition(child->getId(), child_path);
+    }
+    for (const auto& node : path) {
+        node->addSubtreeToSummary(*child);
+        buffer.put(node);
+    }
+
+    adjustInsertPath(path, buffer);
+    return true;
+}
+
+bool IRTree::deleteDocument(int doc_id) {
+    OdsSession session(*this);
+    MBR location;
+    if (!getDocumentLocation(doc_id, location)) {
+        std::cerr << "Document " << doc_id << " not found for deletion" << std::endl;
+        return false;
+    }
+
+    // 与插入相同：路径上的节点只读取一次，修改在缓冲区中进行
+    NodeWriteBuffer buffer;
+    std::vector<std::shared_ptr<Node>> path;
+    if (!findDocumentPath(root_node_id, doc_id, location, buffer, path)) {
+        std::cerr << "Failed to find leaf containing document " << doc_id << std::endl;
+        return false;
+    }
+
+    auto removed = path.back()->removeDocument(doc_id);
+    size_t stride = static_cast<size_t>(dimensions) * 2;
+    std::fill_n(document_locations.begin() + static_cast<size_t>(doc_id) * stride, stride,
+        std::numeric_limits<double>::quiet_NaN());
+
+    std::vector<int> term_ids;
+    for (const auto& entry : removed->getTermFreq()) {
+        int term_id = vocab.getTermId(entry.first);
+        if (term_id >= 0) {
+            term_ids.push_back(term_id);
+        }
+    }
+    global_index.removeDocument(doc_id, term_ids);
+    if (separateDocuments) {
+        storage->deleteDocument(doc_id);
+    }
+
+    // 叶子已重新聚合摘要，祖先节点逐项减去该文档
+    for (size_t i = 0; i + 1 < path.size(); i++) {
+        path[i]->removeDocumentFromSummary(*removed);
+    }
+    for (const auto& node : path) {
+        buffer.put(node);
+    }
+
+    // condense-tree：自底向上删除不足 min_capacity 的非根节点，其中的条目稍后重新插入
+    std::vector<std::shared_ptr<Document>> orphan_documents;
+    std::vector<std::pair<std::shared_ptr<Node>, int>> orphan_subtrees;
+    for (int i = static_cast<int>(path.size()) - 1; i > 0; i--) {
+        auto node = path[i];
+        auto parent = path[i - 1];
+        size_t entries = node->getType() == Node::LEAF ? node->getDocuments().size() : node->getChildNodes().size();
+        // 根节点的唯一子节点不删除，由下面的根节点收缩处理
+        bool underfull = entries < static_cast<size_t>(min_capacity) && parent->getChildNodes().size() > 1;
+
+        if (underfull) {
+            parent->removeChild(node->getId());
+
+            if (node->getType() == Node::LEAF) {
+                for (const auto& doc : node->getDocuments()) {
+                    orphan_documents.push_back(doc);
+                    for (int j = 0; j < i; j++) {
+                        path[j]->removeDocumentFromSummary(*doc);
+                    }
+                }
+            }
+            else {
+                // 子树的 DF 可能是分裂时沿用的上界，不从祖先中减去（祖先的 DF 仍是上界），只修正文档数
+                for (const auto& child : node->getChildNodes()) {
+                    auto subtree = bufferedLoadNode(buffer, child->getId());
+                    if (!subtree) {
+                        std::cerr << "Failed to load subtree " << child->getId() << " for reinsertion" << std::endl;
+                        continue;
+                    }
+                    orphan_subtrees.emplace_back(subtree, node->getChildPosition(child->getId()));
+                    for (int j = 0; j < i; j++) {
+                        path[j]->setDocumentCount(std::max(0, path[j]->getDocumentCount() - subtree->getDocumentCount()));
+                    }
+                }
+            }
+            releaseNode(node->getId(), buffer);
+        }
+        else {
+            parent->refreshChild(node);
+            parent->setChildTextUpperBound(node->getId(), computeChildTextUpperBound(*node));
+        }
+        parent->tightenMBR();
+    }
+
+    // 先挂回子树（层级较高），再重新插入文档
+    for (const auto& entry : orphan_subtrees) {
+        insertSubtree(entry.first, entry.second, buffer);
+    }
+    for (const auto& doc : orphan_documents) {
+        insertIntoTree(doc, buffer);
+    }
+
+    // 根节点只剩一个子节点时由该子节点成为根，树高降低
+    auto root = bufferedLoadNode(buffer, root_node_id);
+    while (root && root->getType() == Node::INTERNAL && root->getChildNodes().size() == 1) {
+        int child_id = root->getChildNodes()[0]->getId();
+        int child_path = root->getChildPosition(child_id);
+        releaseNode(root->getId(), buffer);
+
+        root_node_id = child_id;
+        if (child_path != -1) {
+            setRootPath(child_path);
+        }
+        upper_cache.clear();
+        root = bufferedLoadNode(buffer, root_node_id);
+    }
+
+    commitNodeBuffer(buffer);
+    return true;
+}
+
+bool IRTree::updateDocument(int doc_id, const std::string& text, const MBR& location) {
+    OdsSession session(*this);
+    if (!deleteDocument(doc_id)) {
+        return false;
+    }
+    insertDocument(std::make_shared<Document>(doc_id, location, text));
+    return true;
+}
+
+
+
+std::vector<TreeHeapEntry> IRTree::search(const Query& query, SearchStats* stats)
+{
+    // 委托给参数化搜索方法
+    return search(query.getKeywords(), query.getSpatialScope(), query.getK(), query.getAlpha(), stats);
+}
+
+// 使用递归位置映射的搜索实现
+std::vector<TreeHeapEntry> IRTree::search(const std::vector<std::string>& keywords,
+    const MBR& spatial_scope,
+    int k,
+    double alpha,
+    SearchStats* stats_out) {
+
+    SearchStats local_stats;
+    SearchStats& stats = stats_out ? *stats_out : local_stats;
+    stats = SearchStats();
+    std::vector<TreeHeapEntry> results;
+    OdsSession session(*this);
+
+    if (!storage || keywords.empty() || k <= 0) {
+        return results;
+    }
+
+    // 第一次查询（或缓存失效后）预热上层节点缓存，读取计入本次查询
+    ensureNodeCacheWarm(stats);
+    stats.cached_levels = upper_cache.cachedLevels();
+
+
+    // 获取根节点路径
+    int root_path = getRootPath();
+    if (root_path == -1) {
+        std::cerr << "Failed to get root path for search" << std::endl;
+        return results;
+    }
+
+    // 加载根节点（优先使用缓存，否则使用路径访问）
+    auto root_node = findCachedNode(root_path, stats);
+    if (!root_node) {
+        root_node = accessNodeByPath(root_path);
+        stats.rounds++;
+        stats.blocks += OramL - cacheLevel;
+    }
+    if (!root_node) {
+        std::cerr << "Failed to load root node using path " << root_path << std::endl;
+        return results;
+    }
+
+    // 使用优先队列进行最佳优先搜索（现在包含路径信息）
+    std::priority_queue<TreeHeapEntry, std::vector<TreeHeapEntry>, TreeHeapComparator> queue;
+
+    if (search_mode == OBLIVIOUS) {
+        // 固定访问形态：逐层读取，不使用优先队列
+        stats.nodes_visited = searchLevelsOblivious(root_node, root_path, keywords, spatial_scope, alpha, results, stats);
+        stats.documents_checked = static_cast<int>(results.size());
+    }
+    else {
+        // 根节点按得分上界加入队列（包含路径信息）
+        double root_bound = computeNodeUpperBound(root_node, keywords, spatial_scope, alpha);
+        if (root_bound > 0) {
+            queue.push(TreeHeapEntry(root_node, root_path, root_bound));
+        }
+    }
+
+    // BATCHED 模式每轮取出 frontier 上得分最高的若干节点，
+    // 它们的候选子节点合并为一次批量读取（补齐到固定数量），再统一打分入队
+    bool batched = search_mode == BATCHED;
+    int frontier_width = batched ? search_frontier_width : 1;
+    int batch_size = frontier_width * max_capacity;
+    std::vector<int> child_paths;
+    std::vector<int> fetch_paths;
+
+    // Top-k 分支限界：小顶堆保存当前最好的k个文档得分，堆满后堆顶即第k名得分。
+    // 队列按子树得分上界排序，队首上界不超过第k名时其余节点都不可能再改进结果，提前终止
+    std::priority_queue<double, std::vector<double>, std::greater<double>> top_scores;
+    double kth_score = 0.0;
+
+    // 最佳优先搜索主循环
+    while (!queue.empty()) {
+        if (static_cast<int>(top_scores.size()) >= k && queue.top().score <= kth_score) {
+            stats.nodes_pruned += static_cast<int>(queue.size());
+            break;
+        }
+        child_paths.clear();
+
+        for (int i = 0; i < frontier_width && !queue.empty(); i++) {
+            TreeHeapEntry current = queue.top();
+            if (static_cast<int>(top_scores.size()) >= k && current.score <= kth_score) {
+                break;
+            }
+            queue.pop();
+            stats.nodes_visited++;
+
+            if (current.isData()) {
+                // 找到文档，加入结果
+                results.push_back(current);
+            }
+            else if (current.isNode()) {
+                auto node = current.node;
+
+                if (node->getType() == Node::LEAF) {
+                    // 处理叶子节点 - 检查实际文档
+                    int prev_results = results.size();
+                    processLeafNode(node, keywords, spatial_scope, alpha, results);
+                    stats.documents_checked += (results.size() - prev_results);
+
+                    updateKthScore(results, prev_results, k, top_scores, kth_score);
+                }
+                else if (batched) {
+                    // 只收集候选子节点，本轮结束时一起读取
+                    collectCandidateChildren(node, keywords, spatial_scope, alpha, kth_score, child_paths);
+                }
+                else {
+                    // 处理内部节点 - 使用递归位置映射获取子节点
+                    processInternalNodeWithPath(node, current.path, keywords, spatial_scope, alpha, kth_score, queue, stats);
+                }
+            }
+        }
+
+        // 缓存中的子节点直接打分，其余按 batch_size 分组批量读取
+        fetch_paths.clear();
+        for (int child_path : child_paths) {
+            auto cached = findCachedNode(child_path, stats);
+            if (cached) {
+                scoreLoadedChild(cached, child_path, keywords, spatial_scope, alpha, queue);
+            }
+            else {
+                fetch_paths.push_back(child_path);
+            }
+        }
+
+        for (size_t start = 0; start < fetch_paths.size(); start += batch_size) {
+            size_t end = std::min(fetch_paths.size(), start + batch_size);
+            std::vector<int> group(fetch_paths.begin() + start, fetch_paths.begin() + end);
+
+            auto children = batchAccessNodesByPath(group, batch_size);
+            stats.rounds++;
+            stats.blocks += batch_size * (OramL - cacheLevel);
+
+            for (size_t j = 0; j < group.size(); j++) {
+                if (children[j]) {
+                    scoreLoadedChild(children[j], group[j], keywords, spatial_scope, alpha, queue);
+                }
+            }
+        }
+    }
+
+    // 排序结果
+    std::sort(results.begin(), results.end(),
+        [](const TreeHeapEntry& a, const TreeHeapEntry& b) {
+            return a.score > b.score;
+        });
+
+    // 只返回前k个结果
+    if (results.size() > k) {
+        results.resize(k);
+    }
+
+    // 只为最终的k个结果读取完整文档
+    fetchResultDocuments({ &results }, k, stats);
+
+    // 整段一次输出，多个线程同时查询时各自的统计不会交错
+    std::ostringstream summary;
+    summary << "=== SEARCH COMPLETED ===" << std::endl;
+    summary << "  Nodes visited: " << stats.nodes_visited << std::endl;
+    summary << "  Blocks accessed: " << stats.blocks << endl;
+    summary << "  ORAM rounds: " << stats.rounds << std::endl;
+    summary << "  Nodes pruned: " << stats.nodes_pruned << std::endl;
+    summary << "  Cached levels: " << stats.cached_levels
+        << " (" << stats.cache_hits << " nodes from cache)" << std::endl;
+    summary << "  Documents checked: " << stats.documents_checked << std::endl;
+    summary << "  Documents fetched: " << stats.documents_fetched << std::endl;
+    summary << "  Final results: " << results.size() << std::endl;
+    std::cout << summary.str();
+
+    return results;
+}
+
+// kNN 查询
+//
+// 没有查询范围，文档的空间得分随到查询点的距离线性衰减（computeDistanceRelevance），
+// 归一化距离取查询点到根节点 MBR 最远角点的距离，所有文档的空间得分都在 [0, 1] 内。
+// 叶节点中匹配的文档按实际得分入队，与子树上界一起排序：队首是文档时，
+// 未展开的子树中不可能有得分更高的文档，该文档就是下一个结果，得到 k 个结果即结束。
+std::vector<TreeHeapEntry> IRTree::searchNearest(const std::vector<std::string>& keywords,
+    const std::vector<double>& location,
+    int k,
+    double alpha,
+    SearchStats* stats_out) {
+
+    SearchStats local_stats;
+    SearchStats& stats = stats_out ? *stats_out : local_stats;
+    stats = SearchStats();
+    std::vector<TreeHeapEntry> results;
+    OdsSession session(*this);
+
+    if (!storage || keywords.empty() || k <= 0) {
+        return results;
+    }
+    if (static_cast<int>(location.size()) != dimensions) {
+        std::cerr << "Query point dimension " << location.size()
+            << " does not match tree dimension " << dimensions << std::endl;
+        return results;
+    }
+
+    ensureNodeCacheWarm(stats);
+    stats.cached_levels = upper_cache.cachedLevels();
+
+    int root_path = getRootPath();
+    if (root_path == -1) {
+        std::cerr << "Failed to get root path for search" << std::endl;
+        return results;
+    }
+
+    auto root_node = findCachedNode(root_path, stats);
+    if (!root_node) {
+        root_node = accessNodeByPath(root_path);
+        stats.rounds++;
+        stats.blocks += OramL - cacheLevel;
+    }
+    if (!root_node) {
+        std::cerr << "Failed to load root node using path " << root_path << std::endl;
+        return results;
+    }
+
+    // 查询点到根节点 MBR 最远角点的距离
+    const MBR& root_mbr = root_node->getMBR();
+    double max_distance = 0.0;
+    if (root_mbr.getMin().size() == location.size()) {
+        for (size_t i = 0; i < location.size(); i++) {
+            double far = std::max(std::abs(location[i] - root_mbr.getMin()[i]),
+                std::abs(location[i] - root_mbr.getMax()[i]));
+            max_distance += far * far;
+        }
+        max_distance = std::sqrt(max_distance);
+    }
+
+    std::priority_queue<TreeHeapEntry, std::vector<TreeHeapEntry>, TreeHeapComparator> queue;
+    double root_bound = computeNodeNearestBound(root_node, keywords, location, max_distance, alpha);
+    if (root_bound > 0) {
+        queue.push(TreeHeapEntry(root_node, root_path, root_bound));
+    }
+
+    std::vector<uint64_t> keyword_hashes = KeywordFilter::hashTerms(keywords);
+    double max_idf = computeMaxQueryIdf(keywords);
+
+    // 与 BATCHED 模式相同：每轮展开至多 frontier_width 个节点，子节点合并批量读取
+    int frontier_width = search_frontier_width;
+    int batch_size = frontier_width * max_capacity;
+    std::vector<int> child_paths;
+    std::vector<int> fetch_paths;
+
+    // 已入队文档中最好的k个得分，堆满后上界不超过第k名的子树不再展开
+    std::priority_queue<double, std::vector<double>, std::greater<double>> top_scores;
+    double kth_score = 0.0;
+
+    auto scoreChild = [&](std::shared_ptr<Node> child_node, int child_path) {
+        double upper_bound = computeNodeNearestBound(child_node, keywords, location, max_distance, alpha);
+        if (upper_bound > 0) {
+            queue.push(TreeHeapEntry(child_node, child_path, upper_bound));
+        }
+    };
+
+    while (!queue.empty() && static_cast<int>(results.size()) < k) {
+        child_paths.clear();
+        bool expanded = false;
 
-    auto leaf_node = loadNode(leaf_id);
-    if (!leaf_node) {
-        std::cerr << "Failed to load leaf node " << leaf_id << std::endl;
-        return;
-    }
+        for (int i = 0; i < frontier_width && !queue.empty() && static_cast<int>(results.size()) < k; i++) {
+            if (queue.top().isData()) {
+                // 本轮已展开的节点的子节点尚未入队，其中可能有得分更高的文档，下一轮再输出
+                if (expanded) {
+                    break;
+                }
+                results.push_back(queue.top());
+                queue.pop();
+                continue;
+            }
 
-    // 插入文档到叶子节点
-    leaf_node->addDocument(document);
-    saveNode(leaf_id, leaf_node);
+            TreeHeapEntry current = queue.top();
+            queue.pop();
+            if (static_cast<int>(top_scores.size()) >= k && current.score <= kth_score) {
+                stats.nodes_pruned++;
+                continue;
+            }
+            stats.nodes_visited++;
+            expanded = true;
 
-    // 调整树结构（更新MBR，可能分裂）
-    adjustTree(leaf_id);
+            auto node = current.node;
+            if (node->getType() == Node::LEAF) {
+                for (const auto& doc : node->getDocuments()) {
+                    bool has_all_keywords = true;
+                    for (const auto& keyword : keywords) {
+                        if (doc->getTermFrequency(keyword) == 0) {
+                            has_all_keywords = false;
+                            break;
+                        }
+                    }
+                    if (!has_all_keywords) {
+                        continue;
+                    }
+                    stats.documents_checked++;
+
+                    double text_relevance = computeTextRelevance(*doc, keywords);
+                    double distance = doc->getLocation().minDistance(location);
+                    double score = computeJointRelevance(text_relevance,
+                        computeDistanceRelevance(distance, max_distance), alpha);
+                    queue.push(TreeHeapEntry(doc, score));
+
+                    top_scores.push(score);
+                    if (static_cast<int>(top_scores.size()) > k) {
+                        top_scores.pop();
+                    }
+                    if (static_cast<int>(top_scores.size()) >= k) {
+                        kth_score = top_scores.top();
+                    }
+                }
+            }
+            else {
+                collectNearestChildren(node, keyword_hashes, max_idf, location, max_distance, alpha, kth_score, child_paths);
+            }
+        }
 
-    // 检查根节点是否需要分裂
-    auto root_node = loadNode(root_node_id);
-    if (!root_node) return;
+        // 缓存中的子节点直接打分，其余按 batch_size 分组批量读取
+        fetch_paths.clear();
+        for (int child_path : child_paths) {
+            auto cached = findCachedNode(child_path, stats);
+            if (cached) {
+                scoreChild(cached, child_path);
+            }
+            else {
+                fetch_paths.push_back(child_path);
+            }
+        }
 
-    if ((root_node->getType() == Node::LEAF && root_node->getDocuments().size() > max_capacity) ||
-        (root_node->getType() == Node::INTERNAL && root_node->getChildNodes().size() > max_capacity)) {
-        splitNode(root_node_id);
-    }
-}
+        for (size_t start = 0; start < fetch_paths.size(); start += batch_size) {
+            size_t end = std::min(fetch_paths.size(), start + batch_size);
+            std::vector<int> group(fetch_paths.begin() + start, fetch_paths.begin() + end);
 
+            auto children = batchAccessNodesByPath(group, batch_size);
+            stats.rounds++;
+            stats.blocks += batch_size * (OramL - cacheLevel);
 
+            for (size_t j = 0; j < group.size(); j++) {
+                if (children[j]) {
+                    scoreChild(children[j], group[j]);
+                }
+            }
+        }
+    }
 
-std::vector<TreeHeapEntry> IRTree::search(const Query& query)
-{
-    // 委托给参数化搜索方法
-    return search(query.getKeywords(), query.getSpatialScope(), query.getK(), query.getAlpha());
-}
+    fetchResultDocuments({ &results }, k, stats);
 
-// 使用递归位置映射的搜索实现
-std::vector<TreeHeapEntry> IRTree::search(const std::vector<std::string>& keywords,
-    const MBR& spatial_scope,
-    int k,
-    double alpha) {
+    std::ostringstream summary;
+    summary << "=== NEAREST SEARCH COMPLETED ===" << std::endl;
+    summary << "  Nodes visited: " << stats.nodes_visited << std::endl;
+    summary << "  Blocks accessed: " << stats.blocks << std::endl;
+    summary << "  ORAM rounds: " << stats.rounds << std::endl;
+    summary << "  Nodes pruned: " << stats.nodes_pruned << std::endl;
+    summary << "  Cached levels: " << stats.cached_levels
+        << " (" << stats.cache_hits << " nodes from cache)" << std::endl;
+    summary << "  Documents checked: " << stats.documents_checked << std::endl;
+    summary << "  Documents fetched: " << stats.documents_fetched << std::endl;
+    summary << "  Final results: " << results.size() << std::endl;
+    std::cout << summary.str();
 
-    search_blocks = 0;
-    std::vector<TreeHeapEntry> results;
+    return results;
+}
 
-    if (!storage || keywords.empty() || k <= 0) {
-        return results;
+// 多查询批量执行
+//
+// 每轮每个未结束的查询按 Top-k 分支限界出队至多 frontier_width 个节点，
+// 收集候选子节点路径；所有查询的路径去重后按 batch_size 分组批量读取，
+// 同一节点只读取、反序列化一次，再交给请求它的各个查询打分入队。
+std::vector<std::vector<TreeHeapEntry>> IRTree::searchBatch(const std::vector<Query>& queries,
+    SearchStats* stats_out) {
+
+    SearchStats local_stats;
+    SearchStats& stats = stats_out ? *stats_out : local_stats;
+    stats = SearchStats();
+    OdsSession session(*this);
+
+    std::vector<std::vector<TreeHeapEntry>> all_results(queries.size());
+    if (queries.empty() || !storage) {
+        return all_results;
+    }
+
+    if (search_mode == OBLIVIOUS) {
+        // 固定访问形态：每个查询的访问次数由预算决定，逐个执行
+        SearchStats query_stats;
+        for (size_t q = 0; q < queries.size(); q++) {
+            all_results[q] = search(queries[q], &query_stats);
+            stats.blocks += query_stats.blocks;
+            stats.rounds += query_stats.rounds;
+            stats.nodes_visited += query_stats.nodes_visited;
+            stats.documents_checked += query_stats.documents_checked;
+            stats.cache_hits += query_stats.cache_hits;
+            stats.documents_fetched += query_stats.documents_fetched;
+            stats.cached_levels = query_stats.cached_levels;
+        }
+        return all_results;
     }
 
+    ensureNodeCacheWarm(stats);
+    stats.cached_levels = upper_cache.cachedLevels();
 
-    // 获取根节点路径
     int root_path = getRootPath();
     if (root_path == -1) {
-        std::cerr << "Failed to get root path for search" << std::endl;
-        return results;
+        std::cerr << "Failed to get root path for batch search" << std::endl;
+        return all_results;
     }
 
-    // 加载根节点（使用路径访问）
-    auto root_node = accessNodeByPath(root_path);
+    // 所有查询共享同一次根节点读取
+    auto root_node = findCachedNode(root_path, stats);
+    if (!root_node) {
+        root_node = accessNodeByPath(root_path);
+        stats.rounds++;
+        stats.blocks += OramL - cacheLevel;
+    }
     if (!root_node) {
         std::cerr << "Failed to load root node using path " << root_path << std::endl;
-        return results;
+        return all_results;
     }
 
-    // 使用优先队列进行最佳优先搜索（现在包含路径信息）
-    std::priority_queue<TreeHeapEntry, std::vector<TreeHeapEntry>, TreeHeapComparator> queue;
+    // 每个查询的搜索状态
+    struct QueryState {
+        std::priority_queue<TreeHeapEntry, std::vector<TreeHeapEntry>, TreeHeapComparator> queue;
+        std::priority_queue<double, std::vector<double>, std::greater<double>> top_scores;
+        double kth_score = 0.0;
+        std::vector<int> child_paths;   ///< 本轮请求的子节点路径
+    };
+    std::vector<QueryState> states(queries.size());
 
-    // 计算根节点的相关性并加入队列（包含路径信息）
-    double root_relevance = computeNodeRelevance(root_node, keywords, spatial_scope, alpha);
-    if (root_relevance > 0) {
-        queue.push(TreeHeapEntry(root_node, root_path, root_relevance));
+    for (size_t q = 0; q < queries.size(); q++) {
+        const Query& query = queries[q];
+        if (query.getKeywords().empty() || query.getK() <= 0) {
+            continue;
+        }
+        double root_bound = computeNodeUpperBound(root_node, query.getKeywords(), query.getSpatialScope(), query.getAlpha());
+        if (root_bound > 0) {
+            states[q].queue.push(TreeHeapEntry(root_node, root_path, root_bound));
+        }
     }
 
-    int nodes_visited = 0;
-    int documents_checked = 0;
+    int frontier_width = search_mode == BATCHED ? search_frontier_width : 1;
+    int batch_size = frontier_width * max_capacity;
+    int node_requests = 0;
+    int unique_fetches = 0;
+
+    std::unordered_map<int, std::shared_ptr<Node>> round_nodes;  // 本轮读取的节点：path -> node
+    std::vector<int> fetch_paths;
+
+    while (true) {
+        bool active = false;
+
+        // 1. 各查询独立出队，叶节点直接处理，内部节点只收集候选子节点
+        for (size_t q = 0; q < queries.size(); q++) {
+            const Query& query = queries[q];
+            QueryState& state = states[q];
+            std::vector<TreeHeapEntry>& results = all_results[q];
+            int k = query.getK();
+            state.child_paths.clear();
+
+            for (int i = 0; i < frontier_width && !state.queue.empty(); i++) {
+                TreeHeapEntry current = state.queue.top();
+                if (static_cast<int>(state.top_scores.size()) >= k && current.score <= state.kth_score) {
+                    // 队首上界不超过第k名得分，该查询已结束
+                    stats.nodes_pruned += static_cast<int>(state.queue.size());
+                    state.queue = decltype(state.queue)();
+                    break;
+                }
+                state.queue.pop();
+                stats.nodes_visited++;
 
-    // 最佳优先搜索主循环
-    while (!queue.empty() && results.size() < k) {
-        TreeHeapEntry current = queue.top();
-        queue.pop();
-        nodes_visited++;
+                if (current.isData()) {
+                    results.push_back(current);
+                }
+                else if (current.node->getType() == Node::LEAF) {
+                    size_t prev_results = results.size();
+                    processLeafNode(current.node, query.getKeywords(), query.getSpatialScope(), query.getAlpha(), results);
+                    stats.documents_checked += static_cast<int>(results.size() - prev_results);
+                    updateKthScore(results, prev_results, k, state.top_scores, state.kth_score);
+                }
+                else {
+                    collectCandidateChildren(current.node, query.getKeywords(), query.getSpatialScope(),
+                        query.getAlpha(), state.kth_score, state.child_paths);
+                }
+            }
 
-        if (current.isData()) {
-            // 找到文档，加入结果
-            results.push_back(current);
+            if (!state.queue.empty() || !state.child_paths.empty()) {
+                active = true;
+            }
+        }
+        if (!active) {
+            break;
         }
-        else if (current.isNode()) {
-            auto node = current.node;
 
-            if (node->getType() == Node::LEAF) {
-                // 处理叶子节点 - 检查实际文档
-                int prev_results = results.size();
-                processLeafNode(node, keywords, spatial_scope, alpha, results);
-                documents_checked += (results.size() - prev_results);
+        // 2. 所有查询请求的路径去重，缓存中没有的才需要读取
+        round_nodes.clear();
+        fetch_paths.clear();
+        for (const auto& state : states) {
+            node_requests += static_cast<int>(state.child_paths.size());
+            for (int child_path : state.child_paths) {
+                if (round_nodes.count(child_path)) {
+                    continue;
+                }
+                auto cached = findCachedNode(child_path, stats);
+                round_nodes[child_path] = cached;
+                if (!cached) {
+                    fetch_paths.push_back(child_path);
+                }
             }
-            else {
-                // 处理内部节点 - 使用递归位置映射获取子节点
-                processInternalNodeWithPath(node, current.path, keywords, spatial_scope, alpha, queue);
+        }
+
+        // 3. 按 batch_size 分组批量读取，每组补齐到固定数量
+        for (size_t start = 0; start < fetch_paths.size(); start += batch_size) {
+            size_t end = std::min(fetch_paths.size(), start + batch_size);
+            std::vector<int> group(fetch_paths.begin() + start, fetch_paths.begin() + end);
+
+            auto children = batchAccessNodesByPath(group, batch_size);
+            stats.rounds++;
+            stats.blocks += batch_size * (OramL - cacheLevel);
+            unique_fetches += static_cast<int>(group.size());
+
+            for (size_t j = 0; j < group.size(); j++) {
+                round_nodes[group[j]] = children[j];
+            }
+        }
+
+        // 4. 读取结果分发给请求它的查询
+        for (size_t q = 0; q < queries.size(); q++) {
+            const Query& query = queries[q];
+            QueryState& state = states[q];
+            for (int child_path : state.child_paths) {
+                const auto& child = round_nodes[child_path];
+                if (child) {
+                    scoreLoadedChild(child, child_path, query.getKeywords(), query.getSpatialScope(),
+                        query.getAlpha(), state.queue);
+                }
             }
         }
     }
 
-    search_blocks = nodes_visited * (OramL -cacheLevel);
-    // 排序结果
-    std::sort(results.begin(), results.end(),
-        [](const TreeHeapEntry& a, const TreeHeapEntry& b) {
-            return a.score > b.score;
-        });
+    // 所有查询的最终结果一起读取完整文档，补齐到各查询 k 之和
+    std::vector<std::vector<TreeHeapEntry>*> final_results;
+    int total_k = 0;
+    for (size_t q = 0; q < queries.size(); q++) {
+        auto& results = all_results[q];
+        std::sort(results.begin(), results.end(),
+            [](const TreeHeapEntry& a, const TreeHeapEntry& b) {
+                return a.score > b.score;
+            });
+        if (static_cast<int>(results.size()) > queries[q].getK()) {
+            results.resize(queries[q].getK());
+        }
+        final_results.push_back(&results);
+        total_k += queries[q].getK();
+    }
+    fetchResultDocuments(final_results, total_k, stats);
+
+    std::ostringstream summary;
+    summary << "=== BATCH SEARCH COMPLETED ===" << std::endl;
+    summary << "  Queries: " << queries.size() << std::endl;
+    summary << "  Node requests: " << node_requests << std::endl;
+    summary << "  Unique nodes fetched: " << unique_fetches << std::endl;
+    summary << "  Blocks accessed: " << stats.blocks << std::endl;
+    summary << "  ORAM rounds: " << stats.rounds << std::endl;
+    summary << "  Cached levels: " << stats.cached_levels
+        << " (" << stats.cache_hits << " nodes from cache)" << std::endl;
+    summary << "  Documents fetched: " << stats.documents_fetched << std::endl;
+    std::cout << summary.str();
+
+    return all_results;
+}
 
-    // 只返回前k个结果
-    if (results.size() > k) {
-        results.resize(k);
-    }
+// 多线程并发查询
+//
+// 工作线程通过原子计数器依次领取查询，各自维护查询状态和统计；
+// 共享的只有只读的树结构、上层节点缓存（内部加锁）和 ORAM（存储层串行执行）。
+std::vector<std::vector<TreeHeapEntry>> IRTree::searchParallel(const std::vector<Query>& queries,
+    int num_threads,
+    std::vector<SearchStats>* stats) {
+
+    std::vector<std::vector<TreeHeapEntry>> all_results(queries.size());
+    std::vector<SearchStats> all_stats(queries.size());
+
+    // 先预热缓存，避免所有线程同时等待第一个线程完成预热
+    SearchStats warm_stats;
+    ensureNodeCacheWarm(warm_stats);
+
+    std::atomic<size_t> next_query(0);
+    auto worker = [&]() {
+        while (true) {
+            size_t q = next_query.fetch_add(1);
+            if (q >= queries.size()) {
+                break;
+            }
+            all_results[q] = search(queries[q], &all_stats[q]);
+        }
+    };
 
-    std::cout << "=== SEARCH COMPLETED ===" << std::endl;
-    std::cout << "  Nodes visited: " << nodes_visited << std::endl;
-    std::cout << "  Blocks accessed: " << search_blocks << endl;
-    std::cout << "  Documents checked: " << documents_checked << std::endl;
-    std::cout << "  Final results: " << results.size() << std::endl;
+    int thread_count = std::max(1, std::min(num_threads, static_cast<int>(queries.size())));
+    std::vector<std::thread> workers;
+    for (int i = 1; i < thread_count; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();  // 当前线程也参与执行
+    for (auto& t : workers) {
+        t.join();
+    }
 
-    return results;
+    // 预热的读取计入第一个查询
+    if (!all_stats.empty()) {
+        all_stats[0].blocks += warm_stats.blocks;
+        all_stats[0].rounds += warm_stats.rounds;
+    }
+    if (stats) {
+        *stats = std::move(all_stats);
+    }
+    return all_results;
 }
 
 void IRTree::bulkInsertFromFile(const std::string& filename) {
@@ -963,61 +2158,48 @@ void IRTree::bulkInsertDocuments(const std::vector<std::tuple<std::string, doubl
     // 注意：这里没有输出耗时信息
 }
 
-// 优化的批量插入方法
+// 优化的批量插入方法：文件映射到内存后按行边界并行解析（见 DataLoader.h），
+// 文档对象直接由映射区中的文本创建，不经过中间的字符串元组
 void IRTree::optimizedBulkInsertFromFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Cannot open file " << filename << std::endl;
+    auto load_start = std::chrono::high_resolution_clock::now();
+
+    MappedFile file;
+    if (!file.open(filename)) {
         return;
     }
 
-    std::vector<std::tuple<std::string, double, double>> documents;
-    std::string line;
-    int loaded_count = 0;
-    const int REPORT_INTERVAL = 1000;  // 进度报告间隔
-
-    auto load_start = std::chrono::high_resolution_clock::now();
-
-    // 快速文件解析 - 使用字符串操作替代stringstream
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
+    int threads = resolveThreadCount(buildThreads);
+    std::vector<TextRecord> records = DataLoader::parseRecords(file.data(), file.size(), threads);
 
-        // 使用更快的字符串解析
-        size_t pos1 = line.find('|');
-        if (pos1 == std::string::npos) continue;
+    auto load_end = std::chrono::high_resolution_clock::now();
+    auto load_duration = std::chrono::duration_cast<std::chrono::milliseconds>(load_end - load_start);
+    std::cout << "File loading completed: " << records.size() << " records in "
+        << load_duration.count() << " ms (" << threads << " threads)" << std::endl;
 
-        size_t pos2 = line.find('|', pos1 + 1);
-        if (pos2 == std::string::npos) continue;
+    if (records.empty()) return;
 
-        std::string text = line.substr(0, pos1);
-        std::string lon_str = line.substr(pos1 + 1, pos2 - pos1 - 1);
-        std::string lat_str = line.substr(pos2 + 1);
+    auto total_start = std::chrono::high_resolution_clock::now();
+    std::cout << "Starting bulk insertion of " << records.size() << " documents..." << std::endl;
 
-        try {
-            double lon = std::stod(lon_str);
-            double lat = std::stod(lat_str);
-            documents.emplace_back(text, lon, lat);
-            loaded_count++;
+    // 阶段1：并行创建文档对象，文本从映射区只复制一次（映射在创建完成前保持有效）
+    std::vector<std::shared_ptr<Document>> doc_objects(records.size());
+    int first_doc_id = next_doc_id;
+    next_doc_id += static_cast<int>(records.size());
 
-            // 定期报告加载进度
-            if (loaded_count % REPORT_INTERVAL == 0) {
-                std::cout << "Loaded " << loaded_count << " records..." << std::endl;
-            }
-        }
-        catch (const std::exception& e) {
-            continue; // 跳过解析错误的数据
-        }
-    }
+    parallelFor(records.size(), threads, [&](size_t i) {
+        const TextRecord& record = records[i];
 
-    file.close();
+        double epsilon = 0.001;
+        MBR location({ record.lon - epsilon, record.lat - epsilon }, { record.lon + epsilon, record.lat + epsilon });
+        doc_objects[i] = std::make_shared<Document>(first_doc_id + static_cast<int>(i), location,
+            record.text, record.text_length);
+    });
 
-    auto load_end = std::chrono::high_resolution_clock::now();
-    auto load_duration = std::chrono::duration_cast<std::chrono::milliseconds>(load_end - load_start);
-    std::cout << "File loading completed: " << loaded_count << " records in "
-        << load_duration.count() << " ms" << std::endl;
+    auto create_end = std::chrono::high_resolution_clock::now();
+    auto create_duration = std::chrono::duration_cast<std::chrono::milliseconds>(create_end - total_start);
+    std::cout << "Document objects created: " << create_duration.count() << " ms" << std::endl;
 
-    // 使用优化的批量插入
-    optimizedBulkInsertDocuments(documents);
+    bulkInsertDocumentObjects(doc_objects, total_start);
 }
 
 void IRTree::optimizedBulkInsertDocuments(const std::vector<std::tuple<std::string, double, double>>& documents) {
@@ -1026,40 +2208,37 @@ void IRTree::optimizedBulkInsertDocuments(const std::vector<std::tuple<std::stri
     auto total_start = std::chrono::high_resolution_clock::now();
     std::cout << "Starting bulk insertion of " << documents.size() << " documents..." << std::endl;
 
-    // 阶段1：批量创建文档对象（并行化）
-    std::vector<std::shared_ptr<Document>> doc_objects;
-    doc_objects.reserve(documents.size());
+    int threads = resolveThreadCount(buildThreads);
 
-    auto create_start = std::chrono::high_resolution_clock::now();
+    // 阶段1：并行创建文档对象（分词在 Document 构造时完成），文档 ID 按输入顺序预先分配
+    std::vector<std::shared_ptr<Document>> doc_objects(documents.size());
+    int first_doc_id = next_doc_id;
+    next_doc_id += static_cast<int>(documents.size());
 
-    // 使用更高效的方式创建文档 - OpenMP并行化
-#pragma omp parallel for
-    for (int i = 0; i < documents.size(); i++) {
+    parallelFor(documents.size(), threads, [&](size_t i) {
         const auto& doc_data = documents[i];
-        const auto& text = std::get<0>(doc_data);
         double lon = std::get<1>(doc_data);
         double lat = std::get<2>(doc_data);
 
         double epsilon = 0.001;
         MBR location({ lon - epsilon, lat - epsilon }, { lon + epsilon, lat + epsilon });
-
-#pragma omp critical
-        {
-            // 临界区保护共享资源
-            auto document = std::make_shared<Document>(next_doc_id++, location, text);
-            doc_objects.push_back(document);
-        }
-    }
+        doc_objects[i] = std::make_shared<Document>(first_doc_id + static_cast<int>(i), location, std::get<0>(doc_data));
+    });
 
     auto create_end = std::chrono::high_resolution_clock::now();
-    auto create_duration = std::chrono::duration_cast<std::chrono::milliseconds>(create_end - create_start);
+    auto create_duration = std::chrono::duration_cast<std::chrono::milliseconds>(create_end - total_start);
     std::cout << "Document objects created: " << create_duration.count() << " ms" << std::endl;
 
+    bulkInsertDocumentObjects(doc_objects, total_start);
+}
+
+void IRTree::bulkInsertDocumentObjects(const std::vector<std::shared_ptr<Document>>& documents,
+    std::chrono::high_resolution_clock::time_point total_start) {
     // 阶段2：批量构建全局索引（优化版本）
-    bulkBuildGlobalIndex(doc_objects);
+    bulkBuildGlobalIndex(documents);
 
     // 阶段3：使用自底向上的方式构建树（关键优化）
-    buildTreeBottomUp(doc_objects);
+    buildTreeBottomUp(documents);
 
     auto total_end = std::chrono::high_resolution_clock::now();
     auto total_duration = std::chrono::duration_cast<std::chrono::milliseconds>(total_end - total_start);
@@ -1071,126 +2250,56 @@ void IRTree::optimizedBulkInsertDocuments(const std::vector<std::tuple<std::stri
 void IRTree::bulkBuildGlobalIndex(const std::vector<std::shared_ptr<Document>>& documents) {
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    // 批量词汇表构建 - 先收集所有词汇
-    std::unordered_map<std::string, int> term_frequencies;
-
-    // 先收集所有词汇及其频率
-    for (const auto& doc : documents) {
-        std::istringstream iss(doc->getText());
-        std::string word;
-        while (iss >> word) {
-            term_frequencies[word]++;
-        }
-    }
-
-    // 批量添加到词汇表 
-    for (const auto& term : term_frequencies) {
-        int term_id = vocab.addTerm(term.first);
-       
-        // 验证添加是否成功
-        int verify_id = vocab.getTermId(term.first);
-        if (verify_id != term_id) {
-            std::cerr << "ERROR: Vocabulary inconsistency for term '" << term.first
-                << "'. Added as " << term_id << " but found as " << verify_id << std::endl;
-        }
-    }
-
-    // 验证词汇表最终状态
-    // std::cout << "Final vocabulary size: " << vocab.size() << std::endl;
-
-   
-    //// 批量添加到词汇表
-    //for (const auto& term : term_frequencies) {
-    //    int term_id=vocab.getTermId(term.first); // 这会创建或获取term id
-    //    std::cout << "Term '" << term.first << "' -> ID " << term_id << std::endl;
-    //}
-
-    // 批量构建文档向量
-    for (const auto& doc : documents) {
-        Vector doc_vector(doc->getId());
-        Vector::vectorize(doc_vector, doc->getText(), vocab);
-        global_index.addDocument(doc->getId(), doc_vector);
-    }
-
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-    std::cout << "Optimized global index built: " << duration.count() << " ms" << std::endl;
-}
-
-void IRTree::bulkInsertToTree(const std::vector<std::shared_ptr<Document>>& documents) {
-    auto start_time = std::chrono::high_resolution_clock::now();
-
-    // 按空间位置排序，提高局部性
-    std::vector<std::shared_ptr<Document>> sorted_docs = documents;
-    std::sort(sorted_docs.begin(), sorted_docs.end(),
-        [](const std::shared_ptr<Document>& a, const std::shared_ptr<Document>& b) {
-            return a->getLocation().getCenter()[0] < b->getLocation().getCenter()[0];
-        });
-
-    // 分组插入到叶子节点
-    std::unordered_map<int, std::shared_ptr<Node>> leaf_nodes;
-    std::unordered_map<int, std::vector<std::shared_ptr<Document>>> leaf_docs;
-
-    // 第一步：收集每个叶子节点要插入的文档
-    int choose_leaf_count = 0;
-    for (const auto& doc : sorted_docs) {
-        int leaf_id = chooseLeaf(doc->getLocation());
-        if (leaf_id != -1) {
-            leaf_docs[leaf_id].push_back(doc);
-            choose_leaf_count++;
-
-            if (choose_leaf_count % 1000 == 0) {
-                std::cout << "Processed " << choose_leaf_count << " documents for leaf assignment..." << std::endl;
-            }
-        }
-    }
-
-    // 第二步：批量加载叶子节点
-    for (const auto& entry : leaf_docs) {
-        int leaf_id = entry.first;
-        auto node = loadNode(leaf_id);
-        if (node) {
-            leaf_nodes[leaf_id] = node;
-        }
-    }
-
-    // 第三步：批量添加文档到节点
-    int insert_count = 0;
-    for (const auto& entry : leaf_docs) {
-        int leaf_id = entry.first;
-        auto node = leaf_nodes[leaf_id];
-        if (node) {
-            for (const auto& doc : entry.second) {
-                node->addDocument(doc);
-                insert_count++;
+    int threads = resolveThreadCount(buildThreads);
+    size_t parts = static_cast<size_t>(threads);
+
+    // 1. 每个线程收集一段文档的词项。Document 构造时已经分词（小写、去标点），这里不再重新分词
+    std::vector<std::vector<std::string>> local_terms(parts);
+    parallelFor(parts, threads, [&](size_t t) {
+        std::unordered_set<std::string> seen;
+        size_t end = documents.size() * (t + 1) / parts;
+        for (size_t i = documents.size() * t / parts; i < end; i++) {
+            for (const auto& entry : documents[i]->getTermFreq()) {
+                seen.insert(entry.first);
             }
-
-            saveNode(leaf_id, node);
         }
-    }
-
-    // 第四步：批量调整树结构（延迟调整）
-    int adjust_count = 0;
-    for (const auto& entry : leaf_nodes) {
-        adjustTree(entry.first);
-        adjust_count++;
-
-        if (adjust_count % 100 == 0) {
-            std::cout << "Adjusted " << adjust_count << " nodes..." << std::endl;
+        local_terms[t].assign(seen.begin(), seen.end());
+    }, 1);
+
+    // 2. 合并后按字典序加入词汇表，词项 ID 与线程数无关
+    std::vector<std::string> all_terms;
+    for (auto& terms : local_terms) {
+        std::move(terms.begin(), terms.end(), std::back_inserter(all_terms));
+    }
+    std::sort(all_terms.begin(), all_terms.end());
+    all_terms.erase(std::unique(all_terms.begin(), all_terms.end()), all_terms.end());
+    for (const auto& term : all_terms) {
+        vocab.addTerm(term);
+    }
+
+    // 3. 并行构建文档向量（只读词汇表），再按文档顺序加入倒排索引
+    std::vector<Vector> doc_vectors(documents.size());
+    parallelFor(documents.size(), threads, [&](size_t i) {
+        Vector doc_vector(documents[i]->getId());
+        for (const auto& entry : documents[i]->getTermFreq()) {
+            doc_vector.addTerm(vocab.getTermId(entry.first), static_cast<double>(entry.second));
         }
+        doc_vectors[i] = std::move(doc_vector);
+    });
+    for (size_t i = 0; i < documents.size(); i++) {
+        global_index.addDocument(documents[i]->getId(), doc_vectors[i]);
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-    std::cout << "Tree insertion completed: " << insert_count << " documents in "
-        << duration.count() << " ms" << std::endl;
+    std::cout << "Optimized global index built: " << duration.count() << " ms" << std::endl;
 }
 
 // 刷新缓存 - 将所有缓存节点写回存储
 void IRTree::flushNodeCache() {
     std::lock_guard<std::mutex> lock(cache_mutex);
     for (const auto& entry : node_cache) {
-        storage->storeNode(entry.first, NodeSerializer::serialize(*entry.second));
+        storage->storeNode(entry.first, encodeNode(*entry.second));
     }
     node_cache.clear();
 }
@@ -1225,116 +2334,197 @@ void IRTree::cachedSaveNode(int node_id, std::shared_ptr<Node> node) {
     node_cache[node_id] = node;
 
     // 异步保存到存储
-    storage->storeNode(node_id, NodeSerializer::serialize(*node));
+    storage->storeNode(node_id, encodeNode(*node));
+}
+
+std::vector<int> IRTree::termIdsOf(const std::unordered_map<std::string, int>& term_map) const {
+    std::vector<int> ids;
+    ids.reserve(term_map.size());
+    for (const auto& entry : term_map) {
+        int term_id = vocab.getTermId(entry.first);
+        if (term_id >= 0) {
+            ids.push_back(term_id);
+        }
+    }
+    return ids;
 }
 
-// 关键优化：自底向上构建树 - 避免频繁的树调整操作
+// 关键优化：自底向上构建树 - 避免频繁的树调整操作。
+// 整棵树先在内存中构建（每层的节点并行创建），路径分配后并行序列化，
+// 最后所有节点和文档一次批量写入 ORAM（见 RingOramStorage::bulkStore）
 void IRTree::buildTreeBottomUp(const std::vector<std::shared_ptr<Document>>& documents) {
     auto start_time = std::chrono::high_resolution_clock::now();
 
     if (documents.empty()) return;
+    OdsSession session(*this);
+
+    // 新树替换原来的树（通常只有构造时创建的空根节点），原来的节点块全部释放
+    if (root_node_id != -1) {
+        NodeWriteBuffer buffer;
+        releaseSubtree(root_node_id, buffer);
+        root_node_id = -1;
+    }
+
+    int threads = resolveThreadCount(buildThreads);
+
+    // 按打包策略把空间上相近的文档分到同一个叶子节点（见 BulkLoader.h）
+    BulkLoadStrategy strategy = BulkLoader::fromInt(bulkLoadStrategy);
+    bool text_aware = strategy == BulkLoadStrategy::TEXT_AWARE;
+    std::vector<MBR> doc_boxes(documents.size(), documents[0]->getLocation());
+    std::vector<std::vector<int>> doc_terms(text_aware ? documents.size() : 0);
+    parallelFor(documents.size(), threads, [&](size_t i) {
+        doc_boxes[i] = documents[i]->getLocation();
+        if (text_aware) {
+            doc_terms[i] = termIdsOf(documents[i]->getTermFreq());
+        }
+    });
+    for (const auto& document : documents) {
+        recordDocumentLocation(*document);
+    }
+    auto leaf_groups = BulkLoader::pack(doc_boxes, max_capacity, bulkFillFactor, strategy,
+        &doc_terms, bulkTextTileNodes, bulkTextQueryExtent);
 
-    // 按空间位置聚类 - 提高局部性
-    std::vector<std::shared_ptr<Document>> sorted_docs = documents;
-    std::sort(sorted_docs.begin(), sorted_docs.end(),
-        [](const std::shared_ptr<Document>& a, const std::shared_ptr<Document>& b) {
-            return a->getLocation().getCenter()[0] < b->getLocation().getCenter()[0];
-        });
-
-    // 直接创建叶子节点，避免频繁的chooseLeaf调用
-    std::vector<std::shared_ptr<Node>> leaf_nodes;
-    const int LEAF_CAPACITY = max_capacity;
+    // 所有节点按创建顺序保存，节点 ID 从 first_node_id 起连续分配
+    int first_node_id = next_node_id;
+    std::vector<std::shared_ptr<Node>> all_nodes;
 
-    // 批量创建叶子节点
-    for (size_t i = 0; i < sorted_docs.size(); i += LEAF_CAPACITY) {
-        size_t end_index = std::min(i + LEAF_CAPACITY, sorted_docs.size());
+    // 直接创建叶子节点，不逐个选择插入叶子；每组的节点 ID 预先分配，各组并行构建
+    std::vector<std::shared_ptr<Node>> leaf_nodes(leaf_groups.size());
+    int first_leaf_id = next_node_id;
+    next_node_id += static_cast<int>(leaf_groups.size());
+    parallelFor(leaf_groups.size(), threads, [&](size_t g) {
+        const auto& group = leaf_groups[g];
 
         // 计算叶子节点的MBR - 包含该批次所有文档
-        MBR leaf_mbr = sorted_docs[i]->getLocation();
-        for (size_t j = i + 1; j < end_index; j++) {
-            leaf_mbr.expand(sorted_docs[j]->getLocation());
+        MBR leaf_mbr = doc_boxes[group[0]];
+        for (size_t index : group) {
+            leaf_mbr.expand(doc_boxes[index]);
         }
 
-        // 创建叶子节点
-        int leaf_id = createNewNode(Node::LEAF, 0, leaf_mbr);
-        auto leaf_node = cachedLoadNode(leaf_id);
-
-        if (leaf_node) {
-            // 批量添加文档
-            for (size_t j = i; j < end_index; j++) {
-                leaf_node->addDocument(sorted_docs[j]);
-            }
-            cachedSaveNode(leaf_id, leaf_node);
-            leaf_nodes.push_back(leaf_node);
+        auto leaf_node = std::make_shared<Node>(first_leaf_id + static_cast<int>(g), Node::LEAF, 0, leaf_mbr);
+        for (size_t index : group) {
+            leaf_node->addDocument(documents[index]);
         }
+        leaf_nodes[g] = leaf_node;
+    }, 16);
+    all_nodes.insert(all_nodes.end(), leaf_nodes.begin(), leaf_nodes.end());
 
-
-        //// 定期报告进度
-        //if (leaf_nodes.size() % 100 == 0) {
-        //    std::cout << "Created " << leaf_nodes.size() << " leaf nodes..." << std::endl;
-        //}
-    }
-
-    std::cout << "Created " << leaf_nodes.size() << " leaf nodes total" << std::endl;
+    std::cout << "Created " << leaf_nodes.size() << " leaf nodes total ("
+        << BulkLoader::name(strategy) << ", fill factor " << bulkFillFactor << ")" << std::endl;
 
     // 自底向上构建树 - 从叶子节点开始构建上层节点
     std::vector<std::shared_ptr<Node>> current_level = leaf_nodes;
     int level = 1;
 
     while (current_level.size() > 1) {
-        std::vector<std::shared_ptr<Node>> next_level;
-
-        // 按空间位置排序当前层节点
-        std::sort(current_level.begin(), current_level.end(),
-            [](const std::shared_ptr<Node>& a, const std::shared_ptr<Node>& b) {
-                return a->getMBR().getCenter()[0] < b->getMBR().getCenter()[0];
-            });
+        // 当前层节点按同一策略分组
+        std::vector<MBR> node_boxes(current_level.size(), current_level[0]->getMBR());
+        std::vector<std::vector<int>> node_terms(text_aware ? current_level.size() : 0);
+        parallelFor(current_level.size(), threads, [&](size_t i) {
+            node_boxes[i] = current_level[i]->getMBR();
+            if (text_aware) {
+                node_terms[i] = termIdsOf(current_level[i]->getTFMax());
+            }
+        });
+        auto groups = BulkLoader::pack(node_boxes, max_capacity, bulkFillFactor, strategy,
+            &node_terms, bulkTextTileNodes, bulkTextQueryExtent);
 
-        // 创建父节点
-        for (size_t i = 0; i < current_level.size(); i += max_capacity) {
-            size_t end_index = std::min(i + max_capacity, current_level.size());
+        // 创建父节点（各组并行）
+        std::vector<std::shared_ptr<Node>> next_level(groups.size());
+        int first_parent_id = next_node_id;
+        next_node_id += static_cast<int>(groups.size());
+        parallelFor(groups.size(), threads, [&](size_t g) {
+            const auto& group = groups[g];
 
             // 计算父节点的MBR - 包含所有子节点
-            MBR parent_mbr = current_level[i]->getMBR();
-            for (size_t j = i + 1; j < end_index; j++) {
-                parent_mbr.expand(current_level[j]->getMBR());
+            MBR parent_mbr = node_boxes[group[0]];
+            for (size_t index : group) {
+                parent_mbr.expand(node_boxes[index]);
             }
 
-            // 创建内部节点
-            int parent_id = createNewNode(Node::INTERNAL, level, parent_mbr);
-            auto parent_node = cachedLoadNode(parent_id);
+            auto parent_node = std::make_shared<Node>(first_parent_id + static_cast<int>(g), Node::INTERNAL, level, parent_mbr);
+            for (size_t index : group) {
+                parent_node->addChild(current_level[index]);
+            }
 
-            if (parent_node) {
-                // 添加子节点
-                for (size_t j = i; j < end_index; j++) {
-                    parent_node->addChild(current_level[j]);
-                }
+            //计算并设置子节点的文本上界
+            computeAndSetChildUpperBounds(parent_node);
+            next_level[g] = parent_node;
+        }, 16);
+        all_nodes.insert(all_nodes.end(), next_level.begin(), next_level.end());
+
+        current_level.swap(next_level);
+        level++;
+    }
 
-                //计算并设置子节点的文本上界
-                computeAndSetChildUpperBounds(parent_node);
+    auto pack_end = std::chrono::high_resolution_clock::now();
 
-                cachedSaveNode(parent_id, parent_node);
-                next_level.push_back(parent_node);
+    // 为所有节点分配块，子节点的块号记录到父节点中（与 assignPathRecursively 相同）
+    std::vector<int> node_paths(all_nodes.size());
+    for (size_t i = 0; i < all_nodes.size(); i++) {
+        node_paths[i] = assignNodePath(all_nodes[i]->getId());
+    }
+    // ODS 模式：各节点块预先选定叶子，记录到父节点中（根节点的叶子保存在客户端）
+    std::vector<int> node_leaves(ods_storage ? all_nodes.size() : 0);
+    for (auto& leaf : node_leaves) {
+        leaf = ods_storage->randomLeaf();
+    }
+    for (const auto& node : all_nodes) {
+        if (node->getType() != Node::INTERNAL) continue;
+        for (const auto& child : node->getChildNodes()) {
+            node->setChildPosition(child->getId(), node_paths[child->getId() - first_node_id]);
+            if (ods_storage) {
+                node->setChildLeaf(child->getId(), node_leaves[child->getId() - first_node_id]);
             }
         }
+    }
 
+    // 并行序列化节点与完整文档。所有词项已在 bulkBuildGlobalIndex 中加入词汇表，序列化只读词汇表
+    std::vector<std::pair<int, std::vector<uint8_t>>> node_blocks(all_nodes.size());
+    parallelFor(all_nodes.size(), threads, [&](size_t i) {
+        node_blocks[i].first = all_nodes[i]->getId();
+        node_blocks[i].second = encodeNode(*all_nodes[i]);
+    }, 16);
+    std::vector<std::pair<int, std::vector<uint8_t>>> doc_blocks(separateDocuments ? documents.size() : 0);
+    parallelFor(doc_blocks.size(), threads, [&](size_t i) {
+        doc_blocks[i].first = documents[i]->getId();
+        doc_blocks[i].second = NodeSerializer::serializeDocument(*documents[i]);
+    });
 
-        current_level = next_level;
-        level++;
-    }
+    auto encode_end = std::chrono::high_resolution_clock::now();
 
-    // 更新根节点
-    if (!current_level.empty()) {
-        root_node_id = current_level[0]->getId();
+    // 一次批量写入 ORAM（压缩与加密并行）；其他存储逐个写入
+    auto path_oram_storage = std::dynamic_pointer_cast<RingOramStorage>(storage);
+    if (path_oram_storage) {
+        if (!path_oram_storage->bulkStore(node_blocks, doc_blocks, threads, ods_storage ? &node_leaves : nullptr)) {
+            std::cerr << "Bulk store of the built tree failed" << std::endl;
+        }
+    }
+    else {
+        storage->batchStoreNodes(node_blocks);
+        for (const auto& doc_block : doc_blocks) {
+            storage->storeDocument(doc_block.first, doc_block.second);
+        }
     }
 
-    // 刷新所有缓存到存储
-    flushNodeCache();
+    // 更新根节点；整棵树重建后缓存的节点全部失效，下次查询时重新预热
+    upper_cache.clear();
+    root_node_id = current_level[0]->getId();
+    int root_path = node_paths[root_node_id - first_node_id];
+    if (root_path != -1) {
+        setRootPath(root_path);
+    }
+    if (ods_storage) {
+        ods_storage->setRootLeaf(node_leaves[root_node_id - first_node_id]);
+    }
 
     auto end_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-    std::cout << "Bottom-up tree construction completed in " << duration.count() << " ms" << std::endl;
-    initializeRecursivePositionMap();
+    auto ms = [](std::chrono::high_resolution_clock::time_point from, std::chrono::high_resolution_clock::time_point to) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count();
+    };
+    std::cout << "Bottom-up tree construction completed in " << ms(start_time, end_time) << " ms ("
+        << all_nodes.size() << " nodes, " << threads << " threads: pack " << ms(start_time, pack_end)
+        << " ms, encode " << ms(pack_end, encode_end) << " ms, store " << ms(encode_end, end_time) << " ms)" << std::endl;
 }
 
 
@@ -1343,41 +2533,244 @@ void IRTree::computeAndSetChildUpperBounds(std::shared_ptr<Node> parent) {
         return;
     }
 
-    int total_docs = global_index.getTotalDocuments();
-    auto child_nodes = parent->getChildNodes();
+    for (const auto& child : parent->getChildNodes()) {
+        // 计算该子节点的文本相关性上界，设置到父节点中
+        parent->setChildTextUpperBound(child->getId(), computeChildTextUpperBound(*child));
+    }
+}
+
+double IRTree::computeChildTextUpperBound(const Node& child) const {
+    // 只保存 TF 部分：IDF 随插入的文档变化，写入父节点时的 IDF 之后可能偏小，
+    // 由查询时的 computeMaxQueryIdf 补上
+    int tf_max = 0;
+    for (const auto& tf_pair : child.getTFMax()) {
+        tf_max = std::max(tf_max, tf_pair.second);
+    }
+    return tf_max > 0 ? std::log(1.0 + tf_max) : 0.0;
+}
 
-    for (const auto& child : child_nodes) {
-        int child_id = child->getId();
 
-        // 计算该子节点的文本相关性上界
-        double text_upper_bound = 0.0;
-        const auto& tf_max_map = child->getTFMax();
+// ====================================================
+// 快照
+// ====================================================
 
-        for (const auto& tf_pair : tf_max_map) {
-            const std::string& term = tf_pair.first;
-            int tf_max = tf_pair.second;
+namespace {
 
-            // 获取全局文档频率
-            int term_id = vocab.getTermId(term);
-            if (term_id == -1) continue;
+const char kSnapshotMagic[8] = { 'I', 'R', 'T', 'R', 'S', 'N', 'A', 'P' };
+const uint32_t kMetaSectionTag = snapshotTag('M', 'E', 'T', 'A');
+const uint32_t kTreeSectionTag = snapshotTag('T', 'R', 'E', 'E');
+const uint32_t kVocabularySectionTag = snapshotTag('V', 'O', 'C', 'B');
+const uint32_t kIndexSectionTag = snapshotTag('I', 'N', 'D', 'X');
 
-            int global_df = global_index.getDocumentFrequency(term_id);
-            if (global_df == 0) continue;
+// 影响块内容或 ORAM 布局的参数，与快照中不一致时不能恢复
+void putConfig(SnapshotWriter& writer) {
+    writer.putI32(totalnumRealblock);
+    writer.putI32(OramL);
+    writer.putI32(realBlockEachbkt);
+    writer.putI32(dummyBlockEachbkt);
+    writer.putBool(compactNodeFormat);
+    writer.putBool(separateDocuments);
+}
+
+bool configMatches(SnapshotReader& reader) {
+    bool matches = reader.getI32() == totalnumRealblock;
+    matches = (reader.getI32() == OramL) && matches;
+    matches = (reader.getI32() == realBlockEachbkt) && matches;
+    matches = (reader.getI32() == dummyBlockEachbkt) && matches;
+    matches = (reader.getBool() == compactNodeFormat) && matches;
+    matches = (reader.getBool() == separateDocuments) && matches;
+    return reader.ok() && matches;
+}
 
-            // 计算该词的最大可能TF-IDF值
-            double max_tfidf = Vector::computeTFIDFWeight(tf_max, global_df, total_docs);
-            text_upper_bound = std::max(text_upper_bound, max_tfidf);
+} // namespace
+
+bool IRTree::saveSnapshot(const std::string& filename) {
+    auto start = std::chrono::high_resolution_clock::now();
+    auto oram_storage = std::dynamic_pointer_cast<RingOramStorage>(storage);
+    if (!oram_storage) {
+        std::cerr << "Error: Snapshots require RingOramStorage" << std::endl;
+        return false;
+    }
+
+    // 随机令牌把快照与服务器存储文件对应起来（0 表示无效）
+    std::random_device rd;
+    uint64_t token = 0;
+    while (token == 0) {
+        token = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+
+    // 先保存服务器端：服务器保存失败时不写快照，已有的快照与存储文件仍然配对
+    if (!oram_storage->saveServerStore(token)) {
+        std::cerr << "Error: Server could not save its store; snapshot not written" << std::endl;
+        return false;
+    }
+
+    SnapshotWriter writer;
+    writer.beginSection(kMetaSectionTag);
+    writer.putU64(token);
+    putConfig(writer);
+    writer.endSection();
+
+    writer.beginSection(kTreeSectionTag);
+    writer.putI32(root_node_id);
+    writer.putI32(next_node_id);
+    writer.putI32(next_doc_id);
+    writer.putI32(dimensions);
+    writer.putI32(min_capacity);
+    writer.putI32(max_capacity);
+    writer.putArray(document_locations);
+    writer.endSection();
+
+    // 词项按 ID 顺序保存，恢复时依次加入即得到相同的 ID
+    writer.beginSection(kVocabularySectionTag);
+    writer.putU64(vocab.size());
+    for (size_t id = 0; id < vocab.size(); id++) {
+        writer.putString(vocab.getTerm(static_cast<int>(id)));
+    }
+    writer.endSection();
+
+    writer.beginSection(kIndexSectionTag);
+    writer.putI32(global_index.getTotalDocuments());
+    const auto& entries = global_index.getIndex();
+    writer.putU64(entries.size());
+    for (const auto& entry : entries) {
+        writer.putI32(entry.first);
+        writer.putU64(entry.second.size());
+        for (const auto& posting : entry.second) {
+            writer.putI32(posting.doc_id);
+            writer.putF64(posting.weight);
         }
+    }
+    writer.endSection();
 
-        // 设置到父节点中
-        parent->setChildTextUpperBound(child_id, text_upper_bound);
+    oram_storage->saveState(writer);
+
+    if (!writer.writeFile(filename, kSnapshotMagic)) {
+        return false;
     }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Saved snapshot " << filename << " (" << writer.size() / 1024 << " KB) in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+    return true;
 }
 
+bool IRTree::loadSnapshot(const std::string& filename) {
+    auto start = std::chrono::high_resolution_clock::now();
+    auto oram_storage = std::dynamic_pointer_cast<RingOramStorage>(storage);
+    if (!oram_storage) {
+        std::cerr << "Error: Snapshots require RingOramStorage" << std::endl;
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        return false;
+    }
+    SnapshotReader reader;
+    std::string error;
+    if (!reader.open(file.data(), file.size(), kSnapshotMagic, error)) {
+        std::cerr << "Error: Invalid snapshot " << filename << ": " << error << std::endl;
+        return false;
+    }
+
+    reader.beginSection(kMetaSectionTag);
+    uint64_t token = reader.getU64();
+    if (!configMatches(reader) || !reader.endSection()) {
+        std::cerr << "Error: Snapshot " << filename << " was written with different ORAM parameters" << std::endl;
+        return false;
+    }
+
+    // 服务器内存中的 bucket 必须正是与快照一起保存的存储文件，之后没有被修改过
+    uint64_t server_token = 0;
+    if (!oram_storage->getServerStoreToken(server_token)) {
+        return false;
+    }
+    if (server_token != token) {
+        std::cerr << "Error: Server store does not match snapshot " << filename
+                  << " (the server was not started from the store saved with it, or has been modified since)" << std::endl;
+        return false;
+    }
+
+    // 先全部解析到局部变量，存储状态恢复成功后再替换
+    reader.beginSection(kTreeSectionTag);
+    int saved_root = reader.getI32();
+    int saved_next_node = reader.getI32();
+    int saved_next_doc = reader.getI32();
+    int saved_dimensions = reader.getI32();
+    int saved_min_capacity = reader.getI32();
+    int saved_max_capacity = reader.getI32();
+    std::vector<double> saved_locations;
+    reader.getArray(saved_locations);
+    reader.endSection();
+    if (!reader.ok() || saved_dimensions != dimensions ||
+        saved_min_capacity != min_capacity || saved_max_capacity != max_capacity) {
+        std::cerr << "Error: Snapshot tree parameters do not match" << std::endl;
+        return false;
+    }
+
+    reader.beginSection(kVocabularySectionTag);
+    uint64_t term_count = reader.getU64();
+    Vocabulary saved_vocab;
+    std::string term;
+    for (uint64_t id = 0; id < term_count && reader.getString(term); id++) {
+        if (saved_vocab.addTerm(term) != static_cast<int>(id)) {
+            std::cerr << "Error: Duplicate term in snapshot vocabulary" << std::endl;
+            return false;
+        }
+    }
+    reader.endSection();
+
+    reader.beginSection(kIndexSectionTag);
+    int total_documents = reader.getI32();
+    uint64_t index_size = reader.getU64();
+    std::unordered_map<int, std::vector<Posting>> saved_index;
+    saved_index.reserve(static_cast<size_t>(std::min<uint64_t>(index_size, term_count)));
+    for (uint64_t i = 0; i < index_size && reader.ok(); i++) {
+        int term_id = reader.getI32();
+        uint64_t posting_count = reader.getU64();
+        auto& postings = saved_index[term_id];
+        // 每条至少 12 字节，计数损坏时不预分配
+        if (posting_count <= reader.remaining() / 12) {
+            postings.reserve(static_cast<size_t>(posting_count));
+        }
+        for (uint64_t j = 0; j < posting_count && reader.ok(); j++) {
+            int doc_id = reader.getI32();
+            double weight = reader.getF64();
+            postings.emplace_back(doc_id, weight);
+        }
+    }
+    if (!reader.endSection()) {
+        std::cerr << "Error: Corrupt snapshot " << filename << std::endl;
+        return false;
+    }
+
+    if (!oram_storage->loadState(reader)) {
+        return false;
+    }
 
+    root_node_id = saved_root;
+    next_node_id = saved_next_node;
+    next_doc_id = saved_next_doc;
+    document_locations.swap(saved_locations);
+    vocab = std::move(saved_vocab);
+    global_index.restore(std::move(saved_index), total_documents);
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        node_cache.clear();
+    }
+    upper_cache.clear();
 
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Restored snapshot " << filename << " (" << vocab.size() << " terms, "
+              << oram_storage->getStoredNodeCount() << " nodes, "
+              << oram_storage->getStoredDocumentCount() << " documents) in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+    return true;
+}
 
-std::chrono::nanoseconds IRTree::getRunTime(const std::string& query_keywords, const MBR& scope, int k, bool show_details) {
+std::chrono::nanoseconds IRTree::getRunTime(const std::string& query_keywords, const MBR& scope, int k, bool show_details,
+    SearchStats* stats) {
     // 分割关键词
     std::vector<std::string> keywords;
     std::istringstream iss(query_keywords);
@@ -1391,7 +2784,7 @@ std::chrono::nanoseconds IRTree::getRunTime(const std::string& query_keywords, c
     auto start_time = std::chrono::high_resolution_clock::now();
 
     // 执行搜索
-    auto results = search(keywords, scope, k, 0.5);
+    auto results = search(keywords, scope, k, 0.5, stats);
 
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
@@ -1400,30 +2793,55 @@ std::chrono::nanoseconds IRTree::getRunTime(const std::string& query_keywords, c
 
     // 打印关键词和搜索结果
     if (show_details) {
-        std::cout << "\n" << std::string(40, '=') << std::endl;
-        std::cout << "QUERY: '" << query_keywords << "'" << std::endl;
-        std::cout << std::string(40, '=') << std::endl;
-
-        std::cout << "RESULTS: " << results.size() << " documents found" << std::endl;
-        std::cout << "Time: " << duration.count() / 1000000.0 << " ms" << std::endl;
-
-
-        if (!results.empty()) {
-            for (size_t i = 0; i < results.size(); i++) {
-                const auto& result = results[i];
-                if (result.isData()) {
-                    auto doc = result.document;
-                    std::cout << "  " << (i + 1) << ". Doc " << doc->getId()
-                        << " - Score: " << result.score
-                        << " - '" << doc->getText() << "'" << std::endl;
-                }
-            }
-        }
-        else {
-            std::cout << "  No results found" << std::endl;
-        }
+        printQueryResults(query_keywords, results, duration);
+    }
+
+
+    return duration;
+}
+
+std::chrono::nanoseconds IRTree::getNearestRunTime(const std::string& query_keywords, const std::vector<double>& location,
+    int k, bool show_details, SearchStats* stats) {
+    std::vector<std::string> keywords;
+    std::istringstream iss(query_keywords);
+    std::string keyword;
+    while (iss >> keyword) {
+        keywords.push_back(keyword);
     }
 
+    auto start_time = std::chrono::high_resolution_clock::now();
+    auto results = searchNearest(keywords, location, k, 0.5, stats);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time);
 
+    if (show_details) {
+        printQueryResults(query_keywords, results, duration);
+    }
     return duration;
-}
\ No newline at end of file
+}
+
+void IRTree::printQueryResults(const std::string& query_keywords, const std::vector<TreeHeapEntry>& results,
+    std::chrono::nanoseconds duration) {
+    std::cout << "\n" << std::string(40, '=') << std::endl;
+    std::cout << "QUERY: '" << query_keywords << "'" << std::endl;
+    std::cout << std::string(40, '=') << std::endl;
+
+    std::cout << "RESULTS: " << results.size() << " documents found" << std::endl;
+    std::cout << "Time: " << duration.count() / 1000000.0 << " ms" << std::endl;
+
+
+    if (!results.empty()) {
+        for (size_t i = 0; i < results.size(); i++) {
+            const auto& result = results[i];
+            if (result.isData()) {
+                auto doc = result.document;
+                std::cout << "  " << (i + 1) << ". Doc " << doc->getId()
+                    << " - Score: " << result.score
+                    << " - '" << doc->getText() << "'" << std::endl;
+            }
+        }
+    }
+    else {
+        std::cout << "  No results found" << std::endl;
+    }
+}
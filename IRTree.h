@@ -1,6 +1,7 @@
 #ifndef IRTREE_H
 #define IRTREE_H
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <vector>
@@ -15,7 +16,12 @@
 #include "Vocabulary.h"
 #include "StorageInterface.h"
 #include"ringoram.h"
+#include "NodeCache.h"
 #include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+class RingOramStorage;
 
 //
 // ===============================================
@@ -29,7 +35,7 @@ struct TreeHeapEntry {
     std::shared_ptr<Node> node;         ///< 指向节点对象（内部节点）
     std::shared_ptr<Document> document; ///< 指向文档对象（叶节点）
     double score;                       ///< 相关性得分，越高表示越相关
-    int path;                           ///< 节点的物理路径
+    int path;                           ///< 节点的位置（ORAM 块号）
 
     /// 默认构造函数
     TreeHeapEntry() : node(nullptr), document(nullptr), score(0.0), path(-1) {}
@@ -71,10 +77,62 @@ struct TreeHeapEntry {
 // ===============================================
 // 用于优先队列中按得分(score)排序，
 // 得分高的项优先出队（大顶堆）。
+// 得分相同时层级低（更靠近叶子）的节点优先，尽快得到文档以抬高第k名得分。
 // ===============================================
 struct TreeHeapComparator {
     bool operator()(const TreeHeapEntry& a, const TreeHeapEntry& b) {
-        return a.score < b.score; // 分数高者优先
+        if (a.score != b.score) {
+            return a.score < b.score; // 分数高者优先
+        }
+        int level_a = a.isNode() ? a.node->getLevel() : -1;
+        int level_b = b.isNode() ? b.node->getLevel() : -1;
+        return level_a > level_b;
+    }
+};
+
+// ===============================================
+// SearchStats：一次查询（或一批查询）的统计信息
+// ===============================================
+// 由 search / searchBatch / searchParallel 返回给调用方，
+// 不保存在 IRTree 中，多个线程同时查询时互不干扰。
+// ===============================================
+struct SearchStats {
+    int blocks = 0;             ///< 读取的块数（路径读取次数 × 未缓存层数）
+    int rounds = 0;             ///< ORAM 访问轮数（批量访问计为一轮）
+    int nodes_visited = 0;      ///< 出队处理的节点数
+    int nodes_pruned = 0;       ///< 因上界不超过第k名得分而未展开的节点数
+    int documents_checked = 0;  ///< 计算过得分的文档数
+    int cached_levels = 0;      ///< 查询时客户端缓存的树层数
+    int cache_hits = 0;         ///< 由缓存提供的节点数（未访问 ORAM）
+    int documents_fetched = 0;  ///< 读取的完整文档数（separateDocuments 时只读取最终结果）
+};
+
+// ===============================================
+// NodeWriteBuffer：一次插入的节点缓冲区
+// ===============================================
+// 插入时根到叶子路径上的节点只从 ORAM 读取一次，
+// 插入、MBR/摘要更新和分裂都在缓冲区中的节点上进行，
+// 提交时每个被修改的节点只写回一次。
+// ===============================================
+struct NodeWriteBuffer {
+    std::unordered_map<int, std::shared_ptr<Node>> nodes;  ///< 已读取或新建的节点
+    std::vector<int> dirty;                                 ///< 需要写回的节点（按首次修改顺序）
+    std::unordered_set<int> dirty_set;
+
+    /// 放入（或替换）节点并标记为需要写回
+    void put(std::shared_ptr<Node> node) {
+        nodes[node->getId()] = node;
+        if (dirty_set.insert(node->getId()).second) {
+            dirty.push_back(node->getId());
+        }
+    }
+
+    /// 移出已删除的节点，提交时不再写回
+    void drop(int node_id) {
+        nodes.erase(node_id);
+        if (dirty_set.erase(node_id)) {
+            dirty.erase(std::remove(dirty.begin(), dirty.end(), node_id), dirty.end());
+        }
     }
 };
 
@@ -108,6 +166,35 @@ public:
     int max_capacity;   ///< 节点最大容量（分裂上限）
     int dimensions;     ///< 空间维度（通常为2：经纬度）
 
+    // ====================================================
+    // 搜索模式
+    // ====================================================
+    enum SearchMode {
+        BEST_FIRST,   ///< 每次出队一个节点，子节点逐个 ORAM 访问
+        BATCHED,      ///< 每轮出队多个节点，所有候选子节点一次批量 ORAM 访问
+        OBLIVIOUS     ///< 逐层展开，每层访问次数固定（不足用 dummy 补齐），所有查询访问形态相同
+    };
+
+    SearchMode search_mode;      ///< 当前搜索模式
+    int search_frontier_width;   ///< BATCHED 模式下每轮展开的节点数
+    int oblivious_level_budget;  ///< OBLIVIOUS 模式下每层访问的节点数
+
+    /**
+     * @brief 设置搜索模式
+     * @param mode 搜索模式
+     * @param frontier_width BATCHED 模式下每轮展开的节点数；
+     *        每轮的批量读取补齐到 frontier_width * max_capacity 次
+     */
+    void setSearchMode(SearchMode mode, int frontier_width);
+
+    /**
+     * @brief 切换到固定访问次数的 OBLIVIOUS 模式
+     * @param level_budget 根以下每层访问的节点数。候选子节点超过预算时只保留上界最高的，
+     *        不足时用 dummy 访问补齐；每次查询恰好 1 + 树高 * level_budget 次访问。
+     *        每层的读取作为一个并行批次发出，批次不超过 S（dummyBlockEachbkt），更大的预算截断到 S 并输出警告
+     */
+    void setObliviousMode(int level_budget);
+
     // ====================================================
     // 联合相关性计算
     // ====================================================
@@ -128,6 +215,14 @@ public:
      */
     double computeSpatialRelevance(const MBR& doc_location, const MBR& query_scope) const;
 
+    /**
+     * @brief 计算距离相关性（kNN 查询的空间得分）
+     * @param distance 到查询点的距离
+     * @param max_distance 查询点到数据范围的最远距离（归一化用）
+     * @return 1 - distance / max_distance，距离越近得分越高
+     */
+    double computeDistanceRelevance(double distance, double max_distance) const;
+
     /**
      * @brief 综合文本与空间相关性（通过权重α融合）
      * @param text_relevance 文本得分
@@ -142,69 +237,129 @@ public:
     // ====================================================
 
     /**
-     * @brief 选择插入叶节点（根据MBR扩展代价最小原则）
-     * @param mbr 文档或对象的空间范围
-     * @return 目标叶节点ID
+     * @brief 从缓冲区取节点，不在缓冲区时从存储读取一次并放入缓冲区
+     */
+    std::shared_ptr<Node> bufferedLoadNode(NodeWriteBuffer& buffer, int node_id) const;
+
+    /**
+     * @brief 选择插入位置，返回根到 level 层节点的整条路径（节点读入缓冲区）
+     *
+     * 每层选择扩展面积最小的子节点。level 为 0 时到叶子（插入文档），
+     * 大于 0 时到该层的内部节点（删除后重新插入子树）。
+     * @param mbr 文档或子树的空间范围
+     * @param level 目标节点的层级
+     * @param buffer 本次修改的节点缓冲区
+     * @return 从根到目标节点的节点，失败时为空
+     */
+    std::vector<std::shared_ptr<Node>> choosePathToLevel(const MBR& mbr, int level, NodeWriteBuffer& buffer);
+
+    /**
+     * @brief 把文档插入树中（不更新全局索引），修改只写入缓冲区
+     * @return 是否找到插入位置
      */
-    int chooseLeaf(const MBR& mbr);
+    bool insertIntoTree(std::shared_ptr<Document> document, NodeWriteBuffer& buffer);
 
     /**
-     * @brief 向上调整树结构，更新MBR与层级信息
-     * @param node_id 被修改的节点ID
+     * @brief 新条目加入路径末端的节点后，自底向上分裂溢出的节点并刷新父节点中的子节点条目
+     * @param path 从根到接收新条目的节点（各节点已放入缓冲区）
      */
-    void adjustTree(int node_id);
+    void adjustInsertPath(std::vector<std::shared_ptr<Node>>& path, NodeWriteBuffer& buffer);
 
     /**
-     * @brief 分裂节点（当节点超过max_capacity时触发）
-     * @param node_id 需分裂的节点ID
+     * @brief 查找从 node_id 到包含文档的叶子的路径（只进入子节点MBR包含文档位置的分支）
+     * @param location 文档位置
+     * @param path 输出：从 node_id 到叶子的节点（节点读入缓冲区）
+     * @return 是否找到
      */
-    void splitNode(int node_id);
+    bool findDocumentPath(int node_id, int doc_id, const MBR& location,
+        NodeWriteBuffer& buffer, std::vector<std::shared_ptr<Node>>& path);
+
+    /**
+     * @brief 把删除时拆下的子树重新挂到 level + 1 层的节点下（子树节点本身不修改）
+     * @param child 子树根节点（带有完整摘要）
+     * @param child_path 子树根节点的位置（块号）
+     */
+    bool insertSubtree(std::shared_ptr<Node> child, int child_path, NodeWriteBuffer& buffer);
+
+    /**
+     * @brief 删除节点：从缓冲区移出，删除存储中的节点块（块号留待复用）
+     */
+    void releaseNode(int node_id, NodeWriteBuffer& buffer);
+
+    /**
+     * @brief 删除整棵子树的节点（批量建树替换原来的树时使用）
+     */
+    void releaseSubtree(int node_id, NodeWriteBuffer& buffer);
+
+    /**
+     * @brief 在缓冲区中分裂溢出的节点
+     *
+     * node 保留原ID和前一半内容（替换为新的节点对象），后一半放入新分配ID的兄弟节点。
+     * 内部节点的子节点是占位对象，两半的摘要沿用分裂前的摘要（上界仍然有效）。
+     * @param node 溢出的节点，返回时指向分裂后的前一半
+     * @param buffer 本次插入的节点缓冲区
+     * @return 新的兄弟节点
+     */
+    std::shared_ptr<Node> splitBufferedNode(std::shared_ptr<Node>& node, NodeWriteBuffer& buffer);
+
+    /**
+     * @brief 节点的位置：节点的 ORAM 块号（没有块时分配），父节点以此指向子节点
+     * @return 块号，存储不是 RingOramStorage 时返回 -1
+     */
+    int assignNodePath(int node_id);
+
+    /**
+     * @brief 把缓冲区中被修改的节点各写回一次
+     */
+    void commitNodeBuffer(NodeWriteBuffer& buffer);
 
     // ====================================================
     // 递归位置映射初始化
     // ====================================================
 
     /**
-     * @brief 为整个树分配随机路径并建立递归位置映射
+     * @brief 为整个树登记子节点位置（块号）并建立递归位置映射
      */
     void initializeRecursivePositionMap();
 
     /**
      * @brief 递归分配路径的辅助函数
      * @param node_id 当前节点ID
-     * @return 当前节点的物理路径
+     * @return 当前节点的位置（块号）
      */
     int assignPathRecursively(int node_id);
 
-    /**
-     * @brief 获取随机叶子路径
-     * @return 随机叶子路径 [0, num_leaves-1]
-     */
-    int getRandomLeafPath() const;
-
     // ====================================================
     // 递归查询支持
     // ====================================================
 
     /**
      * @brief 获取根节点的路径（从STASH中）
-     * @return 根节点的物理路径
+     * @return 根节点的位置（块号）
      */
     int getRootPath() const;
 
     /**
      * @brief 设置根节点的路径（到STASH中）
-     * @param path 根节点的物理路径
+     * @param path 根节点的位置（块号）
      */
     void setRootPath(int path);
 
     /**
-     * @brief 递归访问节点（使用路径而不是节点ID）
-     * @param path 要访问的物理路径
+     * @brief 按位置访问节点：位置即块号，一次 ORAM 访问，不经过节点ID映射
+     * @param path 节点的块号（父节点中记录的子节点位置）
      * @return 访问到的节点，如果失败返回nullptr
      */
     std::shared_ptr<Node> accessNodeByPath(int path);
 
+    /**
+     * @brief 批量访问多个位置上的节点（一轮并行的 ORAM 读取）
+     * @param paths 节点的块号
+     * @param pad_to 读取次数补齐到的数量，服务器看到的每轮读取数固定
+     * @return 与 paths 一一对应的节点，失败的为nullptr
+     */
+    std::vector<std::shared_ptr<Node>> batchAccessNodesByPath(const std::vector<int>& paths, int pad_to);
+
     // ====================================================
     // 存储与序列化接口（通过 StorageInterface 实现）
     // ====================================================
@@ -215,6 +370,33 @@ public:
     /// 将节点对象写回存储（序列化）
     void saveNode(int node_id, std::shared_ptr<Node> node);
 
+    /**
+     * @brief 按 compactNodeFormat 选择格式序列化节点（紧凑格式使用 vocab 的词项 ID）
+     */
+    std::vector<uint8_t> encodeNode(const Node& node);
+
+    /**
+     * @brief 反序列化节点，自动识别旧格式与紧凑格式
+     */
+    std::shared_ptr<Node> decodeNode(const std::vector<uint8_t>& data) const;
+
+    /**
+     * @brief separateDocuments 开启时把完整文档写入单独的 ORAM 块
+     *
+     * 叶子节点只保存打分需要的位置和词频，原始文本只在这里存储一次。
+     */
+    void storeFullDocument(const Document& document);
+
+    /**
+     * @brief 为最终结果读取完整文档（一轮批量读取，补齐到 pad_to 块）
+     *
+     * 结果中只带词频的文档被替换为完整文档，得分不变。
+     * separateDocuments 关闭时不做任何事。
+     * @param results 各查询的最终结果
+     * @param pad_to 读取块数补齐到该数量（通常为 k 之和），结果数不泄露给服务器
+     */
+    void fetchResultDocuments(const std::vector<std::vector<TreeHeapEntry>*>& results, int pad_to, SearchStats& stats);
+
     /// 创建新节点（分配ID并初始化）
     int createNewNode(Node::Type type, int level, const MBR& mbr);
 
@@ -225,6 +407,89 @@ public:
     mutable std::mutex cache_mutex;                                     ///< 缓存互斥锁
     const size_t MAX_CACHE_SIZE = 1000;                                 ///< 最大缓存节点数
 
+    // ====================================================
+    // 上层节点缓存（查询时跳过根附近的 ORAM 访问）
+    // ====================================================
+    NodeCache upper_cache;   ///< 靠近根的若干整层的反序列化节点，写入时写穿更新
+    std::mutex cache_warm_mutex;   ///< 并发查询时只由一个线程预热缓存
+
+    /**
+     * @brief 预热上层节点缓存：从根开始逐层批量读取，直到层数或内存上限
+     */
+    void warmNodeCache(SearchStats& stats);
+
+    /**
+     * @brief 缓存未预热时预热（多个线程同时查询时只有一个线程执行预热）
+     */
+    void ensureNodeCacheWarm(SearchStats& stats);
+
+    /**
+     * @brief 查找位置（块号）对应节点的缓存副本
+     * @return 未缓存时返回nullptr
+     */
+    std::shared_ptr<Node> findCachedNode(int path, SearchStats& stats);
+
+    /**
+     * @brief 设置上层节点缓存的容量，缓存被清空并在下次查询时重新预热
+     * @param levels 缓存的层数（0 表示不缓存；ODS 模式下总是不缓存）
+     * @param bytes 内存上限（字节）
+     */
+    void setNodeCacheLimits(int levels, size_t bytes);
+
+    // ====================================================
+    // 不可知数据结构（ODS）会话
+    // ====================================================
+    //
+    // ODS 模式下父节点保存子节点块的叶子，节点块每次读取都换到新叶子并固定在 stash 中
+    // （见 RingOramStorage）。一次查询或更新为一个会话：读取时叶子取自已解码的父节点，
+    // 会话结束时把子节点的新叶子写入父节点（父节点同在 stash 中，不访问服务器），
+    // 根节点的新叶子记入存储，之后解除固定。会话之间串行执行；缓存的节点会带着过期的叶子，
+    // 因此 ODS 模式不使用上层节点缓存。
+
+    /// ODS 模式下的存储，其他模式为空
+    std::shared_ptr<RingOramStorage> ods_storage;
+
+    std::recursive_mutex ods_mutex;   ///< 会话锁：并发的查询与更新在这里排队
+    int ods_depth = 0;                ///< 会话嵌套层数，最外层结束时写回叶子
+
+    /// 已解码的父节点中记录的子节点叶子：块号 -> 叶子
+    mutable std::unordered_map<int, int> ods_leaf_hints;
+
+    /// 本次会话中读出或写入的节点：节点ID -> 最新的节点对象
+    mutable std::unordered_map<int, std::shared_ptr<Node>> ods_nodes;
+
+    /// 会话守卫：ODS 模式下持有会话锁，最外层析构时结束会话
+    class OdsSession {
+    public:
+        explicit OdsSession(IRTree& tree);
+        ~OdsSession();
+
+        OdsSession(const OdsSession&) = delete;
+        OdsSession& operator=(const OdsSession&) = delete;
+
+    private:
+        IRTree& tree_;
+        std::unique_lock<std::recursive_mutex> lock_;
+    };
+
+    /**
+     * @brief 节点块读取时使用的叶子：父节点中记录的叶子，根节点块取存储中的根叶子
+     * @return 未知时返回 -1（块在本次会话中或仍由位置映射管理时不需要）
+     */
+    int odsLeafHint(int block_id) const;
+
+    /// 登记会话中读出或写入的节点，并记录其子节点的叶子
+    void registerOdsNode(const std::shared_ptr<Node>& node) const;
+
+    /**
+     * @brief 把本次会话中已换到新叶子的子节点的叶子写入节点
+     * @return 节点是否被修改
+     */
+    bool refreshChildLeaves(Node& node) const;
+
+    /// 结束会话：按层自底向上写回子节点叶子，记录根叶子，解除 stash 中的固定
+    void finishOdsSession();
+
     // ====================================================
     // 搜索辅助函数
     // ====================================================
@@ -237,6 +502,32 @@ public:
         const MBR& spatial_scope,
         double alpha) const;
 
+    /**
+     * @brief 节点子树中文档文本相关性的上界（按各查询词的 TF_max 计算）
+     */
+    double computeNodeTextUpperBound(std::shared_ptr<Node> node,
+        const std::vector<std::string>& keywords) const;
+
+    /**
+     * @brief 查询词中最大的 IDF（按当前全局文档数和文档频率计算）
+     *
+     * 父节点中缓存的子节点文本上界不含 IDF（见 computeChildTextUpperBound），
+     * 查询时乘以该值得到文本相关性上界：文档相关性是各查询词 TF-IDF 的平均值，
+     * 不超过最大的 log(1+TF) 与最大的 IDF 之积。插入文档改变 IDF 后上界仍然成立。
+     */
+    double computeMaxQueryIdf(const std::vector<std::string>& keywords) const;
+
+    /**
+     * @brief 节点子树中任一文档综合得分的上界（用于 Top-k 分支限界）
+     *
+     * 文档的空间相关性是其自身落在查询范围内的面积比例，节点与查询范围相交时
+     * 子树中可能有文档完全落在范围内，因此空间部分取1，不相交取0。
+     */
+    double computeNodeUpperBound(std::shared_ptr<Node> node,
+        const std::vector<std::string>& keywords,
+        const MBR& spatial_scope,
+        double alpha) const;
+
     /**
      * @brief 处理叶节点：计算包含的文档的相关性并加入结果集
      */
@@ -251,18 +542,76 @@ public:
         const std::vector<std::string>& keywords,
         const MBR& spatial_scope,
         double alpha,
-        std::priority_queue<TreeHeapEntry, std::vector<TreeHeapEntry>, TreeHeapComparator>& queue);
+        double prune_bound,
+        std::priority_queue<TreeHeapEntry, std::vector<TreeHeapEntry>, TreeHeapComparator>& queue,
+        SearchStats& stats);
 
     /**
-     * @brief 处理内部节点：计算子节点相关性并入队
+     * @brief 收集内部节点中通过空间、关键词和上界检查的子节点路径（不访问存储）
+     * @param prune_bound 上界不超过该值的子节点不可能进入 Top-k，直接跳过（当前第k名得分）
+     * @param child_paths 输出：需要加载的子节点路径（追加）
+     * @param upper_bounds 输出（可选）：对应子节点的得分上界
      */
-    void processInternalNode(std::shared_ptr<Node> internal_node,
+    void collectCandidateChildren(std::shared_ptr<Node> internal_node,
         const std::vector<std::string>& keywords,
         const MBR& spatial_scope,
         double alpha,
-        std::priority_queue<TreeHeapEntry,
-        std::vector<TreeHeapEntry>,
-        TreeHeapComparator>& queue) const;
+        double prune_bound,
+        std::vector<int>& child_paths,
+        std::vector<double>* upper_bounds = nullptr) const;
+
+    /**
+     * @brief OBLIVIOUS 模式的逐层搜索：每层的候选子节点截断或补齐到预算后一次批量读取
+     * @param root_node 已加载的根节点
+     * @param root_path 根节点路径
+     * @param results 输出：所有叶节点中匹配的文档
+     * @param stats 累加本次查询的访问统计
+     * @return 访问的节点数（不含 dummy）
+     */
+    int searchLevelsOblivious(std::shared_ptr<Node> root_node,
+        int root_path,
+        const std::vector<std::string>& keywords,
+        const MBR& spatial_scope,
+        double alpha,
+        std::vector<TreeHeapEntry>& results,
+        SearchStats& stats);
+
+    /**
+     * @brief 计算已加载子节点的得分上界并入队（队列按上界排序）
+     */
+    void scoreLoadedChild(std::shared_ptr<Node> child_node,
+        int child_path,
+        const std::vector<std::string>& keywords,
+        const MBR& spatial_scope,
+        double alpha,
+        std::priority_queue<TreeHeapEntry, std::vector<TreeHeapEntry>, TreeHeapComparator>& queue) const;
+
+    /**
+     * @brief kNN 查询：收集内部节点中通过关键词和上界检查的子节点路径（不访问存储）
+     * @param keyword_hashes 查询关键词的哈希（KeywordFilter::hashTerms）
+     * @param max_idf 查询词中最大的 IDF（computeMaxQueryIdf）
+     * @param location 查询点
+     * @param max_distance 距离归一化参数（见 computeDistanceRelevance）
+     * @param prune_bound 上界不超过该值的子节点直接跳过（当前第k名得分）
+     * @param child_paths 输出：需要加载的子节点路径（追加）
+     */
+    void collectNearestChildren(std::shared_ptr<Node> internal_node,
+        const std::vector<uint64_t>& keyword_hashes,
+        double max_idf,
+        const std::vector<double>& location,
+        double max_distance,
+        double alpha,
+        double prune_bound,
+        std::vector<int>& child_paths) const;
+
+    /**
+     * @brief kNN 查询：已加载子节点的得分上界（文本上界与 MBR 到查询点最小距离的加权）
+     */
+    double computeNodeNearestBound(std::shared_ptr<Node> node,
+        const std::vector<std::string>& keywords,
+        const std::vector<double>& location,
+        double max_distance,
+        double alpha) const;
 
     // ====================================================
     // 构造函数
@@ -274,9 +623,10 @@ public:
      * @param dims 空间维度（默认2）
      * @param min_cap 节点最小容量
      * @param max_cap 节点最大容量
+     * @param init_root 是否创建空的根节点；随后从快照恢复时为 false（不访问存储）
      */
     IRTree(std::shared_ptr<StorageInterface> storage_impl,
-        int dims = 2, int min_cap = 2, int max_cap = 4);
+        int dims = 2, int min_cap = 2, int max_cap = 4, bool init_root = true);
 
     // ====================================================
     // 文档插入接口
@@ -288,15 +638,50 @@ public:
     /// 插入已构造的 Document 对象
     void insertDocument(std::shared_ptr<Document> document);
 
+    // ====================================================
+    // 文档删除与更新接口
+    // ====================================================
+
+    /**
+     * @brief 删除文档：从叶子、全局索引和（separateDocuments 时）文档块中删除
+     *
+     * 叶子到根的路径上摘要逐项减去该文档、MBR 收紧；不足 min_capacity 的非根节点被删除，
+     * 其中的文档和子树重新插入（condense-tree）；根只剩一个子节点时树高降低。
+     * 与插入相同，所有修改在缓冲区中进行，每个被修改的节点写回一次。
+     * 路径上父节点中的子节点文本上界按子节点新的 TF_max 重新计算（computeChildTextUpperBound，
+     * 各词 log(1+TF_max) 的最大值）。上界不含 IDF，查询时乘以当前的 computeMaxQueryIdf，
+     * 因此删除改变全局 IDF 后，路径以外的子节点上界仍然有效，不需要重新计算。
+     * @return 文档不存在时返回 false
+     */
+    bool deleteDocument(int doc_id);
+
+    /**
+     * @brief 更新文档的文本和位置（删除后以相同ID重新插入）
+     * @return 文档不存在时返回 false，不插入
+     */
+    bool updateDocument(int doc_id, const std::string& text, const MBR& location);
+
+    /**
+     * @brief 文档的位置（删除时定位叶子用），文档不存在时返回 false
+     */
+    bool getDocumentLocation(int doc_id, MBR& location) const;
+
+    /// 记录文档位置（插入和批量建树时调用）
+    void recordDocumentLocation(const Document& document);
+
+    /// 文档位置表：按文档ID存放 min/max 坐标（每个文档 2 * dimensions 个值），未知或已删除为 NaN
+    std::vector<double> document_locations;
+
     // ====================================================
     // 查询接口
     // ====================================================
 
     /**
      * @brief 执行查询（Query对象方式）
+     * @param stats 输出（可选）：本次查询的统计
      * @return 排序后的结果项
      */
-    std::vector<TreeHeapEntry> search(const Query& query);
+    std::vector<TreeHeapEntry> search(const Query& query, SearchStats* stats = nullptr);
 
     /**
      * @brief 执行 Top-k 查询（关键词+空间范围）
@@ -304,12 +689,64 @@ public:
      * @param spatial_scope 空间范围
      * @param k 返回的结果数量
      * @param alpha 文本权重参数
+     * @param stats 输出（可选）：本次查询的统计
      * @return Top-k 结果项
+     *
+     * 查询只读取树，可以在多个线程中同时调用（不能与插入同时进行）：
+     * 统计通过 stats 返回，ORAM 访问在 RingOramStorage 中串行执行。
      */
     std::vector<TreeHeapEntry> search(const std::vector<std::string>& keywords,
         const MBR& spatial_scope,
         int k = 10,
-        double alpha = 0.5);
+        double alpha = 0.5,
+        SearchStats* stats = nullptr);
+
+    /**
+     * @brief 执行 kNN 查询（关键词+查询点，不限定范围）
+     * @param keywords 查询关键词（文档须包含全部关键词）
+     * @param location 查询点
+     * @param k 返回的结果数量
+     * @param alpha 文本权重参数
+     * @param stats 输出（可选）：本次查询的统计
+     * @return 按综合得分（文本相关性与距离相关性加权）从高到低的至多 k 个结果
+     *
+     * 增量最佳优先搜索：子树的空间上界由 MBR::minDistance 给出，与文本上界加权后排序；
+     * 队首为文档时它不低于任何未展开的子树，即为下一个结果。每轮展开的节点的子节点
+     * 合并为一次批量读取（与 BATCHED 模式相同，按 search_frontier_width 补齐），
+     * 不使用 OBLIVIOUS 模式的固定访问形态。
+     */
+    std::vector<TreeHeapEntry> searchNearest(const std::vector<std::string>& keywords,
+        const std::vector<double>& location,
+        int k = 10,
+        double alpha = 0.5,
+        SearchStats* stats = nullptr);
+
+    /**
+     * @brief 批量执行多个查询，所有查询的搜索前沿同步推进
+     *
+     * 每轮各查询分别出队并收集候选子节点，多个查询请求的同一节点只读取一次，
+     * 读取结果再分发给各自的队列。邻近的查询共享大部分内部节点，
+     * ORAM 访问次数随查询数亚线性增长。OBLIVIOUS 模式下每个查询的访问次数
+     * 必须固定，共享读取无法减少访问，因此逐个执行。
+     * @param stats 输出（可选）：整批查询的统计
+     * @return 与 queries 一一对应的 Top-k 结果
+     */
+    std::vector<std::vector<TreeHeapEntry>> searchBatch(const std::vector<Query>& queries,
+        SearchStats* stats = nullptr);
+
+    /**
+     * @brief 使用多个工作线程并发执行查询
+     *
+     * 每个线程依次领取下一个查询独立执行。ORAM 访问在存储层排队串行执行，
+     * 节点解码、打分等计算在各线程中并行，一个线程等待 ORAM 时其他线程继续计算，
+     * 与服务器之间的链路保持忙碌。
+     * @param num_threads 工作线程数
+     * @param stats 输出（可选）：与 queries 一一对应的统计
+     * @return 与 queries 一一对应的 Top-k 结果
+     */
+    std::vector<std::vector<TreeHeapEntry>> searchParallel(const std::vector<Query>& queries,
+        int num_threads,
+        std::vector<SearchStats>* stats = nullptr);
 
     // ====================================================
     // 批量插入接口（构建阶段）
@@ -325,12 +762,13 @@ public:
     void optimizedBulkInsertFromFile(const std::string& filename);
     void optimizedBulkInsertDocuments(const std::vector<std::tuple<std::string, double, double>>& documents);
 
+    /// 批量插入已创建的文档对象：构建全局索引后自底向上建树（total_start 为整个批量插入的开始时间）
+    void bulkInsertDocumentObjects(const std::vector<std::shared_ptr<Document>>& documents,
+        std::chrono::high_resolution_clock::time_point total_start);
+
     /// 批量构建全局倒排索引
     void bulkBuildGlobalIndex(const std::vector<std::shared_ptr<Document>>& documents);
 
-    /// 批量将文档插入树结构
-    void bulkInsertToTree(const std::vector<std::shared_ptr<Document>>& documents);
-
     // ====================================================
     // 存储同步与缓存管理
     // ====================================================
@@ -366,7 +804,34 @@ public:
 
     void computeAndSetChildUpperBounds(std::shared_ptr<Node> parent);
 
-    int search_blocks;
+    /// 根据子节点的 TFmax 计算其文本上界：各词 log(1+TF_max) 的最大值（不含 IDF，查询时乘以 computeMaxQueryIdf）
+    double computeChildTextUpperBound(const Node& child) const;
+
+    /// 词项表中各词项在词汇表中的 ID（文本感知批量建树使用，未登记的词项忽略）
+    std::vector<int> termIdsOf(const std::unordered_map<std::string, int>& term_map) const;
+
+    // ====================================================
+    // 快照（格式见 Snapshot.h）
+    // ====================================================
+
+    /**
+     * @brief 保存客户端全部状态：树参数、词汇表、倒排索引、块映射与 ORAM 客户端状态
+     *
+     * 先请求服务器以同一随机令牌保存 bucket 存储文件，再原子写入快照文件；
+     * 重启后快照只能与令牌相同的服务器存储一起使用。只能在没有查询执行时调用。
+     * 快照以明文包含 ORAM 密钥与位置映射，是机密文件，须与服务器存储分开保管。
+     * @return 是否成功（服务器未配置存储文件时失败）
+     */
+    bool saveSnapshot(const std::string& filename);
+
+    /**
+     * @brief 从快照恢复客户端状态（树需以 init_root = false 构造）
+     *
+     * 校验格式版本、校验和、ORAM 参数，并确认服务器内存中的 bucket 正是该快照对应的存储文件；
+     * 任一项不符时返回 false，当前状态保持不变，调用方重新建树
+     */
+    bool loadSnapshot(const std::string& filename);
+
     // ====================================================
     // 性能评估接口
     // ====================================================
@@ -377,9 +842,27 @@ public:
      * @param scope 空间范围
      * @param k 返回结果数量
      * @param show_details 是否显示执行细节
+     * @param stats 输出（可选）：本次查询的统计
      * @return 查询耗时（纳秒）
      */
-    std::chrono::nanoseconds getRunTime(const std::string& query_keywords, const MBR& scope, int k, bool show_details = true);
+    std::chrono::nanoseconds getRunTime(const std::string& query_keywords, const MBR& scope, int k, bool show_details = true,
+        SearchStats* stats = nullptr);
+
+    /**
+     * @brief 计算一次 kNN 查询的运行时间（可选输出详细信息）
+     * @param query_keywords 查询关键字
+     * @param location 查询点
+     * @param k 返回结果数量
+     * @param show_details 是否显示执行细节
+     * @param stats 输出（可选）：本次查询的统计
+     * @return 查询耗时（纳秒）
+     */
+    std::chrono::nanoseconds getNearestRunTime(const std::string& query_keywords, const std::vector<double>& location, int k,
+        bool show_details = true, SearchStats* stats = nullptr);
+
+    /// 输出查询关键词、耗时与结果列表（getRunTime / getNearestRunTime 共用）
+    static void printQueryResults(const std::string& query_keywords, const std::vector<TreeHeapEntry>& results,
+        std::chrono::nanoseconds duration);
 };
 
 #endif // IRTREE_H
\ No newline at end of file
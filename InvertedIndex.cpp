@@ -18,6 +18,30 @@ void InvertedIndex::addDocument(int doc_id, Vector& vector) {
     }
 }
 
+void InvertedIndex::removeDocument(int doc_id, const std::vector<int>& term_ids) {
+    for (int term_id : term_ids) {
+        auto it = index.find(term_id);
+        if (it == index.end()) {
+            continue;
+        }
+
+        auto& postings = it->second;
+        auto posting = std::find_if(postings.begin(), postings.end(),
+            [doc_id](const Posting& p) { return p.doc_id == doc_id; });
+        if (posting != postings.end()) {
+            postings.erase(posting);
+        }
+        if (postings.empty()) {
+            index.erase(it);
+        }
+    }
+
+    // 调用方已确认文档在索引中（不含任何词项的文档没有倒排项，但同样计入了文档总数）
+    if (total_documents > 0) {
+        total_documents--;
+    }
+}
+
 std::vector<Posting> InvertedIndex::getPostings(int term_id) const {
     auto it = index.find(term_id);
     if (it != index.end()) {
@@ -50,6 +74,11 @@ void InvertedIndex::clear() {
     total_documents = 0;
 }
 
+void InvertedIndex::restore(std::unordered_map<int, std::vector<Posting>> entries, int total_docs) {
+    index = std::move(entries);
+    total_documents = total_docs;
+}
+
 void InvertedIndex::merge(const InvertedIndex& other) {
     for (const auto& pair : other.index) {
         int term_id = pair.first;
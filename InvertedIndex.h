@@ -25,6 +25,9 @@ public:
     // 添加文档到索引
     void addDocument(int doc_id, Vector& vector);
 
+    // 从索引中删除文档（调用方确认文档已加入索引）：只扫描该文档所含词项的倒排列表，列表为空时删除该词项
+    void removeDocument(int doc_id, const std::vector<int>& term_ids);
+
     // 查询处理
     std::vector<Posting> getPostings(int term_id) const;
     std::vector<int> getDocumentsWithTerm(int term_id) const;
@@ -37,6 +40,10 @@ public:
     void clear();
     void merge(const InvertedIndex& other);
 
+    // 快照保存与恢复：整体读取倒排表，恢复时直接替换（不重新计算权重）
+    const std::unordered_map<int, std::vector<Posting>>& getIndex() const { return index; }
+    void restore(std::unordered_map<int, std::vector<Posting>> entries, int total_docs);
+
     std::string toString(Vocabulary& vocab);
 };
 
@@ -0,0 +1,75 @@
+#include "KeywordFilter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// 每个字 64 位，位下标取 6 位，一个 64 位混合值最多提供 10 个位下标
+const int MAX_HASH_COUNT = 10;
+
+// splitmix64 的终结混合
+uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+} // namespace
+
+uint64_t KeywordFilter::hashTerm(const std::string& term) {
+    // FNV-1a
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (unsigned char c : term) {
+        hash ^= c;
+        hash *= 0x100000001B3ULL;
+    }
+    return mix64(hash);
+}
+
+std::vector<uint64_t> KeywordFilter::hashTerms(const std::vector<std::string>& terms) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(terms.size());
+    for (const auto& term : terms) {
+        hashes.push_back(hashTerm(term));
+    }
+    return hashes;
+}
+
+uint64_t KeywordFilter::bitMask(uint64_t hash) const {
+    uint64_t bits = mix64(hash + 0x9E3779B97F4A7C15ULL);
+    uint64_t mask = 0;
+    for (int i = 0; i < hash_count; i++) {
+        mask |= 1ULL << ((bits >> (6 * i)) & 63);
+    }
+    return mask;
+}
+
+KeywordFilter KeywordFilter::build(const std::vector<uint64_t>& hashes, double fp_rate) {
+    KeywordFilter filter;
+    if (hashes.empty()) {
+        return filter;
+    }
+
+    // 标准 Bloom 过滤器的每词项位数；分块过滤器各字的负载不均匀，多留 25% 的位
+    fp_rate = std::min(std::max(fp_rate, 1e-6), 0.5);
+    double ln2 = std::log(2.0);
+    double bits_per_key = -std::log(fp_rate) / (ln2 * ln2);
+    size_t num_words = static_cast<size_t>(std::ceil(hashes.size() * bits_per_key * 1.25 / 64.0));
+
+    filter.hash_count = std::min(MAX_HASH_COUNT, std::max(1, static_cast<int>(std::lround(bits_per_key * ln2))));
+    filter.words.assign(std::max<size_t>(num_words, 1), 0);
+    for (uint64_t hash : hashes) {
+        filter.words[filter.wordIndex(hash)] |= filter.bitMask(hash);
+    }
+    return filter;
+}
+
+KeywordFilter KeywordFilter::fromWords(std::vector<uint64_t>&& words, int hash_count) {
+    KeywordFilter filter;
+    filter.words = std::move(words);
+    filter.hash_count = std::min(MAX_HASH_COUNT, std::max(0, hash_count));
+    return filter;
+}
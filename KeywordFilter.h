@@ -0,0 +1,94 @@
+#ifndef KEYWORD_FILTER_H
+#define KEYWORD_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * KeywordFilter.h
+ * ----------------------------------------
+ * 内部节点为每个子节点保存的关键词摘要（分块 Bloom 过滤器）。
+ *
+ * 每个词项只映射到一个 64 位字，并在字内置 k 个位；判断是否可能包含
+ * 只需一次取字和一次按位与比较。查询关键词的哈希在每次访问节点时计算一次，
+ * 之后检查每个子节点都不再做字符串哈希。
+ *
+ * 过滤器只会误报（false positive），不会漏报：误报的代价是多访问一个子节点，
+ * 不影响查询结果。
+ */
+
+class KeywordFilter {
+public:
+    /// 空过滤器：不包含任何词项
+    KeywordFilter() : hash_count(0) {}
+
+    /**
+     * @brief 由词项哈希构建过滤器
+     * @param hashes 词项哈希（hashTerm 的结果）
+     * @param fp_rate 目标误报率，决定每个词项占用的位数
+     */
+    static KeywordFilter build(const std::vector<uint64_t>& hashes, double fp_rate);
+
+    /**
+     * @brief 由序列化得到的位数组恢复过滤器
+     */
+    static KeywordFilter fromWords(std::vector<uint64_t>&& words, int hash_count);
+
+    /// 词项哈希（与平台和运行无关，可以随节点一起持久化）
+    static uint64_t hashTerm(const std::string& term);
+
+    /// 批量计算查询关键词的哈希
+    static std::vector<uint64_t> hashTerms(const std::vector<std::string>& terms);
+
+    /**
+     * @brief 是否可能包含某个词项
+     * @param hash 词项哈希
+     */
+    bool mayContain(uint64_t hash) const {
+        if (words.empty()) {
+            return false;
+        }
+        uint64_t mask = bitMask(hash);
+        return (words[wordIndex(hash)] & mask) == mask;
+    }
+
+    /**
+     * @brief 是否可能包含全部词项（空列表返回 true）
+     */
+    bool mayContainAll(const std::vector<uint64_t>& hashes) const {
+        for (uint64_t hash : hashes) {
+            if (!mayContain(hash)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool empty() const { return words.empty(); }
+    int getHashCount() const { return hash_count; }
+    const std::vector<uint64_t>& getWords() const { return words; }
+
+    /// 位数组占用的字节数
+    size_t memoryBytes() const { return words.size() * sizeof(uint64_t); }
+
+    bool operator==(const KeywordFilter& other) const {
+        return hash_count == other.hash_count && words == other.words;
+    }
+    bool operator!=(const KeywordFilter& other) const { return !(*this == other); }
+
+private:
+    /// 哈希高 32 位映射到字下标
+    size_t wordIndex(uint64_t hash) const {
+        return static_cast<size_t>(((hash >> 32) * words.size()) >> 32);
+    }
+
+    /// 由哈希再混合得到字内的 k 个位
+    uint64_t bitMask(uint64_t hash) const;
+
+    std::vector<uint64_t> words;  ///< 位数组
+    int hash_count;               ///< 每个词项在字内置位的个数 k
+};
+
+#endif // KEYWORD_FILTER_H
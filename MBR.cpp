@@ -4,7 +4,7 @@
 #include <stdexcept>
 
 MBR::MBR(const std::vector<double>& min, const std::vector<double>& max)
-    : min_coords(min), max_coords(max), cached_area(-1.0), area_calculated(false) {
+    : min_coords(min), max_coords(max), cached_area(0.0) {
     if (min.size() != max.size()) {
         throw std::invalid_argument("Min and max coordinates must have same dimension");
     }
@@ -13,16 +13,17 @@ MBR::MBR(const std::vector<double>& min, const std::vector<double>& max)
             throw std::invalid_argument("Min coordinate cannot be greater than max coordinate");
         }
     }
+    updateArea();
 }
 
-double MBR::area() const {
-    if (!area_calculated) {
-        cached_area = 1.0;
-        for (size_t i = 0; i < min_coords.size(); i++) {
-            cached_area *= (max_coords[i] - min_coords[i]);
-        }
-        area_calculated = true;
+void MBR::updateArea() {
+    cached_area = 1.0;
+    for (size_t i = 0; i < min_coords.size(); i++) {
+        cached_area *= (max_coords[i] - min_coords[i]);
     }
+}
+
+double MBR::area() const {
     return cached_area;
 }
 
@@ -36,9 +37,7 @@ void MBR::expand(const MBR& other) {
         max_coords[i] = std::max(max_coords[i], other.max_coords[i]);
     }
 
-    // Çå³ý»º´æ
-    cached_area = -1.0;
-    area_calculated = false;
+    updateArea();
 }
 
 bool MBR::contains(const MBR& other) const {
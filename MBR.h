@@ -9,15 +9,16 @@ class MBR {
 private:
     std::vector<double> min_coords;
     std::vector<double> max_coords;
-    mutable double cached_area;    // 缓存面积
-    mutable bool area_calculated;  // 面积计算标志
+    double cached_area;    // 面积，构造和扩展时计算；area() 只读，多个查询线程可共享同一 MBR
+
+    void updateArea();
 
 public:
     /**
      * @brief 默认构造函数
      * 创建一个空的MBR，需要后续初始化
      */
-    MBR() : cached_area(-1.0), area_calculated(false) {
+    MBR() : cached_area(0.0) {
         // 创建空的坐标向量
         min_coords = std::vector<double>{ 0.0, 0.0 };  // 默认2维
         max_coords = std::vector<double>{ 0.0, 0.0 };
@@ -0,0 +1,236 @@
+#include "NetProtocol.h"
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+// ================================
+// 序列化工具函数
+// ================================
+
+size_t calculate_bucket_size(const bucket& bkt) {
+
+    size_t size = sizeof(SerializedBucketHeader);
+
+    // 计算blocks大小
+    size_t blocks_size = 0;
+    for (size_t i = 0; i < bkt.blocks.size(); i++) {
+        const auto& blk = bkt.blocks[i];
+        size_t block_size = sizeof(SerializedBlockHeader) + blk.GetData().size();
+        blocks_size += block_size;
+
+    }
+    size += blocks_size;
+
+    // 计算ptrs和valids大小
+    size_t ptrs_valids_size = (bkt.ptrs.size() + bkt.valids.size()) * sizeof(int32_t);
+    size += ptrs_valids_size;
+
+    return size;
+}
+
+static void serialize_block(const block& blk, uint8_t* buffer, size_t& offset) {
+
+    SerializedBlockHeader header;
+    header.leaf_id = blk.GetLeafid();
+    header.block_index = blk.GetBlockindex();
+
+    const auto& data = blk.GetData();
+    header.data_size = static_cast<int32_t>(data.size());
+    memcpy(buffer + offset, &header, sizeof(header));
+    offset += sizeof(SerializedBlockHeader);
+
+    if (!data.empty()) {
+        memcpy(buffer + offset, data.data(), data.size());
+        offset += data.size();
+    }
+
+}
+
+static block deserialize_block(const uint8_t* data, size_t& offset) {
+    SerializedBlockHeader header;
+    memcpy(&header, data + offset, sizeof(header));
+    offset += sizeof(SerializedBlockHeader);
+
+    std::vector<char> block_data;
+    if (header.data_size > 0) {
+        block_data.resize(header.data_size);
+        memcpy(block_data.data(), data + offset, header.data_size);
+        offset += header.data_size;
+    }
+
+    return block(header.leaf_id, header.block_index, block_data);
+}
+
+bool serialize_bucket_into(const bucket& bkt, std::vector<uint8_t>& out) {
+
+    int num_slots = bkt.Z + bkt.S;
+    if (static_cast<int>(bkt.ptrs.size()) < num_slots || static_cast<int>(bkt.valids.size()) < num_slots) {
+        std::cerr << "ERROR: Not enough space for ptrs and valids" << std::endl;
+        return false;
+    }
+
+    // 先计算大小；resize 在容量足够时不会重新分配
+    size_t total_size = calculate_bucket_size(bkt);
+    out.resize(total_size);
+
+    // 序列化 bucket header
+    SerializedBucketHeader bucket_header;
+    bucket_header.Z = bkt.Z;
+    bucket_header.S = bkt.S;
+    bucket_header.count = bkt.count;
+    bucket_header.num_blocks = static_cast<int32_t>(bkt.blocks.size());
+    memcpy(out.data(), &bucket_header, sizeof(bucket_header));
+
+    size_t offset = sizeof(SerializedBucketHeader);
+
+    // 序列化 blocks
+    for (size_t i = 0; i < bkt.blocks.size(); i++) {
+        serialize_block(bkt.blocks[i], out.data(), offset);
+    }
+
+    // 序列化 ptrs
+    for (int i = 0; i < num_slots; i++) {
+        int32_t ptr = bkt.ptrs[i];
+        memcpy(out.data() + offset, &ptr, sizeof(int32_t));
+        offset += sizeof(int32_t);
+    }
+
+    // 序列化 valids
+    for (int i = 0; i < num_slots; i++) {
+        int32_t valid = bkt.valids[i];
+        memcpy(out.data() + offset, &valid, sizeof(int32_t));
+        offset += sizeof(int32_t);
+    }
+
+    return true;
+}
+
+std::vector<uint8_t> serialize_bucket(const bucket& bkt) {
+    std::vector<uint8_t> result;
+    if (!serialize_bucket_into(bkt, result)) {
+        return std::vector<uint8_t>();
+    }
+    return result;
+}
+
+bucket deserialize_bucket(const uint8_t* data, size_t size) {
+
+    if (size < sizeof(SerializedBucketHeader)) {
+        std::cerr << "  ERROR: Data too small for header" << std::endl;
+        throw std::runtime_error("Invalid bucket data: too small");
+    }
+
+    SerializedBucketHeader bucket_header;
+    memcpy(&bucket_header, data, sizeof(bucket_header));
+
+    // 创建空的bucket
+    bucket result(0, 0);
+    result.Z = bucket_header.Z;
+    result.S = bucket_header.S;
+    result.count = bucket_header.count;
+
+    size_t offset = sizeof(SerializedBucketHeader);
+
+    // 反序列化 blocks
+    for (int i = 0; i < bucket_header.num_blocks && offset < size; i++) {
+        result.blocks.push_back(deserialize_block(data, offset));
+    }
+
+    //从序列化数据中恢复ptrs和valids
+    int num_slots = result.Z + result.S;
+    result.ptrs.resize(num_slots, -1);
+    result.valids.resize(num_slots, 0);
+
+    // 检查是否有足够的空间来读取ptrs和valids
+    if (offset + num_slots * 2 * sizeof(int32_t) <= size) {
+
+        // 反序列化 ptrs
+        for (int i = 0; i < num_slots; i++) {
+            int32_t ptr;
+            memcpy(&ptr, data + offset, sizeof(int32_t));
+            result.ptrs[i] = ptr;
+            offset += sizeof(int32_t);
+        }
+
+        // 反序列化 valids
+        for (int i = 0; i < num_slots; i++) {
+            int32_t valid;
+            memcpy(&valid, data + offset, sizeof(int32_t));
+            result.valids[i] = valid;
+            offset += sizeof(int32_t);
+        }
+
+    } else {
+        std::cout << "  WARNING: No ptrs and valids data in serialized bucket" << std::endl;
+    }
+
+    return result;
+}
+
+bool deserialize_bucket_into(const uint8_t* data, size_t size, bucket& out) {
+    if (size < sizeof(SerializedBucketHeader)) {
+        return false;
+    }
+
+    SerializedBucketHeader bucket_header;
+    memcpy(&bucket_header, data, sizeof(bucket_header));
+
+    int num_slots = bucket_header.Z + bucket_header.S;
+    if (bucket_header.Z < 0 || bucket_header.S < 0 || bucket_header.num_blocks < 0) {
+        return false;
+    }
+
+    // 第一遍：只校验边界，不修改 out
+    size_t offset = sizeof(SerializedBucketHeader);
+    for (int i = 0; i < bucket_header.num_blocks; i++) {
+        if (offset + sizeof(SerializedBlockHeader) > size) {
+            return false;
+        }
+        SerializedBlockHeader header;
+        memcpy(&header, data + offset, sizeof(header));
+        offset += sizeof(SerializedBlockHeader);
+        if (header.data_size < 0 || offset + header.data_size > size) {
+            return false;
+        }
+        offset += header.data_size;
+    }
+    if (offset + num_slots * 2 * sizeof(int32_t) > size) {
+        return false;
+    }
+
+    // 第二遍：原地写入，block 数据复用已有 vector 的容量
+    out.Z = bucket_header.Z;
+    out.S = bucket_header.S;
+    out.count = bucket_header.count;
+    out.blocks.resize(bucket_header.num_blocks);
+
+    offset = sizeof(SerializedBucketHeader);
+    for (int i = 0; i < bucket_header.num_blocks; i++) {
+        SerializedBlockHeader header;
+        memcpy(&header, data + offset, sizeof(header));
+        offset += sizeof(SerializedBlockHeader);
+
+        block& blk = out.blocks[i];
+        blk.SetLeafid(header.leaf_id);
+        blk.SetBlockindex(header.block_index);
+        blk.AssignData(reinterpret_cast<const char*>(data + offset), header.data_size);
+        offset += header.data_size;
+    }
+
+    out.ptrs.resize(num_slots);
+    out.valids.resize(num_slots);
+    for (int i = 0; i < num_slots; i++) {
+        int32_t ptr;
+        memcpy(&ptr, data + offset, sizeof(int32_t));
+        out.ptrs[i] = ptr;
+        offset += sizeof(int32_t);
+    }
+    for (int i = 0; i < num_slots; i++) {
+        int32_t valid;
+        memcpy(&valid, data + offset, sizeof(int32_t));
+        out.valids[i] = valid;
+        offset += sizeof(int32_t);
+    }
+
+    return true;
+}
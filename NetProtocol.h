@@ -0,0 +1,82 @@
+#ifndef NET_PROTOCOL_H
+#define NET_PROTOCOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "bucket.h"
+
+/*
+ * NetProtocol.h
+ * ----------------------------------------
+ * 客户端（ringoram）与存储服务器（storage_server）共用的通信协议定义：
+ * - 请求/响应帧头；
+ * - bucket 的线上序列化格式。
+ *
+ * 帧格式： [RequestHeader][负载分段 0][负载分段 1]...
+ * 负载由多个分段直接从各自的缓冲区聚合发送（writev），
+ * 不再先拼接到临时 request_data 中。
+ */
+
+// 协议定义
+enum RequestType {
+    READ_BUCKET = 1,
+    WRITE_BUCKET = 2,
+    READ_PATH = 3,
+    STORE_SAVE = 4,    // 负载：8 字节令牌。服务器把全部 bucket 写入存储文件，并记下令牌
+    STORE_INFO = 5,    // 无负载。响应：8 字节令牌，内存中的 bucket 与该令牌的存储文件一致，0 表示不一致
+    STORE_RESET = 6,   // 无负载。所有 bucket 恢复为只有 dummy 的初始状态
+    RESPONSE = 100
+};
+
+struct RequestHeader {
+    uint32_t type;
+    uint32_t request_id;
+    uint32_t data_len;
+    uint32_t reserved;
+};
+
+struct ResponseHeader {
+    uint32_t type;
+    uint32_t request_id;
+    uint32_t result;
+    uint32_t data_len;
+};
+
+#pragma pack(push, 1)
+struct SerializedBucketHeader {
+    int32_t Z;
+    int32_t S;
+    int32_t count;
+    int32_t num_blocks;
+};
+
+struct SerializedBlockHeader {
+    int32_t leaf_id;
+    int32_t block_index;
+    int32_t data_size;
+};
+#pragma pack(pop)
+
+// ================================
+// bucket 序列化工具函数
+// ================================
+
+// 计算 bucket 序列化后的字节数
+size_t calculate_bucket_size(const bucket& bkt);
+
+// 将 bucket 序列化到 out 中（复用 out 已有容量，稳态下不分配内存）
+// 返回 false 表示 bucket 结构不完整
+bool serialize_bucket_into(const bucket& bkt, std::vector<uint8_t>& out);
+
+// 将 bucket 序列化为新的字节数组
+std::vector<uint8_t> serialize_bucket(const bucket& bkt);
+
+// 从字节流反序列化出新的 bucket
+bucket deserialize_bucket(const uint8_t* data, size_t size);
+
+// 从字节流原地覆盖已有 bucket（复用各 block 的数据缓冲区）
+// 数据先完整校验，校验失败时 out 保持不变并返回 false
+bool deserialize_bucket_into(const uint8_t* data, size_t size, bucket& out);
+
+#endif // NET_PROTOCOL_H
@@ -1,6 +1,8 @@
 
 #include "Node.h"
 #include "Document.h"
+#include "Vocabulary.h"
+#include "param.h"
 #include <sstream>
 #include <algorithm>
 
@@ -19,12 +21,13 @@ void Node::addChild(std::shared_ptr<Node> child) {
     // 存储子节点的独立MBR
     setChildMBR(child->getId(), child->getMBR());
 
-    // 提取子节点的关键词集合
-    std::unordered_set<std::string> child_terms;
+    // 子节点的关键词摘要
+    std::vector<uint64_t> child_terms;
+    child_terms.reserve(child->getTFMax().size());
     for (const auto& pair : child->getTFMax()) {
-        child_terms.insert(pair.first);
+        child_terms.push_back(KeywordFilter::hashTerm(pair.first));
     }
-    setChildKeywords(child->getId(), child_terms);
+    child_keywords[child->getId()] = KeywordFilter::build(child_terms, keywordFilterFpRate);
     updateSummary();
 }
 
@@ -39,6 +42,7 @@ void Node::addDocument(std::shared_ptr<Document> doc) {
 }
 
 void Node::updateSummary() {
+    unpackTermsForWrite();
     document_count = 0;  // 重置计数
     df.clear();
     tf_max.clear();
@@ -81,16 +85,218 @@ void Node::updateSummary() {
     }
 }
 
+void Node::addDocumentToSummary(const Document& doc) {
+    unpackTermsForWrite();
+    document_count++;
+    for (const auto& pair : doc.getTermFreq()) {
+        df[pair.first]++;
+        int& max_freq = tf_max[pair.first];
+        if (max_freq < pair.second) {
+            max_freq = pair.second;
+        }
+    }
+    mbr.expand(doc.getLocation());
+}
+
+void Node::refreshChild(std::shared_ptr<Node> child) {
+    if (type != INTERNAL) {
+        throw std::logic_error("Cannot refresh child of leaf node");
+    }
+
+    auto it = std::find_if(child_nodes.begin(), child_nodes.end(),
+        [&child](const std::shared_ptr<Node>& existing) { return existing->getId() == child->getId(); });
+    if (it != child_nodes.end()) {
+        *it = child;
+    }
+    else {
+        child_nodes.push_back(child);
+    }
+    mbr.expand(child->getMBR());
+    setChildMBR(child->getId(), child->getMBR());
+
+    std::vector<uint64_t> child_terms;
+    child_terms.reserve(child->getTFMax().size());
+    for (const auto& pair : child->getTFMax()) {
+        child_terms.push_back(KeywordFilter::hashTerm(pair.first));
+    }
+    child_keywords[child->getId()] = KeywordFilter::build(child_terms, keywordFilterFpRate);
+}
+
+void Node::copyChildEntry(const Node& source, std::shared_ptr<Node> child) {
+    if (type != INTERNAL) {
+        throw std::logic_error("Cannot add child to leaf node");
+    }
+
+    int child_id = child->getId();
+    child_nodes.push_back(child);
+    MBR child_mbr = source.getChildMBR(child_id);
+    mbr.expand(child_mbr);
+    setChildMBR(child_id, child_mbr);
+
+    int path = source.getChildPosition(child_id);
+    if (path != -1) {
+        setChildPosition(child_id, path);
+    }
+    int leaf = source.getChildLeaf(child_id);
+    if (leaf != -1) {
+        setChildLeaf(child_id, leaf);
+    }
+    if (source.hasChildTextUpperBound(child_id)) {
+        setChildTextUpperBound(child_id, source.getChildTextUpperBound(child_id));
+    }
+    child_keywords[child_id] = source.getChildKeywordFilter(child_id);
+}
+
+std::shared_ptr<Document> Node::removeDocument(int doc_id) {
+    if (type != LEAF) {
+        throw std::logic_error("Cannot remove document from internal node");
+    }
+
+    auto it = std::find_if(documents.begin(), documents.end(),
+        [doc_id](const std::shared_ptr<Document>& doc) { return doc->getId() == doc_id; });
+    if (it == documents.end()) {
+        return nullptr;
+    }
+    std::shared_ptr<Document> removed = *it;
+    documents.erase(it);
+    updateSummary();
+    tightenMBR();
+    return removed;
+}
+
+void Node::removeDocumentFromSummary(const Document& doc) {
+    unpackTermsForWrite();
+    if (document_count > 0) {
+        document_count--;
+    }
+    for (const auto& pair : doc.getTermFreq()) {
+        auto it = df.find(pair.first);
+        if (it == df.end()) {
+            continue;
+        }
+        if (--it->second <= 0) {
+            df.erase(it);
+            tf_max.erase(pair.first);
+        }
+    }
+}
+
+void Node::addSubtreeToSummary(const Node& child) {
+    unpackTermsForWrite();
+    document_count += child.getDocumentCount();
+    for (const auto& pair : child.getDF()) {
+        df[pair.first] += pair.second;
+    }
+    for (const auto& pair : child.getTFMax()) {
+        int& max_freq = tf_max[pair.first];
+        if (max_freq < pair.second) {
+            max_freq = pair.second;
+        }
+    }
+    mbr.expand(child.getMBR());
+}
+
+void Node::removeChild(int child_id) {
+    child_nodes.erase(std::remove_if(child_nodes.begin(), child_nodes.end(),
+        [child_id](const std::shared_ptr<Node>& child) { return child->getId() == child_id; }),
+        child_nodes.end());
+    child_position_map.erase(child_id);
+    child_leaf_map.erase(child_id);
+    child_mbrs.erase(child_id);
+    child_text_upper_bounds.erase(child_id);
+    child_keywords.erase(child_id);
+}
+
+void Node::tightenMBR() {
+    bool first = true;
+    auto include = [this, &first](const MBR& box) {
+        if (first) {
+            mbr = box;
+            first = false;
+        }
+        else {
+            mbr.expand(box);
+        }
+    };
+
+    if (type == LEAF) {
+        for (const auto& doc : documents) {
+            include(doc->getLocation());
+        }
+    }
+    else {
+        for (const auto& child : child_nodes) {
+            auto it = child_mbrs.find(child->getId());
+            include(it != child_mbrs.end() ? it->second : child->getMBR());
+        }
+    }
+}
+
+void Node::setChildKeywords(int child_id, const std::unordered_set<std::string>& keywords) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(keywords.size());
+    for (const auto& keyword : keywords) {
+        hashes.push_back(KeywordFilter::hashTerm(keyword));
+    }
+    child_keywords[child_id] = KeywordFilter::build(hashes, keywordFilterFpRate);
+}
+
 int Node::getDocumentFrequency(const std::string& term) const {
+    if (!term_maps_ready.load(std::memory_order_acquire)) {
+        const TermSummary* summary = findPackedTerm(term);
+        return summary && summary->df >= 0 ? summary->df : 0;
+    }
     auto it = df.find(term);
     return (it != df.end()) ? it->second : 0;
 }
 
 int Node::getMaxTermFrequency(const std::string& term) const {
+    if (!term_maps_ready.load(std::memory_order_acquire)) {
+        const TermSummary* summary = findPackedTerm(term);
+        return summary && summary->tf_max >= 0 ? summary->tf_max : 0;
+    }
     auto it = tf_max.find(term);
     return (it != tf_max.end()) ? it->second : 0;
 }
 
+const Node::TermSummary* Node::findPackedTerm(const std::string& term) const {
+    int term_id = packed_vocab->getTermId(term);
+    if (term_id < 0) {
+        return nullptr;
+    }
+    auto it = std::lower_bound(packed_terms.begin(), packed_terms.end(), term_id,
+        [](const TermSummary& summary, int id) { return summary.term_id < id; });
+    return (it != packed_terms.end() && it->term_id == term_id) ? &*it : nullptr;
+}
+
+void Node::ensureTermMaps() const {
+    if (term_maps_ready.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(term_maps_mutex);
+    if (term_maps_ready.load(std::memory_order_relaxed)) {
+        return;
+    }
+    df.reserve(packed_terms.size());
+    tf_max.reserve(packed_terms.size());
+    for (const auto& summary : packed_terms) {
+        std::string term = packed_vocab->getTerm(summary.term_id);
+        if (summary.df >= 0) {
+            df.emplace(term, summary.df);
+        }
+        if (summary.tf_max >= 0) {
+            tf_max.emplace(std::move(term), summary.tf_max);
+        }
+    }
+    term_maps_ready.store(true, std::memory_order_release);
+}
+
+void Node::unpackTermsForWrite() {
+    ensureTermMaps();
+    std::vector<TermSummary>().swap(packed_terms);
+    packed_vocab = nullptr;
+}
+
 std::string Node::toString() const {
     std::stringstream ss;
     ss << "Node[id=" << node_id
@@ -100,6 +306,7 @@ std::string Node::toString() const {
         << ", " << mbr.toString() << "]";
 
     // 显示前5个最常见的术语（用于调试）
+    ensureTermMaps();
     int count = 0;
     ss << " {df=";
     for (const auto& pair : df) {
@@ -5,11 +5,15 @@
 #include <memory>
 #include <stdexcept> 
 #include <unordered_map>
+#include <atomic>
+#include <mutex>
 #include "MBR.h"
+#include "KeywordFilter.h"
 #include <unordered_set>
 
 // 前向声明，避免循环依赖
 class Document;
+class Vocabulary;
 
 /**
  * @class Node
@@ -27,6 +31,13 @@ public:
     /// 节点类型：叶子节点或内部节点
     enum Type { LEAF, INTERNAL };
 
+    /// 按词项 ID 存放的一条摘要（紧凑格式反序列化结果），df / tf_max 为 -1 表示该表中没有这个词项
+    struct TermSummary {
+        int term_id;
+        int df;
+        int tf_max;
+    };
+
 private:
     int node_id;       ///< 节点ID，用于唯一标识节点
     Type type;         ///< 节点类型（LEAF 或 INTERNAL）
@@ -39,14 +50,24 @@ private:
 
     // 文档摘要信息（用于索引加速）
     int document_count; ///< 当前节点下的文档总数（包含子节点递归统计）
-    std::unordered_map<std::string, int> df;      ///< 文档频率（Document Frequency）：包含某词项的文档数
-    std::unordered_map<std::string, int> tf_max;  ///< 最大词频（Max Term Frequency）：某词项在该节点下的最大出现次数
+    mutable std::unordered_map<std::string, int> df;      ///< 文档频率（Document Frequency）：包含某词项的文档数
+    mutable std::unordered_map<std::string, int> tf_max;  ///< 最大词频（Max Term Frequency）：某词项在该节点下的最大出现次数
+
+    // 紧凑格式读出的节点先只保存按词项 ID 排序的摘要，df / tf_max 在第一次需要时才由词汇表展开。
+    // 查询只按词项查 TFmax / DF，直接在 packed_terms 上二分查找，不构建字符串哈希表。
+    // packed_terms 在 restoreContent 之后不再改变，展开只写 df / tf_max（加锁，只做一次），
+    // 因此多个查询线程可以同时读取同一个节点。
+    std::vector<TermSummary> packed_terms;
+    const Vocabulary* packed_vocab = nullptr;
+    mutable std::atomic<bool> term_maps_ready{ true };  ///< df / tf_max 是否有效（为 false 时以 packed_terms 为准）
+    mutable std::mutex term_maps_mutex;
 
     
-    std::unordered_map<int, int> child_position_map;  // node_id -> path,存储子节点的 (node_id, path) 对
+    std::unordered_map<int, int> child_position_map;  // node_id -> 子节点的 ORAM 块号，按块号直接读取子节点
+    std::unordered_map<int, int> child_leaf_map;  // node_id -> 子节点块当前所在的叶子（仅 ODS 模式使用）
     std::unordered_map<int, MBR> child_mbrs;  // child_id -> MBR，存储每个子节点的独立MBR
-    std::unordered_map<int, double> child_text_upper_bounds;  // child_id -> max_text_score,存储每个子节点的文本相关性上界
-    std::unordered_map<int, std::unordered_set<std::string>> child_keywords;  // child_id -> keywords,存储每个子节点包含的关键词
+    std::unordered_map<int, double> child_text_upper_bounds;  // child_id -> max log(1+TF),存储每个子节点的文本上界（不含 IDF）
+    std::unordered_map<int, KeywordFilter> child_keywords;  // child_id -> 关键词过滤器，摘要每个子节点包含的关键词
 
 public:
     /**
@@ -112,12 +133,12 @@ public:
     /**
      * @brief 获取 DF 哈希表的引用。
      */
-    const std::unordered_map<std::string, int>& getDF() const { return df; }
+    const std::unordered_map<std::string, int>& getDF() const { ensureTermMaps(); return df; }
 
     /**
      * @brief 获取 TFmax 哈希表的引用。
      */
-    const std::unordered_map<std::string, int>& getTFMax() const { return tf_max; }
+    const std::unordered_map<std::string, int>& getTFMax() const { ensureTermMaps(); return tf_max; }
 
     /* ======================== 调试与输出 ======================== */
 
@@ -135,10 +156,101 @@ public:
      */
     void setDocumentSummary(const std::unordered_map<std::string, int>& new_df,
         const std::unordered_map<std::string, int>& new_tf_max) {
+        unpackTermsForWrite();
         df = new_df;
         tf_max = new_tf_max;
     }
 
+    /**
+     * @brief 直接恢复节点的子节点、文档与摘要（用于反序列化）。
+     *
+     * 摘要已随节点一起存储，不再像 addChild/addDocument 那样逐个添加并重新聚合；
+     * 摘要保持词项 ID 形式，getDF/getTFMax 或修改摘要时才展开为字符串表。
+     * @param children 子节点占位对象
+     * @param docs 文档列表
+     * @param doc_count 存储的文档总数
+     * @param terms 存储的 DF 与 TFmax，按词项 ID 升序
+     * @param vocab 词项 ID 所属的词汇表，须比节点存活更久
+     */
+    void restoreContent(std::vector<std::shared_ptr<Node>>&& children,
+        std::vector<std::shared_ptr<Document>>&& docs, int doc_count,
+        std::vector<TermSummary>&& terms, const Vocabulary& vocab) {
+        child_nodes = std::move(children);
+        documents = std::move(docs);
+        document_count = doc_count;
+        df.clear();
+        tf_max.clear();
+        packed_terms = std::move(terms);
+        packed_vocab = &vocab;
+        term_maps_ready.store(false, std::memory_order_release);
+    }
+
+    /**
+     * @brief 设置文档总数（用于分裂时无法重新聚合的内部节点）。
+     */
+    void setDocumentCount(int count) { document_count = count; }
+
+    /**
+     * @brief 把一个新文档合并进已有摘要（文档数、DF、TFmax），不重新聚合。
+     *
+     * 插入时祖先节点的子节点多为反序列化得到的占位对象，updateSummary 会丢失摘要，
+     * 这里只在存储的摘要上增量合并。
+     * @param doc 新插入的文档
+     */
+    void addDocumentToSummary(const Document& doc);
+
+    /**
+     * @brief 用子节点的最新内容刷新该子节点的条目（MBR、关键词过滤器），并扩展本节点的 MBR。
+     *
+     * 子节点不在列表中时加入列表。与 addChild 不同，不重新聚合摘要。
+     * @param child 子节点（需带有完整的 TFmax）
+     */
+    void refreshChild(std::shared_ptr<Node> child);
+
+    /**
+     * @brief 从另一个节点复制某个子节点的条目（位置、MBR、关键词过滤器、文本上界）并加入子节点列表，
+     * 同时扩展本节点的 MBR。
+     *
+     * 用于内部节点分裂：占位子节点没有摘要，条目只能原样搬移。不重新聚合摘要。
+     * @param source 原父节点
+     * @param child 子节点
+     */
+    void copyChildEntry(const Node& source, std::shared_ptr<Node> child);
+
+    /* ======================== 删除维护 ======================== */
+
+    /**
+     * @brief 从叶子节点删除文档，重新聚合摘要并收紧 MBR。
+     * @param doc_id 文档ID
+     * @return 被删除的文档，不在本节点时返回 nullptr
+     */
+    std::shared_ptr<Document> removeDocument(int doc_id);
+
+    /**
+     * @brief 从摘要中减去一个已删除的文档（祖先节点使用），不重新聚合。
+     *
+     * DF 逐项减一，减到 0 的词项同时从 TFmax 中删除；仍存在的词项保留原 TFmax（仍是上界）。
+     * @param doc 被删除的文档
+     */
+    void removeDocumentFromSummary(const Document& doc);
+
+    /**
+     * @brief 把整棵子树合并进摘要（重新插入子树时路径上的节点使用）。
+     * @param child 子树根节点（需带有完整摘要）
+     */
+    void addSubtreeToSummary(const Node& child);
+
+    /**
+     * @brief 删除子节点及其全部条目（位置、MBR、关键词过滤器、文本上界），不修改摘要与 MBR。
+     * @param child_id 子节点ID
+     */
+    void removeChild(int child_id);
+
+    /**
+     * @brief 按现有条目重新计算 MBR（叶子为文档位置，内部节点为子节点MBR），没有条目时保持不变。
+     */
+    void tightenMBR();
+
     /**
      * @brief 清空节点的文档（常用于测试或节点重建）。
      */
@@ -185,7 +297,7 @@ public:
     /**
      * @brief 设置子节点的位置映射
      * @param child_id 子节点ID
-     * @param path 子节点的物理路径
+     * @param path 子节点的 ORAM 块号
      */
     void setChildPosition(int child_id, int path) {
         child_position_map[child_id] = path;
@@ -194,7 +306,7 @@ public:
     /**
      * @brief 获取子节点的位置映射
      * @param child_id 子节点ID
-     * @return 子节点的物理路径，如果不存在返回-1
+     * @return 子节点的 ORAM 块号，如果不存在返回-1
      */
     int getChildPosition(int child_id) const {
         auto it = child_position_map.find(child_id);
@@ -224,6 +336,39 @@ public:
         child_position_map = new_position_map;
     }
 
+    /**
+     * @brief 设置子节点块当前所在的叶子（ODS 模式下代替位置映射）
+     * @param child_id 子节点ID
+     * @param leaf 叶子编号
+     */
+    void setChildLeaf(int child_id, int leaf) {
+        child_leaf_map[child_id] = leaf;
+    }
+
+    /**
+     * @brief 获取子节点块当前所在的叶子
+     * @param child_id 子节点ID
+     * @return 叶子编号，如果不存在返回-1
+     */
+    int getChildLeaf(int child_id) const {
+        auto it = child_leaf_map.find(child_id);
+        return (it != child_leaf_map.end()) ? it->second : -1;
+    }
+
+    /**
+     * @brief 获取所有子节点的叶子
+     */
+    const std::unordered_map<int, int>& getChildLeafMap() const {
+        return child_leaf_map;
+    }
+
+    /**
+     * @brief 设置整个子节点叶子映射（用于反序列化）
+     */
+    void setChildLeafMap(const std::unordered_map<int, int>& new_leaf_map) {
+        child_leaf_map = new_leaf_map;
+    }
+
     /* ======================== 子节点MBR操作 ======================== */
 
    /**
@@ -271,7 +416,7 @@ public:
     /**
      * @brief 设置子节点的文本相关性上界
      * @param child_id 子节点ID
-     * @param upper_bound 文本相关性上界值
+     * @param upper_bound 文本上界值（子树中各词 log(1+TF_max) 的最大值，不含 IDF）
      */
     void setChildTextUpperBound(int child_id, double upper_bound) {
         child_text_upper_bounds[child_id] = upper_bound;
@@ -299,56 +444,65 @@ public:
     /* ======================== 子节点关键词操作 ======================== */
 
     /**
-     * @brief 设置子节点包含的关键词
+     * @brief 设置子节点包含的关键词（按 keywordFilterFpRate 构建过滤器）
      * @param child_id 子节点ID
      * @param keywords 关键词集合
      */
-    void setChildKeywords(int child_id, const std::unordered_set<std::string>& keywords) {
-        child_keywords[child_id] = keywords;
+    void setChildKeywords(int child_id, const std::unordered_set<std::string>& keywords);
+
+    /**
+     * @brief 直接设置子节点的关键词过滤器（用于反序列化）
+     * @param child_id 子节点ID
+     * @param filter 关键词过滤器
+     */
+    void setChildKeywordFilter(int child_id, KeywordFilter&& filter) {
+        child_keywords[child_id] = std::move(filter);
     }
 
     /**
-     * @brief 检查子节点是否包含某个关键词
+     * @brief 检查子节点是否可能包含某个关键词（过滤器可能误报）
      * @param child_id 子节点ID
      * @param keyword 关键词
-     * @return 是否包含
+     * @return 是否可能包含
      */
     bool childHasKeyword(int child_id, const std::string& keyword) const {
         auto it = child_keywords.find(child_id);
-        return it != child_keywords.end() && it->second.count(keyword) > 0;
+        return it != child_keywords.end() && it->second.mayContain(KeywordFilter::hashTerm(keyword));
     }
 
     /**
-     * @brief 检查子节点是否包含所有查询关键词
+     * @brief 检查子节点是否可能包含所有查询关键词
      * @param child_id 子节点ID
-     * @param keywords 查询关键词列表
-     * @return 是否包含所有关键词
+     * @param keyword_hashes 查询关键词的哈希（KeywordFilter::hashTerms），每次访问节点只计算一次
+     * @return 是否可能包含所有关键词
      */
-    bool childHasAllKeywords(int child_id, const std::vector<std::string>& keywords) const {
+    bool childHasAllKeywords(int child_id, const std::vector<uint64_t>& keyword_hashes) const {
         auto it = child_keywords.find(child_id);
-        if (it == child_keywords.end()) return false;
+        return it != child_keywords.end() && it->second.mayContainAll(keyword_hashes);
+    }
 
-        const auto& child_terms = it->second;
-        for (const auto& keyword : keywords) {
-            if (child_terms.count(keyword) == 0) {
-                return false;
-            }
-        }
-        return true;
+    /**
+     * @brief 检查子节点是否可能包含所有查询关键词
+     * @param child_id 子节点ID
+     * @param keywords 查询关键词列表
+     * @return 是否可能包含所有关键词
+     */
+    bool childHasAllKeywords(int child_id, const std::vector<std::string>& keywords) const {
+        return childHasAllKeywords(child_id, KeywordFilter::hashTerms(keywords));
     }
 
     /**
-     * @brief 获取子节点的关键词集合
+     * @brief 获取子节点的关键词过滤器
      * @param child_id 子节点ID
-     * @return 关键词集合的引用
+     * @return 过滤器的引用，不存在时返回空过滤器
      */
-    const std::unordered_set<std::string>& getChildKeywords(int child_id) const {
+    const KeywordFilter& getChildKeywordFilter(int child_id) const {
         auto it = child_keywords.find(child_id);
         if (it != child_keywords.end()) {
             return it->second;
         }
-        static std::unordered_set<std::string> empty_set;
-        return empty_set;
+        static KeywordFilter empty_filter;
+        return empty_filter;
     }
 
     /**
@@ -361,9 +515,25 @@ public:
     /**
      * @brief 获取所有子节点的关键词映射
      */
-    const std::unordered_map<int, std::unordered_set<std::string>>& getChildKeywordsMap() const {
+    const std::unordered_map<int, KeywordFilter>& getChildKeywordsMap() const {
         return child_keywords;
     }
+
+private:
+    /**
+     * @brief 按词项 ID 展开的摘要尚未转换时，展开为 df / tf_max（线程安全，只做一次）
+     */
+    void ensureTermMaps() const;
+
+    /**
+     * @brief 修改摘要之前调用：展开后丢弃 packed_terms（修改不与查询并发，见 IRTree）
+     */
+    void unpackTermsForWrite();
+
+    /**
+     * @brief 在 packed_terms 中查找词项，不存在时返回 nullptr（只在 term_maps_ready 为 false 时使用）
+     */
+    const TermSummary* findPackedTerm(const std::string& term) const;
 };
 
 #endif // NODE_H
\ No newline at end of file
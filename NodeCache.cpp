@@ -0,0 +1,233 @@
+#include "NodeCache.h"
+#include "Document.h"
+#include <string>
+
+namespace {
+
+// 哈希表每个元素额外的链表指针与桶数组开销
+const size_t HASH_NODE_OVERHEAD = 2 * sizeof(void*);
+
+size_t stringBytes(const std::string& s) {
+    // 短字符串存放在对象内部，超出部分另行分配
+    return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+size_t mbrBytes(const MBR& mbr) {
+    return sizeof(MBR) + (mbr.getMin().size() + mbr.getMax().size()) * sizeof(double);
+}
+
+template <typename Map>
+size_t tableBytes(const Map& m) {
+    return m.bucket_count() * sizeof(void*) + m.size() * (sizeof(typename Map::value_type) + HASH_NODE_OVERHEAD);
+}
+
+size_t termMapBytes(const std::unordered_map<std::string, int>& m) {
+    size_t bytes = tableBytes(m);
+    for (const auto& entry : m) {
+        bytes += stringBytes(entry.first);
+    }
+    return bytes;
+}
+
+} // namespace
+
+NodeCache::NodeCache(int max_levels, size_t max_bytes)
+    : max_levels(max_levels), max_bytes(max_bytes), used_bytes(0),
+    top_level(-1), min_level(0), warm(false), hit_count(0), miss_count(0) {
+}
+
+void NodeCache::configure(int levels, size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        max_levels = levels;
+        max_bytes = bytes;
+    }
+    clear();
+}
+
+bool NodeCache::enabled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return max_levels > 0;
+}
+
+bool NodeCache::isWarm() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return warm;
+}
+
+bool NodeCache::canAddLevel() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return levelsLocked() < max_levels;
+}
+
+void NodeCache::markWarm() {
+    std::lock_guard<std::mutex> lock(mutex);
+    warm = true;
+}
+
+bool NodeCache::coversLevel(int level) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return warm && top_level >= min_level && level >= min_level && level <= top_level;
+}
+
+bool NodeCache::admits(int level) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return admitsLocked(level);
+}
+
+int NodeCache::cachedLevels() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return levelsLocked();
+}
+
+size_t NodeCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+size_t NodeCache::memoryBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return used_bytes;
+}
+
+uint64_t NodeCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hit_count;
+}
+
+uint64_t NodeCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return miss_count;
+}
+
+void NodeCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    used_bytes = 0;
+    top_level = -1;
+    min_level = 0;
+    warm = false;
+}
+
+bool NodeCache::addLevel(const std::vector<std::shared_ptr<Node>>& nodes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (nodes.empty() || levelsLocked() >= max_levels) {
+        return false;
+    }
+
+    size_t level_bytes = 0;
+    for (const auto& node : nodes) {
+        level_bytes += estimateBytes(*node);
+    }
+    if (used_bytes + level_bytes > max_bytes) {
+        return false;
+    }
+
+    int level = nodes[0]->getLevel();
+    for (const auto& node : nodes) {
+        entries[node->getId()] = Entry{ node, estimateBytes(*node) };
+    }
+    used_bytes += level_bytes;
+
+    // 预热从根开始向下，第一层即为最高层
+    if (top_level < min_level) {
+        top_level = level;
+    }
+    min_level = level;
+    return true;
+}
+
+std::shared_ptr<Node> NodeCache::find(int node_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(node_id);
+    if (it == entries.end()) {
+        miss_count++;
+        return nullptr;
+    }
+    hit_count++;
+    return it->second.node;
+}
+
+void NodeCache::update(std::shared_ptr<Node> node) {
+    if (!node) {
+        return;
+    }
+    size_t bytes = estimateBytes(*node);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!admitsLocked(node->getLevel())) {
+        return;
+    }
+
+    auto it = entries.find(node->getId());
+    if (it != entries.end()) {
+        used_bytes -= it->second.bytes;
+        it->second = Entry{ node, bytes };
+    }
+    else {
+        entries[node->getId()] = Entry{ node, bytes };
+    }
+    used_bytes += bytes;
+
+    if (node->getLevel() > top_level) {
+        top_level = node->getLevel();
+    }
+
+    while (top_level >= min_level && (levelsLocked() > max_levels || used_bytes > max_bytes)) {
+        dropLowestLevel();
+    }
+}
+
+void NodeCache::erase(int node_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(node_id);
+    if (it != entries.end()) {
+        used_bytes -= it->second.bytes;
+        entries.erase(it);
+    }
+}
+
+void NodeCache::dropLowestLevel() {
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.node->getLevel() <= min_level) {
+            used_bytes -= it->second.bytes;
+            it = entries.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    min_level++;
+}
+
+size_t NodeCache::estimateBytes(const Node& node) {
+    size_t bytes = sizeof(Node) + mbrBytes(node.getMBR());
+
+    bytes += termMapBytes(node.getDF());
+    bytes += termMapBytes(node.getTFMax());
+
+    // 反序列化得到的子节点是只带 ID、层级和 MBR 的占位节点
+    for (const auto& child : node.getChildNodes()) {
+        bytes += sizeof(std::shared_ptr<Node>) + sizeof(Node) + mbrBytes(child->getMBR());
+    }
+    bytes += tableBytes(node.getChildPositionMap());
+    bytes += tableBytes(node.getChildLeafMap());
+    bytes += tableBytes(node.getChildMBRMap());
+    for (const auto& entry : node.getChildMBRMap()) {
+        bytes += mbrBytes(entry.second) - sizeof(MBR);
+    }
+    bytes += tableBytes(node.getChildTextUpperBounds());
+    bytes += tableBytes(node.getChildKeywordsMap());
+    for (const auto& entry : node.getChildKeywordsMap()) {
+        bytes += entry.second.memoryBytes();
+    }
+
+    for (const auto& doc : node.getDocuments()) {
+        bytes += sizeof(std::shared_ptr<Document>) + sizeof(Document);
+        bytes += stringBytes(doc->getText());
+        bytes += termMapBytes(doc->getTermFreq());
+        bytes += mbrBytes(doc->getLocation()) - sizeof(MBR);
+    }
+
+    return bytes;
+}
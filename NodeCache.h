@@ -0,0 +1,135 @@
+#ifndef NODE_CACHE_H
+#define NODE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Node.h"
+
+/*
+ * NodeCache.h
+ * ----------------------------------------
+ * 客户端缓存 IRTree 靠近根的若干层已反序列化的节点。
+ *
+ * 每次查询都要从根开始访问，根及其下一两层的节点每次都会被读取，
+ * 缓存这些节点后查询可以直接跳过对应的 ORAM 访问。
+ * 缓存总是以整层为单位：覆盖 [min_level, top_level] 内的全部节点，
+ * 因此某一层是否需要访问 ORAM 只取决于树的形状，与查询无关。
+ *
+ * 容量由层数和内存字节数（按反序列化后的对象估算）共同限制，
+ * 超出时整层丢弃最靠近叶子的一层。节点被修改、分裂或删除时由
+ * IRTree 写穿更新，缓存内容始终与 ORAM 中的节点一致。
+ *
+ * 所有操作内部加锁，可供多个查询线程同时使用；缓存的节点对象只读共享。
+ */
+
+class NodeCache {
+public:
+    /**
+     * @param max_levels 最多缓存的层数（从根开始计），0 表示不启用
+     * @param max_bytes 缓存节点的内存上限（字节）
+     */
+    NodeCache(int max_levels, size_t max_bytes);
+
+    /**
+     * @brief 重新设置容量，已缓存的内容被清空
+     */
+    void configure(int max_levels, size_t max_bytes);
+
+    bool enabled() const;
+
+    /// 是否已完成预热（清空后需要重新预热）
+    bool isWarm() const;
+
+    /// 清空缓存并标记为未预热
+    void clear();
+
+    /**
+     * @brief 预热时从根开始逐层加入节点
+     * @param nodes 同一层的全部节点
+     * @return 层数或内存超限时不加入并返回 false
+     */
+    bool addLevel(const std::vector<std::shared_ptr<Node>>& nodes);
+
+    /// 是否还能继续加入下一层
+    bool canAddLevel() const;
+
+    /// 预热结束，开始接受写穿更新
+    void markWarm();
+
+    /**
+     * @brief 查找缓存的节点
+     * @return 未缓存时返回 nullptr
+     */
+    std::shared_ptr<Node> find(int node_id);
+
+    /**
+     * @brief 该层的节点是否全部在缓存中
+     */
+    bool coversLevel(int level) const;
+
+    /**
+     * @brief 该层的节点写入后是否需要刷新缓存（位于缓存层内或新的根）
+     */
+    bool admits(int level) const;
+
+    /**
+     * @brief 写穿：节点写入存储后刷新缓存中的副本
+     *
+     * 分裂产生的同层新节点直接加入；根分裂产生的新根使缓存多一层，
+     * 超出层数或内存上限时丢弃最低的一层。
+     * @param node 写入内容的独立副本（调用方之后不应再修改）
+     */
+    void update(std::shared_ptr<Node> node);
+
+    /// 节点从存储中删除
+    void erase(int node_id);
+
+    /// 当前完整缓存的层数
+    int cachedLevels() const;
+
+    size_t size() const;
+    size_t memoryBytes() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+    /**
+     * @brief 估算反序列化后节点对象占用的内存（包括摘要、子节点信息与内联文档）
+     */
+    static size_t estimateBytes(const Node& node);
+
+private:
+    struct Entry {
+        std::shared_ptr<Node> node;
+        size_t bytes;
+    };
+
+    /// 丢弃最靠近叶子的一层（调用方持有锁）
+    void dropLowestLevel();
+
+    /// 当前缓存层数（调用方持有锁）
+    int levelsLocked() const { return top_level >= min_level ? top_level - min_level + 1 : 0; }
+
+    /// 写穿时该层是否需要缓存（调用方持有锁）
+    bool admitsLocked(int level) const { return warm && top_level >= min_level && level >= min_level; }
+
+    mutable std::mutex mutex;
+
+    std::unordered_map<int, Entry> entries;  ///< node_id -> 缓存节点
+
+    int max_levels;
+    size_t max_bytes;
+    size_t used_bytes;
+
+    int top_level;   ///< 缓存覆盖的最高层（根）
+    int min_level;   ///< 缓存覆盖的最低层
+    bool warm;
+
+    uint64_t hit_count;
+    uint64_t miss_count;
+};
+
+#endif // NODE_CACHE_H
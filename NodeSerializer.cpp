@@ -1,6 +1,48 @@
 #include "NodeSerializer.h"
+#include "param.h"
 #include <iostream>
 #include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// 紧凑格式头：['I' 'R' 版本号 0xFF]
+const uint8_t COMPACT_MAGIC0 = 'I';
+const uint8_t COMPACT_MAGIC1 = 'R';
+const uint8_t COMPACT_MARKER = 0xFF;
+const size_t COMPACT_HEADER_SIZE = 4;
+
+// 字段取值为 0 表示该词项不在对应的表中（DF 和 TFmax 的真实取值都不小于 1）
+const uint32_t ABSENT = 0;
+
+// 词项 ID 查找，未登记的词项加入词汇表
+int termIdOf(Vocabulary& vocab, const std::string& term) {
+    int term_id = vocab.addTerm(term);
+    if (term_id < 0) {
+        throw std::runtime_error("Cannot assign term id for '" + term + "'");
+    }
+    return term_id;
+}
+
+// 按 key 排序遍历 unordered_map，使相同内容的节点序列化结果一致
+template <typename Map>
+std::vector<const typename Map::value_type*> sortedEntries(const Map& m) {
+    std::vector<const typename Map::value_type*> entries;
+    entries.reserve(m.size());
+    for (const auto& entry : m) {
+        entries.push_back(&entry);
+    }
+    std::sort(entries.begin(), entries.end(),
+        [](const typename Map::value_type* a, const typename Map::value_type* b) { return a->first < b->first; });
+    return entries;
+}
+
+} // namespace
+
+const uint8_t NodeSerializer::COMPACT_VERSION;
 
 // 写入整数到字节流
 void NodeSerializer::writeInt(std::vector<uint8_t>& data, int value) {
@@ -87,14 +129,14 @@ MBR NodeSerializer::readMBR(const std::vector<uint8_t>& data, size_t& offset) {
 }
 
 // 序列化文档
-std::vector<uint8_t> NodeSerializer::serializeDocument(const Document& doc) {
+std::vector<uint8_t> NodeSerializer::serializeDocument(const Document& doc, bool include_text) {
     std::vector<uint8_t> data;
 
     // 写入文档ID
     writeInt(data, doc.getId());
 
-    // 写入原始文本
-    writeString(data, doc.getText());
+    // 写入原始文本（不含文本时写入空串）
+    writeString(data, include_text ? doc.getText() : std::string());
 
     // 写入位置信息 (MBR)
     const MBR& location = doc.getLocation();
@@ -158,15 +200,17 @@ std::shared_ptr<Document> NodeSerializer::deserializeDocument(const std::vector<
         }
 
         MBR location(min_coords, max_coords);
-        //使用原始文本创建文档
-        auto document = std::make_shared<Document>(doc_id, location, raw_text);
+
+        // 使用存储的词频创建文档（不含文本的文档只能这样恢复，也省去重新分词）
         int term_count = readInt(data, offset);
+        std::unordered_map<std::string, int> term_freq;
+        term_freq.reserve(term_count > 0 ? term_count : 0);
         for (int i = 0; i < term_count; i++) {
-            readString(data, offset); // 跳过term
-            readInt(data, offset);    // 跳过freq
+            std::string term = readString(data, offset);
+            term_freq[std::move(term)] = readInt(data, offset);
         }
 
-        return document;
+        return std::make_shared<Document>(doc_id, location, std::move(raw_text), std::move(term_freq));
     }
     catch (const std::exception& e) {
         std::cerr << "Error deserializing document: " << e.what() << std::endl;
@@ -175,7 +219,7 @@ std::shared_ptr<Document> NodeSerializer::deserializeDocument(const std::vector<
 }
 
 // 序列化节点
-std::vector<uint8_t> NodeSerializer::serialize(const Node& node) {
+std::vector<uint8_t> NodeSerializer::serialize(const Node& node, bool include_text) {
     std::vector<uint8_t> data;
 
     // 写入节点基本信息
@@ -211,7 +255,7 @@ std::vector<uint8_t> NodeSerializer::serialize(const Node& node) {
         writeInt(data, static_cast<int>(documents.size()));
 
         for (const auto& doc : documents) {
-            auto doc_data = serializeDocument(*doc);
+            auto doc_data = serializeDocument(*doc, include_text);
             writeInt(data, static_cast<int>(doc_data.size()));
             data.insert(data.end(), doc_data.begin(), doc_data.end());
         }
@@ -287,34 +331,47 @@ std::vector<uint8_t> NodeSerializer::serialize(const Node& node) {
         const auto& child_keywords_map = node.getChildKeywordsMap();
         writeInt(data, static_cast<int>(child_keywords_map.size()));
         for (const auto& keyword_pair : child_keywords_map) {
-            int child_id = keyword_pair.first;
-            const auto& keywords = keyword_pair.second;
-
-            writeInt(data, child_id);
-            writeInt(data, static_cast<int>(keywords.size()));
+            const KeywordFilter& filter = keyword_pair.second;
 
-            for (const auto& keyword : keywords) {
-                writeString(data, keyword);
-            }
+            writeInt(data, keyword_pair.first);
+            writeInt(data, filter.getHashCount());
+            writeInt(data, static_cast<int>(filter.getWords().size()));
+            writeWords(data, filter.getWords());
         }
     }
     else {
         writeInt(data, 0); // 叶子节点没有子节点关键词信息
     }
 
-    // 更新版本号到7，表示包含所有子节点优化信息
-    writeInt(data, 7); // 版本号升级到7
+    // 版本号9：子节点关键词以过滤器（KeywordFilter）存储，版本号之后为子节点叶子（ODS 模式）
+    writeInt(data, 9);
+
+    // 写入子节点叶子信息
+    const auto& child_leaf_map = node.getChildLeafMap();
+    writeInt(data, static_cast<int>(child_leaf_map.size()));
+    for (const auto& leaf_pair : child_leaf_map) {
+        writeInt(data, leaf_pair.first);
+        writeInt(data, leaf_pair.second);
+    }
 
     return data;
 }
 
 // 反序列化节点
-std::shared_ptr<Node> NodeSerializer::deserialize(const std::vector<uint8_t>& data) {
+std::shared_ptr<Node> NodeSerializer::deserialize(const std::vector<uint8_t>& data, const Vocabulary* vocab) {
     if (data.empty()) {
         std::cout << "Empty data for node deserialization" << std::endl;
         return nullptr;
     }
 
+    if (isCompact(data)) {
+        if (!vocab) {
+            std::cerr << "Error deserializing node: compact node requires a vocabulary" << std::endl;
+            return nullptr;
+        }
+        return deserializeCompact(data, *vocab);
+    }
+
     try {
         size_t offset = 0;
 
@@ -448,37 +505,40 @@ std::shared_ptr<Node> NodeSerializer::deserialize(const std::vector<uint8_t>& da
             node->setChildTextUpperBound(bound_pair.first, bound_pair.second);
         }
 
-        // 读取子节点关键词信息
-        std::unordered_map<int, std::unordered_set<std::string>> child_keywords_map;
+        // 读取子节点关键词过滤器
         if (offset < data.size()) {
             int child_keywords_count = readInt(data, offset);
             for (int i = 0; i < child_keywords_count; i++) {
                 if (offset >= data.size()) break;
                 int child_id = readInt(data, offset);
-                int keyword_count = readInt(data, offset);
-
-                std::unordered_set<std::string> keywords;
-                for (int j = 0; j < keyword_count; j++) {
-                    if (offset >= data.size()) break;
-                    std::string keyword = readString(data, offset);
-                    keywords.insert(keyword);
+                int hash_count = readInt(data, offset);
+                int word_count = readInt(data, offset);
+                if (word_count < 0) {
+                    throw std::runtime_error("Invalid keyword filter size");
                 }
-
-                child_keywords_map[child_id] = keywords;
+                node->setChildKeywordFilter(child_id,
+                    KeywordFilter::fromWords(readWords(data, offset, word_count), hash_count));
             }
         }
 
-        // 设置子节点关键词信息
-        for (const auto& keyword_pair : child_keywords_map) {
-            node->setChildKeywords(keyword_pair.first, keyword_pair.second);
-        }
-
         // 读取版本号
         int version = 1;
         if (offset < data.size()) {
             version = readInt(data, offset);
         }
 
+        // 读取子节点叶子信息
+        if (version >= 9 && offset < data.size()) {
+            int child_leaf_count = readInt(data, offset);
+            std::unordered_map<int, int> child_leaf_map;
+            for (int i = 0; i < child_leaf_count; i++) {
+                if (offset >= data.size()) break;
+                int child_id = readInt(data, offset);
+                child_leaf_map[child_id] = readInt(data, offset);
+            }
+            node->setChildLeafMap(child_leaf_map);
+        }
+
         // 手动设置文档摘要信息
         node->setDocumentSummary(df_map, tf_max_map);
 
@@ -488,4 +548,422 @@ std::shared_ptr<Node> NodeSerializer::deserialize(const std::vector<uint8_t>& da
         std::cerr << "Error deserializing node: " << e.what() << std::endl;
         return nullptr;
     }
-}
\ No newline at end of file
+}
+
+// ==============================
+// 紧凑格式
+// ==============================
+//
+// [header 4B]
+// [node_id sv][type 1B][level v][document_count v][MBR]
+// [term_count v]{[term_id 差分 v][df v][tf_max v]}        DF/TFmax 共用的词项列表
+// [child_count v]{[child_id sv]}
+// [position_count v]{[child_id sv][path sv]}
+// [leaf_count v]{[child_id sv][leaf sv]}                 子节点叶子（版本 3 起，ODS 模式使用）
+// [child_mbr_count v]{[child_id sv][MBR]}
+// [bound_count v]{[child_id sv][upper_bound f32]}
+// [keyword_child_count v]{[child_id sv][hash_count 1B][word_count v][word 8B...]}   关键词过滤器（版本 1 为词项 ID 列表）
+// [document_count v]{[doc_id sv][MBR][text_len v][text][词项 ID 列表][freq v]...}
+//
+// v = 无符号 varint，sv = zigzag varint，MBR = [dims v][min f64...][dims v][max f64...]，
+// 词项 ID 列表 = [count v]{[term_id 差分 v]}（ID 升序）
+
+bool NodeSerializer::isCompact(const std::vector<uint8_t>& data) {
+    return data.size() >= COMPACT_HEADER_SIZE &&
+        data[0] == COMPACT_MAGIC0 && data[1] == COMPACT_MAGIC1 && data[3] == COMPACT_MARKER;
+}
+
+void NodeSerializer::writeVarint(std::vector<uint8_t>& data, uint32_t value) {
+    while (value >= 0x80) {
+        data.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t NodeSerializer::readVarint(const std::vector<uint8_t>& data, size_t& offset) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (offset >= data.size()) {
+            throw std::runtime_error("Insufficient data for reading varint");
+        }
+        uint8_t byte = data[offset++];
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Malformed varint");
+}
+
+void NodeSerializer::writeSignedVarint(std::vector<uint8_t>& data, int value) {
+    uint32_t v = static_cast<uint32_t>(value);
+    writeVarint(data, (v << 1) ^ (value < 0 ? 0xFFFFFFFFu : 0u));
+}
+
+int NodeSerializer::readSignedVarint(const std::vector<uint8_t>& data, size_t& offset) {
+    uint32_t v = readVarint(data, offset);
+    return static_cast<int>((v >> 1) ^ (0u - (v & 1)));
+}
+
+void NodeSerializer::writeFloat(std::vector<uint8_t>& data, float value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    data.insert(data.end(), bytes, bytes + sizeof(float));
+}
+
+float NodeSerializer::readFloat(const std::vector<uint8_t>& data, size_t& offset) {
+    if (offset + sizeof(float) > data.size()) {
+        throw std::runtime_error("Insufficient data for reading float");
+    }
+    float value;
+    memcpy(&value, data.data() + offset, sizeof(float));
+    offset += sizeof(float);
+    return value;
+}
+
+void NodeSerializer::writeCompactMBR(std::vector<uint8_t>& data, const MBR& mbr) {
+    const auto& min_coords = mbr.getMin();
+    const auto& max_coords = mbr.getMax();
+
+    writeVarint(data, static_cast<uint32_t>(min_coords.size()));
+    for (double coord : min_coords) {
+        writeDouble(data, coord);
+    }
+    writeVarint(data, static_cast<uint32_t>(max_coords.size()));
+    for (double coord : max_coords) {
+        writeDouble(data, coord);
+    }
+}
+
+MBR NodeSerializer::readCompactMBR(const std::vector<uint8_t>& data, size_t& offset) {
+    uint32_t min_size = readVarint(data, offset);
+    if (offset + static_cast<size_t>(min_size) * sizeof(double) > data.size()) {
+        throw std::runtime_error("Insufficient data for reading MBR");
+    }
+    std::vector<double> min_coords(min_size);
+    for (uint32_t i = 0; i < min_size; i++) {
+        min_coords[i] = readDouble(data, offset);
+    }
+
+    uint32_t max_size = readVarint(data, offset);
+    if (offset + static_cast<size_t>(max_size) * sizeof(double) > data.size()) {
+        throw std::runtime_error("Insufficient data for reading MBR");
+    }
+    std::vector<double> max_coords(max_size);
+    for (uint32_t i = 0; i < max_size; i++) {
+        max_coords[i] = readDouble(data, offset);
+    }
+
+    return MBR(min_coords, max_coords);
+}
+
+void NodeSerializer::writeWords(std::vector<uint8_t>& data, const std::vector<uint64_t>& words) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(words.data());
+    data.insert(data.end(), bytes, bytes + words.size() * sizeof(uint64_t));
+}
+
+std::vector<uint64_t> NodeSerializer::readWords(const std::vector<uint8_t>& data, size_t& offset, size_t count) {
+    if (count > (data.size() - offset) / sizeof(uint64_t)) {
+        throw std::runtime_error("Insufficient data for reading words");
+    }
+    std::vector<uint64_t> words(count);
+    memcpy(words.data(), data.data() + offset, count * sizeof(uint64_t));
+    offset += count * sizeof(uint64_t);
+    return words;
+}
+
+// 以紧凑格式序列化节点
+std::vector<uint8_t> NodeSerializer::serializeCompact(const Node& node, Vocabulary& vocab, bool include_text) {
+    std::vector<uint8_t> data;
+    data.reserve(512);
+
+    try {
+        data.push_back(COMPACT_MAGIC0);
+        data.push_back(COMPACT_MAGIC1);
+        data.push_back(COMPACT_VERSION);
+        data.push_back(COMPACT_MARKER);
+
+        // 节点基本信息
+        writeSignedVarint(data, node.getId());
+        data.push_back(static_cast<uint8_t>(node.getType()));
+        writeVarint(data, static_cast<uint32_t>(node.getLevel()));
+        writeVarint(data, static_cast<uint32_t>(node.getDocumentCount()));
+        writeCompactMBR(data, node.getMBR());
+
+        // DF 与 TFmax：两表的词项基本相同，合并为一份按 ID 排序的列表
+        struct TermStat {
+            int term_id;
+            uint32_t df;
+            uint32_t tf_max;
+        };
+        const auto& df = node.getDF();
+        const auto& tf_max = node.getTFMax();
+        std::vector<TermStat> stats;
+        stats.reserve(df.size());
+        for (const auto& df_pair : df) {
+            auto tf_it = tf_max.find(df_pair.first);
+            stats.push_back(TermStat{ termIdOf(vocab, df_pair.first), static_cast<uint32_t>(df_pair.second),
+                tf_it != tf_max.end() ? static_cast<uint32_t>(tf_it->second) : ABSENT });
+        }
+        for (const auto& tf_pair : tf_max) {
+            if (df.find(tf_pair.first) == df.end()) {
+                stats.push_back(TermStat{ termIdOf(vocab, tf_pair.first), ABSENT, static_cast<uint32_t>(tf_pair.second) });
+            }
+        }
+        std::sort(stats.begin(), stats.end(),
+            [](const TermStat& a, const TermStat& b) { return a.term_id < b.term_id; });
+
+        writeVarint(data, static_cast<uint32_t>(stats.size()));
+        int prev = 0;
+        for (const auto& stat : stats) {
+            writeVarint(data, static_cast<uint32_t>(stat.term_id - prev));
+            writeVarint(data, stat.df);
+            writeVarint(data, stat.tf_max);
+            prev = stat.term_id;
+        }
+
+        // 子节点 ID
+        const auto& child_nodes = node.getChildNodes();
+        writeVarint(data, static_cast<uint32_t>(child_nodes.size()));
+        for (const auto& child : child_nodes) {
+            writeSignedVarint(data, child->getId());
+        }
+
+        // 子节点位置映射
+        auto positions = sortedEntries(node.getChildPositionMap());
+        writeVarint(data, static_cast<uint32_t>(positions.size()));
+        for (const auto* entry : positions) {
+            writeSignedVarint(data, entry->first);
+            writeSignedVarint(data, entry->second);
+        }
+
+        // 子节点叶子
+        auto leaves = sortedEntries(node.getChildLeafMap());
+        writeVarint(data, static_cast<uint32_t>(leaves.size()));
+        for (const auto* entry : leaves) {
+            writeSignedVarint(data, entry->first);
+            writeSignedVarint(data, entry->second);
+        }
+
+        // 子节点 MBR
+        auto child_mbrs = sortedEntries(node.getChildMBRMap());
+        writeVarint(data, static_cast<uint32_t>(child_mbrs.size()));
+        for (const auto* entry : child_mbrs) {
+            writeSignedVarint(data, entry->first);
+            writeCompactMBR(data, entry->second);
+        }
+
+        // 子节点文本上界：float32 向上取整，剪枝时仍是合法的上界
+        auto bounds = sortedEntries(node.getChildTextUpperBounds());
+        writeVarint(data, static_cast<uint32_t>(bounds.size()));
+        for (const auto* entry : bounds) {
+            float bound = static_cast<float>(entry->second);
+            if (static_cast<double>(bound) < entry->second) {
+                bound = std::nextafter(bound, std::numeric_limits<float>::infinity());
+            }
+            writeSignedVarint(data, entry->first);
+            writeFloat(data, bound);
+        }
+
+        // 子节点关键词过滤器
+        auto keywords = sortedEntries(node.getChildKeywordsMap());
+        writeVarint(data, static_cast<uint32_t>(keywords.size()));
+        for (const auto* entry : keywords) {
+            const KeywordFilter& filter = entry->second;
+            writeSignedVarint(data, entry->first);
+            data.push_back(static_cast<uint8_t>(filter.getHashCount()));
+            writeVarint(data, static_cast<uint32_t>(filter.getWords().size()));
+            writeWords(data, filter.getWords());
+        }
+
+        // 叶子节点的文档：词频以词项 ID 写入，读取时无需重新分词
+        const auto& documents = node.getDocuments();
+        writeVarint(data, static_cast<uint32_t>(documents.size()));
+        for (const auto& doc : documents) {
+            writeSignedVarint(data, doc->getId());
+            writeCompactMBR(data, doc->getLocation());
+
+            // 完整文档单独存储时不写入文本（长度为 0）
+            if (include_text) {
+                const std::string& text = doc->getText();
+                writeVarint(data, static_cast<uint32_t>(text.size()));
+                data.insert(data.end(), text.begin(), text.end());
+            }
+            else {
+                writeVarint(data, 0);
+            }
+
+            const auto& term_freq = doc->getTermFreq();
+            std::vector<std::pair<int, int>> freqs;
+            freqs.reserve(term_freq.size());
+            for (const auto& term_pair : term_freq) {
+                freqs.emplace_back(termIdOf(vocab, term_pair.first), term_pair.second);
+            }
+            std::sort(freqs.begin(), freqs.end());
+
+            writeVarint(data, static_cast<uint32_t>(freqs.size()));
+            prev = 0;
+            for (const auto& freq : freqs) {
+                writeVarint(data, static_cast<uint32_t>(freq.first - prev));
+                writeVarint(data, static_cast<uint32_t>(freq.second));
+                prev = freq.first;
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error serializing node " << node.getId() << ": " << e.what() << std::endl;
+        return {};
+    }
+
+    return data;
+}
+
+// 反序列化紧凑格式节点
+std::shared_ptr<Node> NodeSerializer::deserializeCompact(const std::vector<uint8_t>& data, const Vocabulary& vocab) {
+    try {
+        int version = data[2];
+        if (version < 1 || version > COMPACT_VERSION) {
+            throw std::runtime_error("Unsupported compact node version " + std::to_string(version));
+        }
+        size_t offset = COMPACT_HEADER_SIZE;
+
+        // 节点基本信息
+        int node_id = readSignedVarint(data, offset);
+        if (offset >= data.size()) {
+            throw std::runtime_error("Insufficient data for reading node type");
+        }
+        Node::Type node_type = static_cast<Node::Type>(data[offset++]);
+        int level = static_cast<int>(readVarint(data, offset));
+        int doc_count = static_cast<int>(readVarint(data, offset));
+        MBR mbr = readCompactMBR(data, offset);
+        auto node = std::make_shared<Node>(node_id, node_type, level, mbr);
+
+        // DF 与 TFmax：保持词项 ID 形式交给 Node，不在这里构建字符串表（见 Node::restoreContent）
+        uint32_t term_count = readVarint(data, offset);
+        if (term_count > data.size() - offset) {
+            throw std::runtime_error("Invalid term count " + std::to_string(term_count));
+        }
+        std::vector<Node::TermSummary> terms;
+        terms.reserve(term_count);
+        int term_id = 0;
+        for (uint32_t i = 0; i < term_count; i++) {
+            term_id += static_cast<int>(readVarint(data, offset));
+            uint32_t df = readVarint(data, offset);
+            uint32_t tf_max = readVarint(data, offset);
+            if (term_id < 0 || static_cast<size_t>(term_id) >= vocab.size()) {
+                throw std::out_of_range("Term ID out of range: " + std::to_string(term_id));
+            }
+            terms.push_back(Node::TermSummary{ term_id,
+                df != ABSENT ? static_cast<int>(df) : -1,
+                tf_max != ABSENT ? static_cast<int>(tf_max) : -1 });
+        }
+
+        // 子节点：与旧格式相同，只创建带 ID 的占位节点
+        uint32_t child_count = readVarint(data, offset);
+        std::vector<std::shared_ptr<Node>> children;
+        children.reserve(child_count);
+        size_t dims = mbr.getMin().size();
+        for (uint32_t i = 0; i < child_count; i++) {
+            int child_id = readSignedVarint(data, offset);
+            MBR child_mbr(std::vector<double>(dims, 0.0), std::vector<double>(dims, 0.0));
+            children.push_back(std::make_shared<Node>(child_id, Node::LEAF, level - 1, child_mbr));
+        }
+
+        // 子节点位置映射
+        uint32_t position_count = readVarint(data, offset);
+        std::unordered_map<int, int> child_position_map;
+        child_position_map.reserve(position_count);
+        for (uint32_t i = 0; i < position_count; i++) {
+            int child_id = readSignedVarint(data, offset);
+            child_position_map[child_id] = readSignedVarint(data, offset);
+        }
+        node->setChildPositionMap(child_position_map);
+
+        // 子节点叶子
+        if (version >= 3) {
+            uint32_t leaf_count = readVarint(data, offset);
+            std::unordered_map<int, int> child_leaf_map;
+            child_leaf_map.reserve(leaf_count);
+            for (uint32_t i = 0; i < leaf_count; i++) {
+                int child_id = readSignedVarint(data, offset);
+                child_leaf_map[child_id] = readSignedVarint(data, offset);
+            }
+            node->setChildLeafMap(child_leaf_map);
+        }
+
+        // 子节点 MBR
+        uint32_t child_mbr_count = readVarint(data, offset);
+        for (uint32_t i = 0; i < child_mbr_count; i++) {
+            int child_id = readSignedVarint(data, offset);
+            node->setChildMBR(child_id, readCompactMBR(data, offset));
+        }
+
+        // 子节点文本上界
+        uint32_t bound_count = readVarint(data, offset);
+        for (uint32_t i = 0; i < bound_count; i++) {
+            int child_id = readSignedVarint(data, offset);
+            node->setChildTextUpperBound(child_id, static_cast<double>(readFloat(data, offset)));
+        }
+
+        // 子节点关键词：版本 1 为词项 ID 列表（读取时构建过滤器），版本 2 起直接存储过滤器
+        uint32_t keyword_child_count = readVarint(data, offset);
+        for (uint32_t i = 0; i < keyword_child_count; i++) {
+            int child_id = readSignedVarint(data, offset);
+            if (version == 1) {
+                uint32_t keyword_count = readVarint(data, offset);
+                std::vector<uint64_t> hashes;
+                hashes.reserve(keyword_count);
+                term_id = 0;
+                for (uint32_t j = 0; j < keyword_count; j++) {
+                    term_id += static_cast<int>(readVarint(data, offset));
+                    hashes.push_back(KeywordFilter::hashTerm(vocab.getTerm(term_id)));
+                }
+                node->setChildKeywordFilter(child_id, KeywordFilter::build(hashes, keywordFilterFpRate));
+            }
+            else {
+                if (offset >= data.size()) {
+                    throw std::runtime_error("Insufficient data for reading keyword filter");
+                }
+                int hash_count = data[offset++];
+                uint32_t word_count = readVarint(data, offset);
+                node->setChildKeywordFilter(child_id,
+                    KeywordFilter::fromWords(readWords(data, offset, word_count), hash_count));
+            }
+        }
+
+        // 文档
+        uint32_t document_count = readVarint(data, offset);
+        std::vector<std::shared_ptr<Document>> documents;
+        documents.reserve(document_count);
+        for (uint32_t i = 0; i < document_count; i++) {
+            int doc_id = readSignedVarint(data, offset);
+            MBR location = readCompactMBR(data, offset);
+
+            uint32_t text_size = readVarint(data, offset);
+            if (offset + text_size > data.size()) {
+                throw std::runtime_error("Insufficient data for reading document text");
+            }
+            std::string text(reinterpret_cast<const char*>(data.data()) + offset, text_size);
+            offset += text_size;
+
+            uint32_t freq_count = readVarint(data, offset);
+            std::unordered_map<std::string, int> term_freq;
+            term_freq.reserve(freq_count);
+            term_id = 0;
+            for (uint32_t j = 0; j < freq_count; j++) {
+                term_id += static_cast<int>(readVarint(data, offset));
+                int freq = static_cast<int>(readVarint(data, offset));
+                term_freq.emplace(vocab.getTerm(term_id), freq);
+            }
+
+            documents.push_back(std::make_shared<Document>(doc_id, location, std::move(text), std::move(term_freq)));
+        }
+
+        node->restoreContent(std::move(children), std::move(documents), doc_count, std::move(terms), vocab);
+        return node;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error deserializing node: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
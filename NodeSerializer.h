@@ -3,20 +3,57 @@
 
 #include "Node.h"
 #include "Document.h"
+#include "Vocabulary.h"
 #include <vector>
 #include <cstdint>
 #include <memory>
 
+/*
+ * 节点有两种序列化格式：
+ *   旧格式（版本 8）：定长 int/double，词项以长度前缀的完整字符串写入；
+ *   紧凑格式：词项写为 Vocabulary 中的 ID，按 ID 排序后差分 varint 编码，
+ *             DF 与 TFmax 共用一份词项列表，子节点文本上界写为 float32（向上取整）。
+ * 两种格式的子节点关键词都以 KeywordFilter 的位数组存储。
+ * 紧凑格式以 ['I' 'R' 版本号 0xFF] 开头；旧格式开头是非负的节点 ID（小端 int），
+ * 其第 4 个字节不会是 0xFF，deserialize 据此自动识别两种格式。
+ */
 class NodeSerializer {
 public:
-    // 序列化节点到字节流
-    static std::vector<uint8_t> serialize(const Node& node);
+    /// 紧凑格式的版本号（3：增加子节点叶子段）
+    static const uint8_t COMPACT_VERSION = 3;
 
-    // 从字节流反序列化节点
-    static std::shared_ptr<Node> deserialize(const std::vector<uint8_t>& data);
+    /**
+     * @brief 序列化节点到字节流（旧格式）
+     * @param node 节点
+     * @param include_text 叶子节点中的文档是否写入原始文本；
+     *        完整文档单独存储时只写入打分需要的位置和词频
+     */
+    static std::vector<uint8_t> serialize(const Node& node, bool include_text = true);
 
-    // 序列化文档到字节流
-    static std::vector<uint8_t> serializeDocument(const Document& doc);
+    /**
+     * @brief 以紧凑格式序列化节点
+     * @param node 节点
+     * @param vocab 词汇表，节点中尚未登记的词项会被加入
+     * @param include_text 叶子节点中的文档是否写入原始文本（同 serialize）
+     * @return 序列化结果，失败时返回空向量
+     */
+    static std::vector<uint8_t> serializeCompact(const Node& node, Vocabulary& vocab, bool include_text = true);
+
+    /**
+     * @brief 从字节流反序列化节点，自动识别旧格式与紧凑格式
+     * @param data 序列化数据
+     * @param vocab 解码紧凑格式词项 ID 的词汇表（只读取旧格式时可为空）
+     * @return 节点对象，数据损坏或缺少词汇表时返回 nullptr
+     */
+    static std::shared_ptr<Node> deserialize(const std::vector<uint8_t>& data, const Vocabulary* vocab = nullptr);
+
+    /**
+     * @brief 判断数据是否为紧凑格式
+     */
+    static bool isCompact(const std::vector<uint8_t>& data);
+
+    // 序列化文档到字节流，include_text 为 false 时只写入位置和词频
+    static std::vector<uint8_t> serializeDocument(const Document& doc, bool include_text = true);
 
     // 从字节流反序列化文档
     static std::shared_ptr<Document> deserializeDocument(const std::vector<uint8_t>& data);
@@ -32,6 +69,19 @@ private:
     // MBR序列化方法
     static void writeMBR(std::vector<uint8_t>& data, const MBR& mbr);
     static MBR readMBR(const std::vector<uint8_t>& data, size_t& offset);
+
+    // 紧凑格式辅助方法
+    static void writeVarint(std::vector<uint8_t>& data, uint32_t value);
+    static uint32_t readVarint(const std::vector<uint8_t>& data, size_t& offset);
+    static void writeSignedVarint(std::vector<uint8_t>& data, int value);
+    static int readSignedVarint(const std::vector<uint8_t>& data, size_t& offset);
+    static void writeFloat(std::vector<uint8_t>& data, float value);
+    static float readFloat(const std::vector<uint8_t>& data, size_t& offset);
+    static void writeCompactMBR(std::vector<uint8_t>& data, const MBR& mbr);
+    static MBR readCompactMBR(const std::vector<uint8_t>& data, size_t& offset);
+    static void writeWords(std::vector<uint8_t>& data, const std::vector<uint64_t>& words);
+    static std::vector<uint64_t> readWords(const std::vector<uint8_t>& data, size_t& offset, size_t count);
+    static std::shared_ptr<Node> deserializeCompact(const std::vector<uint8_t>& data, const Vocabulary& vocab);
 };
 
 #endif
\ No newline at end of file
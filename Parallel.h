@@ -0,0 +1,68 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/*
+ * Parallel.h
+ * ----------------------------------------
+ * 批量建树使用的简单并行循环：下标区间按固定粒度分块，
+ * 工作线程通过原子计数领取分块（调用线程也参与），负载不均时自动平衡。
+ * 与 IRTree::searchParallel 的做法相同，不依赖 OpenMP。
+ */
+
+/// 线程数参数的实际取值：<= 0 表示使用全部硬件线程
+inline int resolveThreadCount(int threads) {
+    if (threads > 0) {
+        return threads;
+    }
+    unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? static_cast<int>(hardware) : 1;
+}
+
+/**
+ * @brief 并行执行 fn(i)，i ∈ [0, count)
+ * @param threads 线程数（<= 0 为硬件线程数），1 时在调用线程中顺序执行
+ * @param grain 每次领取的下标数
+ *
+ * fn 必须可以并发调用，不同下标之间不能写同一对象
+ */
+template <typename Fn>
+void parallelFor(size_t count, int threads, Fn fn, size_t grain = 64) {
+    grain = std::max<size_t>(1, grain);
+    size_t chunks = (count + grain - 1) / grain;
+    size_t workers = std::min<size_t>(static_cast<size_t>(resolveThreadCount(threads)), chunks);
+    if (workers <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next_chunk(0);
+    auto worker = [&]() {
+        size_t chunk;
+        while ((chunk = next_chunk.fetch_add(1)) < chunks) {
+            size_t end = std::min(count, (chunk + 1) * grain);
+            for (size_t i = chunk * grain; i < end; i++) {
+                fn(i);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for (size_t t = 1; t < workers; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+}
+
+#endif // PARALLEL_H
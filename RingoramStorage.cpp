@@ -1,15 +1,67 @@
 #include "RingoramStorage.h"
+#include "BlockCodec.h"
+#include "Parallel.h"
+#include "Snapshot.h"
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
 #include<cstring>
 
+namespace {
+
+const uint32_t kStorageSectionTag = snapshotTag('S', 'T', 'O', 'R');
+
+// 映射表在快照中存为 (键, 值) 数组
+struct MapEntry {
+    int32_t key;
+    int32_t value;
+};
+
+void putMap(SnapshotWriter& writer, const std::unordered_map<int, int>& map) {
+    std::vector<MapEntry> entries;
+    entries.reserve(map.size());
+    for (const auto& pair : map) {
+        entries.push_back({ pair.first, pair.second });
+    }
+    writer.putArray(entries);
+}
+
+void getMap(SnapshotReader& reader, std::unordered_map<int, int>& map) {
+    std::vector<MapEntry> entries;
+    reader.getArray(entries);
+    map.clear();
+    map.reserve(entries.size());
+    for (const auto& entry : entries) {
+        map.emplace(entry.key, entry.value);
+    }
+}
+
+} // namespace
+
 RingOramStorage::RingOramStorage(int cap, int block_size, 
                                  const std::string& server_ip, 
                                  int server_port)
     : next_block_id(0), 
+      live_blocks(0),
+      touched_block_limit(0),
+      block_allocations(0),
+      block_reuses(0),
+      block_releases(0),
+      ods_mode(odsMode),
+      root_leaf(-1),
       capacity(cap),
       server_ip_(server_ip),
-      server_port_(server_port) {
+      server_port_(server_port),
+      compress_nodes(compressNodes),
+      node_size_class(nodeSizeClass),
+      node_raw_bytes(0),
+      node_stored_bytes(0),
+      doc_raw_bytes(0),
+      doc_stored_bytes(0),
+      root_path(-1),
+      root_path_block_index(-1) {
 
     try {
         // 创建网络模式的ringoram
@@ -24,30 +76,148 @@ RingOramStorage::RingOramStorage(int cap, int block_size,
     }
 }
 
+std::vector<char> RingOramStorage::oramAccess(int block_id, ringoram::Operation op, const std::vector<char>& data) {
+    std::lock_guard<std::mutex> lock(oram_mutex);
+    touched_block_limit = std::max(touched_block_limit, block_id + 1);
+    return oram->access(block_id, op, data);
+}
+
+std::vector<char> RingOramStorage::oramAccess(int block_id, ringoram::Operation op, const std::vector<char>& data,
+                                              int old_leaf, int new_leaf, bool pin) {
+    std::lock_guard<std::mutex> lock(oram_mutex);
+    touched_block_limit = std::max(touched_block_limit, block_id + 1);
+    return oram->access(block_id, op, data, old_leaf, new_leaf, pin);
+}
+
+std::vector<std::vector<char>> RingOramStorage::oramBatchAccess(const std::vector<int>& block_ids, int pad_to) {
+    std::lock_guard<std::mutex> lock(oram_mutex);
+    for (int block_id : block_ids) {
+        touched_block_limit = std::max(touched_block_limit, block_id + 1);
+    }
+    return oram->batchAccess(block_ids, pad_to);
+}
+
 int RingOramStorage::getNextBlockId() {
-    int block_id = next_block_id++;
+    int block_id;
+    if (!free_blocks.empty()) {
+        // 复用最小的空闲块，已分配区间保持紧凑
+        block_id = *free_blocks.begin();
+        free_blocks.erase(free_blocks.begin());
+        block_reuses++;
+    }
+    else {
+        block_id = next_block_id;
 
-    // 关键修复：确保block ID在有效范围内
-    if (block_id >= capacity) {
-        std::cerr << "ERROR: Block ID " << block_id << " exceeds ORAM capacity " << capacity << std::endl;
-        throw std::runtime_error("ORAM capacity exceeded");
+        // 关键修复：确保block ID在有效范围内
+        if (block_id >= capacity) {
+            std::cerr << "ERROR: Block ID " << block_id << " exceeds ORAM capacity " << capacity
+                      << " (" << live_blocks << " blocks in use)" << std::endl;
+            throw std::runtime_error("ORAM capacity exceeded");
+        }
+        next_block_id++;
+        if (block_in_use.size() < static_cast<size_t>(next_block_id)) {
+            block_in_use.resize(next_block_id, 0);
+        }
     }
 
+    block_in_use[block_id] = 1;
+    live_blocks++;
+    block_allocations++;
     return block_id;
 }
 
+void RingOramStorage::releaseBlock(int block_id) {
+    if (block_id < 0 || block_id >= next_block_id || !block_in_use[block_id]) {
+        std::cerr << "ERROR: Releasing block " << block_id << " which is not allocated" << std::endl;
+        return;
+    }
 
-bool RingOramStorage::storeNode(int node_id, const std::vector<uint8_t>& data) {
-    try {
+    block_in_use[block_id] = 0;
+    live_blocks--;
+    block_releases++;
+    free_blocks.insert(block_id);
+
+    // 已分配区间末尾的空闲块直接退回，next_block_id 回落
+    while (!free_blocks.empty() && *free_blocks.rbegin() == next_block_id - 1) {
+        free_blocks.erase(std::prev(free_blocks.end()));
+        next_block_id--;
+    }
+}
+
+void RingOramStorage::rebuildBlockUsage() {
+    block_in_use.assign(next_block_id, 0);
+    block_node.assign(next_block_id, -1);
+    auto mark = [this](int block_id) {
+        if (block_id >= 0 && block_id < next_block_id) {
+            block_in_use[block_id] = 1;
+        }
+    };
+    for (const auto& pair : node_id_to_block) {
+        mark(pair.second);
+        if (pair.second >= 0 && pair.second < next_block_id) {
+            block_node[pair.second] = pair.first;
+        }
+    }
+    for (const auto& pair : doc_id_to_block) {
+        mark(pair.second);
+    }
+    mark(root_path_block_index);
 
-        int block_id = getNextBlockId();
-        node_id_to_block[node_id] = block_id;
+    free_blocks.clear();
+    live_blocks = 0;
+    for (int block_id = 0; block_id < next_block_id; block_id++) {
+        if (block_in_use[block_id]) {
+            live_blocks++;
+        }
+        else {
+            free_blocks.insert(free_blocks.end(), block_id);
+        }
+    }
+    while (!free_blocks.empty() && *free_blocks.rbegin() == next_block_id - 1) {
+        free_blocks.erase(std::prev(free_blocks.end()));
+        next_block_id--;
+    }
+    block_in_use.resize(next_block_id);
+    block_node.resize(next_block_id);
+}
 
-        std::vector<char> data_vec(data.begin(), data.end());
+bool RingOramStorage::storeNode(int node_id, const std::vector<uint8_t>& data) {
+    try {
 
+        // 节点重写时沿用原来的块（通常在父节点登记子节点时已经分配）
+        int block_id = allocateNodeBlock(node_id);
 
+        // 可选压缩：压缩后填充到固定档位再交给 ORAM 加密
+        std::vector<char> data_vec;
+        if (!encodeBlock(data, data_vec)) {
+            std::cerr << "Node " << node_id << " does not fit the node size class" << std::endl;
+            return false;
+        }
+        node_raw_bytes += data.size();
+        node_stored_bytes += data_vec.size();
+
+        if (ods_mode) {
+            std::lock_guard<std::mutex> lock(oram_mutex);
+
+            // 本次会话中读出或写入过的节点块在 stash 中，直接替换内容，不访问服务器
+            if (session_leaves.count(block_id)) {
+                return oram->updatePinned(block_id, data_vec);
+            }
+            if (isOdsBlock(block_id)) {
+                std::cerr << "Node " << node_id << " must be read through its parent before it is rewritten" << std::endl;
+                return false;
+            }
+
+            // 新节点：写入后放到新叶子并固定，叶子在会话结束前写入父节点
+            int leaf = oram->randomLeaf();
+            touched_block_limit = std::max(touched_block_limit, block_id + 1);
+            oram->access(block_id, ringoram::WRITE, data_vec, -1, leaf, true);
+            session_leaves[block_id] = leaf;
+            setOdsBlock(block_id, true);
+            return true;
+        }
 
-        oram->access(block_id, ringoram::WRITE, data_vec);
+        oramAccess(block_id, ringoram::WRITE, data_vec);
 
 
 
@@ -68,13 +238,17 @@ std::vector<uint8_t> RingOramStorage::readNode(int node_id) {
         }
 
         int block_id = block_it->second;
+        if (ods_mode) {
+            // 叶子只能来自会话或父节点：按节点 ID 读取只适用于会话中的块和仍由位置映射管理的块
+            return readNodeBlock(block_id);
+        }
 
 
 
         std::vector<char> result_data;
 
 
-        result_data = oram->access(block_id, ringoram::READ, {});
+        result_data = oramAccess(block_id, ringoram::READ, {});
 
 
 
@@ -83,7 +257,9 @@ std::vector<uint8_t> RingOramStorage::readNode(int node_id) {
         }
 
         std::vector<uint8_t> vec_uint8(result_data.begin(), result_data.end());
-        return vec_uint8;
+
+        // 带编码头的块需要解压，未压缩写入的块原样返回
+        return BlockCodec::decode(vec_uint8);
     }
     catch (const std::exception& e) {
         std::cerr << "Error reading node " << node_id << ": " << e.what() << std::endl;
@@ -97,14 +273,33 @@ bool RingOramStorage::deleteNode(int node_id) {
         if (it != node_id_to_block.end()) {
             int block_id = it->second;
 
+            bool discarded = false;
+            if (ods_mode) {
+                std::lock_guard<std::mutex> lock(oram_mutex);
+                if (session_leaves.erase(block_id)) {
+                    // 会话中的节点块只在 stash 中，直接移除
+                    oram->discardPinned(block_id);
+                    discarded = true;
+                }
+                else if (isOdsBlock(block_id)) {
+                    std::cerr << "Node " << node_id << " must be read through its parent before it is deleted" << std::endl;
+                    return false;
+                }
+                setOdsBlock(block_id, false);
+            }
+
             // 从ORAM中删除：写入空数据
             std::vector<char> empty_data;
 
-            oram->access(block_id, ringoram::WRITE, empty_data);
+            if (!discarded) {
+                oramAccess(block_id, ringoram::WRITE, empty_data);
+            }
 
 
-            // 清理映射和缓存
+            // 清理映射，块 ID 留待复用
             node_id_to_block.erase(it);
+            block_node[block_id] = -1;
+            releaseBlock(block_id);
 
             return true;
         }
@@ -119,7 +314,16 @@ bool RingOramStorage::deleteNode(int node_id) {
 bool RingOramStorage::storeDocument(int doc_id, const std::vector<uint8_t>& data) {
     try {
 
-        std::vector<char> processed_data(data.begin(), data.end());
+        // 开启压缩时文档块与节点块填充到同一个固定档位，密文等长；
+        // 未开启压缩时块按原始长度加密，服务器仍可从密文长度区分两者
+        std::vector<char> processed_data;
+        if (!encodeBlock(data, processed_data)) {
+            std::cerr << "Document " << doc_id << " does not fit the node size class" << std::endl;
+            return false;
+        }
+        doc_raw_bytes += data.size();
+        doc_stored_bytes += processed_data.size();
+
         int block_id;
         auto it = doc_id_to_block.find(doc_id);
         if (it != doc_id_to_block.end()) {
@@ -140,7 +344,7 @@ bool RingOramStorage::storeDocument(int doc_id, const std::vector<uint8_t>& data
 
 
 
-        result = oram->access(block_id, ringoram::WRITE, oram_data);
+        result = oramAccess(block_id, ringoram::WRITE, oram_data);
 
 
         return !result.empty();
@@ -168,7 +372,7 @@ std::vector<uint8_t> RingOramStorage::readDocument(int doc_id) {
         std::vector<char> result;
 
 
-        result = oram->access(block_id, ringoram::READ,{});
+        result = oramAccess(block_id, ringoram::READ,{});
 
 
         if (result.empty()) {
@@ -178,7 +382,7 @@ std::vector<uint8_t> RingOramStorage::readDocument(int doc_id) {
         std::vector<uint8_t> data(result.begin(), result.end());
 
 
-        return data;
+        return BlockCodec::decode(data);
     }
     catch (const std::exception& e) {
         std::cerr << "Error reading document " << doc_id << ": " << e.what() << std::endl;
@@ -186,6 +390,52 @@ std::vector<uint8_t> RingOramStorage::readDocument(int doc_id) {
     }
 }
 
+bool RingOramStorage::deleteDocument(int doc_id) {
+    try {
+        auto it = doc_id_to_block.find(doc_id);
+        if (it == doc_id_to_block.end()) {
+            return false;
+        }
+
+        // 与删除节点相同：写入空数据后释放块
+        int block_id = it->second;
+        oramAccess(block_id, ringoram::WRITE, {});
+        doc_id_to_block.erase(it);
+        releaseBlock(block_id);
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error deleting document " << doc_id << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+std::vector<std::vector<uint8_t>> RingOramStorage::batchReadDocuments(const std::vector<int>& doc_ids, int pad_to) {
+    std::vector<std::vector<uint8_t>> results(doc_ids.size());
+
+    // 未存储的文档以 -1 占位（按 dummy 读取），读取次数不因缺失而变化
+    std::vector<int> block_ids(doc_ids.size(), -1);
+    for (size_t i = 0; i < doc_ids.size(); i++) {
+        auto it = doc_id_to_block.find(doc_ids[i]);
+        if (it != doc_id_to_block.end()) {
+            block_ids[i] = it->second;
+        }
+    }
+
+    try {
+        std::vector<std::vector<char>> blocks = oramBatchAccess(block_ids, pad_to);
+        for (size_t i = 0; i < doc_ids.size(); i++) {
+            if (blocks[i].empty()) continue;
+            std::vector<uint8_t> vec_uint8(blocks[i].begin(), blocks[i].end());
+            results[i] = BlockCodec::decode(vec_uint8);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error in batch document read: " << e.what() << std::endl;
+    }
+    return results;
+}
+
 bool RingOramStorage::batchStoreNodes(const std::vector<std::pair<int, std::vector<uint8_t>>>& nodes) {
     bool all_success = true;
 
@@ -201,34 +451,278 @@ bool RingOramStorage::batchStoreNodes(const std::vector<std::pair<int, std::vect
     return all_success;
 }
 
-std::vector<uint8_t> RingOramStorage::accessByPath(int path) {
+bool RingOramStorage::bulkStore(const std::vector<std::pair<int, std::vector<uint8_t>>>& nodes,
+                                const std::vector<std::pair<int, std::vector<uint8_t>>>& documents, int threads,
+                                const std::vector<int>* node_leaves) {
+    bool all_success = true;
+    if (node_leaves && node_leaves->size() != nodes.size()) {
+        std::cerr << "bulkStore: " << nodes.size() << " nodes but " << node_leaves->size() << " leaves" << std::endl;
+        return false;
+    }
+
+    // 新块串行分配块号（节点的块可能在父节点登记子节点时已经分配）。
+    // 已有块的重写与复用的已释放块走普通写入：bulkLoad 只接受从未写入 ORAM 的块
+    std::vector<int> block_ids;
+    std::vector<const std::vector<uint8_t>*> sources;
+    std::vector<int> leaves;
+    size_t node_count = 0;
     try {
+        for (int pass = 0; pass < 2; pass++) {
+            const auto& items = pass == 0 ? nodes : documents;
+            for (size_t i = 0; i < items.size(); i++) {
+                const auto& item = items[i];
+                int block_id;
+                if (pass == 0) {
+                    block_id = allocateNodeBlock(item.first);
+                }
+                else {
+                    auto it = doc_id_to_block.find(item.first);
+                    if (it != doc_id_to_block.end()) {
+                        block_id = it->second;
+                    }
+                    else {
+                        block_id = getNextBlockId();
+                        doc_id_to_block[item.first] = block_id;
+                    }
+                }
+                bool ods_node = pass == 0 && node_leaves;
+                if (block_id < touched_block_limit) {
+                    bool stored = ods_node ? storeNodeAt(block_id, item.second, (*node_leaves)[i])
+                        : pass == 0 ? storeNode(item.first, item.second) : storeDocument(item.first, item.second);
+                    all_success = stored && all_success;
+                    continue;
+                }
+                block_ids.push_back(block_id);
+                sources.push_back(&item.second);
+                if (ods_node) {
+                    leaves.push_back((*node_leaves)[i]);
+                }
+            }
+            if (pass == 0) {
+                node_count = block_ids.size();
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error allocating blocks for bulk store: " << e.what() << std::endl;
+        return false;
+    }
+
+    // 压缩并填充到固定档位（与 storeNode / storeDocument 相同）
+    std::vector<std::vector<char>> payloads(block_ids.size());
+    std::vector<uint8_t> encoded_ok(block_ids.size(), 0);
+    parallelFor(block_ids.size(), threads, [&](size_t i) {
+        encoded_ok[i] = encodeBlock(*sources[i], payloads[i]);
+    });
+    for (size_t i = 0; i < block_ids.size(); i++) {
+        if (!encoded_ok[i]) {
+            std::cerr << "bulkStore: " << (i < node_count ? "node" : "document") << " block " << block_ids[i]
+                      << " does not fit the node size class" << std::endl;
+            return false;
+        }
+    }
+    for (size_t i = 0; i < block_ids.size(); i++) {
+        if (i < node_count) {
+            node_raw_bytes += sources[i]->size();
+            node_stored_bytes += payloads[i].size();
+        }
+        else {
+            doc_raw_bytes += sources[i]->size();
+            doc_stored_bytes += payloads[i].size();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(oram_mutex);
+    for (int block_id : block_ids) {
+        touched_block_limit = std::max(touched_block_limit, block_id + 1);
+    }
+    if (!node_leaves) {
+        return oram->bulkLoad(block_ids, payloads, threads) && all_success;
+    }
+
+    // 文档块仍按位置映射放置（bulkLoad 的叶子参数须与块一一对应）
+    for (size_t i = 0; i < node_count; i++) {
+        setOdsBlock(block_ids[i], true);
+    }
+    for (size_t i = node_count; i < block_ids.size(); i++) {
+        leaves.push_back(oram->positionmap[block_ids[i]]);
+    }
+    return oram->bulkLoad(block_ids, payloads, threads, &leaves) && all_success;
+}
 
+std::vector<uint8_t> RingOramStorage::readNodeBlock(int block_id, int leaf) {
+    if (getNodeIdByBlock(block_id) == -1) {
+        std::cerr << "Block " << block_id << " does not hold a tree node" << std::endl;
+        return {};
+    }
 
-        // 通过路径获取块索引
-        int block_index = getBlockIndexByPath(path);
-        if (block_index == -1) {
-            std::cerr << "No block index allocated for path " << path << std::endl;
+    try {
+        std::vector<char> result_data;
+        if (ods_mode) {
+            // 读取后换到新叶子并固定在 stash 中，新叶子由调用方写入父节点
+            std::lock_guard<std::mutex> lock(oram_mutex);
+            int old_leaf;
+            if (!odsReadLeaf(block_id, leaf, old_leaf)) {
+                std::cerr << "Leaf of node block " << block_id << " is unknown" << std::endl;
+                return {};
+            }
+            int new_leaf = oram->randomLeaf();
+            touched_block_limit = std::max(touched_block_limit, block_id + 1);
+            result_data = oram->access(block_id, ringoram::READ, {}, old_leaf, new_leaf, true);
+            session_leaves[block_id] = new_leaf;
+            setOdsBlock(block_id, true);
+        }
+        else {
+            result_data = oramAccess(block_id, ringoram::READ, {});
+        }
+        if (result_data.empty()) {
             return {};
         }
+        std::vector<uint8_t> vec_uint8(result_data.begin(), result_data.end());
+        return BlockCodec::decode(vec_uint8);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error reading node block " << block_id << ": " << e.what() << std::endl;
+        return {};
+    }
+}
 
-        // 使用原有的节点访问机制 - 这会调用 oram->access(block_index, ...)
-        // 查找节点ID
-        int node_id = getNodeIdByPath(path);
-        if (node_id == -1) {
-            std::cerr << "No node ID mapped to path " << path << std::endl;
-            return {};
+std::vector<std::vector<uint8_t>> RingOramStorage::batchReadNodeBlocks(const std::vector<int>& block_ids, int pad_to,
+                                                                       const std::vector<int>* leaves) {
+    std::vector<std::vector<uint8_t>> results(block_ids.size());
+
+    // 不是节点块的位置以 -1 占位（按 dummy 读取）
+    std::vector<int> reads(block_ids.size(), -1);
+    for (size_t i = 0; i < block_ids.size(); i++) {
+        if (getNodeIdByBlock(block_ids[i]) != -1) {
+            reads[i] = block_ids[i];
+        }
+        else {
+            std::cerr << "Block " << block_ids[i] << " does not hold a tree node" << std::endl;
+        }
+    }
+
+    try {
+        std::vector<std::vector<char>> blocks = ods_mode ? odsBatchRead(reads, pad_to, leaves) : oramBatchAccess(reads, pad_to);
+        for (size_t i = 0; i < block_ids.size(); i++) {
+            if (blocks[i].empty()) continue;
+            std::vector<uint8_t> vec_uint8(blocks[i].begin(), blocks[i].end());
+            results[i] = BlockCodec::decode(vec_uint8);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error in batch node block read: " << e.what() << std::endl;
+    }
+    return results;
+}
+
+// ==============================
+// 不可知数据结构（ODS）模式
+// ==============================
+
+void RingOramStorage::setOdsBlock(int block_id, bool managed) {
+    if (block_id < 0) {
+        return;
+    }
+    if (block_ods.size() <= static_cast<size_t>(block_id)) {
+        if (!managed) {
+            return;
+        }
+        block_ods.resize(block_id + 1, 0);
+    }
+    block_ods[block_id] = managed ? 1 : 0;
+}
+
+bool RingOramStorage::odsReadLeaf(int block_id, int leaf, int& old_leaf) const {
+    auto it = session_leaves.find(block_id);
+    if (it != session_leaves.end()) {
+        old_leaf = it->second;
+        return true;
+    }
+    if (isOdsBlock(block_id)) {
+        old_leaf = leaf;
+        return leaf >= 0;
+    }
+    old_leaf = -1;
+    return true;
+}
+
+std::vector<std::vector<char>> RingOramStorage::odsBatchRead(std::vector<int>& reads, int pad_to,
+                                                            const std::vector<int>* leaves) {
+    std::lock_guard<std::mutex> lock(oram_mutex);
+
+    // 重复的块给出相同的旧叶子与新叶子；叶子未知的块改为 dummy 读取
+    std::vector<int> old_leaves(reads.size(), -1), new_leaves(reads.size(), -1);
+    std::unordered_map<int, int> assigned;
+    for (size_t i = 0; i < reads.size(); i++) {
+        if (reads[i] == -1) continue;
+        int old_leaf;
+        if (!odsReadLeaf(reads[i], leaves ? (*leaves)[i] : -1, old_leaf)) {
+            std::cerr << "Leaf of node block " << reads[i] << " is unknown" << std::endl;
+            reads[i] = -1;
+            continue;
+        }
+        auto it = assigned.find(reads[i]);
+        if (it == assigned.end()) {
+            it = assigned.emplace(reads[i], oram->randomLeaf()).first;
         }
+        old_leaves[i] = old_leaf;
+        new_leaves[i] = it->second;
+        touched_block_limit = std::max(touched_block_limit, reads[i] + 1);
+    }
 
-        return readNode(node_id);
+    std::vector<std::vector<char>> blocks = oram->batchAccess(reads, old_leaves, new_leaves, pad_to, true);
+    for (const auto& pair : assigned) {
+        session_leaves[pair.first] = pair.second;
+        setOdsBlock(pair.first, true);
+    }
+    return blocks;
+}
+
+bool RingOramStorage::storeNodeAt(int block_id, const std::vector<uint8_t>& data, int leaf) {
+    try {
+        std::vector<char> data_vec;
+        if (!encodeBlock(data, data_vec)) {
+            std::cerr << "Node block " << block_id << " does not fit the node size class" << std::endl;
+            return false;
+        }
+        node_raw_bytes += data.size();
+        node_stored_bytes += data_vec.size();
 
+        std::lock_guard<std::mutex> lock(oram_mutex);
+        if (session_leaves.erase(block_id)) {
+            oram->discardPinned(block_id);
+        }
+        else if (isOdsBlock(block_id)) {
+            std::cerr << "Node block " << block_id << " must be read through its parent before it is rewritten" << std::endl;
+            return false;
+        }
+        touched_block_limit = std::max(touched_block_limit, block_id + 1);
+        oram->access(block_id, ringoram::WRITE, data_vec, -1, leaf, false);
+        setOdsBlock(block_id, true);
+        return true;
     }
     catch (const std::exception& e) {
-        std::cerr << "Error accessing path " << path << ": " << e.what() << std::endl;
-        return {};
+        std::cerr << "Error storing node block " << block_id << ": " << e.what() << std::endl;
+        return false;
     }
 }
 
+int RingOramStorage::randomLeaf() {
+    std::lock_guard<std::mutex> lock(oram_mutex);
+    return oram->randomLeaf();
+}
+
+void RingOramStorage::endNodeSession() {
+    std::lock_guard<std::mutex> lock(oram_mutex);
+    oram->unpinAll();
+    session_leaves.clear();
+}
+
+int RingOramStorage::getOdsBlockCount() const {
+    return static_cast<int>(std::count(block_ods.begin(), block_ods.end(), 1));
+}
+
 // 设置根节点路径
 void RingOramStorage::setRootPath(int path) {
     root_path = path;
@@ -264,7 +758,7 @@ void RingOramStorage::persistRootPath() {
 
         // 存储到ORAM
         std::vector<char> data_vec(root_path_data.begin(), root_path_data.end());
-        oram->access(root_path_block_index, ringoram::WRITE, data_vec);
+        oramAccess(root_path_block_index, ringoram::WRITE, data_vec);
 
     }
     catch (const std::exception& e) {
@@ -282,7 +776,7 @@ void RingOramStorage::loadRootPath() {
         }
 
         // 从ORAM读取根路径数据
-        std::vector<char> result_data = oram->access(root_path_block_index, ringoram::READ, {});
+        std::vector<char> result_data = oramAccess(root_path_block_index, ringoram::READ, {});
         if (result_data.size() >= sizeof(int)) {
             memcpy(&root_path, result_data.data(), sizeof(int));
 
@@ -299,17 +793,57 @@ void RingOramStorage::loadRootPath() {
     }
 }
 
-int RingOramStorage::allocateBlockForPath(int path) {
-    int block_index = getNextBlockId();
-    path_to_block_index[path] = block_index;
-    block_index_to_path[block_index] = path;
+int RingOramStorage::allocateNodeBlock(int node_id) {
+    auto it = node_id_to_block.find(node_id);
+    if (it != node_id_to_block.end()) {
+        return it->second;
+    }
 
-    return block_index;
+    int block_id = getNextBlockId();
+    node_id_to_block[node_id] = block_id;
+    if (block_node.size() <= static_cast<size_t>(block_id)) {
+        block_node.resize(block_id + 1, -1);
+    }
+    block_node[block_id] = node_id;
+    return block_id;
 }
 
-int RingOramStorage::getBlockIndexByPath(int path) const {
-    auto it = path_to_block_index.find(path);
-    return (it != path_to_block_index.end()) ? it->second : -1;
+void RingOramStorage::setNodeCompression(bool enabled, size_t size_class) {
+    compress_nodes = enabled;
+    node_size_class = size_class;
+}
+
+bool RingOramStorage::encodeBlock(const std::vector<uint8_t>& data, std::vector<char>& out) const {
+    if (!compress_nodes) {
+        out.assign(data.begin(), data.end());
+        return true;
+    }
+    std::vector<uint8_t> encoded = BlockCodec::encode(data, node_size_class);
+    if (encoded.empty()) {
+        return false;
+    }
+    out.assign(encoded.begin(), encoded.end());
+    return true;
+}
+
+size_t RingOramStorage::getNodeBlockBytes() const {
+    return compress_nodes ? node_size_class : static_cast<size_t>(blocksize);
+}
+
+void RingOramStorage::printCompressionStats() const {
+    std::cout << "=== Node Compression ===" << std::endl;
+    std::cout << "Enabled: " << (compress_nodes ? "yes" : "no")
+              << ", size class: " << node_size_class << " bytes" << std::endl;
+    std::cout << "Raw node bytes: " << node_raw_bytes
+              << ", stored bytes: " << node_stored_bytes;
+    if (node_stored_bytes > 0) {
+        std::cout << " (ratio " << static_cast<double>(node_raw_bytes) / node_stored_bytes << ")";
+    }
+    std::cout << std::endl;
+    if (doc_stored_bytes > 0) {
+        std::cout << "Raw document bytes: " << doc_raw_bytes
+                  << ", stored bytes: " << doc_stored_bytes << std::endl;
+    }
 }
 
 int RingOramStorage::getStoredNodeCount() const {
@@ -325,6 +859,7 @@ void RingOramStorage::printStorageStats() const {
     std::cout << "Total nodes stored: " << getStoredNodeCount() << std::endl;
     std::cout << "Total documents stored: " << getStoredDocumentCount() << std::endl;
     std::cout << "Next block ID: " << next_block_id << std::endl;
+    std::cout << "Free blocks: " << free_blocks.size() << std::endl;
     std::cout << "ORAM capacity: " << capacity << std::endl;
 
 
@@ -334,4 +869,188 @@ void RingOramStorage::printStorageStats() const {
     for (const auto& pair : node_id_to_block) {
         std::cout << "  Node " << pair.first << " -> Block " << pair.second << std::endl;
     }
-}
\ No newline at end of file
+}
+
+RingOramStorage::BlockStats RingOramStorage::getBlockStats() const {
+    BlockStats stats;
+    stats.capacity = capacity;
+    stats.high_water = next_block_id;
+    stats.live = live_blocks;
+    stats.free = static_cast<int>(free_blocks.size());
+    stats.allocations = block_allocations;
+    stats.reuses = block_reuses;
+    stats.releases = block_releases;
+
+    // 核对引用：标记为已引用的块都应被某个映射（或根路径块）引用
+    std::vector<uint8_t> referenced(next_block_id, 0);
+    auto mark = [&referenced](int block_id) {
+        if (block_id >= 0 && block_id < static_cast<int>(referenced.size())) {
+            referenced[block_id] = 1;
+        }
+    };
+    for (const auto& pair : node_id_to_block) {
+        mark(pair.second);
+    }
+    for (const auto& pair : doc_id_to_block) {
+        mark(pair.second);
+    }
+    mark(root_path_block_index);
+    for (int block_id = 0; block_id < next_block_id; block_id++) {
+        if (block_in_use[block_id] && !referenced[block_id]) {
+            stats.unreferenced++;
+        }
+    }
+
+    for (const auto& pair : node_id_to_block) {
+        if (getNodeIdByBlock(pair.second) != pair.first) {
+            stats.mismatched++;
+        }
+        if (isOdsBlock(pair.second)) {
+            stats.ods_nodes++;
+        }
+    }
+    for (int block_id = 0; block_id < static_cast<int>(block_node.size()); block_id++) {
+        int node_id = block_node[block_id];
+        if (node_id != -1) {
+            auto it = node_id_to_block.find(node_id);
+            if (it == node_id_to_block.end() || it->second != block_id) {
+                stats.mismatched++;
+            }
+        }
+    }
+    return stats;
+}
+
+void RingOramStorage::printBlockStats() const {
+    BlockStats stats = getBlockStats();
+    double used = stats.high_water > 0 ? 100.0 * stats.live / stats.high_water : 100.0;
+    std::cout << "=== ORAM Block Allocation ===" << std::endl;
+    std::cout << "Blocks in use: " << stats.live << " / allocated range " << stats.high_water
+              << " / capacity " << stats.capacity << " (" << std::fixed << std::setprecision(1)
+              << used << "% of allocated range used)" << std::endl;
+    std::cout << "Free blocks (holes): " << stats.free << ", reclaimable by compaction: "
+              << (stats.high_water - stats.live) << std::endl;
+    std::cout << "Allocations: " << stats.allocations << " (" << stats.reuses << " reused), releases: "
+              << stats.releases << std::endl;
+    if (stats.unreferenced > 0 || stats.mismatched > 0) {
+        std::cout << "WARNING: " << stats.unreferenced << " allocated blocks not referenced by any node or document, "
+                  << stats.mismatched << " node blocks with inconsistent block mapping" << std::endl;
+    }
+    if (ods_mode) {
+        // ODS 管理的节点块不再需要位置映射项，客户端只保存根节点块的叶子
+        std::cout << "ODS mode: " << stats.ods_nodes << " of " << node_id_to_block.size()
+                  << " node blocks located through parent nodes (no client position map entries), root leaf "
+                  << root_leaf << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
+
+// ==============================
+// 快照与服务器存储文件
+// ==============================
+
+void RingOramStorage::saveState(SnapshotWriter& writer) {
+    std::lock_guard<std::mutex> lock(oram_mutex);
+
+    writer.beginSection(kStorageSectionTag);
+    writer.putI32(capacity);
+    writer.putI32(next_block_id);
+    writer.putI32(root_path);
+    writer.putI32(root_path_block_index);
+    writer.putBool(compress_nodes);
+    writer.putU64(node_size_class);
+    writer.putU64(node_raw_bytes);
+    writer.putU64(node_stored_bytes);
+    writer.putU64(doc_raw_bytes);
+    writer.putU64(doc_stored_bytes);
+    putMap(writer, node_id_to_block);
+    putMap(writer, doc_id_to_block);
+    writer.putI32(touched_block_limit);
+    writer.putI32(root_leaf);
+    writer.putArray(block_ods);
+    writer.endSection();
+
+    oram->saveState(writer);
+}
+
+bool RingOramStorage::loadState(SnapshotReader& reader) {
+    std::lock_guard<std::mutex> lock(oram_mutex);
+
+    if (!reader.beginSection(kStorageSectionTag)) {
+        std::cerr << "Error: Storage state missing from snapshot" << std::endl;
+        return false;
+    }
+    int saved_capacity = reader.getI32();
+    if (!reader.ok() || saved_capacity != capacity) {
+        std::cerr << "Error: Snapshot storage capacity " << saved_capacity
+                  << " does not match " << capacity << std::endl;
+        return false;
+    }
+
+    int saved_next_block = reader.getI32();
+    int saved_root_path = reader.getI32();
+    int saved_root_block = reader.getI32();
+    bool saved_compress = reader.getBool();
+    size_t saved_size_class = static_cast<size_t>(reader.getU64());
+    uint64_t saved_stats[4];
+    for (auto& value : saved_stats) {
+        value = reader.getU64();
+    }
+    std::unordered_map<int, int> saved_nodes, saved_docs;
+    getMap(reader, saved_nodes);
+    getMap(reader, saved_docs);
+    int saved_touched_limit = reader.getI32();
+    int saved_root_leaf = reader.getI32();
+    std::vector<uint8_t> saved_ods;
+    reader.getArray(saved_ods);
+    if (!reader.endSection() || saved_next_block < 0 || saved_next_block > capacity) {
+        std::cerr << "Error: Corrupt storage state in snapshot" << std::endl;
+        return false;
+    }
+
+    // 位置映射模式的快照可以在 ODS 模式下使用（节点块第一次读取时转为 ODS 管理），反之不行
+    if (!ods_mode && std::count(saved_ods.begin(), saved_ods.end(), 1) > 0) {
+        std::cerr << "Error: Snapshot locates node blocks through their parents; enable ODS mode to use it" << std::endl;
+        return false;
+    }
+
+    if (!oram->loadState(reader)) {
+        return false;
+    }
+
+    next_block_id = saved_next_block;
+    root_path = saved_root_path;
+    root_path_block_index = saved_root_block;
+    compress_nodes = saved_compress;
+    node_size_class = saved_size_class;
+    node_raw_bytes = saved_stats[0];
+    node_stored_bytes = saved_stats[1];
+    doc_raw_bytes = saved_stats[2];
+    doc_stored_bytes = saved_stats[3];
+    node_id_to_block.swap(saved_nodes);
+    doc_id_to_block.swap(saved_docs);
+    touched_block_limit = saved_touched_limit;
+    root_leaf = saved_root_leaf;
+    block_ods.swap(saved_ods);
+    session_leaves.clear();
+
+    // 空闲列表与块到节点的反向映射不保存，由映射表重新得出
+    rebuildBlockUsage();
+    return true;
+}
+
+bool RingOramStorage::saveServerStore(uint64_t token) {
+    std::lock_guard<std::mutex> lock(oram_mutex);
+    return oram->saveServerStore(token);
+}
+
+bool RingOramStorage::getServerStoreToken(uint64_t& token) {
+    std::lock_guard<std::mutex> lock(oram_mutex);
+    return oram->getServerStoreToken(token);
+}
+
+bool RingOramStorage::resetServerStore() {
+    std::lock_guard<std::mutex> lock(oram_mutex);
+    return oram->resetServerStore();
+}
+
@@ -6,6 +6,8 @@
 #include "ServerStorage.h"
 #include "CryptoUtil.h"
 #include <memory>
+#include <mutex>
+#include <set>
 #include <unordered_map>
 #include <vector>
 #include <iostream>
@@ -29,6 +31,10 @@ private:
     /// 非递归 Path ORAM 实例
     std::unique_ptr<ringoram> oram;
 
+    /// ORAM 访问锁：ringoram 的 stash、位置图和网络缓冲区都不是线程安全的，
+    /// 并发查询的 ORAM 访问在这里排队串行执行（解码等计算在锁外进行）
+    std::mutex oram_mutex;
+
 
     /// 加密工具类（用于数据加解密）
     std::shared_ptr<CryptoUtils> crypto;
@@ -38,45 +44,143 @@ private:
     /// 节点 ID -> ORAM 块 ID 映射表
     std::unordered_map<int, int> node_id_to_block;
 
+    /// ORAM 块 ID -> 节点 ID（不存放节点的块为 -1），父节点以块号指向子节点，读取时据此核对
+    std::vector<int> block_node;
+
     /// 文档 ID -> ORAM 块 ID 映射表
     std::unordered_map<int, int> doc_id_to_block;
 
 
 
-    /// 下一个可分配的块 ID
+    /// 下一个未分配过的块 ID：[0, next_block_id) 之外的块从未使用，即 ORAM 实际需要的容量
     int next_block_id;
 
+    /// 已释放、可重新分配的块 ID（删除的节点与文档）。getNextBlockId 优先复用最小的，
+    /// 已分配区间的最高块被释放时 next_block_id 随之回落
+    std::set<int> free_blocks;
+
+    /// 各块当前是否被引用（节点、文档或根路径块），重复释放或释放未分配的块时报错而不破坏空闲列表
+    std::vector<uint8_t> block_in_use;
+
+    /// 被引用的块数
+    int live_blocks;
+
+    /// 访问过 ORAM 的最大块 ID + 1：之下的块可能已有内容在 ORAM 中（包括已释放的块），
+    /// 不能再交给 ringoram::bulkLoad（要求块从未写入）
+    int touched_block_limit;
+
+    /// 累计分配次数、其中复用空闲块的次数、累计释放次数
+    uint64_t block_allocations;
+    uint64_t block_reuses;
+    uint64_t block_releases;
+
+    /// 不可知数据结构（ODS）模式：节点块的叶子保存在父节点中（根节点块的叶子为 root_leaf），
+    /// 节点块读写时由调用方给出叶子，位置映射中节点块的项不再使用
+    bool ods_mode;
+
+    /// 根节点块当前所在的叶子，-1 表示根节点块仍由位置映射管理
+    int root_leaf;
+
+    /// 各块的叶子是否由父节点保存（ODS 管理），为 1 时位置映射中的项已失效
+    std::vector<uint8_t> block_ods;
+
+    /// 本次节点会话中读出或新写入的节点块 -> 当前叶子；这些块固定在 stash 中，
+    /// 会话结束时新叶子已写回父节点（见 endNodeSession）
+    std::unordered_map<int, int> session_leaves;
+
     /// ORAM 容量（块数量）
     int capacity;
 
     std::string server_ip_;
     int server_port_;
 
+    /// 节点块是否经过 BlockCodec 压缩与填充
+    bool compress_nodes;
+
+    /// 压缩后节点块的大小档位（字节）
+    size_t node_size_class;
+
+    /// 写入节点的原始字节数 / 实际写入 ORAM 的字节数
+    uint64_t node_raw_bytes;
+    uint64_t node_stored_bytes;
+
+    /// 写入文档的原始字节数 / 实际写入 ORAM 的字节数
+    uint64_t doc_raw_bytes;
+    uint64_t doc_stored_bytes;
+
 
     // ==============================
     // 内部辅助函数
     // ==============================
 
     /**
-     * @brief 获取下一个未使用的 ORAM 块 ID
+     * @brief 分配一个 ORAM 块 ID 并标记为已引用（优先复用已释放的块）
      * @return int 新的块 ID
      */
     int getNextBlockId();
 
-    /// 根节点路径存储
-    int root_path;
+    /**
+     * @brief 释放块 ID，之后可被重新分配
+     */
+    void releaseBlock(int block_id);
 
-    /// 根节点路径的块索引（用于在ORAM中存储根路径）
-    int root_path_block_index;
+    /**
+     * @brief 按节点、文档映射与根路径块重新计算块引用与块到节点的反向映射，
+     *        [0, next_block_id) 中其余的块进入空闲列表（恢复快照后调用）
+     */
+    void rebuildBlockUsage();
+
+    /**
+     * @brief 按当前压缩设置生成写入 ORAM 的块数据
+     * @return 开启压缩且块超出大小档位时返回 false
+     */
+    bool encodeBlock(const std::vector<uint8_t>& data, std::vector<char>& out) const;
+
+    /**
+     * @brief 持有 ORAM 访问锁执行一次 ORAM 访问
+     */
+    std::vector<char> oramAccess(int block_id, ringoram::Operation op, const std::vector<char>& data);
+
+    /**
+     * @brief 带叶子参数的 ORAM 访问（见 ringoram 带叶子参数的 access）
+     */
+    std::vector<char> oramAccess(int block_id, ringoram::Operation op, const std::vector<char>& data,
+                                 int old_leaf, int new_leaf, bool pin);
 
-    /// 路径到节点ID的映射（用于调试和验证）
-    std::unordered_map<int, int> path_to_node_id;
+    /**
+     * @brief 持有 ORAM 访问锁执行一次批量读取（见 ringoram::batchAccess）
+     */
+    std::vector<std::vector<char>> oramBatchAccess(const std::vector<int>& block_ids, int pad_to);
+
+    /// 块的叶子是否由父节点保存
+    bool isOdsBlock(int block_id) const {
+        return block_id >= 0 && block_id < static_cast<int>(block_ods.size()) && block_ods[block_id];
+    }
+
+    void setOdsBlock(int block_id, bool managed);
+
+    /**
+     * @brief ODS 模式下按给定叶子写入节点块（不固定），批量建树中不能走 bulkLoad 的节点使用
+     */
+    bool storeNodeAt(int block_id, const std::vector<uint8_t>& data, int leaf);
 
-    /// 路径到块索引的映射
-    std::unordered_map<int, int> path_to_block_index;
+    /**
+     * @brief ODS 模式下节点块读取的旧叶子：会话中的块取会话叶子，ODS 管理的块取 leaf，
+     *        其余块（仍由位置映射管理）为 -1
+     * @return 是否可以读取（ODS 管理的块必须给出叶子）
+     */
+    bool odsReadLeaf(int block_id, int leaf, int& old_leaf) const;
+
+    /**
+     * @brief ODS 模式的批量读取：读出的块换到新叶子并固定（叶子未知的块改为 dummy 读取）
+     */
+    std::vector<std::vector<char>> odsBatchRead(std::vector<int>& reads, int pad_to, const std::vector<int>* leaves);
+
+    /// 根节点位置（根节点的块号）
+    int root_path;
 
-    /// 块索引到路径的映射  
-    std::unordered_map<int, int> block_index_to_path;
+    /// 根节点位置的块索引（用于在ORAM中存储根节点位置）
+    int root_path_block_index;
 
 public:
     // ==============================
@@ -134,6 +238,21 @@ public:
      */
     std::vector<uint8_t> readDocument(int doc_id) override;
 
+    /**
+     * @brief 删除文档：块内容清空，块 ID 进入空闲列表
+     * @param doc_id 文档 ID
+     * @return 文档存在时返回 true
+     */
+    bool deleteDocument(int doc_id) override;
+
+    /**
+     * @brief 批量读取文档：所有 ORAM 路径读取在一轮内并行完成
+     * @param doc_ids 文档 ID 列表
+     * @param pad_to 读取次数不足时用 dummy 读取补齐到该数量（0 表示不补齐）
+     * @return 与 doc_ids 一一对应的文档数据，未存储的文档为空向量
+     */
+    std::vector<std::vector<uint8_t>> batchReadDocuments(const std::vector<int>& doc_ids, int pad_to = 0);
+
     /**
      * @brief 批量存储多个节点（减少通信轮次）
      * @param nodes 节点 ID 与数据的键值对列表
@@ -141,72 +260,159 @@ public:
      */
     bool batchStoreNodes(const std::vector<std::pair<int, std::vector<uint8_t>>>& nodes) override;
 
+    /**
+     * @brief 批量写入建树生成的节点与文档（见 ringoram::bulkLoad）
+     *
+     * 压缩在 threads 个线程上并行执行，从未访问过 ORAM 的新块一次放入 ORAM；
+     * 已经写入过的节点或文档，以及复用的已释放块（ORAM 中可能还有旧内容），按普通写入逐个处理。
+     * @param nodes 节点 ID 与序列化数据
+     * @param documents 文档 ID 与序列化数据
+     * @param threads 线程数（<= 0 为硬件线程数）
+     * @param node_leaves ODS 模式下与 nodes 一一对应的叶子（已记录在父节点中），为空时节点块使用位置映射
+     * @return 是否全部存储成功
+     */
+    bool bulkStore(const std::vector<std::pair<int, std::vector<uint8_t>>>& nodes,
+                   const std::vector<std::pair<int, std::vector<uint8_t>>>& documents, int threads,
+                   const std::vector<int>* node_leaves = nullptr);
+
+    // ==============================
+    // 按块号访问节点
+    // ==============================
+
+    /**
+     * @brief 节点的块号：已有块时直接返回，否则分配一个块并登记给该节点（尚未写入 ORAM）
+     *
+     * 父节点的子节点位置即子节点的块号，在写入子节点之前就需要确定。
+     * @param node_id 节点ID
+     * @return 块号
+     */
+    int allocateNodeBlock(int node_id);
+
+    /**
+     * @brief 块中存放的节点ID
+     * @param block_id 块号
+     * @return 节点ID，块不存放节点时返回 -1
+     */
+    int getNodeIdByBlock(int block_id) const {
+        return (block_id >= 0 && block_id < static_cast<int>(block_node.size())) ? block_node[block_id] : -1;
+    }
+
+    /**
+     * @brief 按块号读取节点（父节点中记录的子节点位置），一次 ORAM 访问，不查映射表
+     * @param block_id 块号
+     * @param leaf ODS 模式下块所在的叶子（父节点中记录的子节点叶子），其他模式忽略
+     * @return 节点数据，块不存放节点或读取失败时为空向量
+     */
+    std::vector<uint8_t> readNodeBlock(int block_id, int leaf = -1);
+
+    /**
+     * @brief 按块号批量读取节点：所有 ORAM 路径读取在一轮内并行完成
+     * @param block_ids 块号列表
+     * @param pad_to 读取次数不足时用 dummy 读取补齐到该数量（0 表示不补齐）
+     * @param leaves ODS 模式下与 block_ids 一一对应的叶子，其他模式忽略
+     * @return 与 block_ids 一一对应的节点数据，失败的块为空向量
+     */
+    std::vector<std::vector<uint8_t>> batchReadNodeBlocks(const std::vector<int>& block_ids, int pad_to = 0,
+                                                          const std::vector<int>* leaves = nullptr);
+
+    /**
+     * @brief 节点的块号（不分配）
+     * @return 块号，节点没有块时返回 -1
+     */
+    int getNodeBlock(int node_id) const {
+        auto it = node_id_to_block.find(node_id);
+        return it != node_id_to_block.end() ? it->second : -1;
+    }
+
     // ==============================
-    // 递归访问支持
+    // 不可知数据结构（ODS）模式
     // ==============================
+    //
+    // 节点块每次读取都换到新的随机叶子，并固定在 stash 中直到会话结束；
+    // 调用方把新叶子写入父节点（父节点同样在 stash 中，修改不产生网络访问），
+    // 会话结束时解除固定，之后的驱逐把节点写回树中。节点块因此不需要客户端位置映射。
+    // 一个会话内的访问必须串行（IRTree 以会话锁保证）。
+
+    bool isOdsMode() const { return ods_mode; }
 
     /**
-     * @brief 通过路径访问节点（递归ORAM访问）
-     * @param path 物理路径
-     * @return 节点数据
+     * @brief 本次会话中节点块的当前叶子（父节点应记录的子节点叶子）
+     * @return 块不在会话中时返回 -1
      */
-    std::vector<uint8_t> accessByPath(int path);
+    int getSessionLeaf(int block_id) const {
+        auto it = session_leaves.find(block_id);
+        return it != session_leaves.end() ? it->second : -1;
+    }
+
+    /// 随机叶子（批量建树时为节点块预先选择叶子）
+    int randomLeaf();
 
     /**
-     * @brief 设置根节点路径
-     * @param path 根节点路径
+     * @brief 结束节点会话：解除固定，清空会话叶子（调用前新叶子必须已写入父节点和 root_leaf）
+     */
+    void endNodeSession();
+
+    /// 根节点块的叶子（-1 表示由位置映射管理）
+    int getRootLeaf() const { return root_leaf; }
+    void setRootLeaf(int leaf) { root_leaf = leaf; }
+
+    /// 叶子由父节点保存的节点块数（这些块不占用客户端位置映射）
+    int getOdsBlockCount() const;
+
+    /**
+     * @brief 设置根节点位置（根节点的块号）
+     * @param path 根节点块号
      */
     void setRootPath(int path);
 
     /**
-     * @brief 获取根节点路径
-     * @return 根节点路径
+     * @brief 获取根节点位置
+     * @return 根节点块号
      */
     int getRootPath() const;
 
     /**
-     * @brief 持久化根路径到ORAM
+     * @brief 持久化根节点位置到ORAM
      */
     void persistRootPath();
 
     /**
-     * @brief 从ORAM中加载根路径
+     * @brief 从ORAM中加载根节点位置
      */
     void loadRootPath();
 
     /**
-     * @brief 建立路径到节点ID的映射（用于初始化）
-     * @param path 物理路径
-     * @param node_id 节点ID
+     * @brief 空闲列表中的块数
      */
-    void mapPathToNode(int path, int node_id) {
-        path_to_node_id[path] = node_id;
+    size_t getFreeBlockCount() const { return free_blocks.size(); }
 
-    }
+    // ==============================
+    // 块分配统计
+    // ==============================
 
-    /**
-     * @brief 获取路径对应的节点ID（用于调试）
-     * @param path 物理路径
-     * @return 节点ID，如果不存在返回-1
-     */
-    int getNodeIdByPath(int path) const {
-        auto it = path_to_node_id.find(path);
-        return (it != path_to_node_id.end()) ? it->second : -1;
-    }
+    /// 块分配与引用情况
+    struct BlockStats {
+        int capacity = 0;           ///< ORAM 容量（块数）
+        int high_water = 0;         ///< 已分配区间的大小（next_block_id），ORAM 至少需要这么多块
+        int live = 0;               ///< 被引用的块
+        int free = 0;               ///< 空闲列表中的块（已分配区间内的空洞）
+        int unreferenced = 0;       ///< 标记为已引用、但节点与文档映射和根路径块都不引用的块（泄漏）
+        int mismatched = 0;         ///< 节点映射与块到节点的反向映射不一致的块
+        int ods_nodes = 0;          ///< 叶子由父节点保存的节点块（ODS 模式，不占用客户端位置映射）
+        uint64_t allocations = 0;   ///< 累计分配次数
+        uint64_t reuses = 0;        ///< 其中复用空闲块的次数
+        uint64_t releases = 0;      ///< 累计释放次数
+    };
 
     /**
-      * @brief 分配块索引给路径
-      * @param path 物理路径
-      * @return 分配的块索引
-      */
-    int allocateBlockForPath(int path);
+     * @brief 统计块分配情况，并按节点、文档映射核对引用（遍历映射表，不访问 ORAM）
+     */
+    BlockStats getBlockStats() const;
 
     /**
-     * @brief 通过路径获取块索引
-     * @param path 物理路径
-     * @return 块索引
+     * @brief 打印块分配统计：占用率、空洞、复用次数与泄漏检查
      */
-    int getBlockIndexByPath(int path) const;
+    void printBlockStats() const;
 
     // ==============================
     // 存储统计信息
@@ -236,6 +442,51 @@ public:
      */
     void printStorageStats() const;
 
+    // ==============================
+    // 节点压缩
+    // ==============================
+
+    /**
+     * @brief 开启或关闭节点压缩（只影响之后写入的节点，读取时自动识别）
+     * @param enabled 是否压缩
+     * @param size_class 压缩后填充到的大小档位（字节，16的倍数），超出档位的块写入失败
+     */
+    void setNodeCompression(bool enabled, size_t size_class);
+
+    /**
+     * @brief 每个节点块在 ORAM 中占用的字节数（用于带宽统计）
+     */
+    size_t getNodeBlockBytes() const;
+
+    /**
+     * @brief 打印节点压缩统计（原始字节数、存储字节数、压缩率），以及单独存放的文档字节数
+     */
+    void printCompressionStats() const;
+
+    // ==============================
+    // 快照与服务器存储文件
+    // ==============================
+
+    /**
+     * @brief 保存块分配状态、各映射表、统计计数与 ORAM 客户端状态（见 ringoram::saveState）
+     */
+    void saveState(SnapshotWriter& writer);
+
+    /**
+     * @brief 恢复 saveState 保存的状态
+     * @return 是否成功，失败时当前状态保持不变
+     */
+    bool loadState(SnapshotReader& reader);
+
+    /// 请求服务器保存存储文件（见 ringoram::saveServerStore）
+    bool saveServerStore(uint64_t token);
+
+    /// 服务器内存中 bucket 对应的存储文件令牌，0 表示不一致
+    bool getServerStoreToken(uint64_t& token);
+
+    /// 请求服务器清空所有 bucket
+    bool resetServerStore();
+
 
 };
 
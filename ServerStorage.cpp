@@ -1,10 +1,17 @@
 #include"ServerStorage.h"
 #include"param.h"
+#include"NetProtocol.h"
+#include"Snapshot.h"
+#include"DataLoader.h"
 #include <iostream>
 #include <string>
 #include <sstream>
 using namespace std;
 
+// 存储文件的魔数与段标签
+static const char kStoreMagic[8] = { 'R', 'O', 'R', 'A', 'M', 'S', 'T', 'O' };
+static const uint32_t kStoreBucketsTag = snapshotTag('B', 'K', 'T', 'S');
+
 
 
 ServerStorage::ServerStorage() : capacity(0)
@@ -38,4 +45,75 @@ void ServerStorage::SetBucket(int position, bucket& bucketTowrite)
     }
 
     this->buckets.at(position) = bucketTowrite;
-}
\ No newline at end of file
+}
+
+void ServerStorage::reset()
+{
+    this->buckets.assign(this->capacity, bucket(realBlockEachbkt, dummyBlockEachbkt));
+}
+
+bool ServerStorage::saveToFile(const std::string& path, uint64_t token) const
+{
+    SnapshotWriter writer;
+    writer.putU64(token);
+
+    writer.beginSection(kStoreBucketsTag);
+    writer.putI32(this->capacity);
+    writer.putI32(realBlockEachbkt);
+    writer.putI32(dummyBlockEachbkt);
+    std::vector<uint8_t> serialized;
+    for (const auto& bkt : this->buckets) {
+        if (!serialize_bucket_into(bkt, serialized)) {
+            return false;
+        }
+        writer.putByteVector(serialized);
+    }
+    writer.endSection();
+
+    return writer.writeFile(path, kStoreMagic);
+}
+
+bool ServerStorage::loadFromFile(const std::string& path, uint64_t& token)
+{
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+
+    SnapshotReader reader;
+    std::string error;
+    if (!reader.open(file.data(), file.size(), kStoreMagic, error)) {
+        cerr << "Error: Invalid store file " << path << ": " << error << endl;
+        return false;
+    }
+
+    uint64_t file_token = reader.getU64();
+    reader.beginSection(kStoreBucketsTag);
+    int32_t file_capacity = reader.getI32();
+    int32_t file_Z = reader.getI32();
+    int32_t file_S = reader.getI32();
+    if (!reader.ok() || file_capacity != this->capacity ||
+        file_Z != realBlockEachbkt || file_S != dummyBlockEachbkt) {
+        cerr << "Error: Store file " << path << " was written with a different configuration ("
+             << file_capacity << " buckets, Z=" << file_Z << ", S=" << file_S << ")" << endl;
+        return false;
+    }
+
+    // 先解析到新数组，全部成功后再替换
+    std::vector<bucket> loaded(this->capacity, bucket(realBlockEachbkt, dummyBlockEachbkt));
+    std::vector<uint8_t> serialized;
+    for (int i = 0; i < this->capacity; i++) {
+        if (!reader.getByteVector(serialized) ||
+            !deserialize_bucket_into(serialized.data(), serialized.size(), loaded[i])) {
+            cerr << "Error: Corrupt bucket " << i << " in store file " << path << endl;
+            return false;
+        }
+    }
+    if (!reader.endSection()) {
+        return false;
+    }
+
+    this->buckets.swap(loaded);
+    token = file_token;
+    return true;
+}
@@ -3,6 +3,8 @@
 #include"bucket.h"
 #include"block.h"
 #include<vector>
+#include<string>
+#include<cstdint>
 
 
 
@@ -23,6 +25,14 @@ public:
 
     int GetCapacity() const { return capacity; }
 
+    // 所有 bucket 恢复为只有 dummy 的初始状态
+    void reset();
+
+    // 存储文件（格式见 Snapshot.h）：令牌由客户端生成，与客户端快照中的令牌对应。
+    // 保存时调用方负责阻止并发写入；加载时容量或 bucket 结构不符则拒绝，原有数据保持不变
+    bool saveToFile(const std::string& path, uint64_t token) const;
+    bool loadFromFile(const std::string& path, uint64_t& token);
+
 private:
     int capacity;  // 总的bucket数量
 };
\ No newline at end of file
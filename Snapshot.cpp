@@ -0,0 +1,182 @@
+#include "Snapshot.h"
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+uint64_t snapshotChecksum(const uint8_t* data, size_t size) {
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t hash = 14695981039346656037ULL;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * prime;
+    }
+    return hash;
+}
+
+// ==============================
+// SnapshotWriter
+// ==============================
+
+void SnapshotWriter::putBytes(const void* data, size_t size) {
+    if (size == 0) return;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    payload_.insert(payload_.end(), bytes, bytes + size);
+}
+
+void SnapshotWriter::putString(const std::string& value) {
+    putU32(static_cast<uint32_t>(value.size()));
+    putBytes(value.data(), value.size());
+}
+
+void SnapshotWriter::beginSection(uint32_t tag) {
+    putU32(tag);
+    section_start_ = payload_.size();
+    putU64(0);  // 长度在 endSection 时回填
+}
+
+void SnapshotWriter::endSection() {
+    uint64_t length = payload_.size() - section_start_ - sizeof(uint64_t);
+    std::memcpy(payload_.data() + section_start_, &length, sizeof(length));
+}
+
+bool SnapshotWriter::writeFile(const std::string& filename, const char* magic) const {
+    SnapshotFileHeader header;
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.reserved = 0;
+    header.payload_size = payload_.size();
+    header.checksum = snapshotChecksum(payload_.data(), payload_.size());
+
+    // 客户端快照含 ORAM 密钥、IV 与位置映射，临时文件只对属主可读写（不受 umask 影响）。
+    // 上次写入中断留下的临时文件先删除，O_EXCL 保证不会写入别人预先放置的文件或符号链接
+    std::string temp_name = filename + ".tmp";
+    ::unlink(temp_name.c_str());
+    int fd = ::open(temp_name.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0600);
+    if (fd < 0) {
+        std::cerr << "Error: Cannot create file " << temp_name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    auto writeAll = [fd](const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t n = ::write(fd, p, size);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    };
+
+    // 改名前 fsync，掉电后不会出现新文件名指向未落盘内容的情况
+    bool written = writeAll(&header, sizeof(header)) && writeAll(payload_.data(), payload_.size()) && ::fsync(fd) == 0;
+    int saved_errno = errno;
+    if (::close(fd) != 0 && written) {
+        written = false;
+        saved_errno = errno;
+    }
+    if (!written) {
+        std::cerr << "Error: Failed to write " << temp_name << ": " << std::strerror(saved_errno) << std::endl;
+        ::unlink(temp_name.c_str());
+        return false;
+    }
+
+    if (std::rename(temp_name.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Error: Cannot replace " << filename << std::endl;
+        std::remove(temp_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ==============================
+// SnapshotReader
+// ==============================
+
+bool SnapshotReader::open(const char* data, size_t size, const char* magic, std::string& error) {
+    ok_ = false;
+    SnapshotFileHeader header;
+    if (size < sizeof(header)) {
+        error = "file too short";
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(header.magic)) != 0) {
+        error = "not a snapshot of the expected type";
+        return false;
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        error = "unsupported version " + std::to_string(header.version) +
+            " (expected " + std::to_string(SNAPSHOT_VERSION) + ")";
+        return false;
+    }
+    if (header.payload_size != size - sizeof(header)) {
+        error = "truncated (payload " + std::to_string(size - sizeof(header)) + " of " +
+            std::to_string(header.payload_size) + " bytes)";
+        return false;
+    }
+
+    payload_ = reinterpret_cast<const uint8_t*>(data) + sizeof(header);
+    payload_size_ = static_cast<size_t>(header.payload_size);
+    if (snapshotChecksum(payload_, payload_size_) != header.checksum) {
+        error = "checksum mismatch";
+        return false;
+    }
+
+    pos_ = 0;
+    limit_ = payload_size_;
+    ok_ = true;
+    return true;
+}
+
+bool SnapshotReader::getBytes(void* out, size_t size) {
+    if (!ok_ || size > remaining()) {
+        ok_ = false;
+        if (size > 0) std::memset(out, 0, size);
+        return false;
+    }
+    if (size > 0) std::memcpy(out, payload_ + pos_, size);
+    pos_ += size;
+    return true;
+}
+
+bool SnapshotReader::getString(std::string& value) {
+    uint32_t size = getU32();
+    if (!ok_ || size > remaining()) {
+        ok_ = false;
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(payload_ + pos_), size);
+    pos_ += size;
+    return true;
+}
+
+bool SnapshotReader::beginSection(uint32_t tag) {
+    uint32_t actual = getU32();
+    uint64_t length = getU64();
+    if (!ok_ || actual != tag || length > remaining()) {
+        ok_ = false;
+        return false;
+    }
+    limit_ = pos_ + static_cast<size_t>(length);
+    return true;
+}
+
+bool SnapshotReader::endSection() {
+    if (!ok_) return false;
+    // 跳过本段中未读取的内容（同一版本内在段尾追加的字段）
+    pos_ = limit_;
+    limit_ = payload_size_;
+    return true;
+}
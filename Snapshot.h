@@ -0,0 +1,190 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Snapshot.h
+ * ----------------------------------------
+ * 客户端状态快照（IRTree::saveSnapshot / loadSnapshot）与服务器 bucket 存储文件
+ * （ServerStorage::saveToFile / loadFromFile）共用的二进制格式。
+ *
+ * 文件 = [SnapshotFileHeader][负载]
+ *   头部：魔数（区分文件类型）、格式版本、负载长度、负载校验和
+ *   负载：若干段，每段为 [标签 u32][长度 u64][内容]，按固定顺序排列，读取时核对标签
+ *
+ * 整数与浮点数按本机字节序定长存放；位置映射等定长数组整块存放，
+ * 从文件映射区（MappedFile）读取时整块复制，不逐项解析。
+ * 格式不兼容的修改必须增加 SNAPSHOT_VERSION，旧文件会被拒绝而不是读错。
+ *
+ * 客户端快照是机密文件：其中以明文保存 ORAM 的 AES 密钥、IV 和位置映射，
+ * 拿到快照即可解密服务器上的全部 bucket 并还原访问模式。文件只对属主可读写，
+ * 不能与服务器存储放在一起，也不能交给服务器一方保管。
+ */
+
+/// 快照格式版本（2：存储段不再保存路径块映射与空闲列表；3：子节点位置改为块号，不再保存路径到节点的映射；
+/// 4：存储段增加根节点块的叶子与 ODS 管理的块；5：节点中的子节点文本上界不再包含 IDF）
+const uint32_t SNAPSHOT_VERSION = 5;
+
+/// 段标签：四个字符
+constexpr uint32_t snapshotTag(char a, char b, char c, char d) {
+    return static_cast<uint32_t>(static_cast<uint8_t>(a)) |
+        (static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8) |
+        (static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16) |
+        (static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24);
+}
+
+#pragma pack(push, 1)
+struct SnapshotFileHeader {
+    char magic[8];          ///< 文件类型
+    uint32_t version;       ///< 格式版本
+    uint32_t reserved;
+    uint64_t payload_size;  ///< 负载字节数
+    uint64_t checksum;      ///< 负载校验和（snapshotChecksum）
+};
+#pragma pack(pop)
+
+/**
+ * @brief 负载校验和：64 位 FNV-1a，按 8 字节一组处理（剩余字节逐个处理）
+ *
+ * 只用于发现截断和损坏，不防篡改（快照与密钥同样保存在客户端本地）。
+ */
+uint64_t snapshotChecksum(const uint8_t* data, size_t size);
+
+/// 快照写入：负载先在内存中组装，最后一次写入文件
+class SnapshotWriter {
+public:
+    void putU32(uint32_t value) { putPod(value); }
+    void putI32(int32_t value) { putPod(value); }
+    void putU64(uint64_t value) { putPod(value); }
+    void putF64(double value) { putPod(value); }
+    void putBool(bool value) { putPod(static_cast<uint8_t>(value ? 1 : 0)); }
+
+    /// 原始字节（不带长度）
+    void putBytes(const void* data, size_t size);
+
+    /// 带 u64 长度的字节串
+    template <typename Byte>
+    void putByteVector(const std::vector<Byte>& bytes) {
+        static_assert(sizeof(Byte) == 1, "byte vector expected");
+        putU64(bytes.size());
+        putBytes(bytes.data(), bytes.size());
+    }
+
+    /// 带 u32 长度的字符串
+    void putString(const std::string& value);
+
+    /// 定长元素数组：u64 元素数 + 整块数据
+    template <typename T>
+    void putArray(const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "trivially copyable element expected");
+        putU64(count);
+        putBytes(values, count * sizeof(T));
+    }
+
+    template <typename T>
+    void putArray(const std::vector<T>& values) {
+        putArray(values.data(), values.size());
+    }
+
+    /// 开始一段，endSection 时回填长度
+    void beginSection(uint32_t tag);
+    void endSection();
+
+    /**
+     * @brief 写入文件：先写临时文件（权限 0600），fsync 后再改名，写入中断不会破坏已有文件
+     * @param magic 8 字节文件类型
+     * @return 是否成功，失败时输出错误信息
+     */
+    bool writeFile(const std::string& filename, const char* magic) const;
+
+    size_t size() const { return payload_.size(); }
+
+private:
+    template <typename T>
+    void putPod(T value) {
+        putBytes(&value, sizeof(value));
+    }
+
+    std::vector<uint8_t> payload_;
+    size_t section_start_ = 0;
+};
+
+/**
+ * @brief 快照读取：直接在内存（通常是文件映射区）上读取，不复制整个文件
+ *
+ * 任何越界读取都会使读取器进入失败状态，之后的读取全部返回 0 / 空，
+ * 调用方在一组读取之后检查 ok() 即可。
+ */
+class SnapshotReader {
+public:
+    /**
+     * @brief 校验头部（魔数、版本、长度）与校验和
+     * @param error 失败原因
+     */
+    bool open(const char* data, size_t size, const char* magic, std::string& error);
+
+    uint32_t getU32() { return getPod<uint32_t>(); }
+    int32_t getI32() { return getPod<int32_t>(); }
+    uint64_t getU64() { return getPod<uint64_t>(); }
+    double getF64() { return getPod<double>(); }
+    bool getBool() { return getPod<uint8_t>() != 0; }
+
+    bool getBytes(void* out, size_t size);
+
+    template <typename Byte>
+    bool getByteVector(std::vector<Byte>& bytes) {
+        static_assert(sizeof(Byte) == 1, "byte vector expected");
+        uint64_t size = getU64();
+        if (!ok_ || size > remaining()) {
+            ok_ = false;
+            return false;
+        }
+        bytes.resize(static_cast<size_t>(size));
+        return getBytes(bytes.data(), bytes.size());
+    }
+
+    bool getString(std::string& value);
+
+    template <typename T>
+    bool getArray(std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "trivially copyable element expected");
+        uint64_t count = getU64();
+        if (!ok_ || count > remaining() / sizeof(T)) {
+            ok_ = false;
+            return false;
+        }
+        values.resize(static_cast<size_t>(count));
+        return getBytes(values.data(), values.size() * sizeof(T));
+    }
+
+    /// 进入下一段（标签必须为 tag），endSection 跳到该段末尾
+    bool beginSection(uint32_t tag);
+    bool endSection();
+
+    /// 剩余未读的负载字节数（在段内时为段内剩余）
+    size_t remaining() const { return limit_ - pos_; }
+
+    bool ok() const { return ok_; }
+
+private:
+    template <typename T>
+    T getPod() {
+        T value{};
+        getBytes(&value, sizeof(value));
+        return value;
+    }
+
+    const uint8_t* payload_ = nullptr;
+    size_t payload_size_ = 0;
+    size_t pos_ = 0;
+    size_t limit_ = 0;
+    bool ok_ = false;
+};
+
+#endif // SNAPSHOT_H
@@ -67,6 +67,13 @@ public:
     // - 文档数据的二进制表示（若不存在，可返回空 vector）。
     virtual std::vector<uint8_t> readDocument(int doc_id) = 0;
 
+    // 删除指定文档的数据。
+    // 参数：
+    // - doc_id：待删除文档的标识符
+    // 返回值：
+    // - 删除成功返回 true，文档不存在返回 false。
+    virtual bool deleteDocument(int doc_id) = 0;
+
     // ==========================
     // 批量操作接口（性能优化）
     // ==========================
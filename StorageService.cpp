@@ -0,0 +1,403 @@
+// StorageService.cpp
+#include <iostream>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <array>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <condition_variable>
+#include <boost/asio/buffer.hpp>
+#include "StorageService.h"
+#include "ServerStorage.h"
+#include "NetProtocol.h"
+#include "param.h"
+
+// 全局的 ServerStorage 对象
+static std::unique_ptr<ServerStorage> g_storage;
+
+// 多个连接并发处理请求：按 bucket 位置分段加锁。
+// 每个处理函数同一时刻最多持有一把锁，不会死锁。
+static const int kBucketLockStripes = 1024;
+static std::mutex g_bucket_locks[kBucketLockStripes];
+
+static inline std::mutex& bucketLock(int position) {
+    return g_bucket_locks[static_cast<unsigned>(position) % kBucketLockStripes];
+}
+
+// 存储文件路径（为空时不支持 STORE_SAVE）
+static std::string g_store_path;
+
+// 内存中的 bucket 与哪个令牌的存储文件一致：保存或加载时设置，
+// 任何修改 bucket 的请求（写入、路径读取）清零。客户端据此判断能否直接使用本地快照
+static std::atomic<uint64_t> g_store_token(0);
+
+// 锁住全部分段（保存、重置时使用）。按下标顺序加锁，其他处理函数最多持有一把锁，不会死锁
+class AllBucketsLock {
+public:
+    AllBucketsLock() {
+        for (int i = 0; i < kBucketLockStripes; i++) g_bucket_locks[i].lock();
+    }
+    ~AllBucketsLock() {
+        for (int i = kBucketLockStripes - 1; i >= 0; i--) g_bucket_locks[i].unlock();
+    }
+};
+
+// 活跃连接数：所有客户端连接都断开后服务器退出
+static std::mutex g_conn_mutex;
+static std::condition_variable g_conn_cv;
+static int g_active_connections = 0;
+
+// 处理 READ_BUCKET 请求
+// 直接从存储中的 bucket 序列化到连接复用的响应缓冲区，不再拷贝 bucket
+static void handleReadBucket(const uint8_t* request_data, uint32_t data_len, std::vector<uint8_t>& response_data) {
+    if (data_len < 4) {
+        std::cout << "Error: READ_BUCKET request data too short" << std::endl;
+        // 返回空的65536字节数据
+        response_data.assign(65536, 0);
+        return;
+    }
+    
+    // 解析桶位置
+    int32_t position;
+    memcpy(&position, request_data, sizeof(position));
+  
+    try {
+        // 调用 ServerStorage 读取桶（引用，不拷贝）
+        std::lock_guard<std::mutex> lock(bucketLock(position));
+        const bucket& bkt = g_storage->GetBucket(position);
+   
+        // 使用真正的序列化
+        if (!serialize_bucket_into(bkt, response_data)) {
+            response_data.clear();
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to read bucket: " << e.what() << std::endl;
+        // 返回空的65536字节数据
+        response_data.assign(65536, 0);
+    }
+}
+
+
+// 处理 WRITE_BUCKET 请求
+// bucket 数据原地写入存储中的 bucket，复用各 block 已有的数据缓冲区
+static bool handleWriteBucket(const uint8_t* request_data, uint32_t data_len) {
+    if (!g_storage) {
+        std::cout << "Error: ServerStorage not initialized" << std::endl;
+        return false;
+    }
+    
+    if (data_len < 4) {
+        std::cout << "Error: WRITE_BUCKET request data too short" << std::endl;
+        return false;
+    }
+    
+    // 解析桶位置
+    int32_t position;
+    memcpy(&position, request_data, sizeof(position));
+    g_store_token = 0;
+   
+    try {
+        // 反序列化bucket数据（从第5字节开始）
+        if (data_len >= 4 + sizeof(SerializedBucketHeader)) {
+            const uint8_t* bucket_data = request_data + 4;
+            uint32_t bucket_data_len = data_len - 4;
+            
+            std::lock_guard<std::mutex> lock(bucketLock(position));
+            bucket& target = g_storage->GetBucket(position);
+            if (!deserialize_bucket_into(bucket_data, bucket_data_len, target)) {
+                std::cout << "Error: Malformed bucket data" << std::endl;
+                return false;
+            }
+          
+            return true;
+        } else {
+            std::cout << "Error: Incomplete bucket data" << std::endl;
+            return false;
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Write bucket failed: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+static void handleReadPath(const uint8_t* request_data, uint32_t data_len, std::vector<uint8_t>& response) {
+    response.clear();
+
+    if (!g_storage) {
+        std::cout << "Error: ServerStorage not initialized" << std::endl;
+        return;
+    }
+    
+    if (data_len < 8) {
+        std::cout << "Error: READ_PATH request data too short" << std::endl;
+        return;
+    }
+    
+    // 解析 leaf_id 和 block_index
+    int32_t leaf_id;
+    int32_t block_index;
+    memcpy(&leaf_id, request_data, sizeof(leaf_id));
+    memcpy(&block_index, request_data + 4, sizeof(block_index));
+    g_store_token = 0;
+    
+ 
+    try {
+       
+        // 第一个字节：是否是dummy块，找到目标块后改为0并追加数据
+        response.push_back(1);
+        
+        // 遍历路径上的所有层级
+        for (int i = 0; i <= OramL; i++) {
+            int position = (1 << i) - 1 + (leaf_id >> (OramL - i));
+            
+            if (position < 0 || position >= capacity) {
+                std::cout << "Warning: Invalid bucket position: " << position 
+                         << " (leaf_id=" << leaf_id << ", level=" << i << ")" << std::endl;
+                continue;
+            }
+            
+            // 读取bucket（逐层加锁，目标块数据在锁内拷出）
+            std::lock_guard<std::mutex> lock(bucketLock(position));
+            bucket& bkt = g_storage->GetBucket(position);
+            
+            // 查找目标块
+            int offset = -1;
+            for (int j = 0; j < (realBlockEachbkt + dummyBlockEachbkt); j++) {
+                if (bkt.ptrs[j] == block_index && bkt.valids[j] == 1) {
+                    offset = j;
+                    break;
+                }
+            }
+            
+            if (offset == -1) {
+                offset = bkt.GetDummyblockOffset();
+            }
+            if (offset == -1) {
+                // dummy 已耗尽（客户端未及时重排），跳过该层而不是越界访问
+                std::cerr << "Warning: No valid slot in bucket " << position << std::endl;
+                continue;
+            }
+            
+            const block& blk = bkt.blocks[offset];
+            
+            // 标记为无效
+            bkt.valids[offset] = 0;
+            bkt.count += 1;
+            
+            if (blk.GetBlockindex() == block_index && block_index != -1) {
+                response[0] = 0;
+                const auto& data = blk.GetData();
+                // 检查数据大小
+                if (data.size() > 4095) {  // 减去1字节的is_dummy标志
+                    std::cerr << "Warning: Block data too large: " << data.size() 
+                              << " bytes, truncated" << std::endl;
+                    response.insert(response.end(), data.begin(), data.begin() + 4095);
+                } else {
+                    response.insert(response.end(), data.begin(), data.end());
+                }
+            }
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Read path failed: " << e.what() << std::endl;
+        response.clear();
+    }
+}
+
+// 处理 STORE_SAVE 请求：全部 bucket 写入存储文件，写入期间阻塞其他请求
+static bool handleStoreSave(const uint8_t* request_data, uint32_t data_len) {
+    if (g_store_path.empty()) {
+        std::cout << "Error: STORE_SAVE requested but the server was started without a store file" << std::endl;
+        return false;
+    }
+    if (data_len < sizeof(uint64_t)) {
+        std::cout << "Error: STORE_SAVE request data too short" << std::endl;
+        return false;
+    }
+    uint64_t token;
+    memcpy(&token, request_data, sizeof(token));
+
+    AllBucketsLock lock;
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!g_storage->saveToFile(g_store_path, token)) {
+        return false;
+    }
+    g_store_token = token;
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Saved store to " << g_store_path << " in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+    return true;
+}
+
+// 处理 STORE_INFO 请求：返回当前令牌
+static void handleStoreInfo(std::vector<uint8_t>& response_data) {
+    uint64_t token = g_store_token;
+    response_data.resize(sizeof(token));
+    memcpy(response_data.data(), &token, sizeof(token));
+}
+
+// 处理 STORE_RESET 请求：客户端重新建树前清空服务器上的旧数据
+static bool handleStoreReset() {
+    AllBucketsLock lock;
+    g_storage->reset();
+    g_store_token = 0;
+    return true;
+}
+
+// 处理单个客户端连接（每个连接一个线程）
+// 传输相关的优化（Nagle、QUICKACK、缓冲区大小）由具体的 Transport 实现负责
+void handleClient(std::unique_ptr<Transport> transport) {
+    try {
+        // 每个连接复用的收发缓冲区：resize 在容量足够时不会重新分配，
+        // 稳态下每个请求都不会产生堆分配
+        std::vector<uint8_t> request_data;
+        std::vector<uint8_t> response_data;
+
+        while (true) {
+            // 阶段1: 接收请求头
+            RequestHeader header;
+            
+            // 读取前准备（TCP 在此设置一次QUICKACK）
+            transport->prepareReceive();
+            transport->receive(&header, sizeof(header));
+            
+            // 阶段2: 接收请求数据
+            request_data.resize(header.data_len);
+            if (header.data_len > 0) {
+                transport->receive(request_data.data(), header.data_len);
+            }
+            
+            // 阶段3: 处理请求
+            response_data.clear();
+            bool success = false;
+            
+            switch (header.type) {
+                case READ_BUCKET:
+                    handleReadBucket(request_data.data(), header.data_len, response_data);
+                    success = !response_data.empty();
+                    break;
+                case WRITE_BUCKET:
+                    success = handleWriteBucket(request_data.data(), header.data_len);
+                    break;
+                case READ_PATH:
+                    handleReadPath(request_data.data(), header.data_len, response_data);
+                    success = !response_data.empty();
+                    break;
+                case STORE_SAVE:
+                    success = handleStoreSave(request_data.data(), header.data_len);
+                    break;
+                case STORE_INFO:
+                    handleStoreInfo(response_data);
+                    success = true;
+                    break;
+                case STORE_RESET:
+                    success = handleStoreReset();
+                    break;
+            }
+            
+            // 阶段4: 发送响应
+            ResponseHeader response;
+            response.type = RESPONSE;
+            response.request_id = header.request_id;
+            response.result = success ? 0 : 1;
+            response.data_len = response_data.size();
+            
+            // 响应头和数据一次性聚合发送（数据为空时第二段长度为0）
+            FrameBuffers buffers = {
+                boost::asio::buffer(&response, sizeof(response)),
+                boost::asio::buffer(response_data.data(), response_data.size())
+            };
+            transport->send(buffers);
+        }
+    }
+    catch (std::exception& e) {
+        std::cout << "Over (" << transport->describe() << "): " << e.what() << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(g_conn_mutex);
+    if (--g_active_connections == 0) {
+        g_conn_cv.notify_all();
+    }
+}
+
+// 持续接受新连接，每个连接交给独立线程处理
+void acceptLoop(TransportListener* listener) {
+    try {
+        while (true) {
+            auto transport = listener->accept();
+            std::cout << "\n=== client connected (" << transport->describe() << ") ===" << std::endl;
+            {
+                std::lock_guard<std::mutex> lock(g_conn_mutex);
+                g_active_connections++;
+            }
+            g_conn_cv.notify_all();
+            std::thread(handleClient, std::move(transport)).detach();
+        }
+    }
+    catch (std::exception& e) {
+        std::cerr << "Accept failed: " << e.what() << std::endl;
+    }
+}
+
+
+bool initStorageService(const std::string& store_path) {
+    if (g_storage) {
+        return true;
+    }
+    try {
+        g_storage = std::make_unique<ServerStorage>();
+        g_storage->setCapacity(capacity);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        g_storage.reset();
+        return false;
+    }
+    g_store_path = store_path;
+
+    // 加载存储文件（加载失败时从空存储开始，客户端会重新建树）
+    if (!g_store_path.empty() && std::ifstream(g_store_path).good()) {
+        auto start = std::chrono::high_resolution_clock::now();
+        uint64_t token = 0;
+        if (g_storage->loadFromFile(g_store_path, token)) {
+            g_store_token = token;
+            auto end = std::chrono::high_resolution_clock::now();
+            std::cout << "Loaded store from " << g_store_path << " in "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms" << std::endl;
+        }
+        else {
+            std::cerr << "Starting with an empty store" << std::endl;
+        }
+    }
+    return true;
+}
+
+void waitForClientsToFinish() {
+    std::unique_lock<std::mutex> lock(g_conn_mutex);
+    g_conn_cv.wait(lock, [] { return g_active_connections > 0; });
+    g_conn_cv.wait(lock, [] { return g_active_connections == 0; });
+}
+
+bool startLocalServer(const std::string& endpoint, int port, const std::string& store_path) {
+    if (!initStorageService(store_path)) {
+        return false;
+    }
+    try {
+        // 接受线程阻塞在 accept 中无法唤醒，监听器随进程一起结束
+        auto listener = listenTransport(endpoint, port);
+        std::thread(acceptLoop, listener.release()).detach();
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Local server failed: " << e.what() << std::endl;
+        return false;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef STORAGE_SERVICE_H
+#define STORAGE_SERVICE_H
+
+#include <memory>
+#include <string>
+#include "Transport.h"
+
+/*
+ * StorageService.h
+ * ----------------------------------------
+ * 存储服务器的请求处理：bucket 存储、按位置分段的锁、存储文件令牌，
+ * 以及每条连接的收发循环（READ_BUCKET / WRITE_BUCKET / READ_PATH / STORE_*）。
+ *
+ * storage_server 的 main 只负责解析参数和等待连接结束；
+ * 测试与基准可以用 startLocalServer 在本进程的后台线程中启动同样的服务，
+ * 作为替身服务器（通常监听 unix/shm 端点），不需要另外启动 server 进程。
+ * 一个进程中只有一份存储。
+ */
+
+/**
+ * @brief 创建存储（容量为 param.h 中的 capacity），并加载存储文件
+ * @param store_path bucket 存储文件：存在则加载，客户端请求 STORE_SAVE 时写入；为空时不支持保存
+ * @return 存储创建失败时返回 false（存储文件加载失败时从空存储开始，仍返回 true）
+ */
+bool initStorageService(const std::string& store_path);
+
+/**
+ * @brief 处理单个客户端连接，直到连接断开（每个连接一个线程）
+ */
+void handleClient(std::unique_ptr<Transport> transport);
+
+/**
+ * @brief 持续接受新连接，每个连接交给独立线程处理
+ */
+void acceptLoop(TransportListener* listener);
+
+/**
+ * @brief 阻塞到第一个连接建立、且之后所有连接都断开
+ */
+void waitForClientsToFinish();
+
+/**
+ * @brief 本地替身服务器：初始化存储（如未初始化）并在后台线程中监听 endpoint
+ * @param endpoint 监听端点（见 Transport.h），测试中通常为 "shm:<name>" 或 "unix:<path>"
+ * @param port TCP 端口（unix/shm 忽略）
+ * @param store_path bucket 存储文件（见 initStorageService），为空时不支持快照
+ * @return 监听失败时返回 false
+ *
+ * 返回后即可连接。接受线程常驻到进程退出，监听器不会析构，
+ * 遗留的 unix/shm 名字在下次以同一端点启动时清理。
+ */
+bool startLocalServer(const std::string& endpoint, int port = 0, const std::string& store_path = "");
+
+#endif // STORAGE_SERVICE_H
@@ -0,0 +1,506 @@
+#include "Transport.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <boost/asio.hpp>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace asio = boost::asio;
+using asio::ip::tcp;
+typedef asio::local::stream_protocol unix_stream;
+
+// ================================
+// 流式套接字传输（TCP / AF_UNIX）
+// ================================
+
+template <typename Protocol>
+class StreamTransport : public Transport {
+public:
+    StreamTransport(std::shared_ptr<asio::io_context> io,
+                    typename Protocol::socket socket,
+                    const std::string& desc)
+        : io_(std::move(io)), socket_(std::move(socket)), desc_(desc) {
+    }
+
+    void send(const FrameBuffers& buffers) override {
+        asio::write(socket_, buffers);
+    }
+
+    void receive(void* data, size_t len) override {
+        asio::read(socket_, asio::buffer(data, len));
+    }
+
+    bool isOpen() const override { return socket_.is_open(); }
+
+    std::string describe() const override { return desc_; }
+
+protected:
+    std::shared_ptr<asio::io_context> io_;  ///< socket 所属的 io_context，须比 socket 活得久
+    typename Protocol::socket socket_;
+    std::string desc_;
+};
+
+class TcpTransport : public StreamTransport<tcp> {
+public:
+    TcpTransport(std::shared_ptr<asio::io_context> io, tcp::socket socket, const std::string& desc)
+        : StreamTransport<tcp>(std::move(io), std::move(socket), desc) {
+        // 禁用Nagle算法
+        socket_.set_option(tcp::no_delay(true));
+    }
+
+    // === TCP优化：每次等待新消息前设置一次QUICKACK ===
+    void prepareReceive() override {
+        int quickack = 1;
+        setsockopt(socket_.native_handle(), IPPROTO_TCP, TCP_QUICKACK, &quickack, sizeof(quickack));
+    }
+};
+
+typedef StreamTransport<unix_stream> UnixTransport;
+
+class TcpListener : public TransportListener {
+public:
+    TcpListener(const std::string& host, int port)
+        : io_(std::make_shared<asio::io_context>()),
+          acceptor_(*io_, host.empty()
+                              ? tcp::endpoint(tcp::v4(), port)
+                              : tcp::endpoint(asio::ip::make_address(host), port)) {
+    }
+
+    std::unique_ptr<Transport> accept() override {
+        tcp::socket socket(*io_);
+        acceptor_.accept(socket);
+
+        // 增大TCP缓冲区
+        int buf_size = 65536;
+        setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+        setsockopt(socket.native_handle(), SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
+
+        std::string desc = "tcp:" + socket.remote_endpoint().address().to_string()
+                         + ":" + std::to_string(socket.remote_endpoint().port());
+        return std::unique_ptr<Transport>(new TcpTransport(io_, std::move(socket), desc));
+    }
+
+    std::string describe() const override {
+        return "tcp:" + acceptor_.local_endpoint().address().to_string()
+             + ":" + std::to_string(acceptor_.local_endpoint().port());
+    }
+
+private:
+    std::shared_ptr<asio::io_context> io_;
+    tcp::acceptor acceptor_;
+};
+
+class UnixListener : public TransportListener {
+public:
+    explicit UnixListener(const std::string& path)
+        : io_(std::make_shared<asio::io_context>()), path_(path), acceptor_(*io_) {
+        // 清理上次运行遗留的套接字文件
+        ::unlink(path_.c_str());
+        acceptor_.open(unix_stream());
+        acceptor_.bind(unix_stream::endpoint(path_));
+        acceptor_.listen();
+    }
+
+    ~UnixListener() override {
+        ::unlink(path_.c_str());
+    }
+
+    std::unique_ptr<Transport> accept() override {
+        unix_stream::socket socket(*io_);
+        acceptor_.accept(socket);
+        return std::unique_ptr<Transport>(new UnixTransport(io_, std::move(socket), "unix:" + path_));
+    }
+
+    std::string describe() const override { return "unix:" + path_; }
+
+private:
+    std::shared_ptr<asio::io_context> io_;
+    std::string path_;
+    unix_stream::acceptor acceptor_;
+};
+
+// ================================
+// 共享内存环形缓冲区传输
+// ================================
+//
+// 控制区 "/<name>" 由服务器创建；每条连接由客户端创建独立的通道区
+// "/<name>.<slot>"，其中包含两个单生产者/单消费者字节环：
+// to_server 与 to_client。读写指针为单调递增的字节计数，
+// 空/满时先短暂自旋，再在 futex 字上睡眠，由对端唤醒。
+
+namespace {
+
+const uint32_t SHM_MAGIC = 0x4f52414d;          // "ORAM"
+const size_t SHM_RING_BYTES = 4u << 20;         // 每个方向 4MB
+const int SHM_SPIN_ITERATIONS = 2000;           // 进入 futex 前的自旋次数（仅多核）
+const int SHM_WAIT_TIMEOUT_MS = 100;            // futex 等待超时，用于检查关闭标志
+const int SHM_CONNECT_TIMEOUT_MS = 5000;        // 已申请的槽位等待客户端创建通道的时限
+
+struct alignas(64) ShmRing {
+    std::atomic<uint64_t> head;             ///< 生产者已写入的总字节数
+    char pad0[56];
+    std::atomic<uint64_t> tail;             ///< 消费者已读取的总字节数
+    char pad1[56];
+    std::atomic<uint32_t> data_seq;         ///< 有新数据（futex 字）
+    std::atomic<uint32_t> space_seq;        ///< 有新空间（futex 字）
+    std::atomic<uint32_t> reader_waiting;   ///< 消费者正在 futex 上睡眠
+    std::atomic<uint32_t> writer_waiting;   ///< 生产者正在 futex 上睡眠
+    char pad2[48];
+    uint8_t data[SHM_RING_BYTES];
+};
+
+struct ShmChannel {
+    std::atomic<uint32_t> magic;    ///< 客户端初始化完成后写入 SHM_MAGIC
+    std::atomic<uint32_t> closed;   ///< 任一端关闭后置1
+    ShmRing to_server;
+    ShmRing to_client;
+};
+
+struct ShmControl {
+    std::atomic<uint32_t> magic;
+    std::atomic<uint32_t> requested;    ///< 客户端已申请的通道槽位数
+    std::atomic<uint32_t> connect_seq;  ///< 新连接通知（futex 字）
+};
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+void futexWait(std::atomic<uint32_t>* addr, uint32_t expected, int timeout_ms) {
+    struct timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    // 跨进程共享映射，不能使用 FUTEX_PRIVATE_FLAG
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t>* addr) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// 映射一块共享内存，失败时抛出异常
+void* mapShm(const std::string& name, size_t size, bool create) {
+    int flags = O_RDWR | (create ? (O_CREAT | O_EXCL) : 0);
+    int fd = shm_open(name.c_str(), flags, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("shm_open " + name + " failed: " + strerror(errno));
+    }
+    if (create && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        int err = errno;
+        ::close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("ftruncate " + name + " failed: " + strerror(err));
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        throw std::runtime_error("mmap " + name + " failed: " + strerror(errno));
+    }
+    return base;
+}
+
+// 映射客户端创建的通道区。通道尚未创建、尚未扩展到完整大小（客户端在 shm_open 与
+// ftruncate 之间）或尚未发布 magic 时返回 nullptr。必须先检查大小：
+// 访问超出对象长度的映射页会触发 SIGBUS
+ShmChannel* openClientChannel(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(ShmChannel)) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* base = mmap(nullptr, sizeof(ShmChannel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+    auto* channel = static_cast<ShmChannel*>(base);
+    if (channel->magic.load(std::memory_order_acquire) != SHM_MAGIC) {
+        munmap(channel, sizeof(ShmChannel));
+        return nullptr;
+    }
+    return channel;
+}
+
+class ShmTransport : public Transport {
+public:
+    ShmTransport(ShmChannel* channel, bool is_server, const std::string& desc)
+        : channel_(channel),
+          tx_(is_server ? &channel->to_client : &channel->to_server),
+          rx_(is_server ? &channel->to_server : &channel->to_client),
+          desc_(desc) {
+    }
+
+    ~ShmTransport() override {
+        // 通知对端连接已关闭，唤醒所有可能的等待者
+        channel_->closed.store(1);
+        for (ShmRing* ring : { tx_, rx_ }) {
+            ring->data_seq.fetch_add(1);
+            ring->space_seq.fetch_add(1);
+            futexWake(&ring->data_seq);
+            futexWake(&ring->space_seq);
+        }
+        munmap(channel_, sizeof(ShmChannel));
+    }
+
+    void send(const FrameBuffers& buffers) override {
+        for (const auto& buf : buffers) {
+            writeBytes(static_cast<const uint8_t*>(buf.data()), buf.size());
+        }
+        // 整帧写完后只通知一次
+        notify(tx_->data_seq, tx_->reader_waiting);
+    }
+
+    void receive(void* data, size_t len) override {
+        uint8_t* dst = static_cast<uint8_t*>(data);
+        while (len > 0) {
+            uint64_t tail = rx_->tail.load(std::memory_order_relaxed);
+            uint64_t head = rx_->head.load(std::memory_order_acquire);
+            size_t avail = static_cast<size_t>(head - tail);
+            if (avail == 0) {
+                waitFor(rx_->data_seq, rx_->reader_waiting, [&]() {
+                    return rx_->head.load(std::memory_order_acquire) != tail;
+                });
+                continue;
+            }
+
+            size_t chunk = std::min(len, avail);
+            size_t offset = static_cast<size_t>(tail % SHM_RING_BYTES);
+            size_t first = std::min(chunk, SHM_RING_BYTES - offset);
+            memcpy(dst, rx_->data + offset, first);
+            memcpy(dst + first, rx_->data, chunk - first);
+            rx_->tail.store(tail + chunk, std::memory_order_release);
+
+            dst += chunk;
+            len -= chunk;
+            notify(rx_->space_seq, rx_->writer_waiting);
+        }
+    }
+
+    bool isOpen() const override { return channel_->closed.load() == 0; }
+
+    std::string describe() const override { return desc_; }
+
+private:
+    ShmChannel* channel_;
+    ShmRing* tx_;
+    ShmRing* rx_;
+    std::string desc_;
+
+    void writeBytes(const uint8_t* src, size_t len) {
+        while (len > 0) {
+            uint64_t head = tx_->head.load(std::memory_order_relaxed);
+            uint64_t tail = tx_->tail.load(std::memory_order_acquire);
+            size_t space = SHM_RING_BYTES - static_cast<size_t>(head - tail);
+            if (space == 0) {
+                // 环已满：先让对端看到已写入的数据，再等待空间
+                notify(tx_->data_seq, tx_->reader_waiting);
+                waitFor(tx_->space_seq, tx_->writer_waiting, [&]() {
+                    return tx_->tail.load(std::memory_order_acquire) != tail;
+                });
+                continue;
+            }
+
+            size_t chunk = std::min(len, space);
+            size_t offset = static_cast<size_t>(head % SHM_RING_BYTES);
+            size_t first = std::min(chunk, SHM_RING_BYTES - offset);
+            memcpy(tx_->data + offset, src, first);
+            memcpy(tx_->data, src + first, chunk - first);
+            tx_->head.store(head + chunk, std::memory_order_release);
+
+            src += chunk;
+            len -= chunk;
+        }
+    }
+
+    // 发布一次状态变化；只有对端在 futex 上睡眠时才进行系统调用
+    static void notify(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiting) {
+        seq.fetch_add(1, std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_seq_cst)) {
+            futexWake(&seq);
+        }
+    }
+
+    // 等待 ready() 成立：先自旋，再在 seq 上睡眠
+    template <typename Pred>
+    void waitFor(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiting, Pred ready) {
+        // 单核机器上自旋只会占用对端的时间片，直接睡眠
+        static const int spin = std::thread::hardware_concurrency() > 1 ? SHM_SPIN_ITERATIONS : 0;
+        for (int i = 0; i < spin; i++) {
+            if (ready()) return;
+            cpuRelax();
+        }
+        while (true) {
+            uint32_t observed = seq.load(std::memory_order_seq_cst);
+            waiting.store(1, std::memory_order_seq_cst);
+            if (ready()) {
+                waiting.store(0);
+                return;
+            }
+            if (channel_->closed.load()) {
+                waiting.store(0);
+                throw std::runtime_error("shared memory connection closed");
+            }
+            futexWait(&seq, observed, SHM_WAIT_TIMEOUT_MS);
+            waiting.store(0);
+        }
+    }
+};
+
+class ShmListener : public TransportListener {
+public:
+    explicit ShmListener(const std::string& name) : name_("/" + name), accepted_(0) {
+        // 清理上次运行遗留的控制区
+        shm_unlink(name_.c_str());
+        control_ = static_cast<ShmControl*>(mapShm(name_, sizeof(ShmControl), true));
+        control_->requested.store(0);
+        control_->connect_seq.store(0);
+        control_->magic.store(SHM_MAGIC);
+    }
+
+    ~ShmListener() override {
+        munmap(control_, sizeof(ShmControl));
+        shm_unlink(name_.c_str());
+    }
+
+    // 槽位按申请顺序接受。客户端申请槽位后、创建通道前退出时，该槽位永远不会就绪：
+    // 超过 SHM_CONNECT_TIMEOUT_MS 后跳过它，后面的客户端不会一直排在它之后
+    std::unique_ptr<Transport> accept() override {
+        while (true) {
+            uint32_t slot = accepted_;
+            std::string channel_name = name_ + "." + std::to_string(slot);
+            bool requested = false;
+            std::chrono::steady_clock::time_point requested_at;
+
+            while (true) {
+                uint32_t observed = control_->connect_seq.load();
+                if (slot < control_->requested.load()) {
+                    ShmChannel* channel = openClientChannel(channel_name);
+                    if (channel) {
+                        // 双方都已映射，名字不再需要
+                        accepted_++;
+                        shm_unlink(channel_name.c_str());
+                        return std::unique_ptr<Transport>(new ShmTransport(channel, true, "shm:" + channel_name));
+                    }
+
+                    auto now = std::chrono::steady_clock::now();
+                    if (!requested) {
+                        requested = true;
+                        requested_at = now;
+                    }
+                    else if (now - requested_at > std::chrono::milliseconds(SHM_CONNECT_TIMEOUT_MS)) {
+                        std::cerr << "Skipping shared memory slot " << channel_name
+                                  << ": client did not create its channel" << std::endl;
+                        accepted_++;
+                        shm_unlink(channel_name.c_str());
+                        break;
+                    }
+                }
+                futexWait(&control_->connect_seq, observed, SHM_WAIT_TIMEOUT_MS);
+            }
+        }
+    }
+
+    std::string describe() const override { return "shm:" + name_; }
+
+private:
+    std::string name_;
+    ShmControl* control_;
+    uint32_t accepted_;
+};
+
+std::unique_ptr<Transport> connectShm(const std::string& name) {
+    std::string control_name = "/" + name;
+    auto* control = static_cast<ShmControl*>(mapShm(control_name, sizeof(ShmControl), false));
+    if (control->magic.load() != SHM_MAGIC) {
+        munmap(control, sizeof(ShmControl));
+        throw std::runtime_error("shared memory endpoint " + control_name + " is not a storage server");
+    }
+
+    uint32_t slot = control->requested.fetch_add(1);
+    std::string channel_name = control_name + "." + std::to_string(slot);
+    shm_unlink(channel_name.c_str());
+
+    ShmChannel* channel = nullptr;
+    try {
+        channel = static_cast<ShmChannel*>(mapShm(channel_name, sizeof(ShmChannel), true));
+    }
+    catch (...) {
+        munmap(control, sizeof(ShmControl));
+        throw;
+    }
+    // 新建的共享内存已清零，只需在最后发布 magic
+    channel->magic.store(SHM_MAGIC, std::memory_order_release);
+
+    control->connect_seq.fetch_add(1);
+    futexWake(&control->connect_seq);
+    munmap(control, sizeof(ShmControl));
+
+    return std::unique_ptr<Transport>(new ShmTransport(channel, false, "shm:" + channel_name));
+}
+
+bool hasPrefix(const std::string& s, const char* prefix) {
+    return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+} // namespace
+
+// ================================
+// 工厂函数
+// ================================
+
+std::unique_ptr<Transport> connectTransport(const std::string& endpoint, int port) {
+    if (hasPrefix(endpoint, "unix:")) {
+        std::string path = endpoint.substr(5);
+        auto io = std::make_shared<asio::io_context>();
+        unix_stream::socket socket(*io);
+        socket.connect(unix_stream::endpoint(path));
+        return std::unique_ptr<Transport>(new UnixTransport(io, std::move(socket), endpoint));
+    }
+
+    if (hasPrefix(endpoint, "shm:")) {
+        return connectShm(endpoint.substr(4));
+    }
+
+    std::string host = hasPrefix(endpoint, "tcp:") ? endpoint.substr(4) : endpoint;
+    auto io = std::make_shared<asio::io_context>();
+    tcp::resolver resolver(*io);
+
+    // 解析服务器地址并连接
+    auto endpoints = resolver.resolve(host, std::to_string(port));
+    tcp::socket socket(*io);
+    asio::connect(socket, endpoints);
+    return std::unique_ptr<Transport>(new TcpTransport(io, std::move(socket),
+        "tcp:" + host + ":" + std::to_string(port)));
+}
+
+std::unique_ptr<TransportListener> listenTransport(const std::string& endpoint, int port) {
+    if (hasPrefix(endpoint, "unix:")) {
+        return std::unique_ptr<TransportListener>(new UnixListener(endpoint.substr(5)));
+    }
+
+    if (hasPrefix(endpoint, "shm:")) {
+        return std::unique_ptr<TransportListener>(new ShmListener(endpoint.substr(4)));
+    }
+
+    std::string host = hasPrefix(endpoint, "tcp:") ? endpoint.substr(4) : endpoint;
+    return std::unique_ptr<TransportListener>(new TcpListener(host, port));
+}
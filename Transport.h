@@ -0,0 +1,96 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <array>
+#include <memory>
+#include <string>
+#include <boost/asio/buffer.hpp>
+
+/*
+ * Transport.h
+ * ----------------------------------------
+ * 客户端 sendRequest 与服务器 handleClient 之下的可插拔传输层。
+ *
+ * 端点字符串决定使用哪种传输：
+ *   "127.0.0.1" / "tcp:127.0.0.1"  -> TCP（配合端口号）
+ *   "unix:/tmp/oram.sock"          -> AF_UNIX 流式套接字
+ *   "shm:oram"                     -> 共享内存环形缓冲区（futex 通知）
+ *
+ * 同机部署时使用 unix/shm 可绕过内核 TCP 协议栈，
+ * 使本地吞吐量反映的是 ORAM 本身的开销。
+ */
+
+// 一次发送的分段列表：帧头 + 最多3个负载段，长度为0的分段会被忽略。
+// 固定容量，发送路径上不需要分配内存。
+typedef std::array<boost::asio::const_buffer, 4> FrameBuffers;
+
+/**
+ * @class Transport
+ * @brief 一条双向字节流连接
+ *
+ * 所有实现都是阻塞式的；连接断开或出错时抛出 std::exception。
+ */
+class Transport {
+public:
+    virtual ~Transport() = default;
+
+    /**
+     * @brief 聚合发送所有分段（尽量一次系统调用）
+     */
+    virtual void send(const FrameBuffers& buffers) = 0;
+
+    /**
+     * @brief 精确接收 len 字节
+     */
+    virtual void receive(void* data, size_t len) = 0;
+
+    /**
+     * @brief 在等待一条新消息之前调用（TCP 实现在此设置一次 QUICKACK）
+     */
+    virtual void prepareReceive() {}
+
+    /**
+     * @brief 连接是否可用
+     */
+    virtual bool isOpen() const = 0;
+
+    /**
+     * @brief 用于日志输出的连接描述
+     */
+    virtual std::string describe() const = 0;
+};
+
+/**
+ * @class TransportListener
+ * @brief 服务器端监听器，接受新的 Transport 连接
+ */
+class TransportListener {
+public:
+    virtual ~TransportListener() = default;
+
+    /**
+     * @brief 阻塞等待下一个客户端连接
+     */
+    virtual std::unique_ptr<Transport> accept() = 0;
+
+    /**
+     * @brief 监听地址描述
+     */
+    virtual std::string describe() const = 0;
+};
+
+/**
+ * @brief 按端点字符串连接服务器
+ * @param endpoint 端点（见文件头说明）
+ * @param port TCP 端口（unix/shm 忽略）
+ */
+std::unique_ptr<Transport> connectTransport(const std::string& endpoint, int port);
+
+/**
+ * @brief 按端点字符串创建服务器监听器
+ * @param endpoint 端点（TCP 时为绑定地址，空串表示所有地址）
+ * @param port TCP 端口（unix/shm 忽略）
+ */
+std::unique_ptr<TransportListener> listenTransport(const std::string& endpoint, int port);
+
+#endif // TRANSPORT_H
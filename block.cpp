@@ -1,5 +1,6 @@
 #include "block.h"
 #include <cstring> 
+#include <utility>
 
 block::block()
     :leaf_id(-1), blockindex(-1), data()
@@ -7,11 +8,11 @@ block::block()
 }
 
 block::block(int leaf_id, int blockindex, vector<char> data)
-    :leaf_id(leaf_id), blockindex(blockindex), data(data)
+    :leaf_id(leaf_id), blockindex(blockindex), data(std::move(data))
 {
 }
 
-int block::GetBlockindex()
+int block::GetBlockindex() const
 {
     return blockindex;
 }
@@ -21,7 +22,7 @@ void block::SetBlockindex(int blockindex)
     this->blockindex = blockindex;
 }
 
-int block::GetLeafid()
+int block::GetLeafid() const
 {
     return leaf_id;
 }
@@ -31,7 +32,7 @@ void block::SetLeafid(int lead_id)
     this->leaf_id = lead_id;
 }
 
-vector<char> block::GetData() const
+const vector<char>& block::GetData() const
 {
     return data;
 }
@@ -40,3 +41,8 @@ void block::SetData(vector<char> data)
 {
     this->data = data;
 }
+
+void block::AssignData(const char* src, size_t len)
+{
+    this->data.assign(src, src + len);
+}
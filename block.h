@@ -16,12 +16,14 @@ private:
 public:
     block();
     block(int leaf_id, int blockindex, vector<char> data);
-    int GetBlockindex();
+    int GetBlockindex() const;
     void SetBlockindex(int blockindex);
-    int GetLeafid();
+    int GetLeafid() const;
     void SetLeafid(int lead_id);
-    vector<char> GetData() const;
+    const vector<char>& GetData() const;
     void SetData(vector<char> data);
+    // 原地覆盖数据，复用已有容量（网络收包路径使用）
+    void AssignData(const char* src, size_t len);
     bool IsDummy() const {
         return blockindex == -1; 
     }
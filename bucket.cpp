@@ -2,6 +2,7 @@
 #include"param.h"
 #include<random>
 #include<cmath>
+#include<ctime>
 
 bucket::bucket() :Z(realBlockEachbkt), S(dummyBlockEachbkt), blocks(Z + S, dummyBlock), count(0), ptrs(Z + S, -1), valids(Z + S, 1)
 {
@@ -15,13 +16,14 @@ bucket::bucket(int Z, int S)
 
 int bucket::GetDummyblockOffset()
 {
-	vector<int> dummyoffset;
+	// 先统计可用dummy数量，再随机选取第k个，避免每次分配临时数组
+	int dummy_count = 0;
 	for (int i = 0; i < (Z + S); i++)
 	{
 		if (ptrs[i] == -1 && valids[i] == 1)
-			dummyoffset.push_back(i);
+			dummy_count++;
 	}
-	if (dummyoffset.empty())
+	if (dummy_count == 0)
 	{
 		printf("no valid dummyblock");
 		return -1;
@@ -29,7 +31,13 @@ int bucket::GetDummyblockOffset()
 
 	// 随机数引擎（用时间做种子）
 	static std::mt19937 rng(static_cast<unsigned>(time(nullptr)));
-	std::uniform_int_distribution<int> dist(0, dummyoffset.size() - 1);
+	std::uniform_int_distribution<int> dist(0, dummy_count - 1);
 
-	return dummyoffset[dist(rng)];
+	int target = dist(rng);
+	for (int i = 0; i < (Z + S); i++)
+	{
+		if (ptrs[i] == -1 && valids[i] == 1 && target-- == 0)
+			return i;
+	}
+	return -1;
 }
\ No newline at end of file
@@ -5,6 +5,9 @@
 #include <iomanip>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include "RingoramStorage.h"
 #include "IRTree.h"
 #include"param.h"
@@ -17,6 +20,20 @@ int main(int argc, char* argv[]) {
     int server_port = 12345;
     if (argc > 1) server_ip = argv[1];
     if (argc > 2) server_port = std::stoi(argv[2]);
+    if (argc > 3) numConnections = std::stoi(argv[3]);   // 连接池大小
+    if (argc > 4) searchFrontierWidth = std::stoi(argv[4]);   // 批量搜索每轮展开的节点数，0 为逐个访问
+    if (argc > 5) obliviousLevelBudget = std::stoi(argv[5]);  // 固定访问次数模式的每层预算，0 为不启用，最大为 S
+    if (argc > 6) nodeCacheLevels = std::stoi(argv[6]);       // 客户端缓存的上层层数，0 为不缓存
+    if (argc > 7) queryBatchSize = std::stoi(argv[7]);        // 每批一起执行的查询数，0 为逐个执行
+    if (argc > 8) queryThreads = std::stoi(argv[8]);          // 并发执行查询的线程数，1 为单线程
+    if (argc > 9) bulkLoadStrategy = std::stoi(argv[9]);      // 批量建树策略：0 按 x 排序，1 STR，2 Hilbert，3 文本感知
+    if (argc > 10) bulkFillFactor = std::stod(argv[10]);      // 批量建树的节点填充比例
+    if (argc > 11) bulkTextTileNodes = std::stoi(argv[11]);   // 文本感知打包每个空间分块的节点数
+    if (argc > 12) buildThreads = std::stoi(argv[12]);        // 批量建树的线程数，0 为全部硬件线程
+    std::string snapshot_file = "";
+    if (argc > 13) snapshot_file = argv[13];                 // 客户端快照文件：存在且与服务器存储一致时直接恢复，运行结束时保存
+    if (argc > 14) odsMode = std::stoi(argv[14]) != 0;       // 1 为不可知数据结构模式：节点叶子保存在父节点中
+    if (argc > 15) knnQueries = std::stoi(argv[15]) != 0;    // 1 为 kNN 查询：按到查询点的距离排序，不限定范围
   
     std::cout << "=== IR-Tree Query Test ===" << std::endl;
     std::cout << "Block size: " << blocksize << " bytes" << std::endl;
@@ -31,12 +48,31 @@ int main(int argc, char* argv[]) {
             server_port
         );
         
-        // 2. 初始化IR-tree
-        std::cout << "Initializing IR-tree..." << std::endl;
-        IRTree tree(storage, 2, 2, 5);
-        
-        // 3. 批量插入数据
-        tree.optimizedBulkInsertFromFile(data_file);
+        // 2. 从快照恢复，或初始化IR-tree并批量插入数据
+        std::unique_ptr<IRTree> tree_ptr;
+        if (!snapshot_file.empty() && std::ifstream(snapshot_file).good()) {
+            std::cout << "Restoring IR-tree from snapshot..." << std::endl;
+            tree_ptr.reset(new IRTree(storage, 2, 2, 5, false));
+            if (!tree_ptr->loadSnapshot(snapshot_file)) {
+                std::cout << "Snapshot not usable, rebuilding" << std::endl;
+                tree_ptr.reset();
+            }
+        }
+        if (!tree_ptr) {
+            // 服务器可能加载了旧的存储文件，重新建树前清空
+            if (!snapshot_file.empty() && !storage->resetServerStore()) {
+                return 1;
+            }
+
+            std::cout << "Initializing IR-tree..." << std::endl;
+            tree_ptr.reset(new IRTree(storage, 2, 2, 5));
+
+            // 3. 批量插入数据
+            tree_ptr->optimizedBulkInsertFromFile(data_file);
+        }
+        IRTree& tree = *tree_ptr;
+        storage->printCompressionStats();
+        storage->printBlockStats();
         
         // 4. 执行查询
 
@@ -50,9 +86,60 @@ int main(int argc, char* argv[]) {
         std::vector<std::chrono::nanoseconds> query_times;
         std::vector<double> query_bandwidths;  // 存储每个查询的带宽(KB)
         std::vector<size_t> query_blocks;      // 存储每个查询的块数
+        std::vector<double> query_nodes;       // 存储每个查询出队处理的节点数
         std::string line;
         int query_count = 0;
 
+        // 批量执行：攒够 queryBatchSize 个查询后一起执行，共享节点读取；
+        // 多线程执行：查询分给 queryThreads 个线程并发执行（未设置批大小时所有查询一起提交）。
+        // 每个查询的时间按整批平均分摊
+        // kNN 查询逐个执行（批量与多线程执行只支持范围查询）
+        bool collect_queries = !knnQueries && (queryBatchSize > 0 || queryThreads > 1);
+        std::vector<Query> pending_queries;
+        auto run_batch = [&]() {
+            if (pending_queries.empty()) return;
+
+            size_t n = pending_queries.size();
+            std::vector<SearchStats> stats(n);
+            std::vector<std::vector<TreeHeapEntry>> batch_results;
+
+            auto start_time = std::chrono::high_resolution_clock::now();
+            if (queryThreads > 1) {
+                batch_results = tree.searchParallel(pending_queries, queryThreads, &stats);
+            }
+            else {
+                // 共享读取的块数按查询平均分摊
+                SearchStats batch_stats;
+                batch_results = tree.searchBatch(pending_queries, &batch_stats);
+                for (auto& query_stats : stats) {
+                    query_stats.blocks = batch_stats.blocks / static_cast<int>(n);
+                    query_stats.nodes_visited = batch_stats.nodes_visited / static_cast<int>(n);
+                }
+            }
+            auto batch_time = std::chrono::high_resolution_clock::now() - start_time;
+
+            for (size_t q = 0; q < n; q++) {
+                query_times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(batch_time / n));
+                query_bandwidths.push_back(stats[q].blocks * storage->getNodeBlockBytes() / 1024.0);
+                query_blocks.push_back(stats[q].blocks);
+                query_nodes.push_back(stats[q].nodes_visited);
+
+                if (show_details) {
+                    std::cout << "QUERY: '" << pending_queries[q].getKeywords()[0] << "' - "
+                              << batch_results[q].size() << " documents found" << std::endl;
+                    for (size_t i = 0; i < batch_results[q].size(); i++) {
+                        const auto& result = batch_results[q][i];
+                        if (result.isData()) {
+                            std::cout << "  " << (i + 1) << ". Doc " << result.document->getId()
+                                      << " - Score: " << result.score
+                                      << " - '" << result.document->getText() << "'" << std::endl;
+                        }
+                    }
+                }
+            }
+            pending_queries.clear();
+        };
+
         while (std::getline(query_file, line)) {
             if (line.empty()) continue;
 
@@ -74,12 +161,24 @@ int main(int argc, char* argv[]) {
                 MBR search_scope({ x - epsilon, y - epsilon }, 
                                  { x + epsilon, y + epsilon });
 
-                auto query_time = tree.getRunTime(text, search_scope, 10, show_details);
+                if (collect_queries) {
+                    pending_queries.push_back(Query({ text }, search_scope, 10, 0.5));
+                    if (queryBatchSize > 0 && static_cast<int>(pending_queries.size()) >= queryBatchSize) {
+                        run_batch();
+                    }
+                    continue;
+                }
+
+                SearchStats stats;
+                auto query_time = knnQueries
+                    ? tree.getNearestRunTime(text, { x, y }, 10, show_details, &stats)
+                    : tree.getRunTime(text, search_scope, 10, show_details, &stats);
                 query_times.push_back(query_time);
 
                 // 计算这个查询的带宽和块数
-                query_bandwidths.push_back(tree.search_blocks * blocksize / 1024);
-                query_blocks.push_back(tree.search_blocks);
+                query_bandwidths.push_back(stats.blocks * storage->getNodeBlockBytes() / 1024.0);
+                query_blocks.push_back(stats.blocks);
+                query_nodes.push_back(stats.nodes_visited);
                 
                 if (show_details) {
                     std::cout << "Query completed in " 
@@ -89,6 +188,7 @@ int main(int argc, char* argv[]) {
             }
         }
 
+        run_batch();
         query_file.close();
 
         // 5. 性能统计
@@ -96,11 +196,13 @@ int main(int argc, char* argv[]) {
             std::chrono::nanoseconds total_time = std::chrono::nanoseconds::zero();
             double total_bandwidth_kb = 0.0;
             size_t total_blocks = 0;
+            double total_nodes = 0.0;
 
             for (size_t i = 0; i < query_times.size(); i++) {
                 total_time += query_times[i];
                 total_bandwidth_kb += query_bandwidths[i];
                 total_blocks += query_blocks[i];
+                total_nodes += query_nodes[i];
             }
 
             double total_seconds = double(total_time.count()) * std::chrono::nanoseconds::period::num /
@@ -119,6 +221,19 @@ int main(int argc, char* argv[]) {
             std::cout << "Average time: " << std::fixed << std::setprecision(3) 
                       << avg_seconds << " seconds" << std::endl;
 
+            // 延迟分位数（最近秩法）
+            std::vector<std::chrono::nanoseconds> sorted_times = query_times;
+            std::sort(sorted_times.begin(), sorted_times.end());
+            auto percentile = [&sorted_times](double p) {
+                size_t rank = static_cast<size_t>(std::ceil(p * sorted_times.size()));
+                size_t index = rank > 0 ? rank - 1 : 0;
+                return std::chrono::duration<double>(sorted_times[index]).count();
+            };
+            std::cout << "Latency p50: " << std::fixed << std::setprecision(3)
+                      << percentile(0.50) << " seconds" << std::endl;
+            std::cout << "Latency p99: " << std::fixed << std::setprecision(3)
+                      << percentile(0.99) << " seconds" << std::endl;
+
             // 格式化带宽输出
             std::cout << "Total bandwidth: " << std::fixed << std::setprecision(0) 
                       << total_bandwidth_kb << " KB";
@@ -135,6 +250,15 @@ int main(int argc, char* argv[]) {
             std::cout << "Total blocks: " << total_blocks << " blocks" << std::endl;
             std::cout << "Average blocks: " << std::fixed << std::setprecision(1) 
                       << avg_blocks << " blocks per query" << std::endl;
+            auto blocks_range = std::minmax_element(query_blocks.begin(), query_blocks.end());
+            std::cout << "Blocks per query (min/max): " << *blocks_range.first
+                      << " / " << *blocks_range.second << std::endl;
+            std::cout << "Average nodes visited: " << std::fixed << std::setprecision(1)
+                      << total_nodes / query_times.size() << " nodes per query" << std::endl;
+            std::cout << "Cached tree levels: " << tree.upper_cache.cachedLevels()
+                      << " (" << tree.upper_cache.size() << " nodes, "
+                      << tree.upper_cache.memoryBytes() / 1024 << " KB, "
+                      << tree.upper_cache.hits() << " hits)" << std::endl;
             
             // QPS（每秒查询数）
             double qps = query_times.size() / total_seconds;
@@ -147,6 +271,11 @@ int main(int argc, char* argv[]) {
             std::cout << "No valid queries found in the file." << std::endl;
         }
         
+        // 6. 保存快照（查询也会改变 ORAM 状态，所以在最后保存）
+        if (!snapshot_file.empty() && !tree.saveSnapshot(snapshot_file)) {
+            std::cerr << "Warning: Snapshot not saved" << std::endl;
+        }
+
         std::cout << "\nTest completed successfully!" << std::endl;
         
     } catch (const std::exception& e) {
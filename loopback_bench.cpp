@@ -0,0 +1,193 @@
+// 回环请求路径基准：统计稳态下每个请求的堆分配次数与耗时
+//
+// 用法：./loopback_bench [端点] [请求数] [连接数]
+//   端点默认 shm:oram_loopback_bench，也可以是 unix:/tmp/oram_bench.sock 或 tcp:127.0.0.1（端口 12399）
+//
+// 替身服务器（StorageService，见 startLocalServer）与客户端运行在同一进程中，
+// 全局 operator new 计数同时覆盖客户端连接池与服务器处理线程。
+// 第一部分只测请求路径（帧头 + 负载分段 + 复用的收发缓冲区），稳态下应为 0 次分配；
+// 第二部分测完整的 ORAM 访问（ringoram::access），其中解密结果、stash 中的块
+// 和返回给调用方的数据仍按块分配，输出的次数用于对比，不要求为 0。
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include "ConnectionPool.h"
+#include "NetProtocol.h"
+#include "StorageService.h"
+#include "bucket.h"
+#include "param.h"
+#include "ringoram.h"
+
+namespace {
+
+std::atomic<uint64_t> g_allocations(0);
+
+const int BENCH_TCP_PORT = 12399;
+const int BENCH_POSITIONS = 64;     // 请求路径部分轮流读写的 bucket 数
+const int ORAM_BLOCKS = 256;        // ORAM 部分写入并反复读取的块数
+
+// 一个装满真实块的 bucket，序列化后作为 WRITE_BUCKET 的负载
+std::vector<uint8_t> makeBucketPayload() {
+    bucket bkt;
+    for (int i = 0; i < realBlockEachbkt; i++) {
+        bkt.blocks[i] = block(i, i, std::vector<char>(blocksize / 2, static_cast<char>('a' + i)));
+        bkt.ptrs[i] = i;
+    }
+    return serialize_bucket(bkt);
+}
+
+void report(const char* label, uint64_t allocations, size_t operations, std::chrono::nanoseconds elapsed) {
+    std::cout << std::left << std::setw(28) << label
+              << std::right << std::fixed << std::setprecision(3)
+              << static_cast<double>(allocations) / operations << " allocs/op, "
+              << std::setprecision(2) << elapsed.count() / 1000.0 / operations << " us/op" << std::endl;
+}
+
+} // namespace
+
+// 计数的全局分配函数（delete 保持默认语义）
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+int main(int argc, char* argv[]) {
+    std::string endpoint = argc > 1 ? argv[1] : "shm:oram_loopback_bench";
+    int requests = argc > 2 ? std::atoi(argv[2]) : 20000;
+    int connections = argc > 3 ? std::atoi(argv[3]) : 1;
+    if (requests < 1) requests = 1;
+
+    if (!startLocalServer(endpoint, BENCH_TCP_PORT)) {
+        return 1;
+    }
+
+    // ==============================
+    // 1. 请求路径：WRITE_BUCKET / READ_BUCKET / 批量 READ_BUCKET
+    // ==============================
+    {
+        ConnectionPool pool(endpoint, BENCH_TCP_PORT, connections);
+        std::vector<uint8_t> payload = makeBucketPayload();
+        std::vector<uint8_t> response;
+        std::string error;
+
+        int path_length = OramL + 1;
+        std::vector<int32_t> batch_positions(path_length);
+        std::vector<std::vector<uint8_t>> batch_responses(path_length);
+        std::vector<PoolRequest> batch(path_length);
+
+        auto writeBucket = [&](int32_t position) {
+            return pool.request(WRITE_BUCKET, { boost::asio::buffer(&position, sizeof(position)),
+                                                boost::asio::buffer(payload) }, response, error);
+        };
+        auto readBucket = [&](int32_t position) {
+            return pool.request(READ_BUCKET, { boost::asio::buffer(&position, sizeof(position)) }, response, error);
+        };
+        auto readBatch = [&](int first) {
+            for (int i = 0; i < path_length; i++) {
+                batch_positions[i] = (first + i) % BENCH_POSITIONS;
+                batch[i].type = READ_BUCKET;
+                batch[i].segments = { boost::asio::buffer(&batch_positions[i], sizeof(int32_t)),
+                                      boost::asio::const_buffer(), boost::asio::const_buffer() };
+                batch[i].response = &batch_responses[i];
+            }
+            return pool.requestBatch(batch.data(), batch.size());
+        };
+
+        // 预热：每个位置写入、读取一次，收发缓冲区与服务器端 block 数据扩容到稳定大小
+        for (int i = 0; i < BENCH_POSITIONS; i++) {
+            if (!writeBucket(i) || !readBucket(i) || !readBatch(i)) {
+                std::cerr << "Warm-up request failed: " << error << std::endl;
+                return 1;
+            }
+        }
+
+        std::cout << "=== Request path (" << pool.describe() << ", " << requests << " requests) ===" << std::endl;
+
+        bool ok = true;
+        uint64_t before = g_allocations.load();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < requests; i++) ok = writeBucket(i % BENCH_POSITIONS) && ok;
+        auto elapsed = std::chrono::high_resolution_clock::now() - start;
+        report("WRITE_BUCKET", g_allocations.load() - before, requests, elapsed);
+
+        before = g_allocations.load();
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < requests; i++) ok = readBucket(i % BENCH_POSITIONS) && ok;
+        elapsed = std::chrono::high_resolution_clock::now() - start;
+        report("READ_BUCKET", g_allocations.load() - before, requests, elapsed);
+
+        int batches = std::max(1, requests / path_length);
+        before = g_allocations.load();
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < batches; i++) ok = readBatch(i) && ok;
+        elapsed = std::chrono::high_resolution_clock::now() - start;
+        report("READ_BUCKET batch (L+1)", g_allocations.load() - before, static_cast<size_t>(batches) * path_length, elapsed);
+
+        if (!ok) {
+            std::cerr << "Request failed: " << error << std::endl;
+            return 1;
+        }
+
+        // 第二部分的 ORAM 从只有 dummy 的初始状态开始
+        if (!pool.request(STORE_RESET, {}, response, error)) {
+            std::cerr << "STORE_RESET failed: " << error << std::endl;
+            return 1;
+        }
+    }
+
+    // ==============================
+    // 2. 完整 ORAM 访问
+    // ==============================
+    {
+        ringoram oram(totalnumRealblock, endpoint, BENCH_TCP_PORT, cacheLevel, connections);
+        // 加密后需要补齐到 16 字节，负载留出余量，不超过服务器的单块上限
+        std::vector<char> data(blocksize / 2, 'x');
+        for (int i = 0; i < ORAM_BLOCKS; i++) {
+            oram.access(i, ringoram::WRITE, data);
+        }
+        for (int i = 0; i < ORAM_BLOCKS; i++) {
+            oram.access(i, ringoram::READ, {});
+        }
+
+        int accesses = std::max(1, requests / 10);
+        std::cout << "=== ORAM access (" << accesses << " reads) ===" << std::endl;
+        uint64_t before = g_allocations.load();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < accesses; i++) {
+            oram.access(i % ORAM_BLOCKS, ringoram::READ, {});
+        }
+        auto elapsed = std::chrono::high_resolution_clock::now() - start;
+        report("ringoram::access (READ)", g_allocations.load() - before, accesses, elapsed);
+    }
+
+    return 0;
+}
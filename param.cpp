@@ -12,4 +12,40 @@ int EvictRound = 10;
 block dummyBlock(-1, -1, {});
 int maxblockEachbkt = realBlockEachbkt + dummyBlockEachbkt;
 
-int cacheLevel = 3;
\ No newline at end of file
+int cacheLevel = 3;
+
+int numConnections = 4;
+
+bool compactNodeFormat = true;
+
+double keywordFilterFpRate = 0.02;
+
+bool separateDocuments = true;
+
+int bulkLoadStrategy = 1;
+
+double bulkFillFactor = 1.0;
+
+int bulkTextTileNodes = 32;
+
+double bulkTextQueryExtent = 0.02;
+
+bool compressNodes = true;
+int nodeSizeClass = 640;
+
+int searchFrontierWidth = 0;
+
+int obliviousLevelBudget = 0;
+
+int nodeCacheLevels = 3;
+size_t nodeCacheBytes = 4 << 20;
+
+int queryBatchSize = 0;
+
+int queryThreads = 1;
+
+int buildThreads = 0;
+
+bool odsMode = false;
+
+bool knnQueries = false;
@@ -40,4 +40,67 @@ extern int maxblockEachbkt;
 
 extern int cacheLevel;
 
+// 客户端到服务器的并行连接数（连接池大小）
+extern int numConnections;
+
+// 节点序列化格式：true 为以词项 ID 编码的紧凑格式，false 为旧格式（见 NodeSerializer.h）
+extern bool compactNodeFormat;
+
+// 内部节点中子节点关键词过滤器的目标误报率（见 KeywordFilter.h），误报只会多访问一个子节点
+extern double keywordFilterFpRate;
+
+// 完整文档是否单独存放：叶子节点只保存打分需要的位置和词频，
+// 查询结束时只读取最终 k 个结果的完整文档（每次查询固定读取 k 块）
+extern bool separateDocuments;
+
+// 批量建树的打包策略（见 BulkLoader.h）：0 按 x 排序，1 STR，2 Hilbert 曲线，3 文本感知 STR
+extern int bulkLoadStrategy;
+
+// 文本感知打包每个空间分块包含的节点数：越大同一节点的关键词越集中，节点 MBR 也越大
+extern int bulkTextTileNodes;
+
+// 文本感知打包估算代价时假设的查询范围边长（与坐标同单位）
+extern double bulkTextQueryExtent;
+
+// 批量建树时每个节点的填充比例 (0, 1]，小于 1 时为之后的逐条插入预留空间
+extern double bulkFillFactor;
+
+// 节点块是否压缩（见 BlockCodec.h）
+extern bool compressNodes;
+
+// 压缩后节点块与文档块的大小档位（字节，16的倍数），每个块的密文恰为该长度。
+// 压缩后超出档位的节点或文档写入失败，取值须能容纳最大的块
+extern int nodeSizeClass;
+
+// 批量搜索每轮展开的节点数，0（默认）表示逐个访问子节点的最佳优先搜索，大于 0 时启用批量搜索
+extern int searchFrontierWidth;
+
+// 固定访问次数查询模式下根以下每层访问的节点数（不足用 dummy 补齐），0 表示不启用。
+// 所有查询的访问次数相同，候选超过预算时按上界截断，可能降低召回。
+// 每层一个并行批次，预算最大为 S（dummyBlockEachbkt），更大的值被截断
+extern int obliviousLevelBudget;
+
+// 客户端缓存的 IRTree 上层层数（从根开始计，整层缓存），0 表示不缓存
+extern int nodeCacheLevels;
+
+// 客户端节点缓存的内存上限（字节），超出时丢弃最低的缓存层
+extern size_t nodeCacheBytes;
+
+// 客户端每批一起执行的查询数（IRTree::searchBatch），0 表示逐个执行
+extern int queryBatchSize;
+
+// 客户端并发执行查询的线程数（IRTree::searchParallel），1 表示单线程逐个执行
+extern int queryThreads;
+
+// 批量建树的线程数（解析、分词、打包、序列化和加密），0 表示使用全部硬件线程
+extern int buildThreads;
+
+// 不可知数据结构（ODS）模式：节点块的叶子保存在父节点中，每次读取时由客户端换到新叶子，
+// 新叶子随父节点写回；根节点的叶子单独保存在客户端，节点块不再占用客户端位置映射
+extern bool odsMode;
+
+// 客户端查询方式：true 时每个查询点执行 kNN 查询（IRTree::searchNearest，不限定范围），
+// false 时执行查询点附近固定范围内的 Top-k 查询
+extern bool knnQueries;
+
 #endif
\ No newline at end of file
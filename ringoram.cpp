@@ -1,4 +1,5 @@
 #include "ringoram.h"
+#include "NetProtocol.h"
 #include"CryptoUtil.h"
 #include<random>
 #include "param.h"
@@ -8,180 +9,16 @@
 #include <memory>
 #include <fstream>
 #include <chrono>
-#include <mutex>
-#include <boost/asio.hpp>
-#include <memory>
-#include <sys/socket.h>
-#include <netinet/tcp.h>  
+#include <array>
+#include <algorithm>
+#include "ConnectionPool.h"
+#include "Parallel.h"
+#include "Snapshot.h"
 
 
 using namespace std;
-int ringoram::round = 0;
-int ringoram::G = 0;
 
 namespace asio = boost::asio;
-using asio::ip::tcp;
-
-// ================================
-// 网络通信工具函数
-// ================================
-
-// 全局网络连接对象
-static std::unique_ptr<tcp::socket> g_socket;
-static std::mutex g_socket_mutex;
-static uint32_t g_next_request_id = 1;
-
-// 协议定义（和服务器一样）
-enum RequestType {
-    READ_BUCKET = 1,
-    WRITE_BUCKET = 2,
-    READ_PATH = 3,
-    RESPONSE = 100
-};
-
-struct RequestHeader {
-    uint32_t type;
-    uint32_t request_id;
-    uint32_t data_len;
-    uint32_t reserved;
-};
-
-struct ResponseHeader {
-    uint32_t type;
-    uint32_t request_id;
-    uint32_t result;
-    uint32_t data_len;
-};
-
-
-// 初始化网络连接
-bool initNetworkConnection(const std::string& server_address, int port) {
-    try {
-        asio::io_context io_context;  
-        tcp::resolver resolver(io_context);
-        
-        // 解析服务器地址
-        auto endpoints = resolver.resolve(server_address, std::to_string(port));
-        
-        // 创建socket并连接
-        auto socket = std::make_unique<tcp::socket>(io_context);
-        asio::connect(*socket, endpoints);
-        
-        std::lock_guard<std::mutex> lock(g_socket_mutex);
-        g_socket = std::move(socket);
-        
-        std::cout << "Connected to server: " << server_address << ":" << port << std::endl;
-        return true;
-    }
-    catch (const std::exception& e) {
-        std::cerr << "Failed to connect to server: " << e.what() << std::endl;
-        return false;
-    }
-}
-
-
-inline int64_t duration_us(
-    const std::chrono::high_resolution_clock::time_point& end,
-    const std::chrono::high_resolution_clock::time_point& start) {
-    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
-}
-
-// 发送请求并接收响应
-bool sendRequest(uint32_t type, const uint8_t* request_data, size_t request_len,
-                 std::vector<uint8_t>& response_data, std::string& error_msg) {
-    std::lock_guard<std::mutex> lock(g_socket_mutex);
-    
-    if (!g_socket || !g_socket->is_open()) {
-        error_msg = "Network connection is not established or disconnected";
-        return false;
-    }
-    
-    try {
-        auto total_start = std::chrono::high_resolution_clock::now();
-        
-        // 1. 准备请求头
-        RequestHeader req_header;
-        req_header.type = type;
-        req_header.request_id = g_next_request_id++;
-        req_header.data_len = static_cast<uint32_t>(request_len);
-        req_header.reserved = 0;
-        
-        // === TCP优化：设置QUICKACK ===
-        int quickack = 1;
-        setsockopt(g_socket->native_handle(), IPPROTO_TCP, TCP_QUICKACK, &quickack, sizeof(quickack));
-        
-        // 2. 发送请求（一次性发送头和数据）
-        auto send_start = std::chrono::high_resolution_clock::now();
-        
-        if (request_len == 0 || !request_data) {
-            // 只有请求头
-            asio::write(*g_socket, asio::buffer(&req_header, sizeof(req_header)));
-        } else {
-            // 合并发送头和数据
-            std::vector<asio::const_buffer> buffers;
-            buffers.push_back(asio::buffer(&req_header, sizeof(req_header)));
-            buffers.push_back(asio::buffer(request_data, request_len));
-            asio::write(*g_socket, buffers);
-        }
-        auto send_end = std::chrono::high_resolution_clock::now();
-        
-        // 3. 接收响应头
-        auto recv_start = std::chrono::high_resolution_clock::now();
-        
-        // 接收前设置QUICKACK
-        setsockopt(g_socket->native_handle(), IPPROTO_TCP, TCP_QUICKACK, &quickack, sizeof(quickack));
-        ResponseHeader resp_header;
-        asio::read(*g_socket, asio::buffer(&resp_header, sizeof(resp_header)));
-        
-        // 检查响应是否匹配请求
-        if (resp_header.request_id != req_header.request_id) {
-            error_msg = "Response ID mismatch: request=" + std::to_string(req_header.request_id)
-                      + ", response=" + std::to_string(resp_header.request_id);
-            return false;
-        }
-        
-        if (resp_header.type != RESPONSE) {
-            error_msg = "Invalid response type: " + std::to_string(resp_header.type);
-            return false;
-        }
-        
-        if (resp_header.result != 0) {
-            error_msg = "Server operation failed, error code: " + std::to_string(resp_header.result);
-            return false;
-        }
-        
-        // 4. 接收响应数据
-        response_data.clear();
-        if (resp_header.data_len > 0) {
-            // 接收前设置QUICKACK
-            setsockopt(g_socket->native_handle(), IPPROTO_TCP, TCP_QUICKACK, &quickack, sizeof(quickack));
-            response_data.resize(resp_header.data_len);
-            asio::read(*g_socket, asio::buffer(response_data.data(), resp_header.data_len));
-        }
-        auto recv_end = std::chrono::high_resolution_clock::now();
-        auto total_end = recv_end;
-        
-        // 输出客户端视角的耗时
-        // std::cout << "[CLIENT] Type:" << type 
-        //           << " Send:" << duration_us(send_end, send_start)
-        //           << " Recv:" << duration_us(recv_end, recv_start)
-        //           << " Total:" << duration_us(total_end, total_start) << "us" << std::endl;
-        
-        return true;
-    }
-    catch (const std::exception& e) {
-        error_msg = "Network communication error: " + std::string(e.what());
-        return false;
-    }
-}
-
-
-bool sendRequest(uint32_t type, const std::vector<uint8_t>& request_data,
-                 std::vector<uint8_t>& response_data, std::string& error_msg) {
-    return sendRequest(type, request_data.data(), request_data.size(), 
-                      response_data, error_msg);
-}
-
 
 // 析构函数
 ringoram::~ringoram() {
@@ -191,14 +28,18 @@ ringoram::~ringoram() {
 }
 
 
-ringoram::ringoram(int n, const std::string& server_ip, int server_port, int cache_levels)
-    : N(n), 
+ringoram::ringoram(int n, const std::string& server_ip, int server_port, int cache_levels, int connections)
+    : round(0),
+      G(0),
+      rng(std::random_device{}()),
+      N(n), 
       L(static_cast<int>(ceil(log2(N)))), 
       num_bucket((1 << (L + 1)) - 1), 
       num_leaves(1 << L),
       server_ip_(server_ip),
       server_port_(server_port),
-      cache_levels(cache_levels)
+      cache_levels(cache_levels),
+      num_connections_(connections)
 {
     c = 0;
     
@@ -212,7 +53,18 @@ ringoram::ringoram(int n, const std::string& server_ip, int server_port, int cac
     encryption_key = CryptoUtils::generateRandomKey(16);
     crypto = make_shared<CryptoUtils>(encryption_key);
     
-    // 3. 初始化网络连接
+    // 3. 批量请求使用的缓冲区（按路径长度预分配）
+    //    单次访问周期内最多暂存驱逐路径与重排路径各 L+1 个 bucket，批量访问时按需扩容
+    net_batch.resize(2 * (L + 1));
+    net_batch_positions.resize(L + 1);
+    net_batch_rx.resize(2 * (L + 1));
+    net_batch_tx.resize(2 * (L + 1));
+    epoch_write_positions.resize(2 * (L + 1));
+    epoch_write_count = 0;
+    bucket_reads.assign(num_bucket, 0);
+    bucket_written.assign(num_bucket, 0);
+
+    // 4. 初始化网络连接
     try {
         initNetwork();
     } catch (const std::exception& e) {
@@ -220,7 +72,7 @@ ringoram::ringoram(int n, const std::string& server_ip, int server_port, int cac
         throw;  // 重新抛出异常
     }
     
-    cout << "[ORAM] Server: " << server_ip_ << ":" << server_port_ << endl;
+    cout << "[ORAM] Server: " << pool->describe() << endl;
     cout << "[ORAM] Tree depth L = " << L << endl;
     cout << "[ORAM] Number of buckets = " << num_bucket << endl;
     cout << "[ORAM] Number of leaves = " << num_leaves << endl;
@@ -230,7 +82,12 @@ ringoram::ringoram(int n, const std::string& server_ip, int server_port, int cac
 // 网络初始化
 void ringoram::initNetwork() {
 
-    if (!initNetworkConnection(server_ip_, server_port_)) {
+    // server_ip_ 可以是 IP 地址，也可以是 "unix:/path" 或 "shm:name" 形式的端点
+    try {
+        pool.reset(new ConnectionPool(server_ip_, server_port_, num_connections_));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to connect to server: " << e.what() << std::endl;
         throw std::runtime_error("Failed to connect to server at " + 
                                  server_ip_ + ":" + std::to_string(server_port_));
     }
@@ -239,10 +96,8 @@ void ringoram::initNetwork() {
 
 int ringoram::get_random()
 {
-	static std::random_device rd;      // 真随机数种子
-	static std::mt19937 gen(rd());     // 高质量随机数引擎
 	std::uniform_int_distribution<int> dist(0, num_leaves - 1);
-	return dist(gen);
+	return dist(rng);
 }
 
 int ringoram::Path_bucket(int leaf, int level)
@@ -286,238 +141,29 @@ int ringoram::GetBlockOffset(bucket bkt, int blockindex)
 }
 
 
-#pragma pack(push, 1)
-struct SerializedBucketHeader {
-    int32_t Z;
-    int32_t S;
-    int32_t count;
-    int32_t num_blocks;
-};
-
-struct SerializedBlockHeader {
-    int32_t leaf_id;
-    int32_t block_index;
-    int32_t data_size;
-};
-#pragma pack(pop)
-
-// ================================
-// 序列化工具函数
-// ================================
-
-size_t calculate_bucket_size(const bucket& bkt) {
-    
-    size_t size = sizeof(SerializedBucketHeader);
-    
-    // 计算blocks大小
-    size_t blocks_size = 0;
-    for (int i = 0; i < bkt.blocks.size(); i++) {
-        auto& blk = bkt.blocks[i];
-        size_t block_size = sizeof(SerializedBlockHeader) + blk.GetData().size();
-        blocks_size += block_size;
-      
-    }
-    size += blocks_size;
-    
-    // 计算ptrs和valids大小
-    size_t ptrs_valids_size = (bkt.ptrs.size() + bkt.valids.size()) * sizeof(int32_t);
-    size += ptrs_valids_size;
- 
-    return size;
-}
-
-void serialize_block( block& blk, uint8_t* buffer, size_t& offset) {
-  
-    SerializedBlockHeader* header = reinterpret_cast<SerializedBlockHeader*>(buffer + offset);
-    header->leaf_id = blk.GetLeafid();
-    header->block_index = blk.GetBlockindex();
-    
-    const auto& data = blk.GetData();
-    header->data_size = static_cast<int32_t>(data.size());
- 
-    offset += sizeof(SerializedBlockHeader);
-    
-    if (!data.empty()) {
-        memcpy(buffer + offset, data.data(), data.size());
-        offset += data.size();
-    }
-
-}
-
-block deserialize_block(const uint8_t* data, size_t& offset) {
-    const SerializedBlockHeader* header = reinterpret_cast<const SerializedBlockHeader*>(data + offset);
-    offset += sizeof(SerializedBlockHeader);
-    
-    std::vector<char> block_data;
-    if (header->data_size > 0) {
-        block_data.resize(header->data_size);
-        memcpy(block_data.data(), data + offset, header->data_size);
-        offset += header->data_size;
-    }
-    
-    return block(header->leaf_id, header->block_index, block_data);
-}
-
-std::vector<uint8_t> serialize_bucket( bucket& bkt) {
-   
-    try {
-    
-        // 先计算大小
-
-        size_t total_size = calculate_bucket_size(bkt);
-     
-        if (total_size == 0) {
-            std::cerr << "ERROR: Calculated size is 0" << std::endl;
-            return std::vector<uint8_t>();
-        }
-       
-        std::vector<uint8_t> result(total_size);
-      
-        // 序列化 bucket header
-      
-        SerializedBucketHeader* bucket_header = reinterpret_cast<SerializedBucketHeader*>(result.data());
-        bucket_header->Z = bkt.Z;
-        bucket_header->S = bkt.S;
-        bucket_header->count = bkt.count;
-        bucket_header->num_blocks = static_cast<int32_t>(bkt.blocks.size());
-       
-        size_t offset = sizeof(SerializedBucketHeader);
-       
-        // 序列化 blocks
-    
-        for (int i = 0; i < bkt.blocks.size(); i++) {
-          
-            serialize_block(bkt.blocks[i], result.data(), offset);
-       
-        }
-        
-        // 序列化 ptrs 和 valids
-   
-        int num_slots = bkt.Z + bkt.S;
- 
-        // 检查边界
-        if (offset + num_slots * 2 * sizeof(int32_t) > total_size) {
-            std::cerr << "ERROR: Not enough space for ptrs and valids" << std::endl;
-            return std::vector<uint8_t>();
-        }
-        
-        // 序列化 ptrs
-        for (int i = 0; i < num_slots; i++) {
-            *reinterpret_cast<int32_t*>(result.data() + offset) = bkt.ptrs[i];
-            offset += sizeof(int32_t);
-        }
-        
-        // 序列化 valids
-        for (int i = 0; i < num_slots; i++) {
-            *reinterpret_cast<int32_t*>(result.data() + offset) = bkt.valids[i];
-            offset += sizeof(int32_t);
-        }
- 
-        return result;
-        
-    } catch (const std::exception& e) {
-        std::cerr << "serialize_bucket failed with exception: " << e.what() << std::endl;
-        return std::vector<uint8_t>();
-    }
-}
-
-bucket deserialize_bucket(const uint8_t* data, size_t size) {
- 
-    if (size < sizeof(SerializedBucketHeader)) {
-        std::cerr << "  ERROR: Data too small for header" << std::endl;
-        throw std::runtime_error("Invalid bucket data: too small");
-    }
-    
-    const SerializedBucketHeader* bucket_header = reinterpret_cast<const SerializedBucketHeader*>(data);
-  
-    // 创建空的bucket
-    bucket result(0, 0);
-    result.Z = bucket_header->Z;
-    result.S = bucket_header->S;
-    result.count = bucket_header->count;
-    
-    size_t offset = sizeof(SerializedBucketHeader);
- 
-    // 反序列化 blocks
-  
-    for (int i = 0; i < bucket_header->num_blocks && offset < size; i++) {
-        result.blocks.push_back(deserialize_block(data, offset));
-    }
- 
-    //从序列化数据中恢复ptrs和valids
-    int num_slots = result.Z + result.S;
-    result.ptrs.resize(num_slots, -1);
-    result.valids.resize(num_slots, 0);
-    
-    // 检查是否有足够的空间来读取ptrs和valids
-    if (offset + num_slots * 2 * sizeof(int32_t) <= size) {
-     
-        // 反序列化 ptrs
-        for (int i = 0; i < num_slots; i++) {
-            int32_t ptr = *reinterpret_cast<const int32_t*>(data + offset);
-            result.ptrs[i] = ptr;
-            offset += sizeof(int32_t);
-        }
-        
-        // 反序列化 valids
-        for (int i = 0; i < num_slots; i++) {
-            int32_t valid = *reinterpret_cast<const int32_t*>(data + offset);
-            result.valids[i] = valid;
-            offset += sizeof(int32_t);
-        }
-   
-    } else {
-        std::cout << "  WARNING: No ptrs and valids data in serialized bucket" << std::endl;
-    }
-   
-    return result;
-}
-
 void ringoram::ReadBucket(int pos)
 {
     try
     {
-        // 1. 准备请求数据（桶位置）
-        std::vector<uint8_t> request_data(sizeof(int32_t));
-        *reinterpret_cast<int32_t*>(request_data.data()) = static_cast<int32_t>(pos);
+        // 1. 准备请求数据（桶位置，直接从栈上变量发送）
+        int32_t position = static_cast<int32_t>(pos);
         
-        // 2. 发送 READ_BUCKET 请求
-        std::vector<uint8_t> response_data;
+        // 2. 发送 READ_BUCKET 请求，响应写入复用的接收缓冲区
         std::string error_msg;
         
-        if (!sendRequest(READ_BUCKET, request_data, response_data, error_msg)) {
+        if (!pool->request(READ_BUCKET, { asio::buffer(&position, sizeof(position)) }, net_rx_buffer, error_msg)) {
             std::cerr << "Failed to read bucket (network): " << error_msg << std::endl;
             return;
         }
         
         // 3. 检查响应数据大小
-        if (response_data.empty()) {
+        if (net_rx_buffer.empty()) {
             std::cerr << "Empty response for bucket read" << std::endl;
             return;
         }
 
-        // 4. 反序列化bucket
-        bucket remote_bkt = deserialize_bucket(response_data.data(), response_data.size());
-
-        // 5. 将real blocks添加到stash（解密数据）
-        for (int j = 0; j < maxblockEachbkt; j++) {
-            if (remote_bkt.ptrs[j] != -1 && remote_bkt.valids[j] && 
-                !remote_bkt.blocks[j].IsDummy()) {
-                
-                block encrypted_block = remote_bkt.blocks[j];
-                
-                // 解密数据
-                vector<char> decrypted_data = decrypt_data(encrypted_block.GetData());
-                
-                // 创建解密后的block对象
-                block decrypted_block(encrypted_block.GetLeafid(),
-                                        encrypted_block.GetBlockindex(),
-                                        decrypted_data);
-                
-                // 添加到stash
-                stash.push_back(decrypted_block);
-            }
-        }
+        // 4. 反序列化并将real blocks添加到stash
+        AbsorbSerializedBucket(net_rx_buffer.data(), net_rx_buffer.size());
     }
     catch(const std::exception& e)
     {
@@ -525,108 +171,181 @@ void ringoram::ReadBucket(int pos)
     }
 }
 
-bucket ringoram::Read_bucket(int pos)
+void ringoram::AbsorbBucket(const bucket& remote_bkt)
+{
+    // 将real blocks添加到stash（解密数据）
+    for (int j = 0; j < maxblockEachbkt; j++) {
+        if (remote_bkt.ptrs[j] != -1 && remote_bkt.valids[j] && 
+            !remote_bkt.blocks[j].IsDummy()) {
+            
+            const block& encrypted_block = remote_bkt.blocks[j];
+            
+            // 解密数据
+            vector<char> decrypted_data = decrypt_data(encrypted_block.GetData());
+            
+            // 创建解密后的block对象并添加到stash
+            stash.emplace_back(encrypted_block.GetLeafid(),
+                               encrypted_block.GetBlockindex(),
+                               std::move(decrypted_data));
+        }
+    }
+}
+
+bool ringoram::AbsorbSerializedBucket(const uint8_t* data, size_t size)
+{
+    if (!deserialize_bucket_into(data, size, net_rx_bucket)) {
+        std::cerr << "Malformed bucket data" << std::endl;
+        return false;
+    }
+    AbsorbBucket(net_rx_bucket);
+    return true;
+}
+
+void ringoram::EnsureBatchCapacity(int count)
+{
+    if (count > static_cast<int>(net_batch.size())) {
+        net_batch.resize(count);
+        net_batch_rx.resize(count);
+    }
+    if (count > static_cast<int>(net_batch_positions.size())) {
+        net_batch_positions.resize(count);
+    }
+}
+
+bool ringoram::ReadBuckets(const int* positions, int count)
+{
+    EnsureBatchCapacity(count);
+
+    // 每个 bucket 一个独立请求，分散到连接池的各条连接上并行执行
+    for (int i = 0; i < count; i++) {
+        net_batch_positions[i] = static_cast<int32_t>(positions[i]);
+
+        PoolRequest& req = net_batch[i];
+        req.type = READ_BUCKET;
+        req.segments = { asio::buffer(&net_batch_positions[i], sizeof(int32_t)),
+                         asio::const_buffer(), asio::const_buffer() };
+        req.response = &net_batch_rx[i];
+    }
+
+    bool ok = pool->requestBatch(net_batch.data(), count);
+    for (int i = 0; i < count; i++) {
+        if (!net_batch[i].ok) {
+            std::cerr << "Failed to read bucket " << positions[i] << " (network): " << net_batch[i].error << std::endl;
+        }
+        else if (net_batch_rx[i].empty()) {
+            std::cerr << "Empty response for bucket read" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+const bucket& ringoram::Read_bucket(int pos)
 {
     try
     {
-        // 1. 准备请求数据（桶位置）
-        std::vector<uint8_t> request_data(sizeof(int32_t));
-        *reinterpret_cast<int32_t*>(request_data.data()) = static_cast<int32_t>(pos);
+        // 1. 准备请求数据（桶位置，直接从栈上变量发送）
+        int32_t position = static_cast<int32_t>(pos);
         
-        // 2. 发送 READ_BUCKET 请求
-        std::vector<uint8_t> response_data;
+        // 2. 发送 READ_BUCKET 请求，响应写入复用的接收缓冲区
         std::string error_msg;
         
-        if (!sendRequest(READ_BUCKET, request_data, response_data, error_msg)) {
+        if (!pool->request(READ_BUCKET, { asio::buffer(&position, sizeof(position)) }, net_rx_buffer, error_msg)) {
             std::cerr << "Failed to read bucket (network): " << error_msg << std::endl;
-            return bucket();
+            return net_rx_bucket = bucket();
         }
         
         // 3. 检查响应数据大小
-        if (response_data.empty()) {
+        if (net_rx_buffer.empty()) {
             std::cerr << "Empty response for bucket read" << std::endl;
-            return bucket();
+            return net_rx_bucket = bucket();
         }
 
-        // 4. 反序列化bucket
-        bucket remote_bkt = deserialize_bucket(response_data.data(), response_data.size());
-
-        return remote_bkt;
+        // 4. 原地反序列化到复用的bucket
+        if (!deserialize_bucket_into(net_rx_buffer.data(), net_rx_buffer.size(), net_rx_bucket)) {
+            std::cerr << "Malformed bucket data" << std::endl;
+            return net_rx_bucket = bucket();
+        }
+        return net_rx_bucket;
     }
     catch(const std::exception& e)
     {
         std::cerr << "Exception in ReadBucket: " << e.what() << std::endl;
-        return bucket();
+        return net_rx_bucket = bucket();
     }   
 }
 
 
-void ringoram::WriteBucket(int position)
+bool ringoram::PrepareBucket(int position, std::vector<uint8_t>& out)
 {
-	try
-    {
-        int level = GetlevelFromPos(position);
-        vector<block> blocksTobucket;
-
-        // 从stash中选择可以放在这个bucket的块
-        for (auto it = stash.begin(); it != stash.end() && blocksTobucket.size() < realBlockEachbkt; ) {
-	        int target_leaf = it->GetLeafid();
-	        int target_bucket_pos = Path_bucket(target_leaf, level);
-	        if (target_bucket_pos == position) {
-		        // 对要写回当前bucket的块进行加密
-		        if (!it->IsDummy()) {
-			        vector<char> plain_data = it->GetData();  // 当前是明文
-			        vector<char> encrypted_data = encrypt_data(plain_data);
-
-			        // 创建加密后的block
-			        block encrypted_block(it->GetLeafid(), it->GetBlockindex(), encrypted_data);
-			        blocksTobucket.push_back(encrypted_block);
-		        }
-		        it = stash.erase(it);
-	        }
-	        else {
-		        ++it;
+    int level = GetlevelFromPos(position);
+    vector<block> blocksTobucket;
+
+    // 从stash中选择可以放在这个bucket的块
+    for (auto it = stash.begin(); it != stash.end() && blocksTobucket.size() < realBlockEachbkt; ) {
+        int target_leaf = it->GetLeafid();
+        int target_bucket_pos = Path_bucket(target_leaf, level);
+        if (target_bucket_pos == position && !pinned.count(it->GetBlockindex())) {
+	        // 对要写回当前bucket的块进行加密
+	        if (!it->IsDummy()) {
+		        vector<char> plain_data = it->GetData();  // 当前是明文
+		        vector<char> encrypted_data = encrypt_data(plain_data);
+
+		        // 创建加密后的block
+		        block encrypted_block(it->GetLeafid(), it->GetBlockindex(), encrypted_data);
+		        blocksTobucket.push_back(encrypted_block);
 	        }
+	        it = stash.erase(it);
         }
-
-        // 填充dummy块
-        while (blocksTobucket.size() < realBlockEachbkt + dummyBlockEachbkt) {
-	        blocksTobucket.push_back(dummyBlock);
+        else {
+	        ++it;
         }
+    }
 
-        // 随机排列
-        std::random_device rd;
-        std::mt19937 g(rd());
-        std::shuffle(blocksTobucket.begin(), blocksTobucket.end(), g);
-        
-        // 创建新的bucket
-        bucket bktTowrite(realBlockEachbkt, dummyBlockEachbkt);
-        bktTowrite.blocks = blocksTobucket;
+    // 填充dummy块
+    while (blocksTobucket.size() < realBlockEachbkt + dummyBlockEachbkt) {
+        blocksTobucket.push_back(dummyBlock);
+    }
 
-        for (int i = 0; i < maxblockEachbkt; i++) {
-	        bktTowrite.ptrs[i] = bktTowrite.blocks[i].GetBlockindex();
-	        bktTowrite.valids[i] = 1;
-        }
-        bktTowrite.count = 0;
+    // 随机排列
+    std::shuffle(blocksTobucket.begin(), blocksTobucket.end(), rng);
+    
+    // 创建新的bucket
+    bucket bktTowrite(realBlockEachbkt, dummyBlockEachbkt);
+    bktTowrite.blocks = blocksTobucket;
+
+    for (int i = 0; i < maxblockEachbkt; i++) {
+        bktTowrite.ptrs[i] = bktTowrite.blocks[i].GetBlockindex();
+        bktTowrite.valids[i] = 1;
+    }
+    bktTowrite.count = 0;
+    bucket_written[position] = 1;
 
-        // 序列化bucket
-        std::vector<uint8_t> serialized_bkt = serialize_bucket(bktTowrite);
-        if (serialized_bkt.empty()) {
-            std::cerr << "Failed to serialize bucket for writing" << std::endl;
+    // 序列化bucket到调用方提供的复用缓冲区
+    if (!serialize_bucket_into(bktTowrite, out)) {
+        std::cerr << "Failed to serialize bucket for writing" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ringoram::WriteBucket(int position)
+{
+	try
+    {
+        if (!PrepareBucket(position, net_tx_buffer)) {
             return;
         }
 
-        // 准备请求数据：位置 + bucket数据
-        std::vector<uint8_t> request_data(sizeof(int32_t) + serialized_bkt.size());
-        *reinterpret_cast<int32_t*>(request_data.data()) = static_cast<int32_t>(position);
-        memcpy(request_data.data() + sizeof(int32_t), 
-               serialized_bkt.data(), serialized_bkt.size());
+        // 请求负载：位置 + bucket数据，两个分段直接从各自缓冲区发送，不再拼接
+        int32_t pos32 = static_cast<int32_t>(position);
         
         // 发送 WRITE_BUCKET 请求
-        std::vector<uint8_t> response_data;
         std::string error_msg;
         
-        if (!sendRequest(WRITE_BUCKET, request_data, response_data, error_msg)) {
+        if (!pool->request(WRITE_BUCKET,
+                           { asio::buffer(&pos32, sizeof(pos32)), asio::buffer(net_tx_buffer) },
+                           net_rx_buffer, error_msg)) {
             std::cerr << "Failed to write bucket : " << error_msg << std::endl;
         }
     }
@@ -637,41 +356,101 @@ void ringoram::WriteBucket(int position)
     
 }
 
+// ================================
+// 访问周期内的写回缓冲
+// ================================
+//
+// 一个 access()（或 batchAccess() 的一个子批次）内组装好的 bucket 先暂存在 net_batch_tx 中：
+// 之后对同一位置的读取直接从暂存数据得到，重复写入覆盖同一槽位，
+// 周期结束时所有暂存的 bucket 一次并行写回。
+
+int ringoram::FindStagedWrite(int position) const
+{
+    for (int i = 0; i < epoch_write_count; i++) {
+        if (epoch_write_positions[i] == position) return i;
+    }
+    return -1;
+}
+
+bool ringoram::StageBucketWrite(int position)
+{
+    int slot = FindStagedWrite(position);
+    bool new_slot = slot == -1;
+    if (new_slot) {
+        if (epoch_write_count >= static_cast<int>(net_batch_tx.size())) {
+            // 批量访问一个周期内涉及多条路径，按需扩容
+            net_batch_tx.resize(2 * net_batch_tx.size());
+            epoch_write_positions.resize(net_batch_tx.size());
+        }
+        slot = epoch_write_count;
+    }
+
+    if (!PrepareBucket(position, net_batch_tx[slot])) {
+        return false;
+    }
+    if (new_slot) {
+        epoch_write_positions[slot] = static_cast<int32_t>(position);
+        epoch_write_count++;
+    }
+    // 写回的 bucket dummy 全部有效
+    bucket_reads[position] = 0;
+    return true;
+}
+
+bool ringoram::FlushWrites()
+{
+    int count = epoch_write_count;
+    epoch_write_count = 0;
+    EnsureBatchCapacity(count);
+
+    for (int i = 0; i < count; i++) {
+        PoolRequest& req = net_batch[i];
+        req.type = WRITE_BUCKET;
+        req.segments = { asio::buffer(&epoch_write_positions[i], sizeof(int32_t)),
+                         asio::buffer(net_batch_tx[i]), asio::const_buffer() };
+        req.response = &net_batch_rx[i];
+    }
+
+    bool ok = pool->requestBatch(net_batch.data(), count);
+    for (int i = 0; i < count; i++) {
+        if (!net_batch[i].ok) {
+            std::cerr << "Failed to write bucket " << epoch_write_positions[i] << " : " << net_batch[i].error << std::endl;
+        }
+    }
+    return ok;
+}
+
 block ringoram::ReadPath(int leafid, int blockindex)
 {
 	try
     {
-        // 1. 准备请求数据
-        std::vector<uint8_t> request_data(8); // 4字节leaf_id + 4字节block_index
-        *reinterpret_cast<int32_t*>(request_data.data()) = leafid;
-        *reinterpret_cast<int32_t*>(request_data.data() + 4) = blockindex;
+        // 1. 准备请求数据：4字节leaf_id + 4字节block_index
+        int32_t request_data[2] = { leafid, blockindex };
         
         // 2. 发送 READ_PATH 请求
-        std::vector<uint8_t> response_data;
         std::string error_msg;
         
-        if (!sendRequest(READ_PATH, request_data, response_data, error_msg)) {
+        if (!pool->request(READ_PATH, { asio::buffer(request_data, sizeof(request_data)) }, net_rx_buffer, error_msg)) {
             std::cerr << "Failed to read path (network): " << error_msg << std::endl;
             return dummyBlock;
         }
+
+        // 服务器在路径的每一层各消耗一个槽位
+        for (int i = 0; i <= L; i++) {
+            bucket_reads[Path_bucket(leafid, i)]++;
+        }
         
         // 3. 解析响应
-        if (response_data.size() < 1) {
+        if (net_rx_buffer.size() < 1) {
             return dummyBlock;
         }
 
         // 第一个字节：是否是dummy块
-        bool is_dummy = response_data[0] == 1;
+        bool is_dummy = net_rx_buffer[0] == 1;
         
-        if (!is_dummy && response_data.size() > 1) {
-            // 解析block数据
-            std::vector<char> encrypted_data(response_data.begin() + 1, response_data.end());
-            // std::vector<char> decrypted_data = decrypt_data(encrypted_data);
-            
-            // 创建block对象
-            block result(leafid, blockindex, encrypted_data);
-  
-            return result;
+        if (!is_dummy && net_rx_buffer.size() > 1) {
+            // 解析block数据：直接复制到返回的block中（只分配一次）
+            return block(leafid, blockindex, std::vector<char>(net_rx_buffer.begin() + 1, net_rx_buffer.end()));
         }
         return dummyBlock;
     }
@@ -687,42 +466,97 @@ block ringoram::ReadPath(int leafid, int blockindex)
 
 void ringoram::EvictPath()
 {
-	int l = G % (1 << L);
-	G += 1;
+	EvictAndReshuffle(nullptr, 0, 1);
+}
 
-	int i;
-	for (i = 0; i <= L; i++)
+void ringoram::EarlyReshuffle(int l)
+{
+	EvictAndReshuffle(&l, 1, 0);
+}
+
+// 驱逐路径上的 bucket 与需要提前重排的 bucket 合并为一次并行读取，
+// 全部放入stash后由深到浅统一组装（驱逐路径上的 bucket 重新写入后读取次数归零，重排随之完成）。
+//
+// 各 bucket 的读取次数由客户端记录（与服务器端 count 一致），只有需要重排的 bucket 才读取。
+// 批量访问时 count 条路径平均经过第 level 层每个 bucket ceil(count / 2^level) 次，
+// 重排时为下一批预留同样的余量，下一批发出前基本不需要再单独重排；
+// count 为1时即标准的 "count >= S" 规则。是否重排只取决于读取次数，服务器本身可见，不泄露访问内容。
+void ringoram::EvictAndReshuffle(const int* leaves, int count, int evictions)
+{
+	reshuffle_positions.clear();
+	for (int e = 0; e < evictions; e++)
 	{
-		ReadBucket(Path_bucket(l, i));
+		int l = G % (1 << L);
+		G += 1;
+		for (int i = 0; i <= L; i++)
+		{
+			reshuffle_positions.push_back(Path_bucket(l, i));
+		}
 	}
-
-	for (i = L; i >= 0; i--)
+	for (int j = 0; j < count; j++)
 	{
-		WriteBucket(Path_bucket(l, i));
+		for (int i = 0; i <= L; i++)
+		{
+			int position = Path_bucket(leaves[j], i);
+			int headroom = ((count - 1) >> i) + 1;
+			if (bucket_reads[position] + headroom > dummyBlockEachbkt)
+			{
+				reshuffle_positions.push_back(position);
+			}
+		}
 	}
+	if (reshuffle_positions.empty()) return;
+
+	// 多条路径共享的 bucket 去重，按位置（即按层）升序
+	std::sort(reshuffle_positions.begin(), reshuffle_positions.end());
+	reshuffle_positions.erase(std::unique(reshuffle_positions.begin(), reshuffle_positions.end()),
+	                          reshuffle_positions.end());
+
+	ReshuffleBuckets(reshuffle_positions.data(), static_cast<int>(reshuffle_positions.size()));
 }
 
-void ringoram::EarlyReshuffle(int l)
+void ringoram::ReshuffleBuckets(const int* positions, int count)
 {
-	for (int i = 0; i <= L; i++)
+	// 本周期已暂存的 bucket 以暂存数据为准，其余并行读取
+	reshuffle_fetch.clear();
+	for (int i = 0; i < count; i++)
 	{
-		int position = Path_bucket(l, i);
-        bucket bkt=Read_bucket(position);
-
-        if (bkt.count >= dummyBlockEachbkt)
-        {
-            for (int j = 0; j < maxblockEachbkt; j++) {
-		        // 只读取真实且有效的块
-		        if (bkt.ptrs[j] != -1 && bkt.valids[j] && !bkt.blocks[j].IsDummy()) {
-			        // 读取时解密
-			        block encrypted_block = bkt.blocks[j];
-			        vector<char> decrypted_data = decrypt_data(encrypted_block.GetData());
-			        block decrypted_block(encrypted_block.GetLeafid(), encrypted_block.GetBlockindex(), decrypted_data);
-			        stash.push_back(decrypted_block);
-		        }
-	        }
-            WriteBucket(position);
-        }
+		if (FindStagedWrite(positions[i]) == -1)
+		{
+			reshuffle_fetch.push_back(positions[i]);
+		}
+	}
+
+	try
+	{
+		ReadBuckets(reshuffle_fetch.data(), static_cast<int>(reshuffle_fetch.size()));
+		for (int i = 0, k = 0; i < count; i++)
+		{
+			int slot = FindStagedWrite(positions[i]);
+			if (slot != -1)
+			{
+				const std::vector<uint8_t>& staged = net_batch_tx[slot];
+				AbsorbSerializedBucket(staged.data(), staged.size());
+			}
+			else
+			{
+				if (net_batch[k].ok && !net_batch_rx[k].empty())
+				{
+					AbsorbSerializedBucket(net_batch_rx[k].data(), net_batch_rx[k].size());
+				}
+				k++;
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Exception in ReshuffleBuckets: " << e.what() << std::endl;
+	}
+
+	// 由叶到根依次组装（依赖stash，必须串行），暂存到本周期结束时写回
+	for (int i = count - 1; i >= 0; i--)
+	{
+		StageBucketWrite(positions[i]);
 	}
 }
 
@@ -760,14 +594,22 @@ std::vector<char> ringoram::decrypt_data(const std::vector<char>& encrypted_data
 
 
 vector<char> ringoram::access(int blockindex, Operation op, vector<char> data)
+{
+	return access(blockindex, op, std::move(data), -1, -1);
+}
+
+vector<char> ringoram::access(int blockindex, Operation op, vector<char> data, int old_leaf, int new_leaf, bool pin)
 {
 	if (blockindex < 0 || blockindex >= N) {
 
 		return {};
 	}
 
-	int oldLeaf = positionmap[blockindex];
-	positionmap[blockindex] = get_random();
+	int oldLeaf = old_leaf >= 0 ? old_leaf : positionmap[blockindex];
+	if (new_leaf < 0) {
+		new_leaf = get_random();
+		positionmap[blockindex] = new_leaf;
+	}
 
 	// 1. 读取路径获取目标块（加密状态）
 	block interestblock = ReadPath(oldLeaf, blockindex);
@@ -800,13 +642,539 @@ vector<char> ringoram::access(int blockindex, Operation op, vector<char> data)
 	}
 
 	// 明文放入stash
-	stash.emplace_back(positionmap[blockindex], blockindex, blockdata);
+	stash.emplace_back(new_leaf, blockindex, blockdata);
+	if (pin) {
+		pinned.insert(blockindex);
+	}
 
-	// 5. 路径管理和驱逐
+	// 5. 路径管理和驱逐（驱逐与提前重排的 bucket 一次并行读取）
 	round = (round + 1) % EvictRound;
-	if (round == 0) EvictPath();
+	EvictAndReshuffle(&oldLeaf, 1, round == 0 ? 1 : 0);
 
-	EarlyReshuffle(oldLeaf);
+	// 6. 本周期暂存的 bucket 一次性写回
+	FlushWrites();
 
 	return blockdata;
-}
\ No newline at end of file
+}
+
+// ================================
+// 批量访问
+// ================================
+//
+// 一批块的 READ_PATH 请求在连接池上并行发出，之后统一完成重映射、驱逐与提前重排。
+// 服务器处理每个 READ_PATH 时在路径的每一层各消耗一个 dummy，同一批请求共享根附近的 bucket，
+// 因此每个子批次不超过 S 个请求，并在发出前先重排本批读取会耗尽 dummy 的 bucket。
+// 是否重排只取决于各 bucket 的读取次数（服务器本身可见），不泄露访问的是哪些块。
+
+vector<vector<char>> ringoram::batchAccess(const vector<int>& blockindices, int pad_to)
+{
+	vector<int> no_leaves(blockindices.size(), -1);
+	return batchAccess(blockindices, no_leaves, no_leaves, pad_to, false);
+}
+
+vector<vector<char>> ringoram::batchAccess(const vector<int>& blockindices, const vector<int>& old_leaves,
+                                           const vector<int>& new_leaves, int pad_to, bool pin)
+{
+	int n = static_cast<int>(blockindices.size());
+	vector<vector<char>> results(n);
+
+	// 1. 组装读取序列：重复或非法的块按 dummy 读取，不足 pad_to 时用 dummy 补齐
+	vector<int> reads;
+	vector<int> read_old_leaves, read_new_leaves;
+	vector<int> slots;  // reads[i] 的结果写入 results[slots[i]]，dummy 为 -1
+	for (int i = 0; i < n; i++)
+	{
+		int b = blockindices[i];
+		bool real = b >= 0 && b < N && std::find(reads.begin(), reads.end(), b) == reads.end();
+		reads.push_back(real ? b : -1);
+		read_old_leaves.push_back(old_leaves[i]);
+		read_new_leaves.push_back(new_leaves[i]);
+		slots.push_back(real ? i : -1);
+	}
+	while (static_cast<int>(reads.size()) < pad_to)
+	{
+		reads.push_back(-1);
+		read_old_leaves.push_back(-1);
+		read_new_leaves.push_back(-1);
+		slots.push_back(-1);
+	}
+
+	// 2. 按子批次执行
+	int total = static_cast<int>(reads.size());
+	for (int start = 0; start < total; start += dummyBlockEachbkt)
+	{
+		int count = std::min(dummyBlockEachbkt, total - start);
+		ReadPathBatch(&reads[start], &read_old_leaves[start], &read_new_leaves[start], &slots[start],
+		              count, pin, results);
+	}
+
+	// 3. 重复的块使用第一次读取的结果
+	for (int i = 0; i < n; i++)
+	{
+		if (slots[i] != -1 || blockindices[i] < 0 || blockindices[i] >= N) continue;
+		for (int j = 0; j < i; j++)
+		{
+			if (blockindices[j] == blockindices[i])
+			{
+				results[i] = results[j];
+				break;
+			}
+		}
+	}
+
+	return results;
+}
+
+void ringoram::ReadPathBatch(const int* blockindices, const int* old_leaves, const int* new_leaves, const int* slots,
+                             int count, bool pin, vector<vector<char>>& results)
+{
+	// 1. 重映射：真实块取出旧叶子并分配新叶子（调用方给出叶子时不经过位置映射），dummy 读取随机路径
+	batch_leaves.resize(count);
+	batch_new_leaves.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		int b = blockindices[i];
+		if (b >= 0)
+		{
+			batch_leaves[i] = old_leaves[i] >= 0 ? old_leaves[i] : positionmap[b];
+			batch_new_leaves[i] = new_leaves[i];
+			if (batch_new_leaves[i] < 0)
+			{
+				batch_new_leaves[i] = get_random();
+				positionmap[b] = batch_new_leaves[i];
+			}
+		}
+		else
+		{
+			batch_leaves[i] = get_random();
+		}
+	}
+
+	// 2. 统计本批每个 bucket 被读取的次数，dummy 不够用的先重排
+	batch_touched.clear();
+	for (int i = 0; i < count; i++)
+	{
+		for (int level = 0; level <= L; level++)
+		{
+			batch_touched.push_back(Path_bucket(batch_leaves[i], level));
+		}
+	}
+	std::sort(batch_touched.begin(), batch_touched.end());
+
+	vector<int> overflow;
+	for (size_t i = 0; i < batch_touched.size(); )
+	{
+		size_t j = i;
+		while (j < batch_touched.size() && batch_touched[j] == batch_touched[i]) j++;
+		int reads_in_batch = static_cast<int>(j - i);
+		if (bucket_reads[batch_touched[i]] + reads_in_batch > dummyBlockEachbkt)
+		{
+			overflow.push_back(batch_touched[i]);
+		}
+		i = j;
+	}
+	if (!overflow.empty())
+	{
+		ReshuffleBuckets(overflow.data(), static_cast<int>(overflow.size()));
+		FlushWrites();
+	}
+
+	// 3. 所有 READ_PATH 并行发出
+	EnsureBatchCapacity(count);
+	net_path_requests.resize(2 * count);
+	for (int i = 0; i < count; i++)
+	{
+		net_path_requests[2 * i] = batch_leaves[i];
+		net_path_requests[2 * i + 1] = blockindices[i];
+
+		PoolRequest& req = net_batch[i];
+		req.type = READ_PATH;
+		req.segments = { asio::buffer(&net_path_requests[2 * i], 2 * sizeof(int32_t)),
+		                 asio::const_buffer(), asio::const_buffer() };
+		req.response = &net_batch_rx[i];
+	}
+	pool->requestBatch(net_batch.data(), count);
+
+	for (int i = 0; i < count; i++)
+	{
+		if (!net_batch[i].ok)
+		{
+			std::cerr << "Failed to read path (network): " << net_batch[i].error << std::endl;
+			continue;
+		}
+		for (int level = 0; level <= L; level++)
+		{
+			bucket_reads[Path_bucket(batch_leaves[i], level)]++;
+		}
+	}
+
+	// 4. 目标块解密后以新叶子放入stash，不在路径上的从stash中取
+	for (int i = 0; i < count; i++)
+	{
+		int b = blockindices[i];
+		if (b < 0) continue;
+
+		vector<char> blockdata;
+		const std::vector<uint8_t>& rx = net_batch_rx[i];
+		if (net_batch[i].ok && rx.size() > 1 && rx[0] == 0)
+		{
+			blockdata = decrypt_data(std::vector<char>(rx.begin() + 1, rx.end()));
+		}
+		else
+		{
+			for (auto it = stash.begin(); it != stash.end(); ++it) {
+				if (it->GetBlockindex() == b) {
+					blockdata = it->GetData();
+					stash.erase(it);
+					break;
+				}
+			}
+		}
+
+		stash.emplace_back(batch_new_leaves[i], b, blockdata);
+		if (pin) {
+			pinned.insert(b);
+		}
+		results[slots[i]] = std::move(blockdata);
+	}
+
+	// 5. 每次读取（含 dummy）都计入驱逐轮数；驱逐与所有读取过的路径的重排合并进行
+	int evictions = 0;
+	for (int i = 0; i < count; i++)
+	{
+		round = (round + 1) % EvictRound;
+		if (round == 0) evictions++;
+	}
+	EvictAndReshuffle(batch_leaves.data(), count, evictions);
+
+	// 6. 本周期暂存的 bucket 一次性写回
+	FlushWrites();
+}
+
+// ================================
+// 固定在 stash 中的块
+// ================================
+
+bool ringoram::updatePinned(int blockindex, const vector<char>& data)
+{
+	if (!pinned.count(blockindex)) return false;
+	for (auto& blk : stash) {
+		if (blk.GetBlockindex() == blockindex) {
+			blk.SetData(data);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ringoram::discardPinned(int blockindex)
+{
+	if (!pinned.erase(blockindex)) return false;
+	for (auto it = stash.begin(); it != stash.end(); ++it) {
+		if (it->GetBlockindex() == blockindex) {
+			stash.erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+// ================================
+// 批量写入（建树）
+// ================================
+//
+// 建树时成千上万个节点块依次 access 写入，每次都要读写整条路径。这里把所有新块一次放入：
+// 涉及的 bucket 各读一次、写一次，相当于对这些 bucket 做一次重排。
+// 块从未写入过，位置映射中的叶子是构造时随机分配的，读写哪些 bucket 与块内容无关。
+
+bool ringoram::bulkLoad(const vector<int>& blockindices, const vector<vector<char>>& data, int threads,
+                        const vector<int>* leaves)
+{
+	if (blockindices.size() != data.size()) {
+		std::cerr << "bulkLoad: " << blockindices.size() << " blocks but " << data.size() << " payloads" << std::endl;
+		return false;
+	}
+
+	// 1. 新块放入 stash，标记路径经过的 bucket
+	vector<char> touched(num_bucket, 0);
+	for (size_t i = 0; i < blockindices.size(); i++)
+	{
+		int b = blockindices[i];
+		if (b < 0 || b >= N) {
+			std::cerr << "bulkLoad: invalid block index " << b << std::endl;
+			continue;
+		}
+		int leaf = leaves ? (*leaves)[i] : positionmap[b];
+		stash.emplace_back(leaf, b, data[i]);
+		for (int level = 0; level <= L; level++) {
+			touched[Path_bucket(leaf, level)] = 1;
+		}
+	}
+
+	vector<int> positions;
+	vector<int> slot_of(num_bucket, -1);
+	for (int pos = 0; pos < num_bucket; pos++)
+	{
+		if (touched[pos]) {
+			slot_of[pos] = static_cast<int>(positions.size());
+			positions.push_back(pos);
+		}
+	}
+	if (positions.empty()) {
+		return true;
+	}
+
+	bool ok = true;
+	const int chunk_size = 1024;
+
+	// 2. 分批读出其中写入过的 bucket，其中的真实块回到 stash 与新块一起重新放置
+	vector<int> fetch;
+	for (int pos : positions)
+	{
+		if (bucket_written[pos]) fetch.push_back(pos);
+	}
+	for (size_t start = 0; start < fetch.size(); start += chunk_size)
+	{
+		int count = static_cast<int>(std::min<size_t>(chunk_size, fetch.size() - start));
+		ok = ReadBuckets(&fetch[start], count) && ok;
+		for (int i = 0; i < count; i++)
+		{
+			if (net_batch[i].ok && !net_batch_rx[i].empty()) {
+				AbsorbSerializedBucket(net_batch_rx[i].data(), net_batch_rx[i].size());
+			}
+		}
+	}
+
+	// 3. 每个块放到路径上最深的、有空位的 bucket（只在读出的 bucket 中选择）
+	vector<vector<int>> members(positions.size());
+	vector<char> placed(stash.size(), 0);
+	for (size_t k = 0; k < stash.size(); k++)
+	{
+		if (stash[k].IsDummy()) {
+			placed[k] = 1;  // 与 PrepareBucket 相同，stash 中的 dummy 直接丢弃
+			continue;
+		}
+		if (pinned.count(stash[k].GetBlockindex())) {
+			continue;
+		}
+		int leaf = stash[k].GetLeafid();
+		for (int level = L; level >= 0; level--)
+		{
+			int slot = slot_of[Path_bucket(leaf, level)];
+			if (slot != -1 && static_cast<int>(members[slot].size()) < realBlockEachbkt) {
+				members[slot].push_back(static_cast<int>(k));
+				placed[k] = 1;
+				break;
+			}
+		}
+	}
+
+	// 4. 分批组装并写回：随机排列使用 rng，串行确定；加密与序列化并行
+	vector<vector<int>> layouts(chunk_size);
+	vector<vector<uint8_t>> tx(chunk_size);
+	vector<int32_t> tx_positions(chunk_size);
+	for (size_t start = 0; start < positions.size(); start += chunk_size)
+	{
+		int count = static_cast<int>(std::min<size_t>(chunk_size, positions.size() - start));
+		for (int i = 0; i < count; i++)
+		{
+			vector<int>& layout = layouts[i];
+			layout = members[start + i];
+			layout.resize(maxblockEachbkt, -1);
+			std::shuffle(layout.begin(), layout.end(), rng);
+			tx_positions[i] = static_cast<int32_t>(positions[start + i]);
+		}
+
+		std::atomic<bool> serialized(true);
+		parallelFor(static_cast<size_t>(count), threads, [&](size_t i) {
+			bucket bktTowrite(realBlockEachbkt, dummyBlockEachbkt);
+			for (int j = 0; j < maxblockEachbkt; j++)
+			{
+				int k = layouts[i][j];
+				if (k != -1) {
+					const block& plain = stash[k];
+					bktTowrite.blocks[j] = block(plain.GetLeafid(), plain.GetBlockindex(), encrypt_data(plain.GetData()));
+				}
+				bktTowrite.ptrs[j] = bktTowrite.blocks[j].GetBlockindex();
+				bktTowrite.valids[j] = 1;
+			}
+			bktTowrite.count = 0;
+			if (!serialize_bucket_into(bktTowrite, tx[i])) {
+				serialized = false;
+			}
+		}, 16);
+		if (!serialized) {
+			std::cerr << "Failed to serialize bucket for bulk load" << std::endl;
+			return false;
+		}
+
+		EnsureBatchCapacity(count);
+		for (int i = 0; i < count; i++)
+		{
+			PoolRequest& req = net_batch[i];
+			req.type = WRITE_BUCKET;
+			req.segments = { asio::buffer(&tx_positions[i], sizeof(int32_t)),
+			                 asio::buffer(tx[i]), asio::const_buffer() };
+			req.response = &net_batch_rx[i];
+		}
+		if (!pool->requestBatch(net_batch.data(), count)) {
+			for (int i = 0; i < count; i++) {
+				if (!net_batch[i].ok) {
+					std::cerr << "Failed to write bucket " << tx_positions[i] << " : " << net_batch[i].error << std::endl;
+				}
+			}
+			ok = false;
+		}
+		for (int i = 0; i < count; i++) {
+			bucket_reads[positions[start + i]] = 0;
+			bucket_written[positions[start + i]] = 1;
+		}
+	}
+
+	// 5. 已放置的块移出 stash，放不下的留在 stash 中由之后的驱逐写回
+	size_t kept = 0;
+	for (size_t k = 0; k < stash.size(); k++)
+	{
+		if (!placed[k]) {
+			if (kept != k) stash[kept] = std::move(stash[k]);
+			kept++;
+		}
+	}
+	stash.resize(kept);
+
+	return ok;
+}
+
+// ================================
+// 快照
+// ================================
+
+static const uint32_t kOramSectionTag = snapshotTag('O', 'R', 'A', 'M');
+
+void ringoram::saveState(SnapshotWriter& writer) const
+{
+	static_assert(sizeof(int) == sizeof(int32_t), "position map is stored as int32");
+
+	writer.beginSection(kOramSectionTag);
+	writer.putI32(N);
+	writer.putI32(L);
+	writer.putI32(num_bucket);
+	writer.putI32(round);
+	writer.putI32(G);
+	writer.putI32(c);
+	// 密钥与 IV 明文保存：快照文件本身须作为机密保管（SnapshotWriter::writeFile 以 0600 创建）
+	writer.putByteVector(crypto->getKey());
+	writer.putByteVector(crypto->getIV());
+
+	writer.putArray(positionmap, N);
+	writer.putArray(bucket_reads);
+	writer.putArray(bucket_written);
+
+	writer.putU64(stash.size());
+	for (const auto& blk : stash) {
+		writer.putI32(blk.GetLeafid());
+		writer.putI32(blk.GetBlockindex());
+		writer.putByteVector(blk.GetData());
+	}
+	writer.endSection();
+}
+
+bool ringoram::loadState(SnapshotReader& reader)
+{
+	if (!reader.beginSection(kOramSectionTag)) {
+		std::cerr << "Error: ORAM state missing from snapshot" << std::endl;
+		return false;
+	}
+	int saved_N = reader.getI32();
+	int saved_L = reader.getI32();
+	int saved_buckets = reader.getI32();
+	if (!reader.ok() || saved_N != N || saved_L != L || saved_buckets != num_bucket) {
+		std::cerr << "Error: Snapshot ORAM parameters (N=" << saved_N << ", L=" << saved_L
+			<< ") do not match the current ones (N=" << N << ", L=" << L << ")" << std::endl;
+		return false;
+	}
+
+	// 先全部解析到局部变量，校验通过后再替换
+	int saved_round = reader.getI32();
+	int saved_G = reader.getI32();
+	int saved_c = reader.getI32();
+	std::vector<uint8_t> key, iv;
+	reader.getByteVector(key);
+	reader.getByteVector(iv);
+
+	std::vector<int> saved_positions, saved_reads;
+	std::vector<char> saved_written;
+	reader.getArray(saved_positions);
+	reader.getArray(saved_reads);
+	reader.getArray(saved_written);
+
+	uint64_t stash_size = reader.getU64();
+	vector<block> saved_stash;
+	for (uint64_t i = 0; i < stash_size && reader.ok(); i++) {
+		int leaf = reader.getI32();
+		int index = reader.getI32();
+		std::vector<char> data;
+		reader.getByteVector(data);
+		saved_stash.emplace_back(leaf, index, std::move(data));
+	}
+
+	if (!reader.endSection() || saved_positions.size() != static_cast<size_t>(N) ||
+		saved_reads.size() != static_cast<size_t>(num_bucket) ||
+		saved_written.size() != static_cast<size_t>(num_bucket)) {
+		std::cerr << "Error: Corrupt ORAM state in snapshot" << std::endl;
+		return false;
+	}
+
+	std::shared_ptr<CryptoUtils> saved_crypto;
+	try {
+		saved_crypto = make_shared<CryptoUtils>(key, iv);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Error: Invalid key in snapshot: " << e.what() << std::endl;
+		return false;
+	}
+
+	round = saved_round;
+	G = saved_G;
+	c = saved_c;
+	encryption_key = key;
+	crypto = saved_crypto;
+	std::copy(saved_positions.begin(), saved_positions.end(), positionmap);
+	bucket_reads.swap(saved_reads);
+	bucket_written.swap(saved_written);
+	stash.swap(saved_stash);
+	epoch_write_count = 0;
+	return true;
+}
+
+bool ringoram::saveServerStore(uint64_t token)
+{
+	std::string error_msg;
+	if (!pool->request(STORE_SAVE, { asio::buffer(&token, sizeof(token)) }, net_rx_buffer, error_msg)) {
+		std::cerr << "Failed to save server store: " << error_msg << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool ringoram::getServerStoreToken(uint64_t& token)
+{
+	std::string error_msg;
+	if (!pool->request(STORE_INFO, {}, net_rx_buffer, error_msg) || net_rx_buffer.size() < sizeof(token)) {
+		std::cerr << "Failed to query server store: " << error_msg << std::endl;
+		return false;
+	}
+	memcpy(&token, net_rx_buffer.data(), sizeof(token));
+	return true;
+}
+
+bool ringoram::resetServerStore()
+{
+	std::string error_msg;
+	if (!pool->request(STORE_RESET, {}, net_rx_buffer, error_msg)) {
+		std::cerr << "Failed to reset server store: " << error_msg << std::endl;
+		return false;
+	}
+	return true;
+}
+
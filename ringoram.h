@@ -3,17 +3,26 @@
 #include"bucket.h"
 #include"CryptoUtil.h"
 #include"param.h"
+#include"ConnectionPool.h"
 #include<vector>
 #include<cmath>
 #include <memory>
 #include<iostream>
+#include<random>
+#include<unordered_set>
 
 using namespace std;
+
+class SnapshotWriter;
+class SnapshotReader;
+
 class ringoram
 {
 public:
-	static int round;
-	static int G;
+	// 访问计数与驱逐路径计数（每个 ORAM 实例独立）
+	int round;
+	int G;
+	std::mt19937 rng;  // 路径随机数引擎（每个实例独立，多个 ORAM 实例可在不同线程中使用）
 	int* positionmap;
 	vector<block> stash;
 	int c;
@@ -32,9 +41,48 @@ public:
      // 网络通信
     std::string server_ip_;
     int server_port_;
+    int num_connections_;
+    std::unique_ptr<ConnectionPool> pool;  // 到服务器的连接池
+
+	// 可复用的收发缓冲区（稳态下请求路径不再分配内存）
+	std::vector<uint8_t> net_tx_buffer;
+	std::vector<uint8_t> net_rx_buffer;
+
+	// 读取到的 bucket 原地反序列化到这里（复用各 block 的数据缓冲区），再取出真实块
+	bucket net_rx_bucket;
+
+	// 批量请求：驱逐与提前重排时路径上的 bucket 并行读写
+	std::vector<PoolRequest> net_batch;
+	std::vector<int32_t> net_batch_positions;
+	std::vector<std::vector<uint8_t>> net_batch_rx;
+
+	// 访问周期写回缓冲：已组装待写回的 bucket（序列化后）及其位置
+	std::vector<std::vector<uint8_t>> net_batch_tx;
+	std::vector<int32_t> epoch_write_positions;
+	int epoch_write_count;
+
+	// 客户端记录的每个 bucket 自上次写回以来的读取次数（与服务器端 count 一致），
+	// 提前重排据此选择 bucket；批量读取前据此判断哪些 bucket 的 dummy 不够本批使用
+	std::vector<int> bucket_reads;
+
+	// 每个 bucket 是否写入过：服务器初始时所有 bucket 都只有 dummy，批量写入时未写入过的 bucket 不需要读取
+	std::vector<char> bucket_written;
+
+	// 批量访问与批量重排使用的复用缓冲区
+	std::vector<int32_t> net_path_requests;   // 每个 READ_PATH 请求的 leaf_id + block_index
+	std::vector<int> batch_leaves;
+	std::vector<int> batch_new_leaves;
+	std::vector<int> batch_touched;
+	std::vector<int> reshuffle_positions;
+	std::vector<int> reshuffle_fetch;
+
+	// 固定在 stash 中的块：驱逐时跳过，直到 unpinAll。
+	// 不经位置映射访问的块（见带叶子参数的 access）被读出后留在 stash，调用方在其中修改后再放回树中
+	std::unordered_set<int> pinned;
 
 	enum Operation { READ, WRITE };
-	 ringoram(int n, const std::string& server_ip, int server_port, int cache_levels = cacheLevel);
+	 ringoram(int n, const std::string& server_ip, int server_port, int cache_levels = cacheLevel,
+	          int connections = numConnections);
     ~ringoram();
 
     // 网络初始化
@@ -50,12 +98,24 @@ public:
 	block FindBlock(bucket bkt, int offset);//在桶中找到对应Block
 	int GetBlockOffset(bucket bkt, int blockindex);//得到Block的offset
 	void ReadBucket(int pos);
-    bucket Read_bucket(int pos);
+    const bucket& Read_bucket(int pos);//读取bucket，返回的引用在下一次读取前有效
 	void WriteBucket(int position);
+	void AbsorbBucket(const bucket& remote_bkt);//将bucket中的真实块解密后放入stash
+	bool AbsorbSerializedBucket(const uint8_t* data, size_t size);//反序列化到net_rx_bucket后放入stash
+	bool PrepareBucket(int position, std::vector<uint8_t>& out);//从stash组装bucket并序列化
+	void EnsureBatchCapacity(int count);//保证批量请求缓冲区至少容纳count个请求
+	bool ReadBuckets(const int* positions, int count);//并行读取多个bucket到net_batch_rx
+	int FindStagedWrite(int position) const;//本周期已暂存的bucket槽位，没有返回-1
+	bool StageBucketWrite(int position);//组装bucket并暂存，同一位置重复写入会合并
+	bool FlushWrites();//并行写回本周期暂存的所有bucket
 
 	block ReadPath(int leafid, int blockindex);
 	void EvictPath();
 	void EarlyReshuffle(int l);
+	void EvictAndReshuffle(const int* leaves, int count, int evictions);//驱逐与读取过的路径上的提前重排合并执行
+	void ReshuffleBuckets(const int* positions, int count);//读取指定的bucket并重新组装暂存（按位置升序传入）
+	void ReadPathBatch(const int* blockindices, const int* old_leaves, const int* new_leaves, const int* slots,
+	                   int count, bool pin, vector<vector<char>>& results);//一个子批次（不超过S次）的并行路径读取
 
 	// === 数据加密与解密 ===
 	std::vector<char> encrypt_data(const std::vector<char>& data);
@@ -63,4 +123,90 @@ public:
 
 	vector<char> access(int blockindex, Operation op, vector<char> data);
 
+	/**
+	 * @brief 由调用方给出块所在的叶子与新叶子的访问（不可知数据结构模式）
+	 *
+	 * 块的叶子保存在调用方（例如父节点中）时不需要位置映射：读取 old_leaf 路径，块以 new_leaf 放回 stash。
+	 * @param old_leaf 块当前所在的叶子，-1 表示按位置映射查找（块此前经位置映射访问或从未写入）
+	 * @param new_leaf 新叶子，-1 表示随机分配并记入位置映射（块交还位置映射管理）
+	 * @param pin 是否把块固定在 stash 中（见 pinned）
+	 */
+	vector<char> access(int blockindex, Operation op, vector<char> data, int old_leaf, int new_leaf, bool pin = false);
+
+	/**
+	 * @brief 批量读取多个块：所有 READ_PATH 请求并行发出，之后统一驱逐、重排和写回
+	 * @param blockindices 要读取的块号，重复的块只真实读取一次
+	 * @param pad_to 读取次数不足时用 dummy 路径读取补齐，服务器看到的每批请求数固定
+	 * @return 与 blockindices 一一对应的明文数据，不存在的块为空
+	 */
+	vector<vector<char>> batchAccess(const vector<int>& blockindices, int pad_to = 0);
+
+	/**
+	 * @brief 带叶子参数的批量读取（叶子的含义同带叶子参数的 access）
+	 * @param old_leaves 与 blockindices 一一对应，重复的块应给出相同的叶子
+	 * @param new_leaves 与 blockindices 一一对应
+	 * @param pin 读出的块是否固定在 stash 中
+	 */
+	vector<vector<char>> batchAccess(const vector<int>& blockindices, const vector<int>& old_leaves,
+	                                 const vector<int>& new_leaves, int pad_to, bool pin);
+
+	/// 随机叶子（调用方自己保存块的叶子时用于选择新叶子）
+	int randomLeaf() { return get_random(); }
+
+	/**
+	 * @brief 替换固定在 stash 中的块的内容（不访问服务器）
+	 * @return 块不在固定集合中时返回 false
+	 */
+	bool updatePinned(int blockindex, const vector<char>& data);
+
+	/**
+	 * @brief 把固定在 stash 中的块整个移除（块不再存在于 ORAM 中，之后可经位置映射重新写入）
+	 * @return 块不在固定集合中时返回 false
+	 */
+	bool discardPinned(int blockindex);
+
+	/// 解除所有固定，块在之后的驱逐中正常写回
+	void unpinAll() { pinned.clear(); }
+
+	/**
+	 * @brief 批量写入一批从未写入过的块（批量建树使用）
+	 *
+	 * 新块按位置映射中的叶子放入 stash，读出这些路径经过的所有 bucket（原有真实块一起重新放置），
+	 * 每个块放到路径上最深的有空位的 bucket，放不下的留在 stash。块加密与 bucket 序列化
+	 * 在 threads 个线程上并行执行，读写都分批并行发出。读写哪些 bucket 只由随机叶子决定。
+	 * @param blockindices 块号（不能已经写入过）
+	 * @param data 与 blockindices 一一对应的明文
+	 * @param threads 线程数（<= 0 为硬件线程数）
+	 * @param leaves 与 blockindices 一一对应的叶子（调用方自己保存叶子时），为空时使用位置映射
+	 */
+	bool bulkLoad(const vector<int>& blockindices, const vector<vector<char>>& data, int threads,
+	              const vector<int>* leaves = nullptr);
+
+	// === 快照（格式见 Snapshot.h）===
+
+	/**
+	 * @brief 保存客户端状态：参数、访问计数、密钥与 IV、位置映射、bucket 读取计数和 stash
+	 *
+	 * 只在两次访问之间调用（本周期的写回已经完成）。
+	 * 密钥、IV 与位置映射以明文写入，保存结果的文件是机密文件（见 Snapshot.h）
+	 */
+	void saveState(SnapshotWriter& writer) const;
+
+	/**
+	 * @brief 恢复 saveState 保存的状态，参数（N、L）不符时拒绝
+	 * @return 是否成功，失败时当前状态保持不变
+	 */
+	bool loadState(SnapshotReader& reader);
+
+	// === 服务器存储文件（见 NetProtocol.h 中的 STORE_* 请求）===
+
+	/// 请求服务器把全部 bucket 写入存储文件，并记下令牌
+	bool saveServerStore(uint64_t token);
+
+	/// 服务器内存中的 bucket 对应的存储文件令牌，0 表示已修改或从未保存
+	bool getServerStoreToken(uint64_t& token);
+
+	/// 请求服务器把所有 bucket 恢复为只有 dummy 的初始状态
+	bool resetServerStore();
+
 };
\ No newline at end of file
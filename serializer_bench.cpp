@@ -0,0 +1,253 @@
+// 节点序列化微基准：比较旧格式与紧凑格式的节点大小和反序列化耗时
+//
+// 用法：./serializer_bench [数据文件] [重复轮数]
+// 节点直接在内存中构建（按坐标排序后每 5 个打包一层，与 IRTree 的扇出相同），
+// 不需要启动服务器。
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include "Node.h"
+#include "Document.h"
+#include "NodeSerializer.h"
+#include "BlockCodec.h"
+#include "Vocabulary.h"
+#include "KeywordFilter.h"
+#include "param.h"
+
+namespace {
+
+const int FANOUT = 5;
+
+std::vector<std::shared_ptr<Document>> loadDocuments(const std::string& filename) {
+    std::vector<std::shared_ptr<Document>> documents;
+    std::ifstream file(filename);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string text, x, y, id;
+        if (!std::getline(iss, text, '|') || !std::getline(iss, x, '|') ||
+            !std::getline(iss, y, '|') || !std::getline(iss, id)) {
+            continue;
+        }
+        double px = std::stod(x);
+        double py = std::stod(y);
+        MBR location({ px, py }, { px, py });
+        documents.push_back(std::make_shared<Document>(std::stoi(id), location, text));
+    }
+    return documents;
+}
+
+// 自底向上打包：同一层按 MBR 左下角排序后每 FANOUT 个组成一个父节点
+std::vector<std::shared_ptr<Node>> buildNodes(std::vector<std::shared_ptr<Document>> documents) {
+    std::vector<std::shared_ptr<Node>> all_nodes;
+    std::mt19937 rng(42);
+    int next_id = 0;
+
+    std::sort(documents.begin(), documents.end(), [](const std::shared_ptr<Document>& a, const std::shared_ptr<Document>& b) {
+        return a->getLocation().getMin() < b->getLocation().getMin();
+    });
+
+    std::vector<std::shared_ptr<Node>> level_nodes;
+    for (size_t i = 0; i < documents.size(); i += FANOUT) {
+        auto leaf = std::make_shared<Node>(next_id++, Node::LEAF, 0, documents[i]->getLocation());
+        for (size_t j = i; j < std::min(documents.size(), i + FANOUT); j++) {
+            leaf->addDocument(documents[j]);
+        }
+        level_nodes.push_back(leaf);
+    }
+
+    int level = 0;
+    while (level_nodes.size() > 1) {
+        all_nodes.insert(all_nodes.end(), level_nodes.begin(), level_nodes.end());
+        level++;
+        std::vector<std::shared_ptr<Node>> parents;
+        for (size_t i = 0; i < level_nodes.size(); i += FANOUT) {
+            auto parent = std::make_shared<Node>(next_id++, Node::INTERNAL, level, level_nodes[i]->getMBR());
+            for (size_t j = i; j < std::min(level_nodes.size(), i + FANOUT); j++) {
+                const auto& child = level_nodes[j];
+                parent->addChild(child);
+                parent->setChildPosition(child->getId(), static_cast<int>(rng() % 32768));
+                parent->setChildTextUpperBound(child->getId(), 1.0 / (1 + child->getTFMax().size()));
+            }
+            parents.push_back(parent);
+        }
+        level_nodes.swap(parents);
+    }
+    all_nodes.insert(all_nodes.end(), level_nodes.begin(), level_nodes.end());
+    return all_nodes;
+}
+
+struct SizeStats {
+    size_t count = 0;
+    size_t total = 0;
+    size_t max = 0;
+    size_t over_block = 0;
+
+    void add(size_t bytes, size_t block_size) {
+        count++;
+        total += bytes;
+        max = std::max(max, bytes);
+        if (bytes > block_size) {
+            over_block++;
+        }
+    }
+
+    void print(const std::string& name) const {
+        std::cout << "  " << std::left << std::setw(22) << name
+                  << " avg " << std::setw(8) << (count ? total / count : 0)
+                  << " max " << std::setw(8) << max
+                  << " > 4KB: " << over_block << "/" << count << std::endl;
+    }
+};
+
+bool sameNode(const Node& a, const Node& b) {
+    if (a.getId() != b.getId() || a.getType() != b.getType() || a.getLevel() != b.getLevel() ||
+        a.getDF() != b.getDF() || a.getTFMax() != b.getTFMax() ||
+        a.getChildNodeIds() != b.getChildNodeIds() ||
+        a.getChildPositionMap() != b.getChildPositionMap() ||
+        a.getChildLeafMap() != b.getChildLeafMap() ||
+        a.getChildKeywordsMap() != b.getChildKeywordsMap() ||
+        a.getDocuments().size() != b.getDocuments().size()) {
+        return false;
+    }
+    for (const auto& bound : a.getChildTextUpperBounds()) {
+        double other = b.getChildTextUpperBound(bound.first);
+        // 紧凑格式的上界是 float32 向上取整
+        if (other < bound.second || other > bound.second * (1 + 1e-6)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.getDocuments().size(); i++) {
+        const auto& da = *a.getDocuments()[i];
+        const auto& db = *b.getDocuments()[i];
+        if (da.getId() != db.getId() || da.getText() != db.getText() || da.getTermFreq() != db.getTermFreq()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Decode>
+double timeDecode(const std::vector<std::vector<uint8_t>>& encoded, int rounds, Decode decode) {
+    size_t live = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (const auto& data : encoded) {
+            auto node = decode(data);
+            live += node ? 1 : 0;
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    if (live != encoded.size() * rounds) {
+        std::cerr << "Decode failures: " << encoded.size() * rounds - live << std::endl;
+    }
+    return std::chrono::duration<double, std::micro>(end - start).count() / (static_cast<double>(encoded.size()) * rounds);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string data_file = argc > 1 ? argv[1] : "large_data.txt";
+    int rounds = argc > 2 ? std::stoi(argv[2]) : 20;
+    const size_t block_size = 4096;
+
+    auto documents = loadDocuments(data_file);
+    if (documents.empty()) {
+        std::cerr << "Error: no documents loaded from " << data_file << std::endl;
+        return 1;
+    }
+    auto nodes = buildNodes(documents);
+    std::cout << "Documents: " << documents.size() << ", nodes: " << nodes.size() << std::endl;
+
+    Vocabulary vocab;
+    std::vector<std::vector<uint8_t>> legacy, compact;
+    SizeStats legacy_leaf, legacy_internal, compact_leaf, compact_internal, compact_lz;
+    SizeStats leaf_no_text, leaf_no_text_lz;
+    for (const auto& node : nodes) {
+        legacy.push_back(NodeSerializer::serialize(*node));
+        compact.push_back(NodeSerializer::serializeCompact(*node, vocab));
+        bool leaf = node->getType() == Node::LEAF;
+        (leaf ? legacy_leaf : legacy_internal).add(legacy.back().size(), block_size);
+        (leaf ? compact_leaf : compact_internal).add(compact.back().size(), block_size);
+        compact_lz.add(BlockCodec::encode(compact.back(), 0).size(), block_size);
+        if (leaf) {
+            // 完整文档单独存放（separateDocuments）时叶子节点的大小
+            auto no_text = NodeSerializer::serializeCompact(*node, vocab, false);
+            leaf_no_text.add(no_text.size(), block_size);
+            leaf_no_text_lz.add(BlockCodec::encode(no_text, 0).size(), block_size);
+        }
+    }
+
+    int mismatches = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        auto a = NodeSerializer::deserialize(legacy[i]);
+        auto b = NodeSerializer::deserialize(compact[i], &vocab);
+        if (!a || !b || !sameNode(*a, *b)) {
+            mismatches++;
+        }
+    }
+
+    std::cout << "Serialized size (bytes):" << std::endl;
+    legacy_leaf.print("legacy leaf");
+    legacy_internal.print("legacy internal");
+    compact_leaf.print("compact leaf");
+    compact_internal.print("compact internal");
+    compact_lz.print("compact + BlockCodec");
+    leaf_no_text.print("leaf without text");
+    leaf_no_text_lz.print("  + BlockCodec");
+    std::cout << "Round-trip mismatches: " << mismatches << std::endl;
+
+    // 子节点关键词过滤器：用词汇表中不属于该子节点的词项探测误报率
+    size_t filters = 0, filter_bytes = 0, probes = 0, false_positives = 0;
+    for (const auto& node : nodes) {
+        if (node->getType() != Node::INTERNAL) {
+            continue;
+        }
+        for (const auto& child : node->getChildNodes()) {
+            const KeywordFilter& filter = node->getChildKeywordFilter(child->getId());
+            filters++;
+            filter_bytes += filter.memoryBytes();
+            for (size_t term_id = 0; term_id < vocab.size(); term_id++) {
+                std::string term = vocab.getTerm(static_cast<int>(term_id));
+                if (child->getTFMax().count(term)) {
+                    continue;
+                }
+                probes++;
+                false_positives += filter.mayContain(KeywordFilter::hashTerm(term)) ? 1 : 0;
+            }
+        }
+    }
+    std::cout << "Keyword filters: " << filters << ", avg " << (filters ? filter_bytes / filters : 0)
+              << " bytes, false positive rate " << (probes ? 100.0 * false_positives / probes : 0.0)
+              << "% (target " << 100.0 * keywordFilterFpRate << "%)" << std::endl;
+
+    std::cout << "Deserialize (us/node, " << rounds << " rounds):" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (int type = 0; type < 2; type++) {
+        std::vector<std::vector<uint8_t>> legacy_part, compact_part;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (static_cast<int>(nodes[i]->getType()) == type) {
+                legacy_part.push_back(legacy[i]);
+                compact_part.push_back(compact[i]);
+            }
+        }
+        double legacy_us = timeDecode(legacy_part, rounds, [](const std::vector<uint8_t>& data) {
+            return NodeSerializer::deserialize(data);
+        });
+        double compact_us = timeDecode(compact_part, rounds, [&vocab](const std::vector<uint8_t>& data) {
+            return NodeSerializer::deserialize(data, &vocab);
+        });
+        std::cout << "  " << std::left << std::setw(10) << (type == Node::LEAF ? "leaf" : "internal")
+                  << " legacy " << legacy_us << ", compact " << compact_us
+                  << " (" << legacy_us / compact_us << "x)" << std::endl;
+    }
+    return mismatches == 0 ? 0 : 1;
+}
@@ -2,507 +2,43 @@
 #include <iostream>
 #include <string>
 #include <memory>
-#include <cstdint>
-#include <cstring>
-#include<chrono>
-#include <boost/asio.hpp>
-#include <netinet/tcp.h>
-#include <sys/socket.h>
-#include "ServerStorage.h" 
-#include"param.h"
-#include<cmath> 
-
-using boost::asio::ip::tcp;
-
-// 协议定义
-enum RequestType {
-    READ_BUCKET = 1,
-    WRITE_BUCKET = 2,
-    READ_PATH = 3,
-    RESPONSE = 100
-};
-
-struct RequestHeader {
-    uint32_t type;
-    uint32_t request_id;
-    uint32_t data_len;
-    uint32_t reserved;
-};
-
-struct ResponseHeader {
-    uint32_t type;
-    uint32_t request_id;
-    uint32_t result;
-    uint32_t data_len;
-};
-
-
-#pragma pack(push, 1)
-struct SerializedBucketHeader {
-    int32_t Z;
-    int32_t S;
-    int32_t count;
-    int32_t num_blocks;
-};
-
-struct SerializedBlockHeader {
-    int32_t leaf_id;
-    int32_t block_index;
-    int32_t data_size;
-};
-#pragma pack(pop)
-
-// ================================
-// 序列化工具函数
-// ================================
-
-size_t calculate_bucket_size(const bucket& bkt) {
-    
-    size_t size = sizeof(SerializedBucketHeader);
-    
-    // 计算blocks大小
-    size_t blocks_size = 0;
-    for (int i = 0; i < bkt.blocks.size(); i++) {
-        auto& blk = bkt.blocks[i];
-        size_t block_size = sizeof(SerializedBlockHeader) + blk.GetData().size();
-        blocks_size += block_size;
-      
-    }
-    size += blocks_size;
-    
-    // 计算ptrs和valids大小
-    size_t ptrs_valids_size = (bkt.ptrs.size() + bkt.valids.size()) * sizeof(int32_t);
-    size += ptrs_valids_size;
- 
-    return size;
-}
-
-void serialize_block( block& blk, uint8_t* buffer, size_t& offset) {
-  
-    SerializedBlockHeader* header = reinterpret_cast<SerializedBlockHeader*>(buffer + offset);
-    header->leaf_id = blk.GetLeafid();
-    header->block_index = blk.GetBlockindex();
-    
-    const auto& data = blk.GetData();
-    header->data_size = static_cast<int32_t>(data.size());
- 
-    offset += sizeof(SerializedBlockHeader);
-    
-    if (!data.empty()) {
-        memcpy(buffer + offset, data.data(), data.size());
-        offset += data.size();
-    }
-
-}
-
-block deserialize_block(const uint8_t* data, size_t& offset) {
-    const SerializedBlockHeader* header = reinterpret_cast<const SerializedBlockHeader*>(data + offset);
-    offset += sizeof(SerializedBlockHeader);
-    
-    std::vector<char> block_data;
-    if (header->data_size > 0) {
-        block_data.resize(header->data_size);
-        memcpy(block_data.data(), data + offset, header->data_size);
-        offset += header->data_size;
-    }
-    
-    return block(header->leaf_id, header->block_index, block_data);
-}
-
-std::vector<uint8_t> serialize_bucket( bucket& bkt) {
-   
-    try {
-    
-        // 先计算大小
-
-        size_t total_size = calculate_bucket_size(bkt);
-     
-        if (total_size == 0) {
-            std::cerr << "ERROR: Calculated size is 0" << std::endl;
-            return std::vector<uint8_t>();
-        }
-       
-        std::vector<uint8_t> result(total_size);
-      
-        // 序列化 bucket header
-      
-        SerializedBucketHeader* bucket_header = reinterpret_cast<SerializedBucketHeader*>(result.data());
-        bucket_header->Z = bkt.Z;
-        bucket_header->S = bkt.S;
-        bucket_header->count = bkt.count;
-        bucket_header->num_blocks = static_cast<int32_t>(bkt.blocks.size());
-       
-        size_t offset = sizeof(SerializedBucketHeader);
-       
-        // 序列化 blocks
-    
-        for (int i = 0; i < bkt.blocks.size(); i++) {
-          
-            serialize_block(bkt.blocks[i], result.data(), offset);
-       
-        }
-        
-        // 序列化 ptrs 和 valids
-   
-        int num_slots = bkt.Z + bkt.S;
- 
-        // 检查边界
-        if (offset + num_slots * 2 * sizeof(int32_t) > total_size) {
-            std::cerr << "ERROR: Not enough space for ptrs and valids" << std::endl;
-            return std::vector<uint8_t>();
-        }
-        
-        // 序列化 ptrs
-        for (int i = 0; i < num_slots; i++) {
-            *reinterpret_cast<int32_t*>(result.data() + offset) = bkt.ptrs[i];
-            offset += sizeof(int32_t);
-        }
-        
-        // 序列化 valids
-        for (int i = 0; i < num_slots; i++) {
-            *reinterpret_cast<int32_t*>(result.data() + offset) = bkt.valids[i];
-            offset += sizeof(int32_t);
-        }
- 
-        return result;
-        
-    } catch (const std::exception& e) {
-        std::cerr << "serialize_bucket failed with exception: " << e.what() << std::endl;
-        return std::vector<uint8_t>();
-    }
-}
-
-bucket deserialize_bucket(const uint8_t* data, size_t size) {
- 
-    if (size < sizeof(SerializedBucketHeader)) {
-        std::cerr << "  ERROR: Data too small for header" << std::endl;
-        throw std::runtime_error("Invalid bucket data: too small");
-    }
-    
-    const SerializedBucketHeader* bucket_header = reinterpret_cast<const SerializedBucketHeader*>(data);
-  
-    // 创建空的bucket
-    bucket result(0, 0);
-    result.Z = bucket_header->Z;
-    result.S = bucket_header->S;
-    result.count = bucket_header->count;
-    
-    size_t offset = sizeof(SerializedBucketHeader);
- 
-    // 反序列化 blocks
-  
-    for (int i = 0; i < bucket_header->num_blocks && offset < size; i++) {
-        result.blocks.push_back(deserialize_block(data, offset));
-    }
- 
-    //从序列化数据中恢复ptrs和valids
-    int num_slots = result.Z + result.S;
-    result.ptrs.resize(num_slots, -1);
-    result.valids.resize(num_slots, 0);
-    
-    // 检查是否有足够的空间来读取ptrs和valids
-    if (offset + num_slots * 2 * sizeof(int32_t) <= size) {
-     
-        // 反序列化 ptrs
-        for (int i = 0; i < num_slots; i++) {
-            int32_t ptr = *reinterpret_cast<const int32_t*>(data + offset);
-            result.ptrs[i] = ptr;
-            offset += sizeof(int32_t);
-        }
-        
-        // 反序列化 valids
-        for (int i = 0; i < num_slots; i++) {
-            int32_t valid = *reinterpret_cast<const int32_t*>(data + offset);
-            result.valids[i] = valid;
-            offset += sizeof(int32_t);
-        }
-   
-    } else {
-        std::cout << "  WARNING: No ptrs and valids data in serialized bucket" << std::endl;
-    }
-   
-    return result;
-}
-
-
-// 全局的 ServerStorage 对象
-std::unique_ptr<ServerStorage> g_storage;
-
-// 处理 READ_BUCKET 请求
-std::vector<uint8_t> handleReadBucket(const uint8_t* request_data, uint32_t data_len) {
-    if (data_len < 4) {
-        std::cout << "Error: READ_BUCKET request data too short" << std::endl;
-        // 返回空的65536字节数据
-        return std::vector<uint8_t>(65536, 0);
-    }
-    
-    // 解析桶位置
-    int32_t position = *reinterpret_cast<const int32_t*>(request_data);
-  
-    try {
-        // 调用 ServerStorage 读取桶
-        bucket bkt = g_storage->GetBucket(position);
-   
-        // 使用真正的序列化
-        std::vector<uint8_t> serialized = serialize_bucket(bkt);
-   
-        return serialized;
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Failed to read bucket: " << e.what() << std::endl;
-        // 返回空的65536字节数据
-        return std::vector<uint8_t>(65536, 0);
-    }
-}
-
-
-// 处理 WRITE_BUCKET 请求
-bool handleWriteBucket(const uint8_t* request_data, uint32_t data_len) {
-    if (!g_storage) {
-        std::cout << "Error: ServerStorage not initialized" << std::endl;
-        return false;
-    }
-    
-    if (data_len < 4) {
-        std::cout << "Error: WRITE_BUCKET request data too short" << std::endl;
-        return false;
-    }
-    
-    // 解析桶位置
-    int32_t position = *reinterpret_cast<const int32_t*>(request_data);
-   
-    try {
-        // 反序列化bucket数据（从第5字节开始）
-        if (data_len >= 4 + sizeof(SerializedBucketHeader)) {
-            const uint8_t* bucket_data = request_data + 4;
-            uint32_t bucket_data_len = data_len - 4;
-            
-            bucket bkt_to_write = deserialize_bucket(bucket_data, bucket_data_len);
-          
-            // 执行写入
-            g_storage->SetBucket(position, bkt_to_write);
-          
-            return true;
-        } else {
-            std::cout << "Error: Incomplete bucket data" << std::endl;
-            return false;
-        }
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Write bucket failed: " << e.what() << std::endl;
-        return false;
-    }
-}
-
-std::vector<uint8_t> handleReadPath(const uint8_t* request_data, uint32_t data_len) {
-    if (!g_storage) {
-        std::cout << "Error: ServerStorage not initialized" << std::endl;
-        return {};
-    }
-    
-    if (data_len < 8) {
-        std::cout << "Error: READ_PATH request data too short" << std::endl;
-        return {};
-    }
-    
-    // 解析 leaf_id 和 block_index
-    int32_t leaf_id = *reinterpret_cast<const int32_t*>(request_data);
-    int32_t block_index = *reinterpret_cast<const int32_t*>(request_data + 4);
-    
- 
-    try {
-       
-        block interestblock = dummyBlock;
-        
-        // 遍历路径上的所有层级
-        for (int i = 0; i <= OramL; i++) {
-            int position = (1 << i) - 1 + (leaf_id >> (OramL - i));
-            
-            if (position < 0 || position >= capacity) {
-                std::cout << "Warning: Invalid bucket position: " << position 
-                         << " (leaf_id=" << leaf_id << ", level=" << i << ")" << std::endl;
-                continue;
-            }
-            
-            // 读取bucket
-            bucket& bkt = g_storage->GetBucket(position);
-            
-            // 查找目标块
-            int offset = -1;
-            for (int j = 0; j < (realBlockEachbkt + dummyBlockEachbkt); j++) {
-                if (bkt.ptrs[j] == block_index && bkt.valids[j] == 1) {
-                    offset = j;
-                    break;
-                }
-            }
-            
-            if (offset == -1) {
-                offset = bkt.GetDummyblockOffset();
-            }
-            
-            block blk = bkt.blocks[offset];
-            
-            // 标记为无效
-            bkt.valids[offset] = 0;
-            bkt.count += 1;
-            
-            if (blk.GetBlockindex() == block_index) {
-                interestblock = blk;
-            }
-        }
-        
-        // 准备响应
-        std::vector<uint8_t> response;
-        
-        // 第一个字节：是否是dummy块
-        response.push_back(interestblock.GetBlockindex() == -1 ? 1 : 0);
-        
-        // 如果不是dummy块，添加block数据
-        if (interestblock.GetBlockindex() != -1) {
-            const auto& data = interestblock.GetData();
-            if (!data.empty()) {
-                // 检查数据大小
-                if (data.size() > 4095) {  // 减去1字节的is_dummy标志
-                    std::cerr << "Warning: Block data too large: " << data.size() 
-                              << " bytes, truncated" << std::endl;
-                    response.insert(response.end(), data.begin(), data.begin() + 4095);
-                } else {
-                    response.insert(response.end(), data.begin(), data.end());
-                }
-            }
-        }
-
-        return response;
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Read path failed: " << e.what() << std::endl;
-        return {};
-    }
-}
-
-inline int64_t duration_us(
-    const std::chrono::high_resolution_clock::time_point& end,
-    const std::chrono::high_resolution_clock::time_point& start) {
-    return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
-}
-
-// 处理单个客户端连接
-void handleClient(tcp::socket socket) {
-    try {
-        // === TCP优化设置 ===
-        // 1. 禁用Nagle算法
-        tcp::no_delay no_delay_opt(true);
-        socket.set_option(no_delay_opt);
-        
-        // 2. 禁用TCP延迟确认 (TCP_QUICKACK)
-        int quickack = 1;
-        setsockopt(socket.native_handle(), IPPROTO_TCP, TCP_QUICKACK, &quickack, sizeof(quickack));
-        
-        // 3. 增大TCP缓冲区
-        int buf_size = 65536;
-        setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
-        setsockopt(socket.native_handle(), SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
-        
-        while (true) {
-            // 阶段1: 接收请求头
-            auto t1 = std::chrono::high_resolution_clock::now();
-            RequestHeader header;
-            
-            // 确保在读取前设置QUICKACK
-            setsockopt(socket.native_handle(), IPPROTO_TCP, TCP_QUICKACK, &quickack, sizeof(quickack));
-            boost::asio::read(socket, boost::asio::buffer(&header, sizeof(header)));
-            auto t2 = std::chrono::high_resolution_clock::now();
-            
-            // 阶段2: 接收请求数据
-            std::vector<uint8_t> request_data(header.data_len);
-            if (header.data_len > 0) {
-                setsockopt(socket.native_handle(), IPPROTO_TCP, TCP_QUICKACK, &quickack, sizeof(quickack));
-                boost::asio::read(socket, boost::asio::buffer(request_data.data(), header.data_len));
-            }
-            auto t3 = std::chrono::high_resolution_clock::now();
-            
-            // 阶段3: 处理请求
-            auto t4 = std::chrono::high_resolution_clock::now();
-            std::vector<uint8_t> response_data;
-            bool success = false;
-            
-            switch (header.type) {
-                case READ_BUCKET:
-                    response_data = handleReadBucket(request_data.data(), header.data_len);
-                    success = !response_data.empty();
-                    break;
-                case WRITE_BUCKET:
-                    success = handleWriteBucket(request_data.data(), header.data_len);
-                    break;
-                case READ_PATH:
-                    response_data = handleReadPath(request_data.data(), header.data_len);
-                    success = !response_data.empty();
-                    break;
-            }
-            auto t5 = std::chrono::high_resolution_clock::now();
-            
-            // 阶段4: 发送响应
-            ResponseHeader response;
-            response.type = RESPONSE;
-            response.request_id = header.request_id;
-            response.result = success ? 0 : 1;
-            response.data_len = response_data.size();
-            
-            // 一次性发送响应头和数据（如果可能）
-            if (response_data.empty()) {
-                boost::asio::write(socket, boost::asio::buffer(&response, sizeof(response)));
-            } else {
-                // 合并发送头和数据
-                std::vector<boost::asio::const_buffer> buffers;
-                buffers.push_back(boost::asio::buffer(&response, sizeof(response)));
-                buffers.push_back(boost::asio::buffer(response_data.data(), response_data.size()));
-                boost::asio::write(socket, buffers);
-            }
-            auto t7 = std::chrono::high_resolution_clock::now();
-            
-            // 输出各阶段耗时
-            // std::cout << "[SERVER] Type:" << header.type 
-            //           << " RecvHeader:" << duration_us(t2,t1)
-            //           << " RecvData:" << duration_us(t3,t2)
-            //           << " Process:" << duration_us(t5,t4)
-            //           << " SendTotal:" << duration_us(t7,t5)
-            //           << " Total:" << duration_us(t7,t1) << "us" << std::endl;
-        }
-    }
-    catch (std::exception& e) {
-        std::cout << "Over: " << e.what() << std::endl;
-    }
-}
-
+#include <thread>
+#include "StorageService.h"
+#include "Transport.h"
 
 int main(int argc, char* argv[]) {
     std::cout << "=== Storage Server  ===" << std::endl;
-    
-    // 1. 初始化 ServerStorage
-    try {
-        g_storage = std::make_unique<ServerStorage>();
-        
-        g_storage->setCapacity(capacity);
-    }
-    catch (const std::exception& e) {
-        std::cerr << "ERROR: " << e.what() << std::endl;
+
+    // 用法: ./server [endpoint] [port] [store_file]
+    //   endpoint 为空或 "tcp:<addr>" 时监听 TCP，也可以是 "unix:/path" 或 "shm:name"
+    //   store_file 为 bucket 存储文件：启动时存在则加载，客户端请求 STORE_SAVE 时写入
+    std::string endpoint = "";
+    int port = 12345;
+    std::string store_path = "";
+    if (argc > 1) endpoint = argv[1];
+    if (argc > 2) port = std::stoi(argv[2]);
+    if (argc > 3) store_path = argv[3];
+
+    // 1. 初始化 ServerStorage，加载存储文件
+    if (!initStorageService(store_path)) {
         return 1;
     }
-    
+
     // 2. 启动网络服务器
     try {
-        boost::asio::io_context io_context;
-        tcp::acceptor acceptor(io_context, tcp::endpoint(tcp::v4(), 12345));
+        auto listener = listenTransport(endpoint, port);
         
-        std::cout << "Listening on port: 12345" << std::endl;
+        std::cout << "Listening on: " << listener->describe() << std::endl;
         std::cout << "Waiting for client connection..." << std::endl;
         
-        tcp::socket socket(io_context);
-        acceptor.accept(socket);
-        std::cout << "\n=== client connected ===" << std::endl;
+        // 接受线程常驻；第一个连接建立后，所有连接都断开时服务器退出
+        std::thread(acceptLoop, listener.get()).detach();
+
+        waitForClientsToFinish();
 
-        // 当前线程等待 handleClient 结束
-        handleClient(std::move(socket));
+        // 接受线程仍阻塞在 accept 中，监听器不能在此析构；
+        // 遗留的 unix/shm 名字会在下次启动时清理
+        listener.release();
 
         std::cout << "Client disconnected. Server exit." << std::endl;
     }
@@ -512,4 +48,4 @@ int main(int argc, char* argv[]) {
     }
     
     return 0;
-}
\ No newline at end of file
+}
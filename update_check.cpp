@@ -0,0 +1,185 @@
+// 文档删除 / 更新检查：删除、更新后重新查询，核对结果与块引用，并经快照恢复后再删除一轮
+//
+// 用法：./update_check [数据文件] [端点]
+//   数据文件默认 medium_data.txt，端点默认 shm:oram_update_check
+//
+// 替身服务器（StorageService，见 startLocalServer）与客户端运行在同一进程中，不需要另外启动服务器。
+// 每一步都用全范围的单关键词查询取出全部匹配文档，与按删除 / 更新推算的预期集合比较，
+// 并检查 getBlockStats() 中没有泄漏（unreferenced）或映射不一致（mismatched）的块。
+// 全部通过时返回 0。
+
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "IRTree.h"
+#include "RingoramStorage.h"
+#include "StorageService.h"
+#include "param.h"
+
+namespace {
+
+const char* SNAPSHOT_FILE = "update_check.snapshot";
+const char* STORE_FILE = "update_check.store";
+const char* MARKER = "zzqupdated";
+const int UPDATE_COUNT = 20;
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        g_failures++;
+    }
+}
+
+const MBR& world() {
+    static const MBR scope({ -180.0, -90.0 }, { 180.0, 90.0 });
+    return scope;
+}
+
+// 全范围单关键词查询的全部结果（k 取文档总数，不截断）
+std::set<int> matchingDocuments(IRTree& tree, const std::string& keyword, const MBR& scope, int doc_count) {
+    std::set<int> ids;
+    for (const auto& entry : tree.search({ keyword }, scope, doc_count + 1, 0.5)) {
+        if (entry.isData()) {
+            ids.insert(entry.document->getId());
+        }
+    }
+    return ids;
+}
+
+std::set<int> without(std::set<int> ids, const std::set<int>& removed) {
+    for (int id : removed) {
+        ids.erase(id);
+    }
+    return ids;
+}
+
+void checkBlocks(const RingOramStorage& storage, const std::string& stage) {
+    RingOramStorage::BlockStats stats = storage.getBlockStats();
+    std::cout << stage << ": " << stats.live << " live blocks, " << stats.free << " free, "
+              << stats.reuses << " reused" << std::endl;
+    check(stats.unreferenced == 0, stage + ": " + std::to_string(stats.unreferenced) + " unreferenced blocks");
+    check(stats.mismatched == 0, stage + ": " + std::to_string(stats.mismatched) + " mismatched blocks");
+}
+
+// 每个关键词的匹配集合都应等于 expected 中的对应集合
+void checkQueries(IRTree& tree, const std::map<std::string, std::set<int>>& expected, int doc_count,
+                  const std::string& stage) {
+    for (const auto& entry : expected) {
+        std::set<int> actual = matchingDocuments(tree, entry.first, world(), doc_count);
+        check(actual == entry.second, stage + ": query '" + entry.first + "' returned " +
+              std::to_string(actual.size()) + " documents, expected " + std::to_string(entry.second.size()));
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string data_file = argc > 1 ? argv[1] : "medium_data.txt";
+    std::string endpoint = argc > 2 ? argv[2] : "shm:oram_update_check";
+
+    std::remove(STORE_FILE);
+    std::remove(SNAPSHOT_FILE);
+    if (!startLocalServer(endpoint, 0, STORE_FILE)) {
+        return 1;
+    }
+
+    auto storage = std::make_shared<RingOramStorage>(totalnumRealblock, blocksize, endpoint, 0);
+    IRTree tree(storage, 2, 2, 5);
+    tree.optimizedBulkInsertFromFile(data_file);
+    int doc_count = static_cast<int>(tree.document_locations.size() / 4);
+    if (doc_count == 0) {
+        std::cerr << "No documents loaded from " << data_file << std::endl;
+        return 1;
+    }
+    std::cout << "Loaded " << doc_count << " documents" << std::endl;
+
+    // 基准：每个关键词的匹配集合（不用出现在全部文档中的词，其 IDF 为 0，查询不返回结果）
+    std::map<std::string, std::set<int>> expected;
+    for (const char* keyword : { "pizza", "sushi", "bbq", "burger", "ramen" }) {
+        expected[keyword] = matchingDocuments(tree, keyword, world(), doc_count);
+        check(!expected[keyword].empty(), std::string("query '") + keyword + "' matches some documents");
+    }
+    checkBlocks(*storage, "After build");
+
+    // ==============================
+    // 1. 删除三分之二的文档
+    // ==============================
+    std::set<int> removed;
+    for (int id = 0; id < doc_count; id++) {
+        if (id % 3 != 0) {
+            check(tree.deleteDocument(id), "delete document " + std::to_string(id));
+            removed.insert(id);
+        }
+    }
+    check(!tree.deleteDocument(1), "deleting a deleted document fails");
+    check(!tree.deleteDocument(doc_count + 5), "deleting an unknown document fails");
+    for (auto& entry : expected) {
+        entry.second = without(entry.second, removed);
+    }
+    checkQueries(tree, expected, doc_count, "After delete");
+    checkBlocks(*storage, "After delete");
+
+    // ==============================
+    // 2. 更新：换成新文本并移到 (10 + i, 10)
+    // ==============================
+    std::set<int> updated;
+    for (int id = 0; id < doc_count && static_cast<int>(updated.size()) < UPDATE_COUNT; id += 3) {
+        double x = 10.0 + updated.size();
+        check(tree.updateDocument(id, std::string(MARKER) + " place", MBR({ x, 10.0 }, { x, 10.0 })),
+              "update document " + std::to_string(id));
+        updated.insert(id);
+    }
+    check(!tree.updateDocument(1, "deleted", MBR({ 0.0, 0.0 }, { 0.0, 0.0 })), "updating a deleted document fails");
+    for (auto& entry : expected) {
+        entry.second = without(entry.second, updated);
+    }
+    expected[MARKER] = updated;
+    checkQueries(tree, expected, doc_count, "After update");
+
+    // 更新后的位置：只有新位置所在的范围能查到
+    std::set<int> near_first = matchingDocuments(tree, MARKER, MBR({ 9.5, 9.5 }, { 10.5, 10.5 }), doc_count);
+    check(near_first.size() == 1 && near_first.count(*updated.begin()), "updated document found at its new location");
+    check(matchingDocuments(tree, MARKER, MBR({ -72.0, 42.0 }, { -70.0, 43.0 }), doc_count).empty(),
+          "updated documents no longer found at their old location");
+    checkBlocks(*storage, "After update");
+
+    // ==============================
+    // 3. 保存快照，在新的存储对象上恢复后继续删除（快照须带上文档位置表）
+    // ==============================
+    check(tree.saveSnapshot(SNAPSHOT_FILE), "save snapshot");
+
+    auto restored_storage = std::make_shared<RingOramStorage>(totalnumRealblock, blocksize, endpoint, 0);
+    IRTree restored(restored_storage, 2, 2, 5, false);
+    if (!restored.loadSnapshot(SNAPSHOT_FILE)) {
+        std::cerr << "FAILED: load snapshot" << std::endl;
+        return 1;
+    }
+    checkQueries(restored, expected, doc_count, "After restore");
+
+    std::set<int> removed_after_restore;
+    for (int id = 0; id < doc_count; id += 6) {
+        check(restored.deleteDocument(id), "delete document " + std::to_string(id) + " after restore");
+        removed_after_restore.insert(id);
+    }
+    for (auto& entry : expected) {
+        entry.second = without(entry.second, removed_after_restore);
+    }
+    checkQueries(restored, expected, doc_count, "After restore and delete");
+    checkBlocks(*restored_storage, "After restore and delete");
+
+    std::remove(SNAPSHOT_FILE);
+    std::remove(STORE_FILE);
+
+    if (g_failures > 0) {
+        std::cout << g_failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}